@@ -4,19 +4,36 @@ uniform mat4 uView;
 uniform mat4 uProjection;
 uniform mat4 uArcball;
 uniform mat3 uNormalMatrix;
+// Blend factor of a geomorph, 0 for everything else
+uniform float uMorph;
+// Maps packed positions back to the mesh's box, identity for float ones
+uniform mat4 uDequantize;
+// Set when aNormal holds an octahedral encoded normal in x and y
+uniform bool uOctahedralNormals;
 
 layout (location = 0) in vec4 aPos;
 layout (location = 1) in vec4 aNormal;
 layout (location = 2) in vec4 aColor;
+// Where a geomorph moves the vertex to
+layout (location = 3) in vec4 aEndPos;
 
 out vec3 FragPos;
 out vec3 FragNormal;
 out vec4 FragVertColor;
 
+vec3 DecodeNormal(vec4 normal)
+{
+    if (!uOctahedralNormals) return vec3(normal);
+    vec3 n = vec3(normal.xy, 1.0 - abs(normal.x) - abs(normal.y));
+    if (n.z < 0.0) n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return normalize(n);
+}
+
 void main()
 {
-    gl_Position = uProjection * uView  * uModel * uArcball * aPos;
+    vec4 pos = mix(uDequantize * aPos, aEndPos, uMorph);
+    gl_Position = uProjection * uView  * uModel * uArcball * pos;
     FragPos = vec3(gl_Position);
-    FragNormal = uNormalMatrix * vec3(aNormal);
+    FragNormal = uNormalMatrix * DecodeNormal(aNormal);
     FragVertColor = aColor;
 }
\ No newline at end of file
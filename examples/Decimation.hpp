@@ -1,35 +1,164 @@
 #pragma once
-#include <unordered_set>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
 
 #include "Geometry.hpp"
 
-/// Represents a decimation operation on a ProgMesh. Stores all information regarding that operation
-/// so that it can be reversed.
+/// Represents a decimation operation on a ProgMesh while it is being performed or undone: the vertices involved
+/// and the faces and neighbors around them. The history only keeps the compact VertexSplit of each one.
+/// The lists keep their capacity from one collapse to the next, so reuse a decimation instead of making new ones.
+/// Move-only, so the lists are never copied by accident.
 class Decimation {
 public:
     Decimation() = default;
-    ~Decimation() = default;
-    
-    Decimation(const Decimation & d) :
-    v0(d.v0), v1(d.v1), vNew(d.vNew), v0Faces(d.v0Faces),
-    v1Faces(d.v1Faces), degenFaces(d.degenFaces),
-    v0Neighbors(d.v0Neighbors), v1Neighbors(d.v1Neighbors)
-    {}
-    
+    Decimation(Decimation &&) = default;
+    Decimation & operator=(Decimation &&) = default;
+    Decimation(const Decimation &) = delete;
+    Decimation & operator=(const Decimation &) = delete;
+
     Vertex * v0 = nullptr, * v1 = nullptr;
     Vertex * vNew = nullptr;
-    
-    /// The faces that v0 was a part of, not including faces that both v0 and v1 were part of
+    /// The error of the pair when it was collapsed.
+    float error = 0.f;
+
+    /// The faces that v0 was a part of, not including faces that both v0 and v1 were part of. Sorted by id.
     std::vector<Face *> v0Faces;
-    /// The faces that v1 was a part of, not including faces that both v0 and v1 were part of
+    /// The faces that v1 was a part of, not including faces that both v0 and v1 were part of. Sorted by id.
     std::vector<Face *> v1Faces;
-    /// Faces that v0 and  v1 were both members of that became degeneratea due to the collapse.
+    /// Faces that v0 and v1 were both members of that became degenerate due to the collapse. Sorted by id.
     /// NOTE: v0Faces and v1Faces still exist in the mesh, but degen faces are removed from the mesh
     std::vector<Face *> degenFaces;
-    
-    /// Stores all neighbors of v0, except v1
+
+    /// Stores all neighbors of v0, except v1, sorted by id. Only filled in while collapsing.
     std::vector<Vertex *> v0Neighbors;
-    /// Stores all neighbors of v1, except v0
+    /// Stores all neighbors of v1, except v0, sorted by id. Only filled in while collapsing.
     std::vector<Vertex *> v1Neighbors;
-    
+};
+
+/// A decimation as the history keeps it: everything needed to undo it in a fixed 40 bytes. Vertices and faces are
+/// referred to by id. Everything else is read back from the mesh, which is exactly as the collapse left it by the
+/// time the split is undone: the faces of vNew, by id, are v0Faces and v1Faces merged, and the neighbors follow
+/// from the faces.
+struct VertexSplit {
+    static const uint32_t npos = 0xFFFFFFFFu;
+    static const uint32_t kMaxFaces = 64;
+
+    uint32_t v0, v1, vNew;
+    float error;
+    /// The degenerate faces, usually one on either side of the edge. npos where there are fewer.
+    uint32_t degenFaces[2];
+    /// How many faces vNew has.
+    uint32_t numFaces;
+    /// Where the lists of a split that doesn't fit the other fields start in DecimationStack's overflow array,
+    /// npos for all the others.
+    uint32_t overflow;
+    /// Bit i is set if the i-th face of vNew goes back to v1 rather than v0.
+    uint64_t toV1;
+};
+
+/// The decimations of a mesh, most recent on top, as one contiguous array of VertexSplit records. The rare
+/// collapses with more than two degenerate faces or more than kMaxFaces faces around vNew keep their lists in an
+/// overflow array instead: the number of degenerate faces, their ids, then the toV1 bits in 32 bit words.
+class DecimationStack {
+public:
+    bool Empty() const { return mSplits.empty(); }
+    size_t Size() const { return mSplits.size(); }
+
+    const VertexSplit & Top() const { return mSplits.back(); }
+    /// The i-th decimation, counting from the bottom (the first one performed).
+    const VertexSplit & At(size_t i) const { return mSplits[i]; }
+
+    /// Records a decimation. Its face lists must be filled in.
+    void Push(const Decimation & decimation) {
+        size_t overflow = mOverflow.size();
+        mOverflow.resize(overflow + OverflowSize(decimation), 0);
+        mSplits.emplace_back();
+        Write(decimation, overflow, mSplits.back());
+    }
+
+    /// Records count decimations on top of each other, decimationAt(i) being the i-th from the bottom. The records and
+    /// overflow lists are set aside for all of them first, then written in parallel.
+    template <typename DecimationAt>
+    void Push(size_t count, DecimationAt decimationAt) {
+        size_t firstSplit = mSplits.size();
+        mBulkStarts.resize(count + 1);
+        mBulkStarts[0] = mOverflow.size();
+        for (size_t i = 0; i < count; i++) mBulkStarts[i + 1] = mBulkStarts[i] + OverflowSize(decimationAt(i));
+        mOverflow.resize(mBulkStarts[count], 0);
+        mSplits.resize(firstSplit + count);
+#pragma omp parallel for if(count > 64)
+        for (int i = 0; i < (int)count; i++) {
+            Write(decimationAt(i), mBulkStarts[i], mSplits[firstSplit + i]);
+        }
+    }
+
+    /// Removes the top decimation along with its overflow lists.
+    void Pop() {
+        if (mSplits.back().overflow != VertexSplit::npos) mOverflow.resize(mSplits.back().overflow);
+        mSplits.pop_back();
+    }
+
+    uint32_t NumDegenFaces(const VertexSplit & split) const {
+        if (split.overflow != VertexSplit::npos) return mOverflow[split.overflow];
+        return (split.degenFaces[0] != VertexSplit::npos) + (split.degenFaces[1] != VertexSplit::npos);
+    }
+    uint32_t DegenFace(const VertexSplit & split, uint32_t i) const {
+        return split.overflow != VertexSplit::npos ? mOverflow[split.overflow + 1 + i] : split.degenFaces[i];
+    }
+    /// Whether the i-th face of vNew, by id, goes back to v1 rather than v0.
+    bool ToV1(const VertexSplit & split, uint32_t i) const {
+        if (split.overflow == VertexSplit::npos) return (split.toV1 >> i) & 1;
+        const uint32_t * bits = mOverflow.data() + split.overflow + 1 + mOverflow[split.overflow];
+        return (bits[i / 32] >> (i % 32)) & 1;
+    }
+
+private:
+    /// How many words of the overflow array a decimation needs, none if it fits its VertexSplit.
+    static size_t OverflowSize(const Decimation & decimation) {
+        size_t numFaces = decimation.v0Faces.size() + decimation.v1Faces.size();
+        if (decimation.degenFaces.size() <= 2 && numFaces <= VertexSplit::kMaxFaces) return 0;
+        return 1 + decimation.degenFaces.size() + (numFaces + 31) / 32;
+    }
+
+    /// Fills in the record of a decimation, and its lists from overflow on if it needs any. The overflow words
+    /// must be zero.
+    void Write(const Decimation & decimation, size_t overflow, VertexSplit & split) {
+        split.v0 = decimation.v0->mId;
+        split.v1 = decimation.v1->mId;
+        split.vNew = decimation.vNew->mId;
+        split.error = decimation.error;
+        split.numFaces = (uint32_t)(decimation.v0Faces.size() + decimation.v1Faces.size());
+        split.degenFaces[0] = split.degenFaces[1] = VertexSplit::npos;
+        split.overflow = VertexSplit::npos;
+        split.toV1 = 0;
+
+        const std::vector<Face *> & degenFaces = decimation.degenFaces;
+        if (OverflowSize(decimation) == 0) {
+            for (size_t i = 0; i < degenFaces.size(); i++) split.degenFaces[i] = degenFaces[i]->mId;
+            ForEachMerged(decimation, [&](uint32_t i) { split.toV1 |= uint64_t(1) << i; });
+        } else {
+            split.overflow = (uint32_t)overflow;
+            uint32_t * words = mOverflow.data() + overflow;
+            *words++ = (uint32_t)degenFaces.size();
+            for (Face * aFace : degenFaces) *words++ = aFace->mId;
+            ForEachMerged(decimation, [&](uint32_t i) { words[i / 32] |= 1u << (i % 32); });
+        }
+    }
+
+    /// Calls fn(i) for every face of v1Faces, where i is its position among v0Faces and v1Faces merged by id.
+    template <typename Fn>
+    static void ForEachMerged(const Decimation & decimation, Fn fn) {
+        size_t i0 = 0;
+        for (size_t i1 = 0; i1 < decimation.v1Faces.size(); i1++) {
+            uint32_t id = decimation.v1Faces[i1]->mId;
+            while (i0 < decimation.v0Faces.size() && decimation.v0Faces[i0]->mId < id) i0++;
+            fn((uint32_t)(i0 + i1));
+        }
+    }
+
+    std::vector<VertexSplit> mSplits;
+    std::vector<uint32_t> mOverflow;
+    /// Scratch space of the bulk Push: where the overflow lists of each decimation start.
+    std::vector<size_t> mBulkStarts;
 };
@@ -2,6 +2,7 @@
 
 #include <glm/glm.hpp>
 #include <vector>
+#include <cstdint>
 #include <cassert>
 #include <functional>
 #include "Utilities.hpp"
@@ -11,17 +12,16 @@ struct Vertex {
 	Vertex(glm::vec4 _pos = glm::vec4(0, 0, 0, 1.f),
 			 glm::vec4 _norm = glm::vec4(0.f),
 			 glm::vec4 _color = glm::vec4(1.f, 0.4f, 0.1f, 1.f)) :
-			mPos(_pos), mNormal(_norm), mColor(_color),
-            mId(sCount++)
+			mPos(_pos), mNormal(_norm), mColor(_color)
 			{}
     Vertex(const Vertex & other) :
     mPos(other.mPos), mNormal(other.mNormal),
-    mColor(other.mColor), mId(other.mId)
+    mColor(other.mColor), mId(other.mId), mSlot(other.mSlot)
     {}
 
 
     Vertex& operator=(const Vertex & other) {
-    	if(mId != other.mId) { //Self assignment check
+    	if(this != &other) { //Self assignment check
 	    	mPos = other.mPos;
 	    	mNormal = other.mNormal;
 	    	mColor = other.mColor;
@@ -32,8 +32,11 @@ struct Vertex {
 	glm::vec4 mPos;
 	glm::vec4 mNormal;
 	glm::vec4 mColor;
-	const size_t mId;
-	static size_t sCount;
+	/// Dense id assigned by the mesh owning the vertex, unique within that mesh only.
+	/// It is also the index of the vertex in the mesh's vertex pool and connectivity.
+	uint32_t mId = 0xFFFFFFFFu;
+	/// Position of this vertex in its mesh's vertex array (and so in the vertex buffer), if it is part of the mesh.
+	uint32_t mSlot = 0xFFFFFFFFu;
 };
 
 
@@ -46,20 +49,20 @@ inline bool operator==(const Vertex & lhs, const Vertex & rhs)  {
 
 struct Face
 {
-    Face(): mId(sCount++) {
+    Face() {
         mVertices[0] = mVertices[1] = mVertices[2] = nullptr;
     }
 
-    Face(Vertex & v0, Vertex & v1, Vertex & v2): mId(sCount++) {
+    Face(Vertex & v0, Vertex & v1, Vertex & v2) {
         mVertices[0] = &v0; mVertices[1] = &v1; mVertices[2] = & v2;
     }
 
-    Face(Vertex * v0, Vertex * v1, Vertex * v2): mId(sCount++) {
+    Face(Vertex * v0, Vertex * v1, Vertex * v2) {
         mVertices[0] = v0; mVertices[1] = v1; mVertices[2] = v2;
     }
 
 
-    Face(const Face & other) : mId(other.mId) {
+    Face(const Face & other) : mId(other.mId), mSlot(other.mSlot) {
 	    mVertices[0] = other.mVertices[0];
         mVertices[1] = other.mVertices[1];
         mVertices[2] = other.mVertices[2];
@@ -94,8 +97,11 @@ struct Face
     }
 
 	Vertex* mVertices[3];
-    const size_t mId;
-    static size_t sCount ;
+    /// Dense id assigned by the mesh owning the face, unique within that mesh only.
+    /// It is also the index of the face in the mesh's face pool and connectivity.
+    uint32_t mId = 0xFFFFFFFFu;
+    /// Position of this face in its mesh's face list (and so of its triangle in the index buffer), if it is part of the mesh.
+    uint32_t mSlot = 0xFFFFFFFFu;
 };
 
 class Pair {
@@ -114,7 +120,7 @@ public:
 	{}
     
     Pair & operator=(const Pair & other) {
-        if(other.v0 != v0 && other.v1 != v1) {
+        if(this != &other) {
             v0 = other.v0;
             v1 = other.v1;
         }
@@ -137,7 +143,7 @@ namespace std {
         typedef Vertex argument_type;
         typedef std::size_t result_type;
         result_type operator()(argument_type const& v) const {
-            return std::hash<size_t>{}(v.mId);
+            return std::hash<uint32_t>{}(v.mId);
         }
     };
 
@@ -145,7 +151,7 @@ namespace std {
         typedef Face argument_type;
         typedef std::size_t result_type;
         result_type operator()(argument_type const& f) const  {
-            return std::hash<size_t>{}(f.mId);
+            return std::hash<uint32_t>{}(f.mId);
         }
     };
 
@@ -182,3 +188,9 @@ inline bool operator==(const Face & lhs, const Face & rhs) {
 }
 
 typedef std::pair<Vertex *, Vertex*> Edge;
+
+/// Orders vertices or faces by id, so that results don't depend on where they happen to be allocated.
+struct IdLess {
+    template <typename T>
+    bool operator()(const T * lhs, const T * rhs) const { return lhs->mId < rhs->mId; }
+};
@@ -0,0 +1,65 @@
+#include "Geomorph.hpp"
+
+#include <algorithm>
+
+static const uint32_t kInactive = 0xFFFFFFFFu;
+
+static glm::vec4 Vec4(const float * v, float w) {
+    return glm::vec4(v[0], v[1], v[2], w);
+}
+
+void GeomorphBuilder::Build(uint32_t fromLevel, uint32_t toLevel, Geomorph & morph) {
+    const PMHeader & header = mFile.Header();
+    const PMVertex * fileVertices = mFile.Vertices();
+    const PMSplit * splits = mFile.Splits();
+    const uint32_t * faceRefs = mFile.FaceRefs();
+    uint32_t coarse = std::min(fromLevel, toLevel);
+    uint32_t fine = std::max(fromLevel, toLevel);
+    uint32_t numVertices = header.numBaseVertices + 2 * fine;
+    uint32_t numCoarseVertices = header.numBaseVertices + 2 * coarse;
+    uint32_t numFaces = mFile.Levels()[fine].numFaces;
+    morph.fromLevel = fromLevel;
+    morph.toLevel = toLevel;
+
+    // A vertex brought in after the coarse level is part of whatever the vertex it was split from is part of there.
+    // That vertex always comes earlier.
+    mAncestor.resize(numVertices);
+    for (uint32_t v = 0; v < numVertices; v++) {
+        mAncestor[v] = v < numCoarseVertices ? v : mAncestor[splits[mFile.ParentSplit(v)].vertex];
+    }
+
+    // The fine mesh has every vertex up to it that no split up to it has split.
+    mMorphIndex.assign(numVertices, 0);
+    for (uint32_t s = 0; s < fine; s++) {
+        mMorphIndex[splits[s].vertex] = kInactive;
+    }
+    morph.vertices.clear();
+    morph.fileVertices.clear();
+    for (uint32_t v = 0; v < numVertices; v++) {
+        if (mMorphIndex[v] == kInactive) continue;
+        mMorphIndex[v] = (uint32_t)morph.vertices.size();
+        const PMVertex & vertex = fileVertices[v];
+        GeomorphVertex morphVertex;
+        morphVertex.mPos = Vec4(vertex.position, 1.f);
+        morphVertex.mNormal = Vec4(vertex.normal, 0.f);
+        morphVertex.mColor = glm::vec4(vertex.color[0], vertex.color[1], vertex.color[2], vertex.color[3]);
+        morphVertex.mEndPos = Vec4(fileVertices[mAncestor[v]].position, 1.f);
+        if (fromLevel < toLevel) std::swap(morphVertex.mPos, morphVertex.mEndPos);
+        morph.vertices.push_back(morphVertex);
+        morph.fileVertices.push_back(v);
+    }
+
+    // Faces are stored with the corners they have when they appear, the splits after that move them along.
+    morph.indices.assign(mFile.Faces(), mFile.Faces() + 3 * (size_t)numFaces);
+    for (uint32_t s = 0; s < fine; s++) {
+        const PMSplit & split = splits[s];
+        for (uint32_t i = 0; i < split.numV0Faces + split.numV1Faces; i++) {
+            uint32_t * corners = morph.indices.data() + 3 * (size_t)faceRefs[split.firstFaceRef + i];
+            uint32_t child = i < split.numV0Faces ? mFile.SplitV0(s) : mFile.SplitV1(s);
+            std::replace(corners, corners + 3, split.vertex, child);
+        }
+    }
+    for (uint32_t & index : morph.indices) {
+        index = mMorphIndex[index];
+    }
+}
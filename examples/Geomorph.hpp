@@ -0,0 +1,53 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <vector>
+#include <cstdint>
+#include "ProgMeshFile.hpp"
+
+/// A vertex of a geomorph. Starts out like Vertex, so the same shader inputs apply, followed by where it ends up.
+struct GeomorphVertex {
+    glm::vec4 mPos;
+    glm::vec4 mNormal;
+    glm::vec4 mColor;
+    glm::vec4 mEndPos;
+};
+
+/**
+ * A smooth transition between two levels of a progressive mesh (Hoppe, Progressive meshes, 1996, section 4.2).
+ * It is the finer of the two meshes, with every vertex moving between where it is in the fine mesh and where the
+ * vertex it descends from is in the coarse one. Faces the coarse mesh doesn't have have no area at that end.
+ *
+ * Drawing it takes a single blend factor t for the whole transition, however many splits it covers: the position of
+ * every vertex is mix(mPos, mEndPos, t). At t = 0 it looks exactly like the level it comes from, at t = 1 like the
+ * one it goes to. Normals and colors are the ones of the fine mesh throughout.
+ */
+struct Geomorph {
+    uint32_t fromLevel = 0, toLevel = 0;
+    std::vector<GeomorphVertex> vertices;
+    /// Three vertices per face, the faces of the finer level.
+    std::vector<uint32_t> indices;
+    /// The file index of each vertex.
+    std::vector<uint32_t> fileVertices;
+
+    /// Where a vertex is at blend factor t, as the vertex shader computes it.
+    glm::vec4 PositionAt(size_t vertex, float t) const {
+        return vertices[vertex].mPos * (1.f - t) + vertices[vertex].mEndPos * t;
+    }
+};
+
+/// Builds geomorphs between any two available levels of a progressive mesh file. Needs nothing but the file, in
+/// particular no GPU. Keeps its scratch space from one geomorph to the next.
+class GeomorphBuilder {
+public:
+    explicit GeomorphBuilder(const ProgMeshFile & file): mFile(file) {}
+
+    /// Builds the geomorph from one level to another, refining if toLevel is the larger one and coarsening otherwise.
+    /// Both levels must be available. Takes time linear in the size of the finer mesh.
+    void Build(uint32_t fromLevel, uint32_t toLevel, Geomorph & morph);
+
+private:
+    const ProgMeshFile & mFile;
+    /// Per file vertex: the vertex it is part of in the coarse mesh, and its index in the geomorph.
+    std::vector<uint32_t> mAncestor;
+    std::vector<uint32_t> mMorphIndex;
+};
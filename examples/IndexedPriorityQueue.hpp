@@ -0,0 +1,134 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cassert>
+
+/// A min-heap of 32-bit ids with an in-place position table, so the key of any queued id can be
+/// raised, lowered or removed in O(log n) without searching for it.
+/// Ids are expected to be dense (e.g. slots in a table), the position and key tables grow to the largest id pushed.
+class IndexedPriorityQueue {
+public:
+    static const uint32_t npos = 0xFFFFFFFFu;
+
+    IndexedPriorityQueue() = default;
+
+    void Reserve(size_t numIds) {
+        mHeap.reserve(numIds);
+        mPositions.reserve(numIds);
+        mKeys.reserve(numIds);
+    }
+
+    void Clear() {
+        mHeap.clear();
+        mPositions.clear();
+        mKeys.clear();
+    }
+
+    bool Empty() const { return mHeap.empty(); }
+    size_t Size() const { return mHeap.size(); }
+
+    bool Contains(uint32_t id) const { return id < mPositions.size() && mPositions[id] != npos; }
+
+    /// The id with the smallest key. The queue must not be empty.
+    uint32_t Top() const { assert(!mHeap.empty()); return mHeap.front(); }
+
+    /// The key the given id is queued with. The id must be queued.
+    float Key(uint32_t id) const { assert(Contains(id)); return mKeys[id]; }
+
+    /// Queues an id that is not already in the queue.
+    void Push(uint32_t id, float key) {
+        assert(!Contains(id));
+        if (id >= mPositions.size()) {
+            mPositions.resize(id + 1, uint32_t(npos));
+            mKeys.resize(id + 1);
+        }
+        mKeys[id] = key;
+        mPositions[id] = (uint32_t)mHeap.size();
+        mHeap.push_back(id);
+        SiftUp(mPositions[id]);
+    }
+
+    /// Changes the key of a queued id, moving it up or down as needed.
+    void Update(uint32_t id, float key) {
+        assert(Contains(id));
+        float oldKey = mKeys[id];
+        mKeys[id] = key;
+        if (key < oldKey) SiftUp(mPositions[id]);
+        else SiftDown(mPositions[id]);
+    }
+
+    /// Pushes the id if it is not queued, updates its key otherwise.
+    void PushOrUpdate(uint32_t id, float key) {
+        if (Contains(id)) Update(id, key);
+        else Push(id, key);
+    }
+
+    /// Removes an id from the queue. Does nothing if it is not queued.
+    void Remove(uint32_t id) {
+        if (!Contains(id)) return;
+        uint32_t pos = mPositions[id];
+        mPositions[id] = npos;
+        uint32_t last = mHeap.back();
+        mHeap.pop_back();
+        if (last == id) return;
+
+        // Move the last element into the hole and let it settle either way.
+        mHeap[pos] = last;
+        mPositions[last] = pos;
+        SiftUp(pos);
+        SiftDown(mPositions[last]);
+    }
+
+    /// Removes and returns the id with the smallest key.
+    uint32_t Pop() {
+        uint32_t id = Top();
+        Remove(id);
+        return id;
+    }
+
+private:
+    /// Four children per node keeps the tree shallow and a node's children within one cache line.
+    static const uint32_t kArity = 4;
+
+    void SiftUp(uint32_t pos) {
+        uint32_t id = mHeap[pos];
+        float key = mKeys[id];
+        while (pos > 0) {
+            uint32_t parent = (pos - 1) / kArity;
+            if (!(key < mKeys[mHeap[parent]])) break;
+            mHeap[pos] = mHeap[parent];
+            mPositions[mHeap[pos]] = pos;
+            pos = parent;
+        }
+        mHeap[pos] = id;
+        mPositions[id] = pos;
+    }
+
+    void SiftDown(uint32_t pos) {
+        uint32_t id = mHeap[pos];
+        float key = mKeys[id];
+        const uint32_t size = (uint32_t)mHeap.size();
+        while (true) {
+            uint32_t first = pos * kArity + 1;
+            if (first >= size) break;
+            uint32_t last = first + kArity < size ? first + kArity : size;
+            uint32_t best = first;
+            for (uint32_t c = first + 1; c < last; c++) {
+                if (mKeys[mHeap[c]] < mKeys[mHeap[best]]) best = c;
+            }
+            if (!(mKeys[mHeap[best]] < key)) break;
+            mHeap[pos] = mHeap[best];
+            mPositions[mHeap[pos]] = pos;
+            pos = best;
+        }
+        mHeap[pos] = id;
+        mPositions[id] = pos;
+    }
+
+    /// The heap itself, ids ordered by key.
+    std::vector<uint32_t> mHeap;
+    /// Position of each id in mHeap, or npos if it is not queued.
+    std::vector<uint32_t> mPositions;
+    /// Key of each id, indexed by id.
+    std::vector<float> mKeys;
+};
@@ -0,0 +1,67 @@
+#include "MappedFile.hpp"
+
+#include <iostream>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+bool MappedFile::Map(const std::string & path) {
+    Unmap();
+
+#if defined(_WIN32)
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        std::cerr << "ERROR: File " << path << " does not exist." << std::endl;
+        return false;
+    }
+    LARGE_INTEGER fileSize;
+    GetFileSizeEx(file, &fileSize);
+    size_t size = (size_t)fileSize.QuadPart;
+    // The view keeps the mapping, and the mapping the file, alive once the handles are closed.
+    HANDLE mapping = size > 0 ? CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+    void * view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (mapping) CloseHandle(mapping);
+    CloseHandle(file);
+#else
+    int file = open(path.c_str(), O_RDONLY);
+    if (file < 0) {
+        std::cerr << "ERROR: File " << path << " does not exist." << std::endl;
+        return false;
+    }
+    struct stat fileStat;
+    size_t size = fstat(file, &fileStat) == 0 ? (size_t)fileStat.st_size : 0;
+    void * view = size > 0 ? mmap(nullptr, size, PROT_READ, MAP_SHARED, file, 0) : MAP_FAILED;
+    if (view == MAP_FAILED) view = nullptr;
+    // The mapping keeps the file alive.
+    close(file);
+#endif
+    if (!view) {
+        std::cerr << "ERROR: Unable to map " << path << std::endl;
+        return false;
+    }
+
+    mData = view;
+    mSize = size;
+    return true;
+}
+
+void MappedFile::Unmap() {
+    if (mData) {
+#if defined(_WIN32)
+        UnmapViewOfFile(mData);
+#else
+        munmap(mData, mSize);
+#endif
+    }
+    mData = nullptr;
+    mSize = 0;
+}
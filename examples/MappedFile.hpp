@@ -0,0 +1,28 @@
+#pragma once
+#include <string>
+#include <cstddef>
+
+/**
+ * A file mapped read-only into memory. Pages are read as they are first touched, and processes mapping the same
+ * file share them. The mapping starts on a page boundary.
+ */
+class MappedFile {
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile &) = delete;
+    MappedFile & operator=(const MappedFile &) = delete;
+    ~MappedFile() { Unmap(); }
+
+    /// Maps the whole file, unmapping the previous one. Returns false, leaving the object empty, if the file doesn't
+    /// exist, is empty or can't be mapped.
+    bool Map(const std::string & path);
+    void Unmap();
+
+    bool IsMapped() const { return mData != nullptr; }
+    const char * Data() const { return static_cast<const char *>(mData); }
+    size_t Size() const { return mSize; }
+
+private:
+    void * mData = nullptr;
+    size_t mSize = 0;
+};
@@ -0,0 +1,222 @@
+#include "MeshConnectivity.hpp"
+#include <cassert>
+
+void MeshConnectivity::Clear() {
+    mCornerVertex.clear();
+    mCornerNext.clear();
+    mCornerPrev.clear();
+    mVertexCorner.clear();
+    mVertexEdge.clear();
+    mEdges.clear();
+    mFreeEdges.clear();
+    mNumEdges = 0;
+}
+
+void MeshConnectivity::Reserve(size_t numVertices, size_t numFaces) {
+    mCornerVertex.reserve(numFaces * 3);
+    mCornerNext.reserve(numFaces * 3);
+    mCornerPrev.reserve(numFaces * 3);
+    mVertexCorner.reserve(numVertices);
+    mVertexEdge.reserve(numVertices);
+    // A closed triangle mesh has 1.5 edges per face.
+    mEdges.reserve(numFaces * 3 / 2 + 1);
+}
+
+void MeshConnectivity::GrowVertices(uint32_t v) {
+    if (v >= mVertexCorner.size()) {
+        mVertexCorner.resize(size_t(v) + 1, uint32_t(npos));
+        mVertexEdge.resize(size_t(v) + 1, uint32_t(npos));
+    }
+}
+
+void MeshConnectivity::AddFace(uint32_t f, uint32_t v0, uint32_t v1, uint32_t v2) {
+    size_t firstCorner = 3 * size_t(f);
+    if (firstCorner >= mCornerVertex.size()) {
+        mCornerVertex.resize(firstCorner + 3, uint32_t(npos));
+        mCornerNext.resize(firstCorner + 3, uint32_t(npos));
+        mCornerPrev.resize(firstCorner + 3, uint32_t(npos));
+    }
+    assert(!HasFace(f));
+
+    const uint32_t verts[3] = { v0, v1, v2 };
+    for (int i = 0; i < 3; i++) {
+        GrowVertices(verts[i]);
+        LinkCorner(uint32_t(firstCorner + i), verts[i]);
+    }
+    AcquireEdge(v0, v1, nullptr);
+    AcquireEdge(v1, v2, nullptr);
+    AcquireEdge(v2, v0, nullptr);
+}
+
+void MeshConnectivity::RemoveFace(uint32_t f, EdgeBudget * budget) {
+    assert(HasFace(f));
+    uint32_t firstCorner = 3 * f;
+    uint32_t v0 = mCornerVertex[firstCorner];
+    uint32_t v1 = mCornerVertex[firstCorner + 1];
+    uint32_t v2 = mCornerVertex[firstCorner + 2];
+
+    ReleaseEdge(v0, v1, budget);
+    ReleaseEdge(v1, v2, budget);
+    ReleaseEdge(v2, v0, budget);
+    for (uint32_t c = firstCorner; c < firstCorner + 3; c++) {
+        UnlinkCorner(c);
+    }
+}
+
+bool MeshConnectivity::ReplaceVertex(uint32_t f, uint32_t oldV, uint32_t newV, EdgeBudget * budget) {
+    assert(HasFace(f));
+    uint32_t firstCorner = 3 * f;
+    for (int i = 0; i < 3; i++) {
+        uint32_t c = firstCorner + i;
+        if (mCornerVertex[c] != oldV) continue;
+
+        uint32_t a = mCornerVertex[firstCorner + (i + 1) % 3];
+        uint32_t b = mCornerVertex[firstCorner + (i + 2) % 3];
+
+        // Take the new edges before releasing the old ones, so an edge between a and b is never dropped
+        // and re-created with a different id.
+        GrowVertices(newV);
+        AcquireEdge(newV, a, budget);
+        AcquireEdge(newV, b, budget);
+        ReleaseEdge(oldV, a, budget);
+        ReleaseEdge(oldV, b, budget);
+
+        UnlinkCorner(c);
+        LinkCorner(c, newV);
+        return true;
+    }
+    return false;
+}
+
+void MeshConnectivity::TakeEdges(EdgeBudget & budget, size_t count) {
+    TakeEdgeIds(budget.freeEdges, count);
+}
+
+void MeshConnectivity::TakeEdgeIds(std::vector<uint32_t> & ids, size_t count) {
+    // The free list is used from the back, then the table grows by what is missing.
+    size_t reused = std::min(count, mFreeEdges.size());
+    ids.insert(ids.end(), mFreeEdges.rbegin(), mFreeEdges.rbegin() + reused);
+    mFreeEdges.resize(mFreeEdges.size() - reused);
+    size_t first = mEdges.size();
+    EdgeRecord unused = {{npos, npos}, {npos, npos}, {npos, npos}, 0};
+    mEdges.resize(first + (count - reused), unused);
+    for (size_t e = first; e < mEdges.size(); e++) ids.push_back(uint32_t(e));
+}
+
+void MeshConnectivity::ReturnEdges(EdgeBudget & budget) {
+    mFreeEdges.insert(mFreeEdges.end(), budget.freeEdges.begin(), budget.freeEdges.end());
+    mNumEdges += budget.numEdgesAdded;
+    budget.freeEdges.clear();
+    budget.numEdgesAdded = 0;
+}
+
+uint32_t MeshConnectivity::FindEdge(uint32_t a, uint32_t b) const {
+    if (a >= mVertexEdge.size()) return npos;
+    for (uint32_t e = mVertexEdge[a]; e != npos;) {
+        const EdgeRecord & edge = mEdges[e];
+        int side = edge.v[0] == a ? 0 : 1;
+        if (edge.v[1 - side] == b) return e;
+        e = edge.next[side];
+    }
+    return npos;
+}
+
+size_t MeshConnectivity::NumFaces(uint32_t v) const {
+    size_t count = 0;
+    ForEachFace(v, [&count](uint32_t) { count++; });
+    return count;
+}
+
+size_t MeshConnectivity::NumNeighbors(uint32_t v) const {
+    size_t count = 0;
+    ForEachNeighbor(v, [&count](uint32_t, uint32_t) { count++; });
+    return count;
+}
+
+void MeshConnectivity::LinkCorner(uint32_t c, uint32_t v) {
+    uint32_t head = mVertexCorner[v];
+    mCornerVertex[c] = v;
+    mCornerPrev[c] = npos;
+    mCornerNext[c] = head;
+    if (head != npos) mCornerPrev[head] = c;
+    mVertexCorner[v] = c;
+}
+
+void MeshConnectivity::UnlinkCorner(uint32_t c) {
+    uint32_t v = mCornerVertex[c];
+    uint32_t prev = mCornerPrev[c];
+    uint32_t next = mCornerNext[c];
+    if (prev != npos) mCornerNext[prev] = next;
+    else mVertexCorner[v] = next;
+    if (next != npos) mCornerPrev[next] = prev;
+
+    mCornerVertex[c] = mCornerNext[c] = mCornerPrev[c] = npos;
+}
+
+void MeshConnectivity::AcquireEdge(uint32_t a, uint32_t b, EdgeBudget * budget) {
+    // Degenerate input faces repeat a vertex; they do not make an edge.
+    if (a == b) return;
+
+    uint32_t e = FindEdge(a, b);
+    if (e == npos) {
+        if (budget) {
+            assert(!budget->freeEdges.empty());
+            e = budget->freeEdges.back();
+            budget->freeEdges.pop_back();
+        } else if (!mFreeEdges.empty()) {
+            e = mFreeEdges.back();
+            mFreeEdges.pop_back();
+        } else {
+            e = uint32_t(mEdges.size());
+            mEdges.emplace_back();
+        }
+        EdgeRecord & edge = mEdges[e];
+        edge.v[0] = a;
+        edge.v[1] = b;
+        edge.numFaces = 0;
+        LinkEdge(e, 0);
+        LinkEdge(e, 1);
+        if (budget) budget->numEdgesAdded++;
+        else mNumEdges++;
+    }
+    mEdges[e].numFaces++;
+}
+
+void MeshConnectivity::ReleaseEdge(uint32_t a, uint32_t b, EdgeBudget * budget) {
+    if (a == b) return;
+
+    uint32_t e = FindEdge(a, b);
+    assert(e != npos);
+    if (--mEdges[e].numFaces > 0) return;
+
+    UnlinkEdge(e, 0);
+    UnlinkEdge(e, 1);
+    mEdges[e].v[0] = mEdges[e].v[1] = npos;
+    if (budget) {
+        budget->freeEdges.push_back(e);
+        budget->numEdgesAdded--;
+    } else {
+        mFreeEdges.push_back(e);
+        mNumEdges--;
+    }
+}
+
+void MeshConnectivity::LinkEdge(uint32_t e, int side) {
+    EdgeRecord & edge = mEdges[e];
+    uint32_t v = edge.v[side];
+    uint32_t head = mVertexEdge[v];
+    edge.prev[side] = npos;
+    edge.next[side] = head;
+    if (head != npos) mEdges[head].prev[SideOf(head, v)] = e;
+    mVertexEdge[v] = e;
+}
+
+void MeshConnectivity::UnlinkEdge(uint32_t e, int side) {
+    EdgeRecord & edge = mEdges[e];
+    uint32_t v = edge.v[side];
+    uint32_t prev = edge.prev[side];
+    uint32_t next = edge.next[side];
+    if (prev != npos) mEdges[prev].next[SideOf(prev, v)] = next;
+    else mVertexEdge[v] = next;
+    if (next != npos) mEdges[next].prev[SideOf(next, v)] = prev;
+}
@@ -0,0 +1,167 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * Index based connectivity of a triangle mesh: which faces use a vertex and which vertices share an edge.
+ *
+ * Every face has three corners. The corners of a vertex and the edges of a vertex are kept in intrusive doubly
+ * linked lists threaded through flat arrays, so one-ring traversal, adding or removing a face and moving a corner
+ * from one vertex to another are all O(valence) and never allocate once the tables have grown.
+ *
+ * Edges exist exactly as long as at least one face uses them. Each undirected edge has a single id that stays
+ * the same for as long as the edge exists; ids of removed edges are recycled.
+ *
+ * Unlike a half-edge structure this makes no manifold assumptions, so scanned meshes with non-manifold edges and
+ * vertices work the same as clean ones.
+ *
+ * Faces can be edited from several threads at once if each thread uses its own EdgeBudget, no two threads edit
+ * faces sharing a vertex, and the vertex tables already cover every vertex involved (see ReserveVertex).
+ */
+class MeshConnectivity {
+public:
+    static const uint32_t npos = 0xFFFFFFFFu;
+
+    /// Edge ids set aside for one thread. Edges created while editing with a budget take their ids from it,
+    /// and edges removed give theirs back to it, so the shared free list is never touched.
+    struct EdgeBudget {
+        std::vector<uint32_t> freeEdges;
+        /// Edges created minus edges removed with this budget.
+        ptrdiff_t numEdgesAdded = 0;
+    };
+
+    void Clear();
+    void Reserve(size_t numVertices, size_t numFaces);
+
+    /// Adds face f with the given vertices. Face and vertex ids are chosen by the caller and may be sparse.
+    void AddFace(uint32_t f, uint32_t v0, uint32_t v1, uint32_t v2);
+    /// Removes face f, and any edge no other face is using.
+    void RemoveFace(uint32_t f, EdgeBudget * budget = nullptr);
+    /// Moves the corner of face f that uses oldV over to newV. Returns false if the face does not use oldV.
+    bool ReplaceVertex(uint32_t f, uint32_t oldV, uint32_t newV, EdgeBudget * budget = nullptr);
+
+    /// Makes room for vertex v in the vertex tables.
+    void ReserveVertex(uint32_t v) { GrowVertices(v); }
+    /// Moves count free edge ids into the budget, growing the edge table if there are not enough.
+    void TakeEdges(EdgeBudget & budget, size_t count);
+    /// Puts the unused ids of the budget back and accounts for the edges created and removed with it.
+    void ReturnEdges(EdgeBudget & budget);
+
+    /// TakeEdges for count budgets at once, budgetAt(i) being the i-th and numEdgesAt(i) the ids it needs. The budgets
+    /// get the ids they would get one after the other, and are filled in parallel.
+    template <typename BudgetAt, typename NumEdgesAt>
+    void TakeEdges(size_t count, BudgetAt budgetAt, NumEdgesAt numEdgesAt) {
+        mBulkStarts.resize(count + 1);
+        mBulkStarts[0] = 0;
+        for (size_t i = 0; i < count; i++) mBulkStarts[i + 1] = mBulkStarts[i] + numEdgesAt(i);
+        mBulkEdges.clear();
+        TakeEdgeIds(mBulkEdges, mBulkStarts[count]);
+#pragma omp parallel for if(count > 64)
+        for (int i = 0; i < (int)count; i++) {
+            std::vector<uint32_t> & freeEdges = budgetAt(i).freeEdges;
+            freeEdges.insert(freeEdges.end(), mBulkEdges.begin() + mBulkStarts[i], mBulkEdges.begin() + mBulkStarts[i + 1]);
+        }
+    }
+
+    /// ReturnEdges for count budgets at once, in order, budgetAt(i) being the i-th. The ids are copied back in parallel.
+    template <typename BudgetAt>
+    void ReturnEdges(size_t count, BudgetAt budgetAt) {
+        mBulkStarts.resize(count + 1);
+        mBulkStarts[0] = mFreeEdges.size();
+        ptrdiff_t numEdgesAdded = 0;
+        for (size_t i = 0; i < count; i++) {
+            const EdgeBudget & budget = budgetAt(i);
+            mBulkStarts[i + 1] = mBulkStarts[i] + budget.freeEdges.size();
+            numEdgesAdded += budget.numEdgesAdded;
+        }
+        mFreeEdges.resize(mBulkStarts[count]);
+#pragma omp parallel for if(count > 64)
+        for (int i = 0; i < (int)count; i++) {
+            EdgeBudget & budget = budgetAt(i);
+            std::copy(budget.freeEdges.begin(), budget.freeEdges.end(), mFreeEdges.begin() + mBulkStarts[i]);
+            budget.freeEdges.clear();
+            budget.numEdgesAdded = 0;
+        }
+        mNumEdges += numEdgesAdded;
+    }
+
+    bool HasFace(uint32_t f) const { return 3 * size_t(f) < mCornerVertex.size() && mCornerVertex[3 * f] != npos; }
+    uint32_t FaceVertex(uint32_t f, int i) const { return mCornerVertex[3 * f + i]; }
+
+    /// Returns the edge between a and b, or npos if there is none.
+    uint32_t FindEdge(uint32_t a, uint32_t b) const;
+    bool HasEdge(uint32_t e) const { return e < mEdges.size() && mEdges[e].v[0] != npos; }
+    uint32_t EdgeVertex(uint32_t e, int i) const { return mEdges[e].v[i]; }
+    /// Number of faces using edge e.
+    uint32_t EdgeNumFaces(uint32_t e) const { return mEdges[e].numFaces; }
+    /// Number of edges that currently exist.
+    size_t NumEdges() const { return mNumEdges; }
+    /// One past the largest edge id in use, for sizing tables indexed by edge.
+    size_t EdgeCapacity() const { return mEdges.size(); }
+
+    /// Calls fn(faceId) for each face that uses vertex v. fn must not modify the connectivity.
+    template <typename Fn>
+    void ForEachFace(uint32_t v, Fn fn) const {
+        if (v >= mVertexCorner.size()) return;
+        for (uint32_t c = mVertexCorner[v]; c != npos; c = mCornerNext[c]) {
+            fn(c / 3);
+        }
+    }
+
+    /// Calls fn(neighborId, edgeId) for each vertex sharing an edge with v. fn must not modify the connectivity.
+    template <typename Fn>
+    void ForEachNeighbor(uint32_t v, Fn fn) const {
+        if (v >= mVertexEdge.size()) return;
+        for (uint32_t e = mVertexEdge[v]; e != npos;) {
+            const EdgeRecord & edge = mEdges[e];
+            int side = edge.v[0] == v ? 0 : 1;
+            uint32_t next = edge.next[side];
+            fn(edge.v[1 - side], e);
+            e = next;
+        }
+    }
+
+    size_t NumFaces(uint32_t v) const;
+    size_t NumNeighbors(uint32_t v) const;
+
+private:
+    struct EdgeRecord {
+        /// The two vertices of the edge, npos if the record is free.
+        uint32_t v[2];
+        /// Links in the edge lists of v[0] and v[1] respectively.
+        uint32_t next[2];
+        uint32_t prev[2];
+        /// Number of faces using the edge.
+        uint32_t numFaces;
+    };
+
+    void GrowVertices(uint32_t v);
+    /// Appends count free edge ids to ids, growing the edge table if there are not enough.
+    void TakeEdgeIds(std::vector<uint32_t> & ids, size_t count);
+    void LinkCorner(uint32_t c, uint32_t v);
+    void UnlinkCorner(uint32_t c);
+    void AcquireEdge(uint32_t a, uint32_t b, EdgeBudget * budget);
+    void ReleaseEdge(uint32_t a, uint32_t b, EdgeBudget * budget);
+    void LinkEdge(uint32_t e, int side);
+    void UnlinkEdge(uint32_t e, int side);
+    int SideOf(uint32_t e, uint32_t v) const { return mEdges[e].v[0] == v ? 0 : 1; }
+
+    /// Per corner, three per face: the vertex, and the neighboring corners in that vertex's corner list.
+    std::vector<uint32_t> mCornerVertex;
+    std::vector<uint32_t> mCornerNext;
+    std::vector<uint32_t> mCornerPrev;
+
+    /// Per vertex: head of its corner list and head of its edge list.
+    std::vector<uint32_t> mVertexCorner;
+    std::vector<uint32_t> mVertexEdge;
+
+    std::vector<EdgeRecord> mEdges;
+    std::vector<uint32_t> mFreeEdges;
+    size_t mNumEdges = 0;
+
+    /// Scratch space of the bulk TakeEdges and ReturnEdges: the ids taken, and where each budget's share starts.
+    std::vector<uint32_t> mBulkEdges;
+    std::vector<size_t> mBulkStarts;
+};
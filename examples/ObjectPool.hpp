@@ -0,0 +1,75 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+#include <memory>
+#include <cstdint>
+#include <cassert>
+#include <type_traits>
+#include <utility>
+
+/// Stores objects in fixed size blocks and hands out dense 32-bit indices for them. Objects never move once
+/// created, so pointers to them stay valid until they are destroyed, and destroyed slots are reused.
+/// Only trivially destructible types are allowed, so the whole pool is released block by block without
+/// visiting the objects.
+template <typename T>
+class ObjectPool {
+    static_assert(std::is_trivially_destructible<T>::value, "ObjectPool frees its blocks without running destructors");
+public:
+    static const uint32_t kBlockSize = 4096;
+
+    ObjectPool() = default;
+    ObjectPool(const ObjectPool &) = delete;
+    ObjectPool & operator=(const ObjectPool &) = delete;
+
+    void Reserve(size_t numObjects) {
+        mBlocks.reserve((numObjects + kBlockSize - 1) / kBlockSize);
+    }
+
+    /// Constructs an object in a free slot and returns its index.
+    template <typename... Args>
+    uint32_t Create(Args &&... args) {
+        uint32_t index;
+        Allocate(1, &index);
+        Construct(index, std::forward<Args>(args)...);
+        return index;
+    }
+
+    /// Sets aside count free slots, the ones count calls to Create would use, and writes their indices. The objects
+    /// are then made with Construct, which may run on several threads at once for different slots.
+    void Allocate(size_t count, uint32_t * indices) {
+        size_t reused = std::min(count, mFreeIndices.size());
+        std::copy(mFreeIndices.rbegin(), mFreeIndices.rbegin() + reused, indices);
+        mFreeIndices.resize(mFreeIndices.size() - reused);
+        for (size_t i = reused; i < count; i++) indices[i] = mSize++;
+        while (mBlocks.size() * kBlockSize < mSize) mBlocks.emplace_back(new Slot[kBlockSize]);
+    }
+
+    /// Constructs an object in a slot set aside by Allocate.
+    template <typename... Args>
+    T * Construct(uint32_t index, Args &&... args) {
+        assert(index < mSize);
+        return new (&mBlocks[index / kBlockSize][index % kBlockSize]) T(std::forward<Args>(args)...);
+    }
+
+    /// Releases a slot. The object must not be used afterwards.
+    void Destroy(uint32_t index) {
+        assert(index < mSize);
+        mFreeIndices.push_back(index);
+    }
+
+    T * Get(uint32_t index) const {
+        assert(index < mSize);
+        return reinterpret_cast<T *>(&mBlocks[index / kBlockSize][index % kBlockSize]);
+    }
+    T * operator[](uint32_t index) const { return Get(index); }
+
+    /// One past the largest index handed out so far, for sizing tables indexed like the pool.
+    uint32_t Size() const { return mSize; }
+
+private:
+    typedef typename std::aligned_storage<sizeof(T), alignof(T)>::type Slot;
+
+    std::vector<std::unique_ptr<Slot[]>> mBlocks;
+    std::vector<uint32_t> mFreeIndices;
+    uint32_t mSize = 0;
+};
@@ -0,0 +1,318 @@
+#include "OffReader.hpp"
+#include "MappedFile.hpp"
+
+#include <iostream>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+/// How much of the file each thread parses at a time.
+static const size_t kChunkBytes = 1 << 20;
+/// The most numbers a vertex line can hold: position, normal, RGBA and texture coordinates.
+static const int kMaxVertexValues = 12;
+
+static const double kPowersOf10[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                     1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+static void SkipSpace(const char *& p, const char * end) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) p++;
+}
+
+/// Whether nothing but a comment is left on the line.
+static bool AtLineEnd(const char * p, const char * end) {
+    return p == end || *p == '\n' || *p == '#';
+}
+
+static bool AtSeparator(const char * p, const char * end) {
+    return AtLineEnd(p, end) || *p == ' ' || *p == '\t' || *p == '\r';
+}
+
+/// The start of the line after the one p is on, or end.
+static const char * NextLine(const char * p, const char * end) {
+    const char * newline = static_cast<const char *>(std::memchr(p, '\n', end - p));
+    return newline ? newline + 1 : end;
+}
+
+/// Parses an unsigned decimal integer that ends at a separator, advancing p past it.
+static bool ParseCount(const char *& p, const char * end, uint64_t & value) {
+    const char * s = p;
+    value = 0;
+    for (; s < end && *s >= '0' && *s <= '9'; s++) {
+        if (value >= 100000000000000000ull) return false;
+        value = value * 10 + (uint64_t)(*s - '0');
+    }
+    if (s == p || !AtSeparator(s, end)) return false;
+    p = s;
+    return true;
+}
+
+/// Parses a decimal floating point number that ends at a separator, advancing p past it. Works like
+/// std::from_chars, which C++14 doesn't have: no locale, no copy of the text and no terminating zero. The first 19
+/// significant digits are used, which is exact to well below the precision of a float.
+static bool ParseFloat(const char *& p, const char * end, float & value) {
+    const char * s = p;
+    bool negative = false;
+    if (s < end && (*s == '-' || *s == '+')) negative = *s++ == '-';
+    uint64_t mantissa = 0;
+    int numDigits = 0, exponent = 0;
+    bool anyDigits = false;
+    for (; s < end && *s >= '0' && *s <= '9'; s++) {
+        anyDigits = true;
+        if (numDigits < 19) {
+            mantissa = mantissa * 10 + (uint64_t)(*s - '0');
+            if (mantissa) numDigits++;
+        } else {
+            exponent++;
+        }
+    }
+    if (s < end && *s == '.') {
+        for (s++; s < end && *s >= '0' && *s <= '9'; s++) {
+            anyDigits = true;
+            if (numDigits < 19) {
+                mantissa = mantissa * 10 + (uint64_t)(*s - '0');
+                if (mantissa) numDigits++;
+                exponent--;
+            }
+        }
+    }
+    if (!anyDigits) return false;
+    if (s < end && (*s == 'e' || *s == 'E')) {
+        s++;
+        bool negativeExponent = false;
+        if (s < end && (*s == '-' || *s == '+')) negativeExponent = *s++ == '-';
+        if (s == end || *s < '0' || *s > '9') return false;
+        int e = 0;
+        for (; s < end && *s >= '0' && *s <= '9'; s++) {
+            if (e < 10000) e = e * 10 + (*s - '0');
+        }
+        exponent += negativeExponent ? -e : e;
+    }
+    if (!AtSeparator(s, end)) return false;
+
+    double result = (double)mantissa;
+    if (exponent != 0 && mantissa != 0) {
+        int magnitude = std::abs(exponent);
+        double scale = magnitude <= 22 ? kPowersOf10[magnitude] : std::pow(10.0, (double)magnitude);
+        result = exponent < 0 ? result / scale : result * scale;
+    }
+    value = (float)(negative ? -result : result);
+    p = s;
+    return true;
+}
+
+bool OffReader::Read(const std::string & path, std::vector<Vertex> & vertices, std::vector<uint32_t> & indices) {
+    MappedFile file;
+    if (!file.Map(path)) return false;
+    return Parse(file.Data(), file.Size(), path, vertices, indices);
+}
+
+bool OffReader::Parse(const char * data, size_t size, const std::string & name, std::vector<Vertex> & vertices,
+                      std::vector<uint32_t> & indices) {
+    const char * p = data;
+    const char * end = data + size;
+    size_t line = 1;
+    auto fail = [&](size_t errorLine, const std::string & message) {
+        std::cerr << "ERROR: " << name << ":" << errorLine << ": " << message << std::endl;
+        return false;
+    };
+    // Leaves p at the first token of the next line that has one. If there is none, line stays at the last line.
+    auto nextDataLine = [&]() {
+        for (;;) {
+            SkipSpace(p, end);
+            if (p == end) return false;
+            if (*p != '\n' && *p != '#') return true;
+            p = NextLine(p, end);
+            if (p < end) line++;
+        }
+    };
+
+    // The header: the keyword, then the counts on the same line or the next one that isn't blank.
+    if (!nextDataLine()) return fail(line, "Empty file, expected OFF");
+    const char * keywordEnd = p;
+    while (!AtSeparator(keywordEnd, end)) keywordEnd++;
+    std::string keyword(p, keywordEnd);
+    size_t k = 0;
+    mHasTextureCoordinates = keyword.compare(0, 2, "ST") == 0;
+    if (mHasTextureCoordinates) k += 2;
+    // Colors are told apart by the number of values on each vertex line, with or without the C.
+    if (k < keyword.size() && keyword[k] == 'C') k++;
+    mHasNormals = k < keyword.size() && keyword[k] == 'N';
+    if (mHasNormals) k++;
+    if (keyword.compare(k, std::string::npos, "OFF") != 0) {
+        if (keyword.find("4OFF") != std::string::npos || keyword.find("nOFF") != std::string::npos) {
+            return fail(line, "Only three-dimensional OFF files are supported, not " + keyword);
+        }
+        return fail(line, "Not an OFF file, it starts with " + keyword);
+    }
+    p = keywordEnd;
+    SkipSpace(p, end);
+    if (AtLineEnd(p, end)) {
+        p = NextLine(p, end);
+        if (p < end) line++;
+        if (!nextDataLine()) return fail(line, "Expected the vertex, face and edge counts");
+    }
+    uint64_t counts[3] = {0, 0, 0};
+    for (int i = 0; i < 3; i++) {
+        // The edge count is optional.
+        if (i == 2 && AtLineEnd(p, end)) break;
+        if (!ParseCount(p, end, counts[i])) return fail(line, "Expected the vertex, face and edge counts");
+        SkipSpace(p, end);
+    }
+    if (!AtLineEnd(p, end)) return fail(line, "Expected only the vertex, face and edge counts");
+    if (counts[0] > 0xFFFFFFFFull || counts[1] > 0xFFFFFFFFull) return fail(line, "Too many vertices or faces");
+    mNumVertices = (size_t)counts[0];
+    mNumFaces = (size_t)counts[1];
+
+    // Split the rest into chunks of whole lines.
+    const char * body = NextLine(p, end);
+    size_t numChunks = (size_t)(end - body) / kChunkBytes + 1;
+    mChunks.resize(numChunks);
+    const char * at = body;
+    for (size_t c = 0; c < numChunks; c++) {
+        Chunk & chunk = mChunks[c];
+        chunk.begin = at;
+        const char * nominal = c + 1 == numChunks ? end : body + (c + 1) * kChunkBytes;
+        chunk.end = c + 1 == numChunks ? end : nominal <= at ? at : NextLine(nominal - 1, end);
+        chunk.numLines = 0;
+        chunk.numRecords = 0;
+        chunk.indices.clear();
+        chunk.byteColors = false;
+        chunk.errorLine = 0;
+        chunk.error.clear();
+        at = chunk.end;
+    }
+
+    // Count the lines and records of each chunk, then number them.
+#pragma omp parallel for schedule(dynamic)
+    for (int c = 0; c < (int)numChunks; c++) {
+        Chunk & chunk = mChunks[c];
+        for (const char * q = chunk.begin; q < chunk.end; q = NextLine(q, chunk.end)) {
+            chunk.numLines++;
+            SkipSpace(q, chunk.end);
+            if (!AtLineEnd(q, chunk.end)) chunk.numRecords++;
+        }
+    }
+    size_t numLines = line + 1, numRecords = 0;
+    for (Chunk & chunk : mChunks) {
+        chunk.firstLine = numLines;
+        chunk.firstRecord = numRecords;
+        numLines += chunk.numLines;
+        numRecords += chunk.numRecords;
+    }
+    if (numRecords < mNumVertices + mNumFaces) {
+        size_t lastLine = std::max(numLines - 1, line);
+        if (numRecords < mNumVertices) {
+            return fail(lastLine, "The file ends after " + std::to_string(numRecords) + " of the " +
+                                  std::to_string(mNumVertices) + " vertices");
+        }
+        return fail(lastLine, "The file ends after " + std::to_string(numRecords - mNumVertices) + " of the " +
+                              std::to_string(mNumFaces) + " faces");
+    }
+
+    // Parse them.
+    vertices.clear();
+    vertices.resize(mNumVertices);
+    mColorComponents.assign(mNumVertices, 0);
+#pragma omp parallel for schedule(dynamic)
+    for (int c = 0; c < (int)numChunks; c++) {
+        ParseChunk(mChunks[c], vertices);
+    }
+    bool byteColors = false;
+    for (const Chunk & chunk : mChunks) {
+        if (chunk.errorLine) return fail(chunk.errorLine, chunk.error);
+        byteColors = byteColors || chunk.byteColors;
+    }
+
+    // Colors are in [0, 255] if any is above 1. Alpha defaults to opaque.
+    float colorScale = byteColors ? 1.f / 255.f : 1.f;
+#pragma omp parallel for
+    for (long long i = 0; i < (long long)mNumVertices; i++) {
+        uint8_t numComponents = mColorComponents[i];
+        if (numComponents == 0) continue;
+        glm::vec4 & color = vertices[i].mColor;
+        color = glm::vec4(color.x * colorScale, color.y * colorScale, color.z * colorScale,
+                          numComponents == 4 ? color.w * colorScale : 1.f);
+    }
+
+    size_t numIndices = 0;
+    for (Chunk & chunk : mChunks) {
+        chunk.firstIndex = numIndices;
+        numIndices += chunk.indices.size();
+    }
+    indices.resize(numIndices);
+#pragma omp parallel for schedule(dynamic)
+    for (int c = 0; c < (int)numChunks; c++) {
+        Chunk & chunk = mChunks[c];
+        std::copy(chunk.indices.begin(), chunk.indices.end(), indices.begin() + chunk.firstIndex);
+        // The copy is all that is needed, and it may be most of the file.
+        std::vector<uint32_t>().swap(chunk.indices);
+    }
+    return true;
+}
+
+void OffReader::ParseChunk(Chunk & chunk, std::vector<Vertex> & vertices) {
+    size_t line = chunk.firstLine;
+    size_t record = chunk.firstRecord;
+    auto fail = [&](const std::string & message) {
+        chunk.errorLine = line;
+        chunk.error = message;
+    };
+    const int numFixed = 3 + (mHasNormals ? 3 : 0) + (mHasTextureCoordinates ? 2 : 0);
+
+    for (const char * q = chunk.begin; q < chunk.end; q = NextLine(q, chunk.end), line++) {
+        SkipSpace(q, chunk.end);
+        if (AtLineEnd(q, chunk.end)) continue;
+
+        if (record < mNumVertices) {
+            // x y z, then the normal, the color and the texture coordinates if there are any.
+            float values[kMaxVertexValues];
+            int numValues = 0;
+            for (; !AtLineEnd(q, chunk.end); SkipSpace(q, chunk.end)) {
+                if (numValues == kMaxVertexValues) return fail("Too many values for a vertex");
+                if (!ParseFloat(q, chunk.end, values[numValues++])) return fail("Expected a number");
+            }
+            int numColor = numValues - numFixed;
+            if (numColor != 0 && numColor != 3 && numColor != 4) {
+                return fail("Expected " + std::to_string(numFixed) + " values for a vertex, plus 3 or 4 for a color, not " +
+                            std::to_string(numValues));
+            }
+            Vertex & aVertex = vertices[record];
+            aVertex.mPos = glm::vec4(values[0], values[1], values[2], 1.f);
+            if (numColor > 0) {
+                const float * color = values + 3 + (mHasNormals ? 3 : 0);
+                aVertex.mColor = glm::vec4(color[0], color[1], color[2], numColor == 4 ? color[3] : 1.f);
+                mColorComponents[record] = (uint8_t)numColor;
+                for (int i = 0; i < numColor; i++) chunk.byteColors = chunk.byteColors || color[i] > 1.f;
+            }
+        } else if (record < mNumVertices + mNumFaces) {
+            // The vertex count, the vertices, then maybe a color, which is ignored. Triangles with a repeated vertex
+            // are left out.
+            uint64_t numCorners;
+            if (!ParseCount(q, chunk.end, numCorners)) return fail("Expected the number of vertices of the face");
+            if (numCorners < 3) return fail("A face needs at least 3 vertices, not " + std::to_string(numCorners));
+            uint32_t first = 0, previous = 0;
+            for (uint64_t i = 0; i < numCorners; i++) {
+                SkipSpace(q, chunk.end);
+                uint64_t index;
+                if (!ParseCount(q, chunk.end, index)) {
+                    return fail("Expected " + std::to_string(numCorners) + " vertex indices");
+                }
+                if (index >= mNumVertices) {
+                    return fail("Vertex index " + std::to_string(index) + " is out of range, there are " +
+                                std::to_string(mNumVertices) + " vertices");
+                }
+                uint32_t current = (uint32_t)index;
+                if (i == 0) first = current;
+                if (i >= 2 && first != previous && previous != current && current != first) {
+                    chunk.indices.push_back(first);
+                    chunk.indices.push_back(previous);
+                    chunk.indices.push_back(current);
+                }
+                previous = current;
+            }
+        } else {
+            return fail("More vertices and faces than the header announces");
+        }
+        record++;
+    }
+}
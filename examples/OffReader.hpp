@@ -0,0 +1,57 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "Geometry.hpp"
+
+/**
+ * Reads OFF meshes: an [ST][C][N]OFF line, the vertex, face and edge counts, which may follow on the same line, then
+ * one vertex and one face per line. Comments (#) and blank lines may appear anywhere, and the edge count is optional
+ * and ignored. Vertices may carry RGB or RGBA colors, in [0, 1] or [0, 255], whether or not the header has the C.
+ * Normals, texture coordinates and face colors are skipped. Polygons are fan triangulated.
+ *
+ * The file is mapped and split into chunks at line boundaries. One parallel pass counts the vertices and faces each
+ * chunk holds, which tells every chunk where its own go, a second one parses them.
+ */
+class OffReader {
+public:
+    /// Reads the file at path into vertices and three indices per triangle. Reports the first malformed line and
+    /// returns false if there is one.
+    bool Read(const std::string & path, std::vector<Vertex> & vertices, std::vector<uint32_t> & indices);
+    /// Read for a file already in memory. name is what error messages call it.
+    bool Parse(const char * data, size_t size, const std::string & name, std::vector<Vertex> & vertices,
+               std::vector<uint32_t> & indices);
+
+private:
+    /// A run of whole lines, parsed by one thread.
+    struct Chunk {
+        const char * begin;
+        const char * end;
+        /// The lines in the chunk, and those holding a vertex or face.
+        size_t numLines;
+        size_t numRecords;
+        /// The number of the chunk's first line in the file, from 1, and of its first vertex or face record.
+        size_t firstLine;
+        size_t firstRecord;
+        /// The triangles of the chunk's faces, and where they go in the whole index list.
+        std::vector<uint32_t> indices;
+        size_t firstIndex;
+        /// Whether a vertex of the chunk has a color above 1, i.e. in [0, 255].
+        bool byteColors;
+        /// The first error in the chunk, if errorLine isn't 0.
+        size_t errorLine;
+        std::string error;
+    };
+
+    /// Parses the lines of a chunk, once its first line and record are known.
+    void ParseChunk(Chunk & chunk, std::vector<Vertex> & vertices);
+
+    bool mHasNormals = false;
+    bool mHasTextureCoordinates = false;
+    size_t mNumVertices = 0;
+    size_t mNumFaces = 0;
+    std::vector<Chunk> mChunks;
+    /// The color components of each vertex: 0, 3 or 4.
+    std::vector<uint8_t> mColorComponents;
+};
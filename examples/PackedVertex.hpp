@@ -0,0 +1,89 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include "Geometry.hpp"
+
+/// Vertex as ProgMesh uploads it when packing, 16 bytes instead of the 56 of Vertex:
+/// - the position in 16-bit normalized shorts relative to a box around the mesh, see PositionQuantization
+/// - the normal in two 16-bit normalized shorts, octahedral encoded
+/// - the color in 8-bit normalized bytes.
+/// The shader reads the position as (x, y, z, 1), the normal as (u, v, 0, 1), which it decodes, and the color as is.
+struct PackedVertex {
+    int16_t position[3];
+    int16_t pad;
+    int16_t normal[2];
+    uint8_t color[4];
+};
+
+/// Maps positions in a box to [-1, 1] on every axis, the range of normalized shorts. Positions outside the box are
+/// clamped to it.
+struct PositionQuantization {
+    glm::vec3 center = glm::vec3(0.f);
+    glm::vec3 halfExtent = glm::vec3(1.f);
+
+    /// The box from min to max, grown by margin times its size on every side for the positions that only show up
+    /// later, like the ones edge collapses move vertices to.
+    static PositionQuantization FromBounds(const glm::vec3 & min, const glm::vec3 & max, float margin) {
+        PositionQuantization q;
+        q.center = (min + max) * 0.5f;
+        q.halfExtent = (max - min) * (0.5f + margin);
+        // A flat axis still needs a scale to divide by.
+        for (int i = 0; i < 3; i++) {
+            if (!(q.halfExtent[i] > 0.f)) q.halfExtent[i] = 1.f;
+        }
+        return q;
+    }
+
+    /// What the shader multiplies the positions it reads by to get them back.
+    glm::mat4 DequantizeMatrix() const {
+        return glm::scale(glm::translate(glm::mat4(1.f), center), halfExtent);
+    }
+};
+
+inline int16_t PackSnorm16(float value) {
+    return (int16_t)std::lround(glm::clamp(value, -1.f, 1.f) * 32767.f);
+}
+
+inline uint8_t PackUnorm8(float value) {
+    return (uint8_t)std::lround(glm::clamp(value, 0.f, 1.f) * 255.f);
+}
+
+/// Maps a unit vector onto the octahedron |x| + |y| + |z| = 1, then folds the lower half over the upper one, giving
+/// a point in [-1, 1]^2. The error stays about the same in every direction.
+inline glm::vec2 EncodeOctahedral(const glm::vec3 & n) {
+    float sum = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+    if (!(sum > 0.f)) return glm::vec2(0.f);
+    glm::vec2 e = glm::vec2(n.x, n.y) / sum;
+    if (n.z < 0.f) {
+        glm::vec2 sign(e.x >= 0.f ? 1.f : -1.f, e.y >= 0.f ? 1.f : -1.f);
+        e = (glm::vec2(1.f) - glm::abs(glm::vec2(e.y, e.x))) * sign;
+    }
+    return e;
+}
+
+/// The inverse of EncodeOctahedral, as the shader does it.
+inline glm::vec3 DecodeOctahedral(const glm::vec2 & e) {
+    glm::vec3 n(e.x, e.y, 1.f - std::abs(e.x) - std::abs(e.y));
+    if (n.z < 0.f) {
+        glm::vec2 sign(n.x >= 0.f ? 1.f : -1.f, n.y >= 0.f ? 1.f : -1.f);
+        glm::vec2 folded = (glm::vec2(1.f) - glm::abs(glm::vec2(n.y, n.x))) * sign;
+        n.x = folded.x;
+        n.y = folded.y;
+    }
+    return glm::normalize(n);
+}
+
+inline PackedVertex PackVertex(const Vertex & aVertex, const PositionQuantization & quantization) {
+    PackedVertex packed;
+    glm::vec3 position = (glm::vec3(aVertex.mPos) - quantization.center) / quantization.halfExtent;
+    for (int i = 0; i < 3; i++) packed.position[i] = PackSnorm16(position[i]);
+    packed.pad = 0;
+    glm::vec2 normal = EncodeOctahedral(glm::vec3(aVertex.mNormal));
+    packed.normal[0] = PackSnorm16(normal.x);
+    packed.normal[1] = PackSnorm16(normal.y);
+    for (int i = 0; i < 4; i++) packed.color[i] = PackUnorm8(aVertex.mColor[i]);
+    return packed;
+}
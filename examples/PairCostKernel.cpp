@@ -0,0 +1,200 @@
+#include "PairCostKernel.hpp"
+#include <cmath>
+
+// PAIRCOST_NO_SIMD forces the scalar code, to test it on targets that have SIMD.
+#if defined(PAIRCOST_NO_SIMD)
+#elif defined(__AVX__)
+#include <immintrin.h>
+#define PAIRCOST_AVX
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define PAIRCOST_SSE
+#endif
+
+namespace {
+
+/// The system is treated as singular when |det| is below this fraction of trace^3, i.e. relative to the scale of
+/// the quadric. Positions found past that point are dominated by rounding and can land far away from the pair.
+const float kSingularThreshold = 1e-5f;
+
+// Each Lanes type wraps one instruction set behind the same set of operations, so the kernel below is written once.
+// None of them fuse multiplies and adds, so all of them produce the same results.
+
+struct ScalarLanes {
+    static const size_t kWidth = 1;
+    typedef float Reg;
+    typedef bool Mask;
+
+    static Reg Load(const float * p) { return *p; }
+    static void Store(float * p, Reg a) { *p = a; }
+    static Reg Set(float f) { return f; }
+    static Reg Add(Reg a, Reg b) { return a + b; }
+    static Reg Sub(Reg a, Reg b) { return a - b; }
+    static Reg Mul(Reg a, Reg b) { return a * b; }
+    static Reg Div(Reg a, Reg b) { return a / b; }
+    static Reg Abs(Reg a) { return std::fabs(a); }
+    static Mask Less(Reg a, Reg b) { return a < b; }
+    static Mask And(Mask a, Mask b) { return a && b; }
+    static Reg Select(Mask m, Reg a, Reg b) { return m ? a : b; }
+};
+
+#if defined(PAIRCOST_SSE)
+struct SseLanes {
+    static const size_t kWidth = 4;
+    typedef __m128 Reg;
+    typedef __m128 Mask;
+
+    static Reg Load(const float * p) { return _mm_load_ps(p); }
+    static void Store(float * p, Reg a) { _mm_store_ps(p, a); }
+    static Reg Set(float f) { return _mm_set1_ps(f); }
+    static Reg Add(Reg a, Reg b) { return _mm_add_ps(a, b); }
+    static Reg Sub(Reg a, Reg b) { return _mm_sub_ps(a, b); }
+    static Reg Mul(Reg a, Reg b) { return _mm_mul_ps(a, b); }
+    static Reg Div(Reg a, Reg b) { return _mm_div_ps(a, b); }
+    static Reg Abs(Reg a) { return _mm_andnot_ps(_mm_set1_ps(-0.f), a); }
+    static Mask Less(Reg a, Reg b) { return _mm_cmplt_ps(a, b); }
+    static Mask And(Mask a, Mask b) { return _mm_and_ps(a, b); }
+    static Reg Select(Mask m, Reg a, Reg b) { return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b)); }
+};
+typedef SseLanes Lanes;
+#elif defined(PAIRCOST_AVX)
+struct AvxLanes {
+    static const size_t kWidth = 8;
+    typedef __m256 Reg;
+    typedef __m256 Mask;
+
+    static Reg Load(const float * p) { return _mm256_load_ps(p); }
+    static void Store(float * p, Reg a) { _mm256_store_ps(p, a); }
+    static Reg Set(float f) { return _mm256_set1_ps(f); }
+    static Reg Add(Reg a, Reg b) { return _mm256_add_ps(a, b); }
+    static Reg Sub(Reg a, Reg b) { return _mm256_sub_ps(a, b); }
+    static Reg Mul(Reg a, Reg b) { return _mm256_mul_ps(a, b); }
+    static Reg Div(Reg a, Reg b) { return _mm256_div_ps(a, b); }
+    static Reg Abs(Reg a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.f), a); }
+    static Mask Less(Reg a, Reg b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+    static Mask And(Mask a, Mask b) { return _mm256_and_ps(a, b); }
+    static Reg Select(Mask m, Reg a, Reg b) { return _mm256_blendv_ps(b, a, m); }
+};
+typedef AvxLanes Lanes;
+#else
+typedef ScalarLanes Lanes;
+#endif
+
+/// v^T Q v at (x, y, z), with the same operation order as Quadric::Evaluate.
+template <typename L>
+typename L::Reg QuadricError(const typename L::Reg q[10], typename L::Reg x, typename L::Reg y, typename L::Reg z) {
+    typedef typename L::Reg Reg;
+    const Reg two = L::Set(2.f);
+    Reg ex = L::Mul(x, L::Add(L::Mul(q[0], x), L::Mul(two, L::Add(L::Add(L::Mul(q[1], y), L::Mul(q[2], z)), q[3]))));
+    Reg ey = L::Mul(y, L::Add(L::Mul(q[4], y), L::Mul(two, L::Add(L::Mul(q[5], z), q[6]))));
+    Reg ez = L::Mul(z, L::Add(L::Mul(q[7], z), L::Mul(two, q[8])));
+    return L::Add(L::Add(L::Add(ex, ey), ez), q[9]);
+}
+
+/// Scores kWidth candidates starting at the given lane.
+template <typename L>
+void EvaluateLanes(const float (&Q)[10][PairCostBatch::kBatchSize], const float (&P0)[3][PairCostBatch::kBatchSize],
+                   const float (&P1)[3][PairCostBatch::kBatchSize], float (&cost)[PairCostBatch::kBatchSize],
+                   float (&pos)[3][PairCostBatch::kBatchSize], size_t lane) {
+    typedef typename L::Reg Reg;
+    typedef typename L::Mask Mask;
+
+    Reg q[10];
+    for (int i = 0; i < 10; i++) q[i] = L::Load(&Q[i][lane]);
+    const Reg &a2 = q[0], &ab = q[1], &ac = q[2], &ad = q[3];
+    const Reg &b2 = q[4], &bc = q[5], &bd = q[6];
+    const Reg &c2 = q[7], &cd = q[8];
+
+    // Solve A x = -b by Cramer's rule, where A is the symmetric 3x3 block and b = (ad, bd, cd).
+    Reg c00 = L::Sub(L::Mul(b2, c2), L::Mul(bc, bc));
+    Reg c01 = L::Sub(L::Mul(bc, ac), L::Mul(ab, c2));
+    Reg c02 = L::Sub(L::Mul(ab, bc), L::Mul(b2, ac));
+    Reg c11 = L::Sub(L::Mul(a2, c2), L::Mul(ac, ac));
+    Reg c12 = L::Sub(L::Mul(ab, ac), L::Mul(a2, bc));
+    Reg c22 = L::Sub(L::Mul(a2, b2), L::Mul(ab, ab));
+    Reg det = L::Add(L::Add(L::Mul(a2, c00), L::Mul(ab, c01)), L::Mul(ac, c02));
+
+    Reg trace = L::Add(L::Add(a2, b2), c2);
+    Reg scale = L::Mul(L::Mul(L::Mul(trace, trace), trace), L::Set(kSingularThreshold));
+    // NaN compares false, so a broken quadric also counts as singular.
+    Mask solvable = L::And(L::Less(L::Set(0.f), trace), L::Less(scale, L::Abs(det)));
+
+    // Divide by 1 in the singular lanes so they stay finite, their result is discarded anyway.
+    Reg invDet = L::Div(L::Set(-1.f), L::Select(solvable, det, L::Set(1.f)));
+    Reg xOpt = L::Mul(L::Add(L::Add(L::Mul(c00, ad), L::Mul(c01, bd)), L::Mul(c02, cd)), invDet);
+    Reg yOpt = L::Mul(L::Add(L::Add(L::Mul(c01, ad), L::Mul(c11, bd)), L::Mul(c12, cd)), invDet);
+    Reg zOpt = L::Mul(L::Add(L::Add(L::Mul(c02, ad), L::Mul(c12, bd)), L::Mul(c22, cd)), invDet);
+
+    // The fallback candidates. The midpoint wins ties so flat regions collapse the way they always have.
+    Reg x0 = L::Load(&P0[0][lane]), y0 = L::Load(&P0[1][lane]), z0 = L::Load(&P0[2][lane]);
+    Reg x1 = L::Load(&P1[0][lane]), y1 = L::Load(&P1[1][lane]), z1 = L::Load(&P1[2][lane]);
+    const Reg half = L::Set(0.5f);
+    Reg bestX = L::Mul(L::Add(x0, x1), half);
+    Reg bestY = L::Mul(L::Add(y0, y1), half);
+    Reg bestZ = L::Mul(L::Add(z0, z1), half);
+    Reg best = QuadricError<L>(q, bestX, bestY, bestZ);
+
+    Reg e0 = QuadricError<L>(q, x0, y0, z0);
+    Mask take = L::Less(e0, best);
+    best = L::Select(take, e0, best);
+    bestX = L::Select(take, x0, bestX); bestY = L::Select(take, y0, bestY); bestZ = L::Select(take, z0, bestZ);
+
+    Reg e1 = QuadricError<L>(q, x1, y1, z1);
+    take = L::Less(e1, best);
+    best = L::Select(take, e1, best);
+    bestX = L::Select(take, x1, bestX); bestY = L::Select(take, y1, bestY); bestZ = L::Select(take, z1, bestZ);
+
+    // In exact arithmetic the optimum is never worse than the others, still compare to be safe from rounding.
+    Reg eOpt = QuadricError<L>(q, xOpt, yOpt, zOpt);
+    take = L::And(solvable, L::Less(eOpt, best));
+    best = L::Select(take, eOpt, best);
+    bestX = L::Select(take, xOpt, bestX); bestY = L::Select(take, yOpt, bestY); bestZ = L::Select(take, zOpt, bestZ);
+
+    L::Store(&cost[lane], best);
+    L::Store(&pos[0][lane], bestX);
+    L::Store(&pos[1][lane], bestY);
+    L::Store(&pos[2][lane], bestZ);
+}
+
+}
+
+size_t PairCostBatch::Add(const Quadric & q, const glm::vec3 & p0, const glm::vec3 & p1) {
+    size_t lane = mCount++;
+    double o[3];
+    for (int i = 0; i < 3; i++) {
+        o[i] = 0.5 * ((double)p0[i] + (double)p1[i]);
+        mOrigin[i][lane] = o[i];
+        mP0[i][lane] = (float)(p0[i] - o[i]);
+        mP1[i][lane] = (float)(p1[i] - o[i]);
+    }
+    // With v = o + u, v^T Q v = u^T A u + 2 (A o + b)^T u + Q(o): the 3x3 block stays, the linear part and the
+    // constant change.
+    mQ[0][lane] = (float)q.a2; mQ[1][lane] = (float)q.ab; mQ[2][lane] = (float)q.ac;
+    mQ[4][lane] = (float)q.b2; mQ[5][lane] = (float)q.bc;
+    mQ[7][lane] = (float)q.c2;
+    mQ[3][lane] = (float)(q.a2 * o[0] + q.ab * o[1] + q.ac * o[2] + q.ad);
+    mQ[6][lane] = (float)(q.ab * o[0] + q.b2 * o[1] + q.bc * o[2] + q.bd);
+    mQ[8][lane] = (float)(q.ac * o[0] + q.bc * o[1] + q.c2 * o[2] + q.cd);
+    mQ[9][lane] = (float)(o[0] * (q.a2 * o[0] + 2.0 * (q.ab * o[1] + q.ac * o[2] + q.ad))
+                        + o[1] * (q.b2 * o[1] + 2.0 * (q.bc * o[2] + q.bd))
+                        + o[2] * (q.c2 * o[2] + 2.0 * q.cd)
+                        + q.d2);
+    return lane;
+}
+
+void PairCostBatch::Evaluate() {
+    if (mCount == 0) return;
+
+    // Pad the unused lanes with the first candidate rather than leaving them uninitialized.
+    for (size_t lane = mCount; lane < kBatchSize; lane++) {
+        for (int i = 0; i < 10; i++) mQ[i][lane] = mQ[i][0];
+        for (int i = 0; i < 3; i++) {
+            mP0[i][lane] = mP0[i][0];
+            mP1[i][lane] = mP1[i][0];
+        }
+    }
+
+    for (size_t lane = 0; lane < kBatchSize; lane += Lanes::kWidth) {
+        EvaluateLanes<Lanes>(mQ, mP0, mP1, mCost, mPos, lane);
+    }
+}
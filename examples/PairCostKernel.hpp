@@ -0,0 +1,52 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <cstddef>
+#include "Quadric.hpp"
+
+/**
+ * Scores a batch of collapse candidates at once: for each one, finds the position minimizing the summed quadric
+ * of its two vertices and the error there.
+ *
+ * The optimal position solves the 3x3 system formed by the upper left block of the quadric. When that system is
+ * (close to) singular, e.g. for pairs on a flat patch, the best of the two endpoints and the midpoint is used
+ * instead.
+ *
+ * Each quadric is moved to the midpoint of its pair in double before it is narrowed to float, and the kernel solves
+ * for the offset from there. In absolute coordinates the coefficients grow with the square of the distance to the
+ * origin while the error stays small, and far from the origin float cancels the error away.
+ *
+ * Candidates are stored as a structure of arrays so all lanes are evaluated together with AVX, SSE2 or plain
+ * scalar code, whichever the compiler targets. Every lane goes through the same instructions no matter how full
+ * the batch is, so a pair gets the same result whether it is scored alone or with others.
+ */
+class PairCostBatch {
+public:
+    static const size_t kBatchSize = 8;
+
+    void Clear() { mCount = 0; }
+    size_t Size() const { return mCount; }
+    bool Full() const { return mCount == kBatchSize; }
+
+    /// Adds a candidate with the summed quadric of both vertices and their positions. Returns its lane.
+    size_t Add(const Quadric & q, const glm::vec3 & p0, const glm::vec3 & p1);
+
+    /// Scores every candidate added since the last Clear().
+    void Evaluate();
+
+    float Cost(size_t lane) const { return mCost[lane]; }
+    glm::vec3 Position(size_t lane) const {
+        return glm::vec3(mOrigin[0][lane] + mPos[0][lane], mOrigin[1][lane] + mPos[1][lane], mOrigin[2][lane] + mPos[2][lane]);
+    }
+
+private:
+    /// Quadric coefficients in the order of Quadric's members, and the positions, all relative to mOrigin.
+    alignas(32) float mQ[10][kBatchSize];
+    alignas(32) float mP0[3][kBatchSize];
+    alignas(32) float mP1[3][kBatchSize];
+    double mOrigin[3][kBatchSize];
+
+    alignas(32) float mCost[kBatchSize];
+    alignas(32) float mPos[3][kBatchSize];
+
+    size_t mCount = 0;
+};
@@ -0,0 +1,391 @@
+#include "PlyReader.hpp"
+#include "MappedFile.hpp"
+
+#include <iostream>
+#include <sstream>
+#include <cstring>
+#include <algorithm>
+
+static const size_t kTypeSizes[] = {1, 1, 2, 2, 4, 4, 4, 8};
+/// What integer colors are divided by to bring them to [0, 1].
+static const double kTypeMax[] = {127.0, 255.0, 32767.0, 65535.0, 2147483647.0, 4294967295.0, 1.0, 1.0};
+
+/// The vertex properties that are read, and the names they go by.
+enum VertexSlot { kX, kY, kZ, kNX, kNY, kNZ, kRed, kGreen, kBlue, kAlpha, kNumSlots };
+static const char * const kSlotNames[kNumSlots][2] = {
+    {"x", "x"}, {"y", "y"}, {"z", "z"}, {"nx", "nx"}, {"ny", "ny"}, {"nz", "nz"},
+    {"red", "diffuse_red"}, {"green", "diffuse_green"}, {"blue", "diffuse_blue"}, {"alpha", "diffuse_alpha"}
+};
+
+static bool IsLittleEndian() {
+    const uint16_t one = 1;
+    return *reinterpret_cast<const uint8_t *>(&one) == 1;
+}
+
+static bool IsInteger(PlyReader::Type type) {
+    return type != PlyReader::kFloat32 && type != PlyReader::kFloat64;
+}
+
+template <typename T>
+static T Load(const uint8_t * p, bool swap) {
+    uint8_t bytes[sizeof(T)];
+    std::memcpy(bytes, p, sizeof(T));
+    if (swap) std::reverse(bytes, bytes + sizeof(T));
+    T value;
+    std::memcpy(&value, bytes, sizeof(T));
+    return value;
+}
+
+static double LoadScalar(const uint8_t * p, PlyReader::Type type, bool swap) {
+    switch (type) {
+        case PlyReader::kInt8: return Load<int8_t>(p, swap);
+        case PlyReader::kUint8: return Load<uint8_t>(p, swap);
+        case PlyReader::kInt16: return Load<int16_t>(p, swap);
+        case PlyReader::kUint16: return Load<uint16_t>(p, swap);
+        case PlyReader::kInt32: return Load<int32_t>(p, swap);
+        case PlyReader::kUint32: return Load<uint32_t>(p, swap);
+        case PlyReader::kFloat32: return Load<float>(p, swap);
+        case PlyReader::kFloat64: return Load<double>(p, swap);
+    }
+    return 0.0;
+}
+
+/// Loads a count or index, which the header checks are of an integer type.
+static int64_t LoadInteger(const uint8_t * p, PlyReader::Type type, bool swap) {
+    switch (type) {
+        case PlyReader::kInt8: return Load<int8_t>(p, swap);
+        case PlyReader::kUint8: return Load<uint8_t>(p, swap);
+        case PlyReader::kInt16: return Load<int16_t>(p, swap);
+        case PlyReader::kUint16: return Load<uint16_t>(p, swap);
+        case PlyReader::kInt32: return Load<int32_t>(p, swap);
+        case PlyReader::kUint32: return Load<uint32_t>(p, swap);
+        default: return -1;
+    }
+}
+
+static bool ParseType(const std::string & name, PlyReader::Type & type) {
+    static const char * const kNames[][2] = {
+        {"char", "int8"}, {"uchar", "uint8"}, {"short", "int16"}, {"ushort", "uint16"},
+        {"int", "int32"}, {"uint", "uint32"}, {"float", "float32"}, {"double", "float64"}
+    };
+    for (int i = 0; i < 8; i++) {
+        if (name == kNames[i][0] || name == kNames[i][1]) {
+            type = (PlyReader::Type)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool PlyReader::Read(const std::string & path, std::vector<Vertex> & vertices, std::vector<uint32_t> & indices) {
+    MappedFile file;
+    if (!file.Map(path)) return false;
+    return Parse(file.Data(), file.Size(), path, vertices, indices);
+}
+
+bool PlyReader::Parse(const char * data, size_t size, const std::string & name, std::vector<Vertex> & vertices,
+                      std::vector<uint32_t> & indices) {
+    vertices.clear();
+    indices.clear();
+    mHasNormals = false;
+    const uint8_t * p = ParseHeader(data, size, name);
+    if (!p) return false;
+    const uint8_t * end = reinterpret_cast<const uint8_t *>(data) + size;
+
+    const Element * vertexElement = nullptr;
+    const Element * faceElement = nullptr;
+    for (const Element & element : mElements) {
+        if (element.name == "vertex") vertexElement = &element;
+        if (element.name == "face") faceElement = &element;
+    }
+    if (!vertexElement || !faceElement) {
+        std::cerr << "ERROR: " << name << ": Expected a vertex and a face element" << std::endl;
+        return false;
+    }
+    if (vertexElement->count > 0xFFFFFFFFull) {
+        std::cerr << "ERROR: " << name << ": Too many vertices" << std::endl;
+        return false;
+    }
+
+    for (const Element & element : mElements) {
+        if (&element == vertexElement) {
+            p = ReadVertices(element, p, end, name, vertices);
+        } else if (&element == faceElement) {
+            p = ReadFaces(element, p, end, name, (size_t)vertexElement->count, indices);
+        } else {
+            p = SkipElement(element, p, end);
+            if (!p) std::cerr << "ERROR: " << name << ": The file ends inside the " << element.name << " element" << std::endl;
+        }
+        if (!p) return false;
+    }
+    return true;
+}
+
+const uint8_t * PlyReader::ParseHeader(const char * data, size_t size, const std::string & name) {
+    mElements.clear();
+    const char * p = data;
+    const char * end = data + size;
+    size_t lineNumber = 0;
+    bool hasFormat = false;
+    auto fail = [&](const std::string & message) -> const uint8_t * {
+        std::cerr << "ERROR: " << name << ":" << lineNumber << ": " << message << std::endl;
+        return nullptr;
+    };
+
+    while (p < end) {
+        const char * newline = static_cast<const char *>(std::memchr(p, '\n', end - p));
+        if (!newline) break;
+        std::string line(p, newline);
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        p = newline + 1;
+        lineNumber++;
+
+        std::istringstream tokens(line);
+        std::string keyword;
+        tokens >> keyword;
+        if (lineNumber == 1) {
+            if (keyword != "ply") return fail("Not a PLY file");
+            continue;
+        }
+        if (keyword == "end_header") {
+            if (!hasFormat) return fail("The header has no format line");
+            // Without lists every record has the same size, and each property a fixed offset in it.
+            for (Element & element : mElements) {
+                element.stride = 0;
+                for (Property & property : element.properties) {
+                    if (property.isList) {
+                        element.stride = 0;
+                        break;
+                    }
+                    property.offset = element.stride;
+                    element.stride += kTypeSizes[property.type];
+                }
+            }
+            return reinterpret_cast<const uint8_t *>(p);
+        } else if (keyword == "format") {
+            std::string format;
+            tokens >> format;
+            if (format == "ascii") return fail("ASCII PLY files are not supported, only binary ones");
+            if (format != "binary_little_endian" && format != "binary_big_endian") return fail("Unknown format " + format);
+            mSwapBytes = (format == "binary_little_endian") != IsLittleEndian();
+            hasFormat = true;
+        } else if (keyword == "element") {
+            Element element;
+            if (!(tokens >> element.name >> element.count)) return fail("Expected an element name and count");
+            element.stride = 0;
+            mElements.push_back(element);
+        } else if (keyword == "property") {
+            if (mElements.empty()) return fail("A property before the first element");
+            Property property;
+            std::string typeName;
+            tokens >> typeName;
+            property.isList = typeName == "list";
+            property.countType = kUint8;
+            property.offset = 0;
+            if (property.isList) {
+                std::string countTypeName;
+                tokens >> countTypeName >> typeName;
+                if (!ParseType(countTypeName, property.countType) || !IsInteger(property.countType)) {
+                    return fail("Unknown list count type " + countTypeName);
+                }
+            }
+            if (!ParseType(typeName, property.type)) return fail("Unknown property type " + typeName);
+            if (!(tokens >> property.name)) return fail("Expected a property name");
+            mElements.back().properties.push_back(property);
+        } else if (keyword != "comment" && keyword != "obj_info" && !keyword.empty()) {
+            return fail("Unknown header line " + keyword);
+        }
+    }
+    return fail("The file ends inside the header");
+}
+
+const uint8_t * PlyReader::ReadVertices(const Element & element, const uint8_t * p, const uint8_t * end,
+                                        const std::string & name, std::vector<Vertex> & vertices) {
+    if (element.stride == 0) {
+        std::cerr << "ERROR: " << name << ": Vertices with list properties are not supported" << std::endl;
+        return nullptr;
+    }
+    if (element.count > (uint64_t)(end - p) / element.stride) {
+        std::cerr << "ERROR: " << name << ": The file ends inside the vertex element" << std::endl;
+        return nullptr;
+    }
+
+    bool hasSlot[kNumSlots];
+    size_t offsets[kNumSlots];
+    Type types[kNumSlots];
+    double scales[kNumSlots];
+    for (int s = 0; s < kNumSlots; s++) {
+        hasSlot[s] = false;
+        for (const Property & property : element.properties) {
+            if (property.name != kSlotNames[s][0] && property.name != kSlotNames[s][1]) continue;
+            hasSlot[s] = true;
+            offsets[s] = property.offset;
+            types[s] = property.type;
+            // Integer colors use their whole range, integer normals and positions are taken as they are.
+            scales[s] = s >= kRed ? 1.0 / kTypeMax[property.type] : 1.0;
+            break;
+        }
+    }
+    if (!hasSlot[kX] || !hasSlot[kY] || !hasSlot[kZ]) {
+        std::cerr << "ERROR: " << name << ": The vertices have no x, y and z" << std::endl;
+        return nullptr;
+    }
+    mHasNormals = hasSlot[kNX] && hasSlot[kNY] && hasSlot[kNZ];
+    bool hasColors = hasSlot[kRed] && hasSlot[kGreen] && hasSlot[kBlue];
+    bool swap = mSwapBytes;
+    auto load = [&](const uint8_t * record, int s) {
+        return (float)(LoadScalar(record + offsets[s], types[s], swap) * scales[s]);
+    };
+
+    vertices.resize((size_t)element.count);
+#pragma omp parallel for
+    for (long long i = 0; i < (long long)element.count; i++) {
+        const uint8_t * record = p + (size_t)i * element.stride;
+        Vertex & aVertex = vertices[(size_t)i];
+        aVertex.mPos = glm::vec4(load(record, kX), load(record, kY), load(record, kZ), 1.f);
+        if (mHasNormals) aVertex.mNormal = glm::vec4(load(record, kNX), load(record, kNY), load(record, kNZ), 0.f);
+        if (hasColors) {
+            aVertex.mColor = glm::vec4(load(record, kRed), load(record, kGreen), load(record, kBlue),
+                                       hasSlot[kAlpha] ? load(record, kAlpha) : 1.f);
+        }
+    }
+    return p + (size_t)element.count * element.stride;
+}
+
+const uint8_t * PlyReader::ReadFaces(const Element & element, const uint8_t * p, const uint8_t * end,
+                                     const std::string & name, size_t numVertices, std::vector<uint32_t> & indices) {
+    const Property * list = nullptr;
+    size_t listOffset = 0, scalarBytes = 0;
+    bool otherLists = false;
+    for (const Property & property : element.properties) {
+        if (!list && property.isList && (property.name == "vertex_indices" || property.name == "vertex_index")) {
+            list = &property;
+            listOffset = scalarBytes;
+        } else if (property.isList) {
+            otherLists = true;
+        } else {
+            scalarBytes += kTypeSizes[property.type];
+        }
+    }
+    if (!list || !IsInteger(list->type)) {
+        std::cerr << "ERROR: " << name << ": The faces have no integer vertex_indices list" << std::endl;
+        return nullptr;
+    }
+    auto badIndex = [&](uint64_t face, int64_t index) -> const uint8_t * {
+        std::cerr << "ERROR: " << name << ": Face " << face << " refers to vertex " << index << ", there are "
+                  << numVertices << " vertices" << std::endl;
+        return nullptr;
+    };
+
+    // Most meshes are all triangles, then every face has the same size and they can be decoded in parallel. If the
+    // first face is a triangle, the second starts where assumed, and so on as long as the counts say 3.
+    bool swap = mSwapBytes;
+    size_t countSize = kTypeSizes[list->countType], itemSize = kTypeSizes[list->type];
+    size_t stride = scalarBytes + countSize + 3 * itemSize;
+    size_t numFaces = (size_t)element.count;
+    if (!otherLists && numFaces > 0 && stride <= (size_t)(end - p) && element.count <= (uint64_t)(end - p) / stride
+        && LoadInteger(p + listOffset, list->countType, swap) == 3) {
+        indices.resize(3 * numFaces);
+        bool allTriangles = true, allValid = true, anyDegenerate = false;
+#pragma omp parallel for reduction(&&: allTriangles, allValid) reduction(||: anyDegenerate)
+        for (long long f = 0; f < (long long)numFaces; f++) {
+            const uint8_t * count = p + (size_t)f * stride + listOffset;
+            allTriangles = allTriangles && LoadInteger(count, list->countType, swap) == 3;
+            uint32_t * triangle = indices.data() + 3 * (size_t)f;
+            for (int k = 0; k < 3; k++) {
+                int64_t index = LoadInteger(count + countSize + k * itemSize, list->type, swap);
+                allValid = allValid && index >= 0 && (uint64_t)index < numVertices;
+                triangle[k] = (uint32_t)index;
+            }
+            anyDegenerate = anyDegenerate || triangle[0] == triangle[1] || triangle[1] == triangle[2] || triangle[2] == triangle[0];
+        }
+        if (allTriangles) {
+            if (!allValid) {
+                for (size_t f = 0; f < numFaces; f++) {
+                    const uint8_t * count = p + f * stride + listOffset;
+                    for (int k = 0; k < 3; k++) {
+                        int64_t index = LoadInteger(count + countSize + k * itemSize, list->type, swap);
+                        if (index < 0 || (uint64_t)index >= numVertices) return badIndex(f, index);
+                    }
+                }
+            }
+            // Triangles with a repeated vertex are left out.
+            if (anyDegenerate) {
+                size_t kept = 0;
+                for (size_t t = 0; t < numFaces; t++) {
+                    const uint32_t * triangle = indices.data() + 3 * t;
+                    if (triangle[0] == triangle[1] || triangle[1] == triangle[2] || triangle[2] == triangle[0]) continue;
+                    std::copy(triangle, triangle + 3, indices.begin() + 3 * kept++);
+                }
+                indices.resize(3 * kept);
+            }
+            return p + numFaces * stride;
+        }
+        indices.clear();
+    }
+
+    // Walk the faces one by one, fan triangulating polygons.
+    indices.reserve(3 * std::min<size_t>(numFaces, (size_t)(end - p) / (countSize + 3 * itemSize)));
+    for (uint64_t f = 0; f < element.count; f++) {
+        for (const Property & property : element.properties) {
+            if (!property.isList) {
+                if (kTypeSizes[property.type] > (size_t)(end - p)) p = nullptr;
+                else p += kTypeSizes[property.type];
+            } else if (countSize > (size_t)(end - p)) {
+                p = nullptr;
+            } else {
+                int64_t numItems = LoadInteger(p, property.countType, swap);
+                size_t propertyItemSize = kTypeSizes[property.type];
+                p += kTypeSizes[property.countType];
+                if (numItems < 0 || (uint64_t)numItems > (uint64_t)(end - p) / propertyItemSize) {
+                    p = nullptr;
+                } else if (&property == list) {
+                    if (numItems < 3) {
+                        std::cerr << "ERROR: " << name << ": Face " << f << " has " << numItems
+                                  << " vertices, it needs at least 3" << std::endl;
+                        return nullptr;
+                    }
+                    uint32_t first = 0, previous = 0;
+                    for (int64_t i = 0; i < numItems; i++) {
+                        int64_t index = LoadInteger(p + i * propertyItemSize, property.type, swap);
+                        if (index < 0 || (uint64_t)index >= numVertices) return badIndex(f, index);
+                        uint32_t current = (uint32_t)index;
+                        if (i == 0) first = current;
+                        if (i >= 2 && first != previous && previous != current && current != first) {
+                            indices.push_back(first);
+                            indices.push_back(previous);
+                            indices.push_back(current);
+                        }
+                        previous = current;
+                    }
+                    p += numItems * propertyItemSize;
+                } else {
+                    p += numItems * propertyItemSize;
+                }
+            }
+            if (!p) {
+                std::cerr << "ERROR: " << name << ": The file ends inside face " << f << std::endl;
+                return nullptr;
+            }
+        }
+    }
+    return p;
+}
+
+const uint8_t * PlyReader::SkipElement(const Element & element, const uint8_t * p, const uint8_t * end) const {
+    if (element.stride > 0) {
+        if (element.count > (uint64_t)(end - p) / element.stride) return nullptr;
+        return p + (size_t)element.count * element.stride;
+    }
+    for (uint64_t i = 0; i < element.count; i++) {
+        for (const Property & property : element.properties) {
+            size_t countSize = property.isList ? kTypeSizes[property.countType] : 0;
+            if (countSize > (size_t)(end - p)) return nullptr;
+            int64_t numItems = property.isList ? LoadInteger(p, property.countType, mSwapBytes) : 1;
+            p += countSize;
+            if (numItems < 0 || (uint64_t)numItems > (uint64_t)(end - p) / kTypeSizes[property.type]) return nullptr;
+            p += numItems * kTypeSizes[property.type];
+        }
+    }
+    return p;
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "Geometry.hpp"
+
+/**
+ * Reads binary PLY meshes, little or big endian. The vertex element gives the positions, and the normals (nx, ny, nz)
+ * and colors (red, green, blue, alpha) if it has them. The face element gives the polygons through its vertex_indices
+ * list, fan triangulated. Properties and elements besides these are skipped, whatever their types.
+ *
+ * The file is mapped and decoded in place. Vertices have a fixed size, so they are decoded in parallel. Faces are
+ * too when the first face is a triangle, assuming every face is one, and walked one by one if that turns out wrong.
+ */
+class PlyReader {
+public:
+    /// Reads the file at path into vertices and three indices per triangle. Reports what is wrong with the file and
+    /// returns false if it can't be read.
+    bool Read(const std::string & path, std::vector<Vertex> & vertices, std::vector<uint32_t> & indices);
+    /// Read for a file already in memory. name is what error messages call it.
+    bool Parse(const char * data, size_t size, const std::string & name, std::vector<Vertex> & vertices,
+               std::vector<uint32_t> & indices);
+
+    /// Whether the vertices of the last file read had normals.
+    bool HasNormals() const { return mHasNormals; }
+
+    /// The scalar types of PLY properties.
+    enum Type { kInt8, kUint8, kInt16, kUint16, kInt32, kUint32, kFloat32, kFloat64 };
+
+private:
+    struct Property {
+        std::string name;
+        Type type;
+        /// Lists start with their length, of countType, followed by that many items of type.
+        bool isList;
+        Type countType;
+        /// Where the property starts in its element, if the element has no lists.
+        size_t offset;
+    };
+
+    struct Element {
+        std::string name;
+        uint64_t count;
+        std::vector<Property> properties;
+        /// The size of each record, 0 if the element has lists.
+        size_t stride;
+    };
+
+    /// Reads the header into mElements. Returns the first byte of the data, or nullptr if the header is malformed.
+    const uint8_t * ParseHeader(const char * data, size_t size, const std::string & name);
+    /// Decodes the vertex element starting at p. Returns the end of the element, or nullptr if it is malformed.
+    const uint8_t * ReadVertices(const Element & element, const uint8_t * p, const uint8_t * end,
+                                 const std::string & name, std::vector<Vertex> & vertices);
+    /// Decodes the face element starting at p. Returns the end of the element, or nullptr if it is malformed.
+    const uint8_t * ReadFaces(const Element & element, const uint8_t * p, const uint8_t * end, const std::string & name,
+                              size_t numVertices, std::vector<uint32_t> & indices);
+    /// Returns the end of the element starting at p, or nullptr if it runs past end.
+    const uint8_t * SkipElement(const Element & element, const uint8_t * p, const uint8_t * end) const;
+
+    std::vector<Element> mElements;
+    /// Whether the file's byte order is the opposite of this machine's.
+    bool mSwapBytes = false;
+    bool mHasNormals = false;
+};
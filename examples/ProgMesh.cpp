@@ -2,10 +2,39 @@
 #include "Utilities.hpp"
 #include <utility>
 #include <algorithm>
+#include <unordered_set>
+#include <cmath>
+#include <chrono>
+#include <cstring>
 
-size_t Vertex::sCount = 0;
-size_t Face::sCount = 0;
 bool ProgMesh::sPrintStatements = false;
+bool ProgMesh::sValidatePairs = false;
+bool ProgMesh::sOptimizeVertexCache = false;
+bool ProgMesh::sPackVertices = false;
+
+/// A round of SimplifyToParallel only looks at this fraction of the pairs, cheapest first. Smaller rounds follow
+/// the sequential order more closely, larger ones leave more collapses to run side by side.
+static const size_t kRoundCandidateDivisor = 8;
+/// How many pair errors a round samples to find its cutoff, and how many pieces the edges are split into to be filtered.
+static const uint32_t kRoundSampleSize = 1024;
+static const uint32_t kRoundChunks = 256;
+/// What mIndices holds for a face the prefix layout has never written.
+static const uint32_t kNoTriangle = 0xFFFFFFFFu;
+/// How far the box packed positions are relative to reaches past the vertices, as a fraction of its size.
+static const float kQuantizationMargin = 1.f / 16.f;
+/// The most vertices 16-bit indices can refer to.
+static const size_t kMaxShortIndexVertices = 65536;
+/// The size of the stream buffer UpdateBuffers writes through, a few frames of refinement. Uploads larger than
+/// this, like switching index sizes, update the buffers directly.
+static const long long kStreamBufferBytes = 1 << 20;
+/// Where stream buffer allocations start, a multiple of every vertex and index size.
+static const long long kStreamAlignment = 16;
+
+static Vertex MakeVertex(const PMVertex & v) {
+    return Vertex(glm::vec4(v.position[0], v.position[1], v.position[2], 1.f),
+                  glm::vec4(v.normal[0], v.normal[1], v.normal[2], 0.f),
+                  glm::vec4(v.color[0], v.color[1], v.color[2], v.color[3]));
+}
 
 //ProgMesh::ProgMesh(std::vector<Vertex> & _verts, std::unordered_set<Face> & _faces):
 //mVertices(_verts)
@@ -24,27 +53,122 @@ ProgMesh::ProgMesh(std::vector<Vertex> & _verts, std::vector<uint32_t > & _indic
 mIndices(_indices),
 mOpInProgress(false) {
     mVertices.reserve(_verts.size());
+    mVertexPool.Reserve(_verts.size());
     for (Vertex & aVert : _verts) {
-        Vertex * newVert = new Vertex(aVert);
-        mVertices.push_back(newVert);
+        InsertVertex(CreateVertex(aVert));
     }
+    mFacePool.Reserve(_indices.size() / 3);
 	for (int i = 0; i < _indices.size(); i+=3) {
-		mFaces.insert(new Face(mVertices.at(_indices.at(i)), mVertices.at(_indices.at(i+1)), mVertices.at(_indices.at(i+2))));
+		InsertFace(CreateFace(mVertices.at(_indices.at(i)), mVertices.at(_indices.at(i+1)), mVertices.at(_indices.at(i+2))));
 	}
 }
 
+ProgMesh::ProgMesh(std::shared_ptr<const ProgMeshFile> file, bool prefixLayout) :
+mProgressive(file),
+mPrefixLayout(prefixLayout),
+mOpInProgress(false) {
+    const PMHeader & header = file->Header();
+    // The quadric and plane tables stay empty, they are only needed to simplify.
+    mFileVertices.resize(header.numVertices, nullptr);
+    mFileFaces.resize(header.numFaces, nullptr);
+
+    mVertices.reserve(header.numBaseVertices);
+    for (uint32_t i = 0; i < header.numBaseVertices; i++) {
+        InsertVertex(GetFileVertex(i));
+    }
+    mFaceList.reserve(header.numBaseFaces);
+    for (uint32_t i = 0; i < header.numBaseFaces; i++) {
+        InsertFace(GetFileFace(i));
+        if (mPrefixLayout) mChangedFaces.push_back(i);
+    }
+    GenerateIndicesFromFaces();
+}
+
 ProgMesh::ProgMesh(const ProgMesh & other): mOpInProgress(false) {
     //TODO: Implement proper copy constructor.
 }
 
 ProgMesh::~ProgMesh() {
-	for(auto & facePtr: mFaces) {
-		delete facePtr;
-	}
-    
-    for (auto & vertPtr : mVertices) {
-        delete vertPtr;
-    }
+    // The pools own every vertex and face, including the ones only a decimation refers to, and release them in blocks.
+}
+
+Vertex * ProgMesh::CreateVertex(const Vertex & aVertex) {
+	uint32_t index = mVertexPool.Create(aVertex);
+	Vertex * newVertex = mVertexPool[index];
+	newVertex->mId = index;
+	if (mQuadrics.size() < mVertexPool.Size()) mQuadrics.resize(mVertexPool.Size());
+	return newVertex;
+}
+
+void ProgMesh::DestroyVertex(Vertex * aVertex) {
+	mVertexPool.Destroy(aVertex->mId);
+}
+
+Face * ProgMesh::CreateFace(Vertex * v0, Vertex * v1, Vertex * v2) {
+	uint32_t index = mFacePool.Create(v0, v1, v2);
+	Face * newFace = mFacePool[index];
+	newFace->mId = index;
+	if (mFacePlanes.size() < mFacePool.Size()) mFacePlanes.resize(mFacePool.Size());
+	return newFace;
+}
+
+void ProgMesh::InsertVertex(Vertex * aVertex) {
+	aVertex->mSlot = (uint32_t)mVertices.size();
+	mVertices.push_back(aVertex);
+	MarkInsertedVertexDirty(aVertex);
+}
+
+void ProgMesh::MarkInsertedVertexDirty(const Vertex * aVertex) {
+	// With the prefix layout a vertex never moves, and is usually still in the buffer from the last time.
+	uint32_t slot = VertexBufferSlot(aVertex);
+	if (!mPrefixLayout || slot >= mSlotUploaded.size() || !mSlotUploaded[slot]) MarkVertexDirty(aVertex);
+}
+
+void ProgMesh::RemoveVertex(Vertex * aVertex) {
+	// Order doesn't matter for the vertex array, the index buffer is regenerated after every change.
+	Vertex * last = mVertices.back();
+	mVertices[aVertex->mSlot] = last;
+	last->mSlot = aVertex->mSlot;
+	mVertices.pop_back();
+	aVertex->mSlot = 0xFFFFFFFFu;
+	if (last != aVertex && !mPrefixLayout) MarkVertexDirty(last);
+}
+
+void ProgMesh::InsertFace(Face * aFace) {
+	aFace->mSlot = (uint32_t)mFaceList.size();
+	mFaceList.push_back(aFace);
+}
+
+void ProgMesh::RemoveFace(Face * aFace) {
+	Face * last = mFaceList.back();
+	mFaceList[aFace->mSlot] = last;
+	last->mSlot = aFace->mSlot;
+	mFaceList.pop_back();
+	aFace->mSlot = 0xFFFFFFFFu;
+}
+
+void ProgMesh::MarkVertexDirty(const Vertex * aVertex) {
+	// A vertex out of the mesh keeps its slot with the prefix layout, and has to be right when it comes back.
+	if (aVertex->mSlot == 0xFFFFFFFFu && !mPrefixLayout) return;
+	uint32_t slot = VertexBufferSlot(aVertex);
+	if (mSlotDirty.size() <= slot) mSlotDirty.resize(std::max<size_t>(slot + 1, 2 * mSlotDirty.size()), 0);
+	if (mSlotDirty[slot]) return;
+	mSlotDirty[slot] = 1;
+	mDirtySlots.push_back(slot);
+}
+
+void ProgMesh::MarkTriangleDirty(size_t triangle) {
+	if (mTriangleDirty.size() <= triangle) mTriangleDirty.resize(std::max(triangle + 1, 2 * mTriangleDirty.size()), 0);
+	if (mTriangleDirty[triangle]) return;
+	mTriangleDirty[triangle] = 1;
+	mDirtyTriangles.push_back((uint32_t)triangle);
+}
+
+void ProgMesh::ClearDirty() {
+	for (uint32_t slot : mDirtySlots) mSlotDirty[slot] = 0;
+	mDirtySlots.clear();
+	for (uint32_t triangle : mDirtyTriangles) mTriangleDirty[triangle] = 0;
+	mDirtyTriangles.clear();
 }
 
 void ProgMesh::AllocateBuffers(starforge::RenderDevice &renderDevice) {
@@ -52,209 +176,339 @@ void ProgMesh::AllocateBuffers(starforge::RenderDevice &renderDevice) {
     if(mVBO) renderDevice.DestroyVertexBuffer(mVBO);
     if(mIBO) renderDevice.DestroyIndexBuffer(mIBO);
     if(mVertexDescription) renderDevice.DestroyVertexDescription(mVertexDescription);
+    if (sOptimizeVertexCache) OptimizeVertexCache();
     
     // Make a local contiguous array to copy verts into GPU buffer
     std::vector<Vertex> localVerts;
-    localVerts.reserve(mVertices.size());
-    for (auto & vertPtr : mVertices) {
-        localVerts.push_back(*vertPtr);
+    if (mPrefixLayout) {
+        // Every vertex the file has so far, in file order, whether or not it is in the mesh right now.
+        const PMHeader & header = mProgressive->Header();
+        uint32_t numAvailable = header.numBaseVertices + 2 * mProgressive->NumSplitsAvailable();
+        localVerts.reserve(numAvailable);
+        for (uint32_t i = 0; i < numAvailable; i++) {
+            localVerts.push_back(mFileVertices[i] ? *mFileVertices[i] : MakeVertex(mProgressive->Vertices()[i]));
+        }
+        mSlotUploaded.assign(header.numVertices, 0);
+        std::fill(mSlotUploaded.begin(), mSlotUploaded.begin() + numAvailable, 1);
+
+        // Same for the faces: the ones out of the mesh hold the corners they come back with, which are only drawn
+        // once the draw range reaches them again.
+        uint32_t numAvailableFaces = mProgressive->Levels()[mProgressive->NumSplitsAvailable()].numFaces;
+        if (mIndices.size() < 3 * (size_t)numAvailableFaces) mIndices.resize(3 * (size_t)numAvailableFaces, kNoTriangle);
+        const uint32_t * corners = mProgressive->Faces();
+        for (uint32_t i = 0; i < numAvailableFaces; i++) {
+            if (mIndices[3 * i] != kNoTriangle) continue;
+            std::copy(corners + 3 * i, corners + 3 * i + 3, mIndices.begin() + 3 * i);
+        }
+    } else {
+        localVerts.reserve(mVertices.size());
+        for (auto & vertPtr : mVertices) {
+            localVerts.push_back(*vertPtr);
+        }
     }
 
-    mVBO = renderDevice.CreateVertexBuffer(mVertices.size() * sizeof(Vertex), localVerts.data());
-    mIBO = renderDevice.CreateIndexBuffer(mIndices.size() * sizeof(uint32_t), mIndices.data());
-    starforge::VertexElement vertexElements[] = {
-        {0, starforge::VERTEXELEMENTTYPE_FLOAT, 4, sizeof(Vertex), 0}, // Position attribute
-        {1, starforge::VERTEXELEMENTTYPE_FLOAT, 4, sizeof(Vertex), sizeof(glm::vec4)}, // Normal attribute
-        {2, starforge::VERTEXELEMENTTYPE_FLOAT, 4, sizeof(Vertex), sizeof(glm::vec4) * 2} // Color attribute.
-    };
-    mVertexDescription = renderDevice.CreateVertexDescription(3, vertexElements);
+    // Packed positions are relative to a box around every vertex the mesh can show at any level.
+    mPacked = sPackVertices;
+    if (mPacked) {
+        glm::vec3 boundsMin(std::numeric_limits<float>::max()), boundsMax(-std::numeric_limits<float>::max());
+        auto addBounds = [&](const glm::vec3 & position) {
+            boundsMin = glm::min(boundsMin, position);
+            boundsMax = glm::max(boundsMax, position);
+        };
+        if (mProgressive) {
+            // A mapped file has every vertex in place even while its splits are checked on use.
+            const PMHeader & header = mProgressive->Header();
+            uint32_t numAvailable = mProgressive->IsMapped() ? header.numVertices
+                                                             : header.numBaseVertices + 2 * mProgressive->NumSplitsAvailable();
+            for (uint32_t i = 0; i < numAvailable; i++) {
+                const float * position = mProgressive->Vertices()[i].position;
+                addBounds(glm::vec3(position[0], position[1], position[2]));
+            }
+        } else {
+            for (const Vertex * aVertex : mVertices) addBounds(glm::vec3(aVertex->mPos));
+            for (size_t i = 0; i < mDecimations.Size(); i++) {
+                addBounds(glm::vec3(mVertexPool[mDecimations.At(i).v0]->mPos));
+                addBounds(glm::vec3(mVertexPool[mDecimations.At(i).v1]->mPos));
+            }
+        }
+        if (boundsMin.x > boundsMax.x) boundsMin = boundsMax = glm::vec3(0.f);
+        mQuantization = PositionQuantization::FromBounds(boundsMin, boundsMax, kQuantizationMargin);
+    }
+
+    // UpdateBuffers only overwrites the buffers, so make room for the finest level the mesh can be refined to.
+    // Every split adds one vertex, and no face exists that isn't in a pool already. The index buffer has room for
+    // 32-bit indices, so UpdateBuffers can switch to them and back.
+    size_t numSplitsLeft = mProgressive ? mProgressive->Header().numSplits - mProgressiveLevel : mDecimations.Size();
+    size_t maxFaces = mProgressive ? mProgressive->Header().numFaces : mFacePool.Size();
+    size_t maxVertices = mPrefixLayout ? mProgressive->Header().numVertices : mVertices.size() + numSplitsLeft;
+    mShortIndices = mPacked && (mPrefixLayout ? maxVertices : mVertices.size()) <= kMaxShortIndexVertices;
+    mVBO = renderDevice.CreateVertexBuffer(maxVertices * VertexStride(), nullptr);
+    mIBO = renderDevice.CreateIndexBuffer(std::max(maxFaces, mFaceList.size()) * 3 * sizeof(uint32_t), nullptr);
+    if (!mStreamBuffer) mStreamBuffer = renderDevice.CreateStreamBuffer(kStreamBufferBytes);
+    long long vertexBytes, indexBytes;
+    const void * vertexData = VertexData(localVerts, vertexBytes);
+    const void * indexData = IndexData(0, mIndices.size(), indexBytes);
+    renderDevice.FillVertexBuffer(mVBO, vertexBytes, vertexData);
+    renderDevice.FillIndexBuffer(mIBO, indexBytes, indexData);
+    mUploadStats.bytes += vertexBytes + indexBytes;
+    mUploadStats.ranges += 2;
+    // Everything is on the GPU now, UpdateBuffers only has to send what changes from here on.
+    ClearDirty();
+    if (mPacked) {
+        starforge::VertexElement vertexElements[] = {
+            {0, starforge::VERTEXELEMENTTYPE_SHORT_NORMALIZE, 3, sizeof(PackedVertex), offsetof(PackedVertex, position)},
+            {1, starforge::VERTEXELEMENTTYPE_SHORT_NORMALIZE, 2, sizeof(PackedVertex), offsetof(PackedVertex, normal)},
+            {2, starforge::VERTEXELEMENTTYPE_UNSIGNED_BYTE_NORMALIZE, 4, sizeof(PackedVertex), offsetof(PackedVertex, color)}
+        };
+        mVertexDescription = renderDevice.CreateVertexDescription(3, vertexElements);
+    } else {
+        starforge::VertexElement vertexElements[] = {
+            {0, starforge::VERTEXELEMENTTYPE_FLOAT, 4, sizeof(Vertex), 0}, // Position attribute
+            {1, starforge::VERTEXELEMENTTYPE_FLOAT, 4, sizeof(Vertex), sizeof(glm::vec4)}, // Normal attribute
+            {2, starforge::VERTEXELEMENTTYPE_FLOAT, 4, sizeof(Vertex), sizeof(glm::vec4) * 2} // Color attribute.
+        };
+        mVertexDescription = renderDevice.CreateVertexDescription(3, vertexElements);
+    }
 
     mVAO = renderDevice.CreateVertexArray(1, &mVBO, &mVertexDescription);
 }
 
+const void * ProgMesh::VertexData(const std::vector<Vertex> & vertices, long long & bytes) {
+    if (!mPacked) {
+        bytes = (long long)(vertices.size() * sizeof(Vertex));
+        return vertices.data();
+    }
+    mUploadPacked.resize(vertices.size());
+    for (size_t i = 0; i < vertices.size(); i++) mUploadPacked[i] = PackVertex(vertices[i], mQuantization);
+    bytes = (long long)(mUploadPacked.size() * sizeof(PackedVertex));
+    return mUploadPacked.data();
+}
+
+const void * ProgMesh::IndexData(size_t first, size_t count, long long & bytes) {
+    if (!mShortIndices) {
+        bytes = (long long)(count * sizeof(uint32_t));
+        return mIndices.data() + first;
+    }
+    mUploadShortIndices.assign(mIndices.begin() + first, mIndices.begin() + first + count);
+    bytes = (long long)(count * sizeof(uint16_t));
+    return mUploadShortIndices.data();
+}
+
+void ProgMesh::StreamUpload(starforge::RenderDevice & renderDevice, bool indices, long long offset, long long bytes,
+                            const void * data) {
+    long long streamOffset;
+    void * memory = mStreamBuffer->Allocate(bytes, kStreamAlignment, streamOffset);
+    if (!memory) {
+        if (indices) renderDevice.UpdateIndexBuffer(mIBO, offset, bytes, data);
+        else renderDevice.UpdateVertexBuffer(mVBO, offset, bytes, data);
+        return;
+    }
+    std::memcpy(memory, data, (size_t)bytes);
+    if (indices) renderDevice.CopyStreamToIndexBuffer(mStreamBuffer, streamOffset, mIBO, offset, bytes);
+    else renderDevice.CopyStreamToVertexBuffer(mStreamBuffer, streamOffset, mVBO, offset, bytes);
+}
+
+void ProgMesh::ReleaseBuffers(starforge::RenderDevice &renderDevice) {
+    if (mVAO) renderDevice.DestroyVertexArray(mVAO);
+    if (mVBO) renderDevice.DestroyVertexBuffer(mVBO);
+    if (mIBO) renderDevice.DestroyIndexBuffer(mIBO);
+    if (mVertexDescription) renderDevice.DestroyVertexDescription(mVertexDescription);
+    if (mMorphVAO) renderDevice.DestroyVertexArray(mMorphVAO);
+    if (mMorphVBO) renderDevice.DestroyVertexBuffer(mMorphVBO);
+    if (mMorphIBO) renderDevice.DestroyIndexBuffer(mMorphIBO);
+    if (mMorphDescription) renderDevice.DestroyVertexDescription(mMorphDescription);
+    if (mStreamBuffer) renderDevice.DestroyStreamBuffer(mStreamBuffer);
+    mStreamBuffer = nullptr;
+    mVAO = mMorphVAO = nullptr;
+    mVBO = mMorphVBO = nullptr;
+    mIBO = mMorphIBO = nullptr;
+    mVertexDescription = mMorphDescription = nullptr;
+}
+
 void ProgMesh::Draw(starforge::RenderDevice &renderDevice) {
+	if (mMorphing) {
+		renderDevice.SetVertexArray(mMorphVAO);
+		renderDevice.SetIndexBuffer(mMorphIBO);
+		renderDevice.DrawTrianglesIndexed32(0, (int)mGeomorph.indices.size());
+		return;
+	}
 	renderDevice.SetVertexArray(mVAO);
 	renderDevice.SetIndexBuffer(mIBO);
 
-	renderDevice.DrawTrianglesIndexed32(0, (int)mIndices.size());
+	int count = mPrefixLayout ? 3 * (int)mDrawFaces : (int)mIndices.size();
+	if (mShortIndices) renderDevice.DrawTrianglesIndexed16(0, count);
+	else renderDevice.DrawTrianglesIndexed32(0, count);
 }
 
 void ProgMesh::BuildConnectivity() {
 // Clear any previous adjacency
-	mVertexFaceAdjacency.clear();
-	mVertexFaceAdjacency = std::unordered_multimap<Vertex *, Face *, VertexPtrHash>();
-	mEdges.clear();
-	mEdges = std::unordered_multimap<Vertex *, Vertex *, VertexPtrHash>();
-
-// Iterate over all faces and add to vertex to Face adjacency list.
-	for(auto & aFace: mFaces) {
-		for (int i = 0; i < 3; ++i) {
-			Vertex * aVertex = aFace->GetVertex(i);
-			mVertexFaceAdjacency.insert(std::make_pair(aVertex, aFace));
-		}
-	}
-
-// Go over each face and add the edges to the vertex to vertex adjacency list.
-	for(auto & aFace: mFaces) {
-		Vertex * v0 = aFace->GetVertex(0);
-		Vertex * v1 = aFace->GetVertex(1);
-		Vertex * v2 = aFace->GetVertex(2);
+	mConnectivity.Clear();
+	mConnectivity.Reserve(mVertexPool.Size(), mFacePool.Size());
 
-		std::vector<Vertex* > neighbors = GetConnectedVertices(v0);
-		if (std::find(neighbors.begin(), neighbors.end(), v1) == neighbors.end()) {
-			mEdges.insert(std::make_pair(v0, v1));
-			mEdges.insert(std::make_pair(v1, v0));
-		}
-
-		neighbors = GetConnectedVertices(v1);
-		if (std::find(neighbors.begin(), neighbors.end(), v2) == neighbors.end()) {
-			mEdges.insert(std::make_pair(v1, v2));
-			mEdges.insert(std::make_pair(v2, v1));
-		}
-
-		neighbors = GetConnectedVertices(v2);
-		if (std::find(neighbors.begin(), neighbors.end(), v0) == neighbors.end()) {
-			mEdges.insert(std::make_pair(v2, v0));
-			mEdges.insert(std::make_pair(v0, v2));
-		}
+// Adding a face links it to its vertices and creates any of its edges that don't exist yet.
+	for(auto & aFace: mFaceList) {
+		mConnectivity.AddFace(aFace->mId, aFace->GetVertex(0)->mId,
+							  aFace->GetVertex(1)->mId, aFace->GetVertex(2)->mId);
 	}
 }
 
 void ProgMesh::PrintConnectivity(std::ostream & os) {
     //for( Vertex & aVertex: mVertices) {
-    //    auto range = mVertexFaceAdjacency.equal_range(&aVertex);
-    //    size_t count = 0;
-    //    for(auto it = range.first; it != range.second; ++it) {
-    //        auto vert = it->first;
-    //        auto face = it->second;
-    //        count++;
-    //    }
-    //    os << "\t\tVertex " << aVertex.mId << " is adjacent to " << count << " faces." << std::endl;
+    //    os << "\t\tVertex " << aVertex.mId << " is adjacent to " << mConnectivity.NumFaces(aVertex.mId) << " faces." << std::endl;
     //}
 
-	os << "\t\tThere are " << mEdges.size() / 2.f << " edges in this mesh." << std::endl;
+	os << "\t\tThere are " << mConnectivity.NumEdges() << " edges in this mesh." << std::endl;
 }
 
 std::vector<Vertex *> ProgMesh::GetConnectedVertices(Vertex * aVertex) const {
-	auto range = mEdges.equal_range(aVertex);
 	std::vector<Vertex *> neighbors;
-	for(auto it = range.first; it != range.second; ++it) {
-		neighbors.push_back(it->second);
-	}
+	mConnectivity.ForEachNeighbor(aVertex->mId, [&](uint32_t aNeighbor, uint32_t) {
+		neighbors.push_back(mVertexPool[aNeighbor]);
+	});
 	return neighbors;
 }
 
 std::vector<Face *> ProgMesh::GetAdjacentFaces(Vertex * aVertex) const {
-	auto range = mVertexFaceAdjacency.equal_range(aVertex);
 	std::vector<Face*> neighbors;
-	for(auto it = range.first; it != range.second; ++it) {
-		neighbors.push_back(it->second);
-	}
+	mConnectivity.ForEachFace(aVertex->mId, [&](uint32_t aFace) {
+		neighbors.push_back(mFacePool[aFace]);
+	});
 	return neighbors;
 }
 
-glm::mat4 ProgMesh::ComputeQuadric(Vertex * aVertex) const {
-
-	std::vector<Face* > faces = GetAdjacentFaces(aVertex);
-	glm::vec3 v0, v1, v2, n;
-	glm::vec4 q;
-	glm::mat4 Q = glm::mat4(0.0f);
-
-	for (Face* & aFace : faces) {
-		v0 = aFace->GetVertex(0)->mPos;
-		v1 = aFace->GetVertex(1)->mPos;
-		v2 = aFace->GetVertex(2)->mPos;
-
-		n = glm::cross(v1 - v0, v2 - v0);
-		n = glm::normalize(n);
-
-		q = { n.x,n.y,n.z,glm::dot(-n,v0) };
-		Q += glm::outerProduct(q, q);
-	}
+Quadric ProgMesh::ComputeQuadric(Vertex * aVertex) const {
+	Quadric Q;
+	mConnectivity.ForEachFace(aVertex->mId, [&](uint32_t faceIndex) {
+		Q += mFacePlanes[faceIndex];
+	});
 	return Q;
 }
 
-void ProgMesh::PreparePairsAndQuadrics() {
-	for (Vertex *& aVertex : mVertices) {
-        // Compute quadric for each vertex
-		mQuadrics.insert(std::make_pair(aVertex, ComputeQuadric(aVertex)));
+Quadric ProgMesh::ComputePlaneQuadric(const Face * aFace) {
+	glm::vec3 v0 = aFace->GetVertex(0)->mPos;
+	glm::vec3 v1 = aFace->GetVertex(1)->mPos;
+	glm::vec3 v2 = aFace->GetVertex(2)->mPos;
 
-        // Compute error for each pair and order them
-		auto neighbors = GetConnectedVertices(aVertex);
-		for (Vertex* & aNeighbor : neighbors) {
-			Pair newPair(aVertex, aNeighbor);
+	glm::vec3 n = glm::cross(v1 - v0, v2 - v0);
+	float length = glm::length(n);
+	// A face without area has no plane. Leaving it out keeps a NaN from spreading through every quadric it touches.
+	if (length == 0.f) return Quadric();
+	n /= length;
 
-            // only midpoint TODO - can definetly make this the legit optimal w/o too much trouble
-			Vertex vOptimal = newPair.CalcOptimal();
-            float error = glm::dot(vOptimal.mPos,
-				(mQuadrics[aVertex] + mQuadrics[aNeighbor]) * vOptimal.mPos);
+	return Quadric::FromPlane(glm::vec4(n, glm::dot(-n, v0)));
+}
 
-			auto itr = mPairs.insert(std::make_pair(error, newPair));
-			mEdgeToPair.insert(std::make_pair(std::make_pair(aVertex, aNeighbor), itr));
-		}
+void ProgMesh::PreparePairsAndQuadrics() {
+	// Compute the plane of each face, then the quadric for each vertex. All of them must exist before any pair is scored.
+#pragma omp parallel for
+	for (int i = 0; i < (int)mFacePool.Size(); i++) {
+		mFacePlanes[i] = ComputePlaneQuadric(mFacePool[i]);
+	}
+#pragma omp parallel for
+	for (int i = 0; i < (int)mVertices.size(); i++) {
+		mQuadrics[mVertices[i]->mId] = ComputeQuadric(mVertices[i]);
 	}
+
+	PreparePairs();
 }
 
 void ProgMesh::PreparePairs() {
-	for (Vertex *& aVertex : mVertices) {
-
-		// Compute error for each pair and order them
-		auto neighbors = GetConnectedVertices(aVertex);
-		for (Vertex* & aNeighbor : neighbors) {
-			Pair newPair(aVertex, aNeighbor);
-
-			// only midpoint TODO - can definetly make this the legit optimal w/o too much trouble
-			Vertex vOptimal = newPair.CalcOptimal();
-			float error = glm::dot(vOptimal.mPos,
-				(mQuadrics[aVertex] + mQuadrics[aNeighbor]) * vOptimal.mPos);
-
-			auto itr = mPairs.insert(std::make_pair(error, newPair));
-			mEdgeToPair.insert(std::make_pair(std::make_pair(aVertex, aNeighbor), itr));
-		}
+	mPairs.Clear();
+	mPairs.Reserve(mConnectivity.EdgeCapacity());
+
+	// Compute error for each pair and order them. There is exactly one pair per edge.
+	mPendingPairs.clear();
+	mPendingPairs.reserve(mConnectivity.NumEdges());
+	for (uint32_t edgeId = 0; edgeId < mConnectivity.EdgeCapacity(); edgeId++) {
+		if (mConnectivity.HasEdge(edgeId)) mPendingPairs.push_back(edgeId);
 	}
+	ScorePendingPairs();
 }
 
+Edge ProgMesh::MakeEdgeKey(Vertex * vA, Vertex * vB) {
+	return vA->mId < vB->mId ? std::make_pair(vA, vB) : std::make_pair(vB, vA);
+}
 
-void ProgMesh::DeletePairsWithNeighbor(Vertex* v, std::vector<Vertex* > neighbors, Decimation & dec) {
+Pair ProgMesh::GetPair(uint32_t edgeId) const {
+	return Pair(mVertexPool[mConnectivity.EdgeVertex(edgeId, 0)], mVertexPool[mConnectivity.EdgeVertex(edgeId, 1)]);
+}
 
-	for (Vertex* & aNeighbor : neighbors) {
-		auto itr = mEdgeToPair.find(std::make_pair(v, aNeighbor));
-		if (itr != mEdgeToPair.end()) {
-			mPairs.erase(itr->second);
-			mEdgeToPair.erase(itr);
-		}
-		itr = mEdgeToPair.find(std::make_pair(aNeighbor, v));
-		if (itr != mEdgeToPair.end()) {
-			mPairs.erase(itr->second);
-			mEdgeToPair.erase(itr);
-		}
-	}
+float ProgMesh::CalcPairError(uint32_t edgeId, glm::vec3 & target) const {
+	uint32_t v0 = mConnectivity.EdgeVertex(edgeId, 0);
+	uint32_t v1 = mConnectivity.EdgeVertex(edgeId, 1);
+
+	PairCostBatch batch;
+	batch.Add(mQuadrics[v0] + mQuadrics[v1], glm::vec3(mVertexPool[v0]->mPos), glm::vec3(mVertexPool[v1]->mPos));
+	batch.Evaluate();
+	target = batch.Position(0);
+	return batch.Cost(0);
 }
 
-void ProgMesh::CalculateAndStorePair(Vertex* vA, Vertex * vB) {
+void ProgMesh::DeletePairsAround(Vertex * v) {
+	mConnectivity.ForEachNeighbor(v->mId, [this](uint32_t, uint32_t edgeId) {
+		mPairs.Remove(edgeId);
+	});
+}
 
-	Pair pairAB(vA, vB);
-	Pair pairBA(vB, vA);
+void ProgMesh::StorePairsAround(Vertex * v) {
+	mConnectivity.ForEachNeighbor(v->mId, [this](uint32_t, uint32_t edgeId) {
+		mPendingPairs.push_back(edgeId);
+	});
+}
 
-	Vertex vOptimal = pairAB.CalcOptimal();
-	float error = glm::dot(vOptimal.mPos,
-			(mQuadrics[vA] + mQuadrics[vB]) * vOptimal.mPos);
+void ProgMesh::ScorePendingPairs() {
+	// An edge between two vertices that both had their pairs queued shows up twice.
+	std::sort(mPendingPairs.begin(), mPendingPairs.end());
+	mPendingPairs.erase(std::unique(mPendingPairs.begin(), mPendingPairs.end()), mPendingPairs.end());
 
+	EvaluatePendingPairs();
+	for (uint32_t edgeId : mPendingPairs) {
+		mPairs.PushOrUpdate(edgeId, mPairCosts[edgeId]);
+	}
+	mPendingPairs.clear();
+}
 
-	auto itr = mPairs.insert(std::make_pair(error, pairAB));
-	mEdgeToPair.insert(std::make_pair(std::make_pair(vA, vB), itr));
+void ProgMesh::EvaluatePendingPairs() {
+	if (mPairTargets.size() < mConnectivity.EdgeCapacity()) {
+		mPairTargets.resize(mConnectivity.EdgeCapacity());
+		mPairCosts.resize(mConnectivity.EdgeCapacity());
+	}
 
-	itr = mPairs.insert(std::make_pair(error, pairBA));
-	mEdgeToPair.insert(std::make_pair(std::make_pair(vB, vA), itr));
-	
+	// The batches are independent, only big lists are worth splitting across threads.
+	const size_t numPending = mPendingPairs.size();
+	const int numBatches = (int)((numPending + PairCostBatch::kBatchSize - 1) / PairCostBatch::kBatchSize);
+#pragma omp parallel for if(numBatches > 64)
+	for (int b = 0; b < numBatches; b++) {
+		size_t first = size_t(b) * PairCostBatch::kBatchSize;
+		size_t last = std::min(first + PairCostBatch::kBatchSize, numPending);
+
+		PairCostBatch batch;
+		for (size_t i = first; i < last; i++) {
+			uint32_t v0 = mConnectivity.EdgeVertex(mPendingPairs[i], 0);
+			uint32_t v1 = mConnectivity.EdgeVertex(mPendingPairs[i], 1);
+			batch.Add(mQuadrics[v0] + mQuadrics[v1], glm::vec3(mVertexPool[v0]->mPos), glm::vec3(mVertexPool[v1]->mPos));
+		}
+		batch.Evaluate();
+		for (size_t i = first; i < last; i++) {
+			mPairCosts[mPendingPairs[i]] = batch.Cost(i - first);
+			mPairTargets[mPendingPairs[i]] = batch.Position(i - first);
+		}
+	}
 }
 
-// need to update mVector, mFaces, mVertexFaceAdjacency, mEdges, mQuadrics
+// need to update mVector, mFaceList, mConnectivity, mQuadrics
 void ProgMesh::EdgeCollapse(Pair* collapsePair) {
-    Vertex * vNew = new Vertex(collapsePair->CalcOptimal());
     Vertex* v0 = collapsePair->v0;
     Vertex* v1 = collapsePair->v1;
-    Decimation decimation;
+    // CalcOptimal averages the attributes, the position comes from the quadrics.
+    Vertex * vNew = CreateVertex(collapsePair->CalcOptimal());
+    uint32_t edgeId = mConnectivity.FindEdge(v0->mId, v1->mId);
+    Decimation & decimation = mScratchDecimation;
+    decimation.error = 0.f;
+    if (edgeId != MeshConnectivity::npos) {
+        vNew->mPos = glm::vec4(mPairTargets[edgeId], 1.f);
+        decimation.error = mPairCosts[edgeId];
+    }
     // Save v0, v1, and vNew in decimation object
     decimation.vNew = vNew;
     decimation.v0 = v0;
@@ -262,56 +516,57 @@ void ProgMesh::EdgeCollapse(Pair* collapsePair) {
     
     
     // Insert replacement vertex vNew into master array
-    mVertices.push_back(vNew);
+    InsertVertex(vNew);
     
     
-    // 1. Update Faces ( Create new faces, remove degenerates)
+    // 1. Update Faces ( Create new faces, remove degenerates). This also moves the edges over to vNew.
     UpdateFaces(v0, v1, *vNew, decimation);
     
-    // 2. Update Edges (Create new edges, delete degenerates)
-	std::vector<Vertex* > neighbors = UpdateEdgesAndQuadrics(v0, v1, *vNew, decimation);
+    // 2. Update the quadrics of vNew and of every vertex whose faces changed
+	UpdateQuadrics(v0, v1, *vNew, decimation);
 
     // 3. Remove v0 and v1 from master vertices array.
-    // TODO: Replace deletion with move to decimation object
-    mVertices.erase(std::remove_if(mVertices.begin(), mVertices.end(), [v0, v1] (Vertex *& v) {
-        return (*v == *v0) || (*v == *v1);
-    }), mVertices.end());
+    RemoveVertex(v0);
+    RemoveVertex(v1);
 
-	// 4. Update Pairs
-	UpdatePairs(v0, v1, *vNew, neighbors, decimation);
+    // 4. Add decimation to list, ValidatePairs rebuilds the quadric of vNew from it
+    mDecimations.Push(decimation);
 
-	// 5. (Regen indices for rendering)
-	GenerateIndicesFromFaces();
-    
-    // 6. Add decimation to list
-    mDecimations.push(decimation);
+	// 5. Update Pairs
+	UpdatePairs(decimation);
 
 }
 
 bool ProgMesh::Downscale() {
-	if (mPairs.empty() || mOpInProgress) return false;
+	if (mProgressive) {
+		if (mProgressiveLevel == 0 || mOpInProgress) return false;
+		if (mSelective) SetProgressiveLevel(mProgressiveLevel);
+		UndoSplit(--mProgressiveLevel);
+		GenerateIndicesFromFaces();
+		return true;
+	}
+	if (mPairs.Empty() || mOpInProgress) return false;
     
     mOpInProgress = true;
     
     // First check if we had previously schedule a collapse.
-    if(mScheduledCollapse != nullptr) {
-        if (sPrintStatements) std::cout << "Collapsing pair: " << mScheduledCollapse->v0 << ", " << mScheduledCollapse->v1 << std::endl;
-        EdgeCollapse(mScheduledCollapse);
-        if (sPrintStatements) PrintConnectivity(std::cout);
-        mScheduledCollapse = nullptr;
+    if(mScheduledCollapse.v0 != nullptr) {
+        PerformScheduledCollapse();
+        GenerateIndicesFromFaces();
         mOpInProgress = false;
     }
     // If not, start the animation and schdule it for later.
     else {
-        mScheduledCollapse =  &(mPairs.begin()->second);
-        Vertex* v0 = mScheduledCollapse->v0;
-        Vertex* v1 = mScheduledCollapse->v1;
+        uint32_t pairId = mPairs.Top();
+        mScheduledCollapse = GetPair(pairId);
+        Vertex* v0 = mScheduledCollapse.v0;
+        Vertex* v1 = mScheduledCollapse.v1;
         
-        glm::vec3 start0(v0->mPos);
-        glm::vec3 start1(v1->mPos);
-        glm::vec3 end = mScheduledCollapse->CalcOptimal().mPos;
-        mVerticesInMotion.insert(std::make_pair(v0, std::make_pair(start0, end)));
-        mVerticesInMotion.insert(std::make_pair(v1, std::make_pair(start1, end)));
+        mScheduledStart0 = glm::vec3(v0->mPos);
+        mScheduledStart1 = glm::vec3(v1->mPos);
+        glm::vec3 end = mPairTargets[pairId];
+        mVerticesInMotion.insert(std::make_pair(v0, std::make_pair(mScheduledStart0, end)));
+        mVerticesInMotion.insert(std::make_pair(v1, std::make_pair(mScheduledStart1, end)));
         mVertexTime.insert(std::make_pair(v0, 0.0));
         mVertexTime.insert(std::make_pair(v1, 0.0));
     }
@@ -323,28 +578,417 @@ bool ProgMesh::Downscale() {
 void ProgMesh::TestEdgeCollapse(unsigned int v0, unsigned int v1) {
 	Vertex* vStart = mVertices.at(v0);
 	Vertex* vEnd = mVertices.at(v1);
-	glm::vec4 vOptimal = (vStart->mPos + vEnd->mPos / 2.0f);
-
-	float error = glm::dot(vOptimal,(mQuadrics[vStart] + mQuadrics[vEnd]) * vOptimal);
-	auto itr = mPairs.find(error);
 
-	if (itr == mPairs.end()) {
+	if (mConnectivity.FindEdge(vStart->mId, vEnd->mId) == MeshConnectivity::npos) {
 		std::cerr << "Pair not found!" << std::endl;
 		return;
 	}
 
-	EdgeCollapse(&(itr->second));
+	Pair aPair(vStart, vEnd);
+	EdgeCollapse(&aPair);
+	GenerateIndicesFromFaces();
+}
+
+SimplifyStats ProgMesh::SimplifyTo(const SimplifyTarget & target) {
+	auto start = std::chrono::steady_clock::now();
+	FinishAnimations();
+
+	SimplifyStats stats;
+	stats.facesBefore = mFaceList.size();
+	stats.verticesBefore = mVertices.size();
+
+	while (!mPairs.Empty() && mFaceList.size() > target.maxFaces && mVertices.size() > target.maxVertices) {
+		uint32_t pairId = mPairs.Top();
+		float error = mPairs.Key(pairId);
+		if (error > target.maxError) break;
+
+		Pair aPair = GetPair(pairId);
+		EdgeCollapse(&aPair);
+		stats.collapses++;
+		stats.maxError = std::max(stats.maxError, error);
+		stats.totalError += error;
+	}
+	GenerateIndicesFromFaces();
+	if (sOptimizeVertexCache) OptimizeVertexCache();
+
+	stats.facesAfter = mFaceList.size();
+	stats.verticesAfter = mVertices.size();
+	stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	if (sPrintStatements) {
+		std::cout << "Simplified from " << stats.facesBefore << " to " << stats.facesAfter << " faces with "
+				  << stats.collapses << " collapses in " << stats.seconds << "s" << std::endl;
+	}
+	return stats;
+}
+
+std::shared_ptr<ProgMesh> ProgMesh::CopyCurrentMesh() {
+	FinishAnimations();
+	// Straight from the lists, mIndices may be in the prefix layout.
+	std::vector<Vertex> vertices;
+	vertices.reserve(mVertices.size());
+	for (const Vertex * aVertex : mVertices) vertices.push_back(*aVertex);
+	std::vector<uint32_t> indices;
+	indices.reserve(3 * mFaceList.size());
+	for (const Face * aFace : mFaceList) {
+		for (int i = 0; i < 3; i++) indices.push_back(aFace->GetVertex(i)->mSlot);
+	}
+	auto copy = std::make_shared<ProgMesh>(vertices, indices);
+	copy->BuildConnectivity();
+	copy->PreparePairsAndQuadrics();
+	return copy;
+}
+
+/// Takes items out of a list in which every item knows its slot, like RemoveVertex and RemoveFace do one at a time,
+/// but for many at once: the slots they free below the new end get the items past it that stay, in order. Each item
+/// is listed once. The slots are read and written in parallel, and the items that moved are left in moved.
+template <typename T>
+static void RemoveFromSlots(std::vector<T *> & list, const std::vector<T *> & removed, std::vector<uint32_t> & holes,
+							std::vector<T *> & moved) {
+	const size_t newSize = list.size() - removed.size();
+	holes.resize(removed.size());
+#pragma omp parallel for if(removed.size() > 256)
+	for (int i = 0; i < (int)removed.size(); i++) {
+		holes[i] = removed[i]->mSlot;
+		removed[i]->mSlot = 0xFFFFFFFFu;
+	}
+	holes.erase(std::remove_if(holes.begin(), holes.end(), [newSize](uint32_t slot) { return slot >= newSize; }), holes.end());
+	moved.clear();
+	for (size_t slot = newSize; slot < list.size(); slot++) {
+		if (list[slot]->mSlot != 0xFFFFFFFFu) moved.push_back(list[slot]);
+	}
+#pragma omp parallel for if(moved.size() > 256)
+	for (int i = 0; i < (int)moved.size(); i++) {
+		list[holes[i]] = moved[i];
+		moved[i]->mSlot = holes[i];
+	}
+	list.resize(newSize);
+}
+
+SimplifyStats ProgMesh::SimplifyToParallel(const SimplifyTarget & target) {
+	auto start = std::chrono::steady_clock::now();
+	FinishAnimations();
+
+	SimplifyStats stats;
+	stats.facesBefore = mFaceList.size();
+	stats.verticesBefore = mVertices.size();
+
+	// Keeping mPairs ordered would take a heap update per pair on a single thread. Every round sorts the
+	// candidates anyway, so work from mPairCosts instead and queue the pairs again once at the end.
+	mPairs.Clear();
+
+	bool errorReached = false;
+	while (!errorReached && mConnectivity.NumEdges() > 0 && mFaceList.size() > target.maxFaces && mVertices.size() > target.maxVertices) {
+		// 1. Collect and sort the cheapest pairs. Sampling the errors gives the error below which there are about
+		// numCandidates pairs, then the edges are filtered against it in parallel. The chunks are fixed, so the
+		// candidates come out in the same order no matter how many threads there are.
+		const uint32_t edgeCapacity = (uint32_t)mConnectivity.EdgeCapacity();
+		const size_t numCandidates = std::max<size_t>(1, mConnectivity.NumEdges() / kRoundCandidateDivisor);
+		mRoundSample.clear();
+		const uint32_t stride = std::max<uint32_t>(1, edgeCapacity / kRoundSampleSize);
+		for (uint32_t e = 0; e < edgeCapacity; e += stride) {
+			if (mConnectivity.HasEdge(e)) mRoundSample.push_back(mPairCosts[e]);
+		}
+		float threshold = std::numeric_limits<float>::infinity();
+		if (!mRoundSample.empty()) {
+			size_t rank = std::min(mRoundSample.size() - 1, mRoundSample.size() * numCandidates / mConnectivity.NumEdges());
+			std::nth_element(mRoundSample.begin(), mRoundSample.begin() + rank, mRoundSample.end());
+			threshold = mRoundSample[rank];
+		}
+
+		const uint32_t chunkSize = (edgeCapacity + kRoundChunks - 1) / kRoundChunks;
+		mRoundChunkStarts.assign(kRoundChunks + 1, 0);
+#pragma omp parallel for
+		for (int c = 0; c < (int)kRoundChunks; c++) {
+			uint32_t last = std::min(edgeCapacity, (c + 1) * chunkSize);
+			for (uint32_t e = c * chunkSize; e < last; e++) {
+				if (mConnectivity.HasEdge(e) && mPairCosts[e] <= threshold) mRoundChunkStarts[c + 1]++;
+			}
+		}
+		for (size_t c = 0; c < kRoundChunks; c++) mRoundChunkStarts[c + 1] += mRoundChunkStarts[c];
+		mRoundCandidates.resize(mRoundChunkStarts[kRoundChunks]);
+#pragma omp parallel for
+		for (int c = 0; c < (int)kRoundChunks; c++) {
+			uint32_t last = std::min(edgeCapacity, (c + 1) * chunkSize);
+			size_t next = mRoundChunkStarts[c];
+			for (uint32_t e = c * chunkSize; e < last; e++) {
+				if (mConnectivity.HasEdge(e) && mPairCosts[e] <= threshold) mRoundCandidates[next++] = std::make_pair(mPairCosts[e], e);
+			}
+		}
+		// Ties go to the lower edge id. Many pairs can share the threshold error, e.g. on flat parts.
+		if (mRoundCandidates.size() > numCandidates) {
+			std::nth_element(mRoundCandidates.begin(), mRoundCandidates.begin() + (numCandidates - 1), mRoundCandidates.end());
+			mRoundCandidates.resize(numCandidates);
+		}
+		std::sort(mRoundCandidates.begin(), mRoundCandidates.end());
+
+		// 2. Pick pairs in order as long as neither vertex nor any of their neighbors belongs to a pair picked before.
+		// The collapses then touch separate faces, quadrics and edge lists, and the order they happen in doesn't matter.
+		if (mVertexClaimed.size() < mVertexPool.Size()) mVertexClaimed.resize(mVertexPool.Size(), 0);
+		size_t numFaces = mFaceList.size();
+		size_t numVertices = mVertices.size();
+		size_t numCollapses = 0;
+		for (size_t i = 0; i < mRoundCandidates.size() && numFaces > target.maxFaces && numVertices > target.maxVertices; i++) {
+			float error = mRoundCandidates[i].first;
+			uint32_t edgeId = mRoundCandidates[i].second;
+			if (error > target.maxError) {
+				errorReached = true;
+				break;
+			}
+
+			uint32_t v0 = mConnectivity.EdgeVertex(edgeId, 0);
+			uint32_t v1 = mConnectivity.EdgeVertex(edgeId, 1);
+			// Most candidates lose here, this loop runs on one thread, so skip the neighborhoods when it is already clear.
+			if (mVertexClaimed[v0] || mVertexClaimed[v1]) continue;
+			bool isFree = true;
+			auto checkNeighbor = [&](uint32_t aNeighbor, uint32_t) { isFree = isFree && !mVertexClaimed[aNeighbor]; };
+			mConnectivity.ForEachNeighbor(v0, checkNeighbor);
+			mConnectivity.ForEachNeighbor(v1, checkNeighbor);
+			if (!isFree) continue;
+
+			auto claimNeighbor = [&](uint32_t aNeighbor, uint32_t) { mVertexClaimed[aNeighbor] = 1; };
+			mConnectivity.ForEachNeighbor(v0, claimNeighbor);
+			mConnectivity.ForEachNeighbor(v1, claimNeighbor);
+
+			// The faces on the edge are the ones that become degenerate.
+			numFaces -= mConnectivity.EdgeNumFaces(edgeId);
+			numVertices--;
+			if (numCollapses == mRoundCollapses.size()) mRoundCollapses.emplace_back();
+			mRoundCollapses[numCollapses++].edgeId = edgeId;
+			stats.maxError = std::max(stats.maxError, error);
+			stats.totalError += error;
+		}
+		if (numCollapses == 0) break;
+
+		// 3. Gather the lists of every collapse. This only reads the mesh.
+#pragma omp parallel for if(numCollapses > 64)
+		for (int i = 0; i < (int)numCollapses; i++) {
+			RoundCollapse & aCollapse = mRoundCollapses[i];
+			Pair aPair = GetPair(aCollapse.edgeId);
+			aCollapse.decimation.v0 = aPair.v0;
+			aCollapse.decimation.v1 = aPair.v1;
+			GatherCollapse(aCollapse.decimation);
+		}
+
+		// 4. Everything the collapses share is set aside for the whole round up front: a pool slot and a vertex list
+		// slot for every vNew, and the edge ids of every collapse, all taken in one go. The collapses then fill in
+		// their parts in parallel, and the degenerate faces leave the face list in one bulk removal.
+		auto edgesOf = [this](size_t i) -> MeshConnectivity::EdgeBudget & { return mRoundCollapses[i].edges; };
+		mRoundVertexIds.resize(numCollapses);
+		mVertexPool.Allocate(numCollapses, mRoundVertexIds.data());
+		if (mQuadrics.size() < mVertexPool.Size()) mQuadrics.resize(mVertexPool.Size());
+		mVertexClaimed.resize(mVertexPool.Size(), 0);
+		mConnectivity.ReserveVertex(mVertexPool.Size() - 1);
+		// vNew ends up with at most one edge per neighbor of v0 and v1.
+		mConnectivity.TakeEdges(numCollapses, edgesOf, [this](size_t i) {
+			return mRoundCollapses[i].decimation.v0Neighbors.size() + mRoundCollapses[i].decimation.v1Neighbors.size();
+		});
+		const size_t firstSlot = mVertices.size();
+		mVertices.resize(firstSlot + numCollapses);
+		mRoundStarts.resize(numCollapses + 1);
+		mRoundStarts[0] = 0;
+		for (size_t i = 0; i < numCollapses; i++) mRoundStarts[i + 1] = mRoundStarts[i] + mRoundCollapses[i].decimation.degenFaces.size();
+		mRoundFaces.resize(mRoundStarts[numCollapses]);
+#pragma omp parallel for if(numCollapses > 64)
+		for (int i = 0; i < (int)numCollapses; i++) {
+			RoundCollapse & aCollapse = mRoundCollapses[i];
+			Decimation & dec = aCollapse.decimation;
+			Pair aPair(dec.v0, dec.v1);
+			dec.vNew = mVertexPool.Construct(mRoundVertexIds[i], aPair.CalcOptimal());
+			dec.vNew->mId = mRoundVertexIds[i];
+			dec.vNew->mPos = glm::vec4(mPairTargets[aCollapse.edgeId], 1.f);
+			dec.vNew->mSlot = (uint32_t)(firstSlot + i);
+			mVertices[firstSlot + i] = dec.vNew;
+			dec.error = mPairCosts[aCollapse.edgeId];
+			std::copy(dec.degenFaces.begin(), dec.degenFaces.end(), mRoundFaces.begin() + mRoundStarts[i]);
+		}
+		RemoveFromSlots(mFaceList, mRoundFaces, mRoundHoles, mRoundMovedFaces);
+
+		// 5. The collapses themselves.
+#pragma omp parallel for if(numCollapses > 16)
+		for (int i = 0; i < (int)numCollapses; i++) {
+			RoundCollapse & aCollapse = mRoundCollapses[i];
+			Decimation & dec = aCollapse.decimation;
+			RewireFaces(dec, &aCollapse.edges);
+			UpdateQuadrics(dec.v0, dec.v1, *dec.vNew, dec);
+		}
+
+		// 6. List the pairs touching a neighbor, whose quadric changed. An edge between the neighborhoods of two
+		// collapses, or between two neighbors of the same one, is listed only from its end with the lower id.
+#pragma omp parallel for if(numCollapses > 16)
+		for (int i = 0; i < (int)numCollapses; i++) {
+			RoundCollapse & aCollapse = mRoundCollapses[i];
+			const Decimation & dec = aCollapse.decimation;
+			aCollapse.stalePairs.clear();
+			auto listPairs = [&](Vertex * aNeighbor) {
+				mConnectivity.ForEachNeighbor(aNeighbor->mId, [&](uint32_t other, uint32_t edgeId) {
+					if (!mVertexClaimed[other] || aNeighbor->mId < other) aCollapse.stalePairs.push_back(edgeId);
+				});
+			};
+			for (Vertex * aNeighbor : dec.v0Neighbors) listPairs(aNeighbor);
+			for (Vertex * aNeighbor : dec.v1Neighbors) {
+				if (!std::binary_search(dec.v0Neighbors.begin(), dec.v0Neighbors.end(), aNeighbor, IdLess())) listPairs(aNeighbor);
+			}
+		}
+
+		// 7. Put back the unused edge ids, record the collapses, retire v0 and v1 and release the neighborhoods, again
+		// in bulk, then rescore all the pairs at once.
+		mConnectivity.ReturnEdges(numCollapses, edgesOf);
+		mDecimations.Push(numCollapses, [this](size_t i) -> const Decimation & { return mRoundCollapses[i].decimation; });
+		mRoundStarts[0] = mPendingPairs.size();
+		for (size_t i = 0; i < numCollapses; i++) mRoundStarts[i + 1] = mRoundStarts[i] + mRoundCollapses[i].stalePairs.size();
+		mPendingPairs.resize(mRoundStarts[numCollapses]);
+		mRoundVertices.resize(2 * numCollapses);
+#pragma omp parallel for if(numCollapses > 64)
+		for (int i = 0; i < (int)numCollapses; i++) {
+			const RoundCollapse & aCollapse = mRoundCollapses[i];
+			const Decimation & dec = aCollapse.decimation;
+			std::copy(aCollapse.stalePairs.begin(), aCollapse.stalePairs.end(), mPendingPairs.begin() + mRoundStarts[i]);
+			mRoundVertices[2 * i] = dec.v0;
+			mRoundVertices[2 * i + 1] = dec.v1;
+
+			mVertexClaimed[dec.v0->mId] = mVertexClaimed[dec.v1->mId] = 0;
+			for (Vertex * aNeighbor : dec.v0Neighbors) mVertexClaimed[aNeighbor->mId] = 0;
+			for (Vertex * aNeighbor : dec.v1Neighbors) mVertexClaimed[aNeighbor->mId] = 0;
+		}
+		RemoveFromSlots(mVertices, mRoundVertices, mRoundHoles, mRoundMovedVertices);
+		// Same buffer updates as InsertVertex and RemoveVertex: the new vertices, and the ones moved to another slot.
+		for (size_t i = 0; i < numCollapses; i++) MarkInsertedVertexDirty(mRoundCollapses[i].decimation.vNew);
+		if (!mPrefixLayout) {
+			for (Vertex * aVertex : mRoundMovedVertices) MarkVertexDirty(aVertex);
+		}
+		EvaluatePendingPairs();
+		mPendingPairs.clear();
+
+		stats.collapses += numCollapses;
+		stats.rounds++;
+	}
+
+	for (uint32_t edgeId = 0; edgeId < mConnectivity.EdgeCapacity(); edgeId++) {
+		if (mConnectivity.HasEdge(edgeId)) mPairs.Push(edgeId, mPairCosts[edgeId]);
+	}
+	if (sValidatePairs) ValidatePairs();
+	GenerateIndicesFromFaces();
+	if (sOptimizeVertexCache) OptimizeVertexCache();
+
+	stats.facesAfter = mFaceList.size();
+	stats.verticesAfter = mVertices.size();
+	stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	if (sPrintStatements) {
+		std::cout << "Simplified from " << stats.facesBefore << " to " << stats.facesAfter << " faces with "
+				  << stats.collapses << " collapses in " << stats.rounds << " rounds in " << stats.seconds << "s" << std::endl;
+	}
+	return stats;
 }
 
 void ProgMesh::GenerateIndicesFromFaces() {
-	mIndices.clear();
-	mIndices.reserve(mFaces.size() * 3);
-    // Order doesn't matter for indices.
-	for(auto faceItr = mFaces.begin(); faceItr != mFaces.end(); faceItr++) {
-		mIndices.push_back(std::find(mVertices.begin(), mVertices.end(), (*faceItr)->GetVertex(0)) - mVertices.begin());
-		mIndices.push_back(std::find(mVertices.begin(), mVertices.end(), (*faceItr)->GetVertex(1)) - mVertices.begin());
-		mIndices.push_back(std::find(mVertices.begin(), mVertices.end(), (*faceItr)->GetVertex(2)) - mVertices.begin());
+	if (mPrefixLayout) {
+		GeneratePrefixIndices();
+		return;
+	}
+	// Faces keep their slot in mFaceList, so only the triangles of faces that were added, moved into a freed slot,
+	// rewired or whose vertices moved to another slot come out different.
+	size_t oldTriangles = mIndices.size() / 3;
+	mIndices.resize(mFaceList.size() * 3);
+	if (mTriangleDirty.size() < mFaceList.size()) mTriangleDirty.resize(mFaceList.size(), 0);
+	int changed = 0;
+
+    // Every vertex knows its own slot in mVertices, which is its index in the vertex buffer.
+#pragma omp parallel for reduction(|:changed)
+	for (int i = 0; i < (int)mFaceList.size(); i++) {
+		const Face * aFace = mFaceList[i];
+		uint32_t * triangle = mIndices.data() + 3 * (size_t)i;
+		uint32_t slots[3] = {aFace->GetVertex(0)->mSlot, aFace->GetVertex(1)->mSlot, aFace->GetVertex(2)->mSlot};
+		if ((size_t)i < oldTriangles && triangle[0] == slots[0] && triangle[1] == slots[1] && triangle[2] == slots[2]) continue;
+		triangle[0] = slots[0];
+		triangle[1] = slots[1];
+		triangle[2] = slots[2];
+		// Listed below, the threads can't all append to mDirtyTriangles.
+		if (!mTriangleDirty[i]) mTriangleDirty[i] = 2;
+		changed = 1;
 	}
+	if (!changed) return;
+	for (size_t i = 0; i < mFaceList.size(); i++) {
+		if (mTriangleDirty[i] != 2) continue;
+		mTriangleDirty[i] = 1;
+		mDirtyTriangles.push_back((uint32_t)i);
+	}
+}
+
+void ProgMesh::GeneratePrefixIndices() {
+	// The draw range ends after the last face in the mesh. Only the changed faces can have moved that end out, and
+	// only faces at the end can have left it behind.
+	auto inMesh = [this](uint32_t face) { return mFileFaces[face] && mFileFaces[face]->mSlot != 0xFFFFFFFFu; };
+	uint32_t oldDrawFaces = mDrawFaces;
+	for (uint32_t face : mChangedFaces) {
+		if (face >= mDrawFaces && inMesh(face)) mDrawFaces = face + 1;
+	}
+	while (mDrawFaces > 0 && !inMesh(mDrawFaces - 1)) mDrawFaces--;
+	if (mIndices.size() < 3 * (size_t)mDrawFaces) mIndices.resize(3 * (size_t)mDrawFaces, kNoTriangle);
+
+	// Triangles past the range are not drawn and are left as they are, they are written once the range reaches them.
+	for (uint32_t face = oldDrawFaces; face < mDrawFaces; face++) WritePrefixTriangle(face);
+	for (uint32_t face : mChangedFaces) {
+		if (face < std::min(oldDrawFaces, mDrawFaces)) WritePrefixTriangle(face);
+	}
+	mChangedFaces.clear();
+}
+
+void ProgMesh::WritePrefixTriangle(uint32_t face) {
+	// Vertices never move with the prefix layout, so a triangle only changes when its face is rewired, or leaves
+	// or comes back inside the draw range. A face that is out shows as a degenerate triangle.
+	const Face * aFace = mFileFaces[face];
+	uint32_t slots[3] = {0, 0, 0};
+	if (aFace && aFace->mSlot != 0xFFFFFFFFu) {
+		for (int i = 0; i < 3; i++) slots[i] = VertexBufferSlot(aFace->GetVertex(i));
+	}
+	uint32_t * triangle = mIndices.data() + 3 * (size_t)face;
+	if (triangle[0] == slots[0] && triangle[1] == slots[1] && triangle[2] == slots[2]) return;
+	std::copy(slots, slots + 3, triangle);
+	MarkTriangleDirty(face);
+}
+
+VertexCacheStats ProgMesh::OptimizeVertexCache() {
+	GenerateIndicesFromFaces();
+	if (mPrefixLayout || mFaceList.empty()) return AnalyzeVertexCache();
+	if (!mCacheOptimizer) mCacheOptimizer.reset(new VertexCacheOptimizer());
+
+	// Faces first, the order of the vertices follows from theirs.
+	std::vector<glm::vec3> positions(mVertices.size());
+	for (size_t i = 0; i < mVertices.size(); i++) positions[i] = glm::vec3(mVertices[i]->mPos);
+	std::vector<uint32_t> order;
+	mCacheOptimizer->OrderTriangles(mIndices.data(), mFaceList.size(), mVertices.size(), positions.data(), order);
+	std::vector<Face *> faces(mFaceList.size());
+	std::vector<uint32_t> indices(mIndices.size());
+	for (size_t i = 0; i < order.size(); i++) {
+		faces[i] = mFaceList[order[i]];
+		faces[i]->mSlot = (uint32_t)i;
+		std::copy(mIndices.begin() + 3 * order[i], mIndices.begin() + 3 * order[i] + 3, indices.begin() + 3 * i);
+	}
+	mFaceList.swap(faces);
+
+	std::vector<uint32_t> remap;
+	VertexCacheOptimizer::OrderVertices(indices.data(), indices.size(), mVertices.size(), remap);
+	std::vector<Vertex *> vertices(mVertices.size());
+	for (size_t i = 0; i < mVertices.size(); i++) {
+		vertices[remap[i]] = mVertices[i];
+		mVertices[i]->mSlot = remap[i];
+	}
+	mVertices.swap(vertices);
+	for (Vertex * aVertex : mVertices) MarkVertexDirty(aVertex);
+	GenerateIndicesFromFaces();
+
+	VertexCacheStats stats = AnalyzeVertexCache();
+	if (sPrintStatements) {
+		std::cout << "Reordered " << mFaceList.size() << " faces, ACMR " << stats.acmr << ", ATVR " << stats.atvr << std::endl;
+	}
+	return stats;
+}
+
+VertexCacheStats ProgMesh::AnalyzeVertexCache() const {
+	// With the prefix layout only the first mDrawFaces are drawn, degenerate ones included.
+	size_t numIndices = mPrefixLayout ? 3 * (size_t)mDrawFaces : mIndices.size();
+	size_t numVertices = mPrefixLayout ? mProgressive->Header().numVertices : mVertices.size();
+	return VertexCacheOptimizer::Analyze(mIndices.data(), numIndices, numVertices);
 }
 
 void ProgMesh::GenerateNormals() {
@@ -374,241 +1018,518 @@ void ProgMesh::GenerateNormals() {
     for (int i = 0; i < mVertices.size(); i++) {
         mVertices.at(i)->mNormal = glm::normalize(mVertices.at(i)->mNormal);
     }
+    for (Vertex * aVertex : mVertices) MarkVertexDirty(aVertex);
+}
+
+bool ProgMesh::SaveProgressive(const std::string & path) {
+	FinishAnimations();
+
+	uint32_t numBaseFaces;
+	std::vector<PMVertex> vertices;
+	std::vector<uint32_t> faces;
+	std::vector<PMSplit> splits;
+	std::vector<uint32_t> faceRefs;
+	if (!NumberProgressive(numBaseFaces, vertices, faces, splits, faceRefs)) {
+		std::cerr << "ERROR: The decimations of the mesh don't lead back to its current state, not writing " << path << std::endl;
+		return false;
+	}
+	return ProgMeshFile::Write(path, (uint32_t)mVertices.size(), numBaseFaces, vertices, faces, splits, faceRefs);
+}
+
+std::shared_ptr<const ProgMeshFile> ProgMesh::MakeProgressiveFile() {
+	FinishAnimations();
+
+	uint32_t numBaseFaces;
+	std::vector<PMVertex> vertices;
+	std::vector<uint32_t> faces;
+	std::vector<PMSplit> splits;
+	std::vector<uint32_t> faceRefs;
+	if (!NumberProgressive(numBaseFaces, vertices, faces, splits, faceRefs)) {
+		std::cerr << "ERROR: The decimations of the mesh don't lead back to its current state" << std::endl;
+		return nullptr;
+	}
+	auto file = std::make_shared<ProgMeshFile>();
+	if (!file->Assign((uint32_t)mVertices.size(), numBaseFaces, vertices, faces, splits, faceRefs)) return nullptr;
+	return file;
+}
+
+bool ProgMesh::NumberProgressive(uint32_t & numBaseFaces, std::vector<PMVertex> & vertices, std::vector<uint32_t> & faces,
+								 std::vector<PMSplit> & splits, std::vector<uint32_t> & faceRefs) {
+	// Number everything in the order the file introduces it: the current mesh first, then the vertices and faces
+	// each split brings back, most recent decimation first.
+	const uint32_t unnumbered = 0xFFFFFFFFu;
+	std::vector<uint32_t> vertexIndex(mVertexPool.Size(), unnumbered);
+	std::vector<uint32_t> faceIndex(mFacePool.Size(), unnumbered);
+	vertices.clear();
+	faces.clear();
+	splits.clear();
+	faceRefs.clear();
+	vertices.reserve(mVertices.size() + 2 * mDecimations.Size());
+	splits.reserve(mDecimations.Size());
+
+	auto addVertex = [&](const Vertex * aVertex) {
+		vertexIndex[aVertex->mId] = (uint32_t)vertices.size();
+		PMVertex v;
+		for (int i = 0; i < 3; i++) {
+			v.position[i] = aVertex->mPos[i];
+			v.normal[i] = aVertex->mNormal[i];
+		}
+		for (int i = 0; i < 4; i++) v.color[i] = aVertex->mColor[i];
+		vertices.push_back(v);
+	};
+	bool consistent = true;
+	auto addFace = [&](const Face * aFace) {
+		faceIndex[aFace->mId] = (uint32_t)(faces.size() / 3);
+		for (int i = 0; i < 3; i++) {
+			uint32_t index = vertexIndex[aFace->GetVertex(i)->mId];
+			consistent = consistent && index != unnumbered;
+			faces.push_back(index);
+		}
+	};
+	auto addFaceRef = [&](const Face * aFace) {
+		consistent = consistent && faceIndex[aFace->mId] != unnumbered;
+		faceRefs.push_back(faceIndex[aFace->mId]);
+	};
+
+	for (Vertex * aVertex : mVertices) addVertex(aVertex);
+	// Sorted so the same mesh always gives the same file.
+	std::vector<Face *> baseFaces(mFaceList.begin(), mFaceList.end());
+	std::sort(baseFaces.begin(), baseFaces.end(), IdLess());
+	for (Face * aFace : baseFaces) addFace(aFace);
+	numBaseFaces = (uint32_t)baseFaces.size();
+
+	// The history only knows which faces of vNew go where, so the faces are read off a copy of the connectivity
+	// that is split along the way, the same way Upscale would.
+	MeshConnectivity connectivity = mConnectivity;
+	std::vector<uint32_t> vNewFaces;
+	for (size_t i = mDecimations.Size(); i-- > 0;) {
+		const VertexSplit & dec = mDecimations.At(i);
+		PMSplit split;
+		split.vertex = vertexIndex[dec.vNew];
+		consistent = consistent && split.vertex != unnumbered;
+		addVertex(mVertexPool[dec.v0]);
+		addVertex(mVertexPool[dec.v1]);
+
+		vNewFaces.clear();
+		connectivity.ForEachFace(dec.vNew, [&](uint32_t aFace) { vNewFaces.push_back(aFace); });
+		std::sort(vNewFaces.begin(), vNewFaces.end());
+		consistent = consistent && vNewFaces.size() == dec.numFaces;
+		split.firstFaceRef = (uint32_t)faceRefs.size();
+		split.numV0Faces = split.numV1Faces = 0;
+		for (bool toV1 : {false, true}) {
+			for (uint32_t j = 0; j < (uint32_t)vNewFaces.size(); j++) {
+				if (mDecimations.ToV1(dec, j) != toV1) continue;
+				addFaceRef(mFacePool[vNewFaces[j]]);
+				connectivity.ReplaceVertex(vNewFaces[j], dec.vNew, toV1 ? dec.v1 : dec.v0);
+				(toV1 ? split.numV1Faces : split.numV0Faces)++;
+			}
+		}
+
+		split.firstNewFace = (uint32_t)(faces.size() / 3);
+		split.numNewFaces = mDecimations.NumDegenFaces(dec);
+		for (uint32_t j = 0; j < split.numNewFaces; j++) {
+			Face * aFace = mFacePool[mDecimations.DegenFace(dec, j)];
+			addFace(aFace);
+			connectivity.AddFace(aFace->mId, aFace->GetVertex(0)->mId, aFace->GetVertex(1)->mId, aFace->GetVertex(2)->mId);
+		}
+
+		split.error = dec.error;
+		splits.push_back(split);
+	}
+	return consistent;
 }
 
 void ProgMesh::UpdateFaces(Vertex * v0, Vertex * v1, Vertex & vNew, Decimation & dec) {
-    // make adjacency of newV the union of v0 and v1 adjacency lists (w/o duplicates)
-    std::vector<Face*> v0Faces = GetAdjacentFaces(v0);
-    std::vector<Face*> v1Faces = GetAdjacentFaces(v1);
-    
-    //Figure out which faces will become degenerate post-collapse.
-    std::sort(v0Faces.begin(), v0Faces.end());
-    std::sort(v1Faces.begin(), v1Faces.end());
-    std::vector<Face*> degenFaces;
-    std::set_intersection(v0Faces.begin(), v0Faces.end(), v1Faces.begin(), v1Faces.end(), std::back_inserter(degenFaces));
-    
-    // Now remove degenerate faces from local v0 and v1 lists
-    v0Faces.erase(std::remove_if(v0Faces.begin(), v0Faces.end(), [degenFaces] (Face *& f) {
-        for(auto & aDegenFace: degenFaces)
-            if (*f == *aDegenFace)
-                return true;
-        return false;
-    }), v0Faces.end());
-    v1Faces.erase(std::remove_if(v1Faces.begin(), v1Faces.end(), [degenFaces] (Face *& f) {
-        for(auto & aDegenFace: degenFaces)
-            if (*f == *aDegenFace)
-                return true;
-        return false;
-    }), v1Faces.end());
-    
-    // Keep track of faces in decimation object
-    dec.v0Faces = v0Faces;
-    dec.v1Faces = v1Faces;
-    dec.degenFaces = degenFaces;
-    
-    // Now, for each degenerate face, remove it from its vertex to face adjacencies
-    // In doing so, each degen face is removed for v0 and v1 in master arrays
-    for(auto *& aDegenFace: degenFaces) {
-        for (size_t i = 0; i < 3; i++) {
-            auto range = mVertexFaceAdjacency.equal_range(aDegenFace->GetVertex(i));
-            for (auto it = range.first; it != range.second;) {
-                if (*(it->second) == (*aDegenFace)) {
-                    it = mVertexFaceAdjacency.erase(it);
-                } else it++;
-            }
-        }
-    }
-    
-    // Now, delete degen faces from master faces list
-    for(auto *& aDegenFace: degenFaces) {
-        mFaces.erase(aDegenFace);
-        aDegenFace = nullptr;
-    }
-    degenFaces.clear(); // Sanity
-    
-    // Now, iterate over the remainining non-degen faces adj to v0 and v1 and assign new vertex
-    for(auto *& v0Face: v0Faces) {
-        // Make a copy
-        Face faceCopy(*v0Face);
-        faceCopy.ReplaceVertex(v0, &vNew);
-        Utilities::ReplaceObject(v0Face, faceCopy);
-        
-        mVertexFaceAdjacency.insert(std::make_pair(&vNew, v0Face));
-    }
-    for(auto *& v1Face: v1Faces) {
-        // Make a copy
-        Face faceCopy(*v1Face);
-        faceCopy.ReplaceVertex(v1, &vNew);
-        Utilities::ReplaceObject(v1Face, faceCopy);
-        
-        mVertexFaceAdjacency.insert(std::make_pair(&vNew, v1Face));
+    // Record the neighbors and faces of v0 and v1 before their edges are moved over to vNew.
+    GatherCollapse(dec);
+
+    // Every edge of v0 and v1 is about to go away, and its id may be handed out again.
+    DeletePairsAround(v0);
+    DeletePairsAround(v1);
+
+    // The face objects of the degenerate faces stay in the pool, the decimation refers to them.
+    for (Face * aDegenFace : dec.degenFaces) {
+        RemoveFace(aDegenFace);
     }
+    RewireFaces(dec, nullptr);
     
     // At this point, all degenerate faces have been removed, a new vertex has been created,
-    // and the mVertexFaceAdjacency has been updated to reflect the removals and creation of new vertex and faces.
+    // and mConnectivity has been updated to reflect the removals and creation of new vertex and faces.
+    // v0 and v1 are left without faces or edges.
     // The decimation object is now storing the degenerate faces that were removed and other faces that were modified.
 }
 
-std::vector<Vertex* > ProgMesh::UpdateEdgesAndQuadrics(Vertex * v0, Vertex * v1, Vertex & newVertex, Decimation & dec) {
-    auto v0Neighbors = GetConnectedVertices(v0);
-    auto v1Neighbors = GetConnectedVertices(v1);
-    std::sort(v0Neighbors.begin(), v0Neighbors.end());
-    std::sort(v1Neighbors.begin(), v1Neighbors.end());
-    // Make a union, so there is just one array we have to deal with
-    std::vector<Vertex*> allNeighbors;
-    allNeighbors.reserve(v0Neighbors.size() + v1Neighbors.size() - 2);
-    std::set_union(v0Neighbors.begin(), v0Neighbors.end(), v1Neighbors.begin(), v1Neighbors.end(), std::back_inserter(allNeighbors));
-    
-    /// Fance-shmancy way to remove v0 and v1 from v1Neighbors and v0Neighbors respectfully
-    std::vector<Vertex *> decV0Neighbors; std::vector<Vertex*> v0Vec; v0Vec.push_back(v0);
-    std::vector<Vertex *> decV1Neighbors; std::vector<Vertex*> v1Vec; v1Vec.push_back(v1);
-    std::set_difference(v0Neighbors.begin(), v0Neighbors.end(), v1Vec.begin(), v1Vec.end(), std::back_inserter(decV0Neighbors));
-    std::set_difference(v1Neighbors.begin(), v1Neighbors.end(), v0Vec.begin(), v0Vec.end(), std::back_inserter(decV1Neighbors));
-    dec.v0Neighbors = decV0Neighbors; // We bougie up in this bitch
-    dec.v1Neighbors = decV1Neighbors;
-    
-    // 'Edges' are really directed edges between two vertices
-    // Remove all the incoming edges into v0 & v1 from their neighbors.
-    for(auto *& aNeighbor: allNeighbors) {
-		//pairs
-        auto range = mEdges.equal_range(aNeighbor);
-        for(auto it = range.first; it != range.second;) {
-            if (it->second == v0) {
-                it = mEdges.erase(it);
-            } else it++;
-        }
+void ProgMesh::GatherCollapse(Decimation & dec) const {
+    Vertex * v0 = dec.v0;
+    Vertex * v1 = dec.v1;
+    // The neighbors of v0 and v1, without each other
+    dec.v0Neighbors.clear();
+    dec.v1Neighbors.clear();
+    mConnectivity.ForEachNeighbor(v0->mId, [&](uint32_t aNeighbor, uint32_t) {
+        if (aNeighbor != v1->mId) dec.v0Neighbors.push_back(mVertexPool[aNeighbor]);
+    });
+    mConnectivity.ForEachNeighbor(v1->mId, [&](uint32_t aNeighbor, uint32_t) {
+        if (aNeighbor != v0->mId) dec.v1Neighbors.push_back(mVertexPool[aNeighbor]);
+    });
+    std::sort(dec.v0Neighbors.begin(), dec.v0Neighbors.end(), IdLess());
+    std::sort(dec.v1Neighbors.begin(), dec.v1Neighbors.end(), IdLess());
+
+    dec.v0Faces.clear();
+    dec.v1Faces.clear();
+    dec.degenFaces.clear();
+    mConnectivity.ForEachFace(v0->mId, [&](uint32_t aFace) { dec.v0Faces.push_back(mFacePool[aFace]); });
+    mConnectivity.ForEachFace(v1->mId, [&](uint32_t aFace) { dec.v1Faces.push_back(mFacePool[aFace]); });
+
+    //Figure out which faces will become degenerate post-collapse.
+    std::sort(dec.v0Faces.begin(), dec.v0Faces.end(), IdLess());
+    std::sort(dec.v1Faces.begin(), dec.v1Faces.end(), IdLess());
+    std::set_intersection(dec.v0Faces.begin(), dec.v0Faces.end(), dec.v1Faces.begin(), dec.v1Faces.end(),
+                          std::back_inserter(dec.degenFaces), IdLess());
+
+    // Now remove degenerate faces from the v0 and v1 lists
+    const std::vector<Face *> & degenFaces = dec.degenFaces;
+    auto isDegen = [&degenFaces](Face * f) { return std::binary_search(degenFaces.begin(), degenFaces.end(), f, IdLess()); };
+    dec.v0Faces.erase(std::remove_if(dec.v0Faces.begin(), dec.v0Faces.end(), isDegen), dec.v0Faces.end());
+    dec.v1Faces.erase(std::remove_if(dec.v1Faces.begin(), dec.v1Faces.end(), isDegen), dec.v1Faces.end());
+}
+
+void ProgMesh::ExpandSplit(const VertexSplit & split, Decimation & dec) const {
+    dec.v0 = mVertexPool[split.v0];
+    dec.v1 = mVertexPool[split.v1];
+    dec.vNew = mVertexPool[split.vNew];
+    dec.error = split.error;
+    dec.v0Neighbors.clear();
+    dec.v1Neighbors.clear();
+
+    // The faces of vNew by id, each of which goes back to either v0 or v1.
+    dec.v0Faces.clear();
+    dec.v1Faces.clear();
+    mConnectivity.ForEachFace(split.vNew, [&](uint32_t aFace) { dec.v0Faces.push_back(mFacePool[aFace]); });
+    std::sort(dec.v0Faces.begin(), dec.v0Faces.end(), IdLess());
+    size_t numV0Faces = 0;
+    for (uint32_t i = 0; i < (uint32_t)dec.v0Faces.size(); i++) {
+        if (mDecimations.ToV1(split, i)) dec.v1Faces.push_back(dec.v0Faces[i]);
+        else dec.v0Faces[numV0Faces++] = dec.v0Faces[i];
     }
-    for(auto *& aNeighbor: allNeighbors) {
-        auto range = mEdges.equal_range(aNeighbor);
-        for(auto it = range.first; it != range.second;) {
-            if (it->second == v1) {
-                it = mEdges.erase(it);
-            } else it++;
-        }
+    dec.v0Faces.resize(numV0Faces);
+
+    dec.degenFaces.clear();
+    for (uint32_t i = 0; i < mDecimations.NumDegenFaces(split); i++) {
+        dec.degenFaces.push_back(mFacePool[mDecimations.DegenFace(split, i)]);
     }
-    
-    // Now remove outgoing edges of v0 and v1
-    mEdges.erase(v0);
-    mEdges.erase(v1);
-    
-    // Now create new edges for the vNew
-    // First remove v0 and v1 from the allNeighbors array
-    allNeighbors.erase(std::remove_if(allNeighbors.begin(), allNeighbors.end(), [v0, v1] (Vertex *& v) {
-        return ((*v) == (*v0)) || ((*v) == (*v1));
-    }), allNeighbors.end());
-    
-    for(auto & aNeighbor: allNeighbors) {
-        // Create inbound edge to vNew
-        mEdges.insert(std::make_pair(aNeighbor, &newVertex));
-        // Create outbound edge from vNew to neighbor
-        mEdges.insert(std::make_pair(&newVertex, aNeighbor));
+}
+
+void ProgMesh::RewireFaces(const Decimation & dec, MeshConnectivity::EdgeBudget * budget) {
+    Vertex * v0 = dec.v0;
+    Vertex * v1 = dec.v1;
+    Vertex * vNew = dec.vNew;
+
+    for (Face * aDegenFace : dec.degenFaces) {
+        mConnectivity.RemoveFace(aDegenFace->mId, budget);
     }
     
-    // Done updating edges.
+    // Now, iterate over the remainining non-degen faces adj to v0 and v1 and assign new vertex
+    for (Face * v0Face : dec.v0Faces) {
+        v0Face->ReplaceVertex(v0, vNew);
+        mConnectivity.ReplaceVertex(v0Face->mId, v0->mId, vNew->mId, budget);
+    }
+    for (Face * v1Face : dec.v1Faces) {
+        v1Face->ReplaceVertex(v1, vNew);
+        mConnectivity.ReplaceVertex(v1Face->mId, v1->mId, vNew->mId, budget);
+    }
+}
 
-	// update mQuadrics for vertices whose adjacent planes have changed
-	for (auto & aNeighbor : allNeighbors) {
-		auto itr = mQuadrics.find(aNeighbor);
-		itr->second = ComputeQuadric(aNeighbor);
+void ProgMesh::UpdateFacePlane(Face * aFace, const Vertex * skipA, const Vertex * skipB) {
+	Quadric & plane = mFacePlanes[aFace->mId];
+	Quadric newPlane = ComputePlaneQuadric(aFace);
+	for (int i = 0; i < 3; i++) {
+		Vertex * aVertex = aFace->GetVertex(i);
+		if (aVertex == skipA || aVertex == skipB) continue;
+		mQuadrics[aVertex->mId] -= plane;
+		mQuadrics[aVertex->mId] += newPlane;
+	}
+	plane = newPlane;
+}
+
+void ProgMesh::UpdateQuadrics(Vertex * v0, Vertex * v1, Vertex & newVertex, const Decimation & dec) {
+	// The new vertex inherits the error of both vertices it replaces (Garland-Heckbert).
+	// v0 and v1 keep their quadrics untouched until they are restored.
+	mQuadrics[newVertex.mId] = mQuadrics[v0->mId] + mQuadrics[v1->mId];
+
+	// The neighbors lose the planes of the degenerate faces...
+	for (Face * aDegenFace : dec.degenFaces) {
+		for (int i = 0; i < 3; i++) {
+			Vertex * aVertex = aDegenFace->GetVertex(i);
+			if (aVertex != v0 && aVertex != v1) mQuadrics[aVertex->mId] -= mFacePlanes[aDegenFace->mId];
+		}
 	}
-	// add a quadric for the new vertex
-	mQuadrics.insert(std::make_pair(&newVertex, ComputeQuadric(&newVertex)));
+	// ...and see the faces that now use vNew tilt. Every quadric holds the current planes of its vertex's faces, which
+	// the neighbors of later collapses subtract again. The old planes in Q0 + Q1 stay as vNew's history, so vNew
+	// gets the new ones on top. Replacing the old ones instead would subtract planes it never had.
+	for (Face * aFace : dec.v0Faces) {
+		UpdateFacePlane(aFace, &newVertex, nullptr);
+		mQuadrics[newVertex.mId] += mFacePlanes[aFace->mId];
+	}
+	for (Face * aFace : dec.v1Faces) {
+		UpdateFacePlane(aFace, &newVertex, nullptr);
+		mQuadrics[newVertex.mId] += mFacePlanes[aFace->mId];
+	}
+}
 
-	return allNeighbors;
+void ProgMesh::StoreCollapsePairs(const Decimation & dec) {
+	// The pairs of v0 and v1 were removed along with their edges. The quadric of every neighbor
+	// has been recomputed, so any pair touching a neighbor is stale, including the new pairs of vNew.
+	// A neighbor of both v0 and v1 is queued twice, ScorePendingPairs drops the duplicates.
+	for (Vertex * aNeighbor : dec.v0Neighbors) StorePairsAround(aNeighbor);
+	for (Vertex * aNeighbor : dec.v1Neighbors) StorePairsAround(aNeighbor);
 }
 
-void ProgMesh::UpdatePairs(Vertex * v0, Vertex * v1, Vertex & newVertex, std::vector<Vertex* > neighbors, Decimation & dec)
+void ProgMesh::UpdatePairs(const Decimation & dec)
 {
-    /*
-	// Deleting all pairs with v0 and v1 as one of the vertices
-	DeletePairsWithNeighbor(v0, neighbors);
-	DeletePairsWithNeighbor(v1, neighbors);
+	StoreCollapsePairs(dec);
+	ScorePendingPairs();
 
-	// Delete the rest of the pairs that are connected to vertices whose quadrics have been updated
-	for (auto & aNeighbor : neighbors) {
-		auto inLaws = GetConnectedVertices(aNeighbor);
-		DeletePairsWithNeighbor(aNeighbor, inLaws);
+	if (sValidatePairs) ValidatePairs();
+}
+
+/// Incremental quadrics may differ from rebuilt ones by rounding, by at most this fraction of their largest coefficient.
+static const double kQuadricTolerance = 1e-9;
+/// Pair errors may differ by the rounding of the float kernel, by at most this fraction of the size of the terms it
+/// sums.
+static const double kPairErrorTolerance = 1e-5;
+
+/// The largest coefficient of a quadric that is a sum of planes, which is on its diagonal.
+static double QuadricScale(const Quadric & q) {
+	return std::max(std::max(q.a2, q.b2), std::max(q.c2, q.d2));
+}
+
+static bool QuadricsAgree(const Quadric & a, const Quadric & b) {
+	static double Quadric::* const kCoefficients[] = {&Quadric::a2, &Quadric::ab, &Quadric::ac, &Quadric::ad,
+		&Quadric::b2, &Quadric::bc, &Quadric::bd, &Quadric::c2, &Quadric::cd, &Quadric::d2};
+	double tolerance = kQuadricTolerance * std::max(QuadricScale(a), QuadricScale(b));
+	for (double Quadric::* coefficient : kCoefficients) {
+		if (!(std::fabs(a.*coefficient - b.*coefficient) <= tolerance)) return false;
 	}
+	return true;
+}
 
-	// add pairs from every vertex whose quadric was affected to its new neighbors
-	// (since edges have already been updated this includes the new vertex)
-	for (auto & aNeighbor : neighbors) {
-		auto inLaws = GetConnectedVertices(aNeighbor);
-		for (auto & inLaw : inLaws) {
-			CalculateAndStorePair(aNeighbor, inLaw);
+bool ProgMesh::ValidatePairs() const {
+	// Rebuild the edges from the faces, so the connectivity is checked as well.
+	std::unordered_set<Edge> faceEdges;
+	for (auto & aFace : mFaceList) {
+		for (int i = 0; i < 3; i++) {
+			Vertex * vA = aFace->GetVertex(i);
+			Vertex * vB = aFace->GetVertex((i + 1) % 3);
+			if (vA != vB) faceEdges.insert(MakeEdgeKey(vA, vB));
 		}
 	}
 
-	// delete pairs between v0 and v1
-	auto itr = mEdgeToPair.find(std::make_pair(v0, v1));
-	if (itr != mEdgeToPair.end()) {
-		auto numErased = mPairs.erase(itr->second->first);
-		mEdgeToPair.erase(itr);
-    }
-    
-	itr = mEdgeToPair.find(std::make_pair(v1, v0));
-	if (itr != mEdgeToPair.end()) {
-		auto numErased = mPairs.erase(itr->second->first);
-		mEdgeToPair.erase(itr);
-    }
-    */
-    
+	bool valid = true;
+	if (faceEdges.size() != mConnectivity.NumEdges()) {
+		std::cerr << "ERROR: The faces have " << faceEdges.size() << " edges but the connectivity has "
+				  << mConnectivity.NumEdges() << std::endl;
+		valid = false;
+	}
+	if (mPairs.Size() != mConnectivity.NumEdges()) {
+		std::cerr << "ERROR: " << mPairs.Size() << " pairs queued but there are " << mConnectivity.NumEdges() << " edges" << std::endl;
+		valid = false;
+	}
 
+	// Rebuild the quadrics from scratch: the planes of the faces around each vertex where they are now, plus for a
+	// vertex made by a collapse, the quadrics of the two it replaced, which stay as they were until it is undone.
+	std::vector<Quadric> rebuilt(mQuadrics.size());
+	for (size_t i = 0; i < mDecimations.Size(); i++) {
+		const VertexSplit & split = mDecimations.At(i);
+		rebuilt[split.vNew] = mQuadrics[split.v0] + mQuadrics[split.v1];
+	}
+	std::vector<Quadric> planes(mFacePool.Size());
+	for (auto & aFace : mFaceList) planes[aFace->mId] = ComputePlaneQuadric(aFace);
+	for (Vertex * aVertex : mVertices) {
+		mConnectivity.ForEachFace(aVertex->mId, [&](uint32_t aFace) { rebuilt[aVertex->mId] += planes[aFace]; });
+		if (!QuadricsAgree(mQuadrics[aVertex->mId], rebuilt[aVertex->mId])) {
+			std::cerr << "ERROR: The quadric of vertex " << aVertex->mId << " has drifted from a full rebuild" << std::endl;
+			valid = false;
+		}
+	}
 
-    // Clear all pairs and regen.
-    //TODO: Fix the individual updating above
-    mPairs.clear();
-    mEdgeToPair.clear();
+	// Every edge must have a pair scored against the current quadrics, and agree with one scored against the rebuilt ones.
+	for (uint32_t edgeId = 0; edgeId < mConnectivity.EdgeCapacity(); edgeId++) {
+		if (!mConnectivity.HasEdge(edgeId)) continue;
+		Pair aPair = GetPair(edgeId);
+		if (faceEdges.find(MakeEdgeKey(aPair.v0, aPair.v1)) == faceEdges.end()) {
+			std::cerr << "ERROR: Edge " << aPair.v0->mId << ", " << aPair.v1->mId << " is not part of any face" << std::endl;
+			valid = false;
+		}
+		if (!mPairs.Contains(edgeId)) {
+			std::cerr << "ERROR: Pair " << aPair.v0->mId << ", " << aPair.v1->mId << " is not queued" << std::endl;
+			valid = false;
+			continue;
+		}
+		float error = mPairs.Key(edgeId);
+		glm::vec3 expectedTarget;
+		float expected = CalcPairError(edgeId, expectedTarget);
+		if (expected != error && !(std::isnan(expected) && std::isnan(error))) {
+			std::cerr << "ERROR: Pair " << aPair.v0->mId << ", " << aPair.v1->mId << " has error " << error
+					  << " but the current quadrics give " << expected << std::endl;
+			valid = false;
+			continue;
+		} else if (expectedTarget != mPairTargets[edgeId] && !std::isnan(expected)) {
+			std::cerr << "ERROR: Pair " << aPair.v0->mId << ", " << aPair.v1->mId
+					  << " collapses to a different position than the current quadrics give" << std::endl;
+			valid = false;
+			continue;
+		}
+
+		Quadric sum = rebuilt[aPair.v0->mId] + rebuilt[aPair.v1->mId];
+		PairCostBatch batch;
+		batch.Add(sum, glm::vec3(aPair.v0->mPos), glm::vec3(aPair.v1->mPos));
+		batch.Evaluate();
+		glm::vec3 target = batch.Position(0);
+		// Evaluating v^T Q v sums terms as big as the largest coefficient times (1 + |x| + |y| + |z|)^2, float
+		// rounds them to about that much.
+		double extent = 1.0 + std::fabs(target.x) + std::fabs(target.y) + std::fabs(target.z);
+		double tolerance = kPairErrorTolerance * QuadricScale(sum) * extent * extent;
+		if (!(std::fabs((double)batch.Cost(0) - error) <= tolerance) && !std::isnan(error)) {
+			std::cerr << "ERROR: Pair " << aPair.v0->mId << ", " << aPair.v1->mId << " has error " << error
+					  << " but a full rebuild gives " << batch.Cost(0) << std::endl;
+			valid = false;
+		}
+		// The error is a sum of squared distances. Only the rounding of the kernel may take it below zero, and no further.
+		if (error < -tolerance) {
+			std::cerr << "ERROR: Pair " << aPair.v0->mId << ", " << aPair.v1->mId << " has negative error " << error << std::endl;
+			valid = false;
+		}
+	}
+	return valid;
+}
+
+/// Runs of changed elements at most this many bytes apart are uploaded as one, a few unchanged bytes cost less
+/// than another buffer update.
+static const size_t kUploadGapBytes = 256;
 
-    PreparePairs();
-//    for (auto & aPair : mPairs) {
-//        if( (*aPair.second.v0 == *v0 || *aPair.second.v1 == *v0) && (*aPair.second.v0 == *v1 || *aPair.second.v1 == *v1)) {
-//            std::cout << "ERROR: Found v0 and v1 pair in mPairs after it should have been removed" << std::endl;
-//        }
-//    }
+/// Appends the elements [begin, end) to a list of runs, extending the last run if it ends close enough.
+static void AddUploadRun(std::vector<std::pair<size_t, size_t>> & runs, size_t begin, size_t end, size_t maxGap) {
+    if (!runs.empty() && begin <= runs.back().second + maxGap) runs.back().second = std::max(runs.back().second, end);
+    else runs.push_back(std::make_pair(begin, end));
 }
 
 /// After all operations for a particular edge collapse have been performed, need to update the GPU buffers
 void ProgMesh::UpdateBuffers(starforge::RenderDevice & renderDevice) {
-    // Make a local contiguous array to copy verts into GPU buffer
-    std::vector<Vertex> localVerts;
-    localVerts.reserve(mVertices.size());
-    for (auto & vertPtr : mVertices) {
-        localVerts.push_back(*vertPtr);
+    std::vector<std::pair<size_t, size_t>> runs;
+
+    // Slots past the end belong to vertices that are gone, the draw call doesn't reach them. With the prefix layout
+    // every vertex of the file has a slot.
+    size_t numSlots = mPrefixLayout ? mProgressive->Header().numVertices : mVertices.size();
+    std::sort(mDirtySlots.begin(), mDirtySlots.end());
+    for (uint32_t slot : mDirtySlots) {
+        if (slot < numSlots) AddUploadRun(runs, slot, slot + 1, kUploadGapBytes / VertexStride());
     }
-    
-    renderDevice.FillVertexBuffer(mVBO, localVerts.size() * sizeof(localVerts.front()), localVerts.data());
-    renderDevice.FillIndexBuffer(mIBO, mIndices.size() * sizeof(mIndices.front()), mIndices.data());
+    for (const auto & run : runs) {
+        // Make a local contiguous array to copy verts into GPU buffer
+        mUploadVertices.clear();
+        for (size_t slot = run.first; slot < run.second; slot++) {
+            if (!mPrefixLayout) {
+                mUploadVertices.push_back(*mVertices[slot]);
+                continue;
+            }
+            const Vertex * aVertex = mFileVertices[slot];
+            mUploadVertices.push_back(aVertex ? *aVertex : MakeVertex(mProgressive->Vertices()[slot]));
+            if (slot < mSlotUploaded.size()) mSlotUploaded[slot] = 1;
+        }
+        long long bytes;
+        const void * data = VertexData(mUploadVertices, bytes);
+        StreamUpload(renderDevice, false, run.first * VertexStride(), bytes, data);
+        mUploadStats.bytes += bytes;
+        mUploadStats.ranges++;
+    }
+
+    // Without the prefix layout the vertex count changes with the level, and with it whether 16-bit indices reach
+    // every vertex. Switching rewrites the whole index buffer.
+    bool shortIndices = mPacked && numSlots <= kMaxShortIndexVertices;
+    if (shortIndices != mShortIndices) {
+        mShortIndices = shortIndices;
+        long long bytes;
+        const void * data = IndexData(0, mIndices.size(), bytes);
+        StreamUpload(renderDevice, true, 0, bytes, data);
+        mUploadStats.bytes += bytes;
+        mUploadStats.ranges++;
+        ClearDirty();
+        mStreamBuffer->EndFrame();
+        return;
+    }
+
+    runs.clear();
+    size_t numTriangles = mIndices.size() / 3;
+    size_t indexSize = IndexSize();
+    std::sort(mDirtyTriangles.begin(), mDirtyTriangles.end());
+    for (uint32_t triangle : mDirtyTriangles) {
+        if (triangle < numTriangles) AddUploadRun(runs, triangle, triangle + 1, kUploadGapBytes / (3 * indexSize));
+    }
+    for (const auto & run : runs) {
+        long long bytes;
+        const void * data = IndexData(3 * run.first, 3 * (run.second - run.first), bytes);
+        StreamUpload(renderDevice, true, run.first * 3 * indexSize, bytes, data);
+        mUploadStats.bytes += bytes;
+        mUploadStats.ranges++;
+    }
+    ClearDirty();
+    // The copies are issued, the stream buffer memory comes back once the GPU has done them.
+    mStreamBuffer->EndFrame();
+}
+
+UploadStats ProgMesh::TakeUploadStats() {
+    UploadStats stats = mUploadStats;
+    mUploadStats = UploadStats();
+    return stats;
 }
 
 bool ProgMesh::Upscale() {
-    if (mDecimations.empty() || mOpInProgress) return false;
+    if (mProgressive) {
+        if (mProgressiveLevel == mProgressive->CheckSplits(mProgressiveLevel + 1) || mOpInProgress) return false;
+        if (mSelective) SetProgressiveLevel(mProgressiveLevel);
+        mOpInProgress = true;
+        // Same animation as below: v0 and v1 start out where the split vertex was.
+        const PMSplit & split = mProgressive->Splits()[mProgressiveLevel];
+        glm::vec3 startPos = mFileVertices[split.vertex]->mPos;
+        Vertex * v0 = GetFileVertex(mProgressive->SplitV0(mProgressiveLevel));
+        Vertex * v1 = GetFileVertex(mProgressive->SplitV1(mProgressiveLevel));
+        ApplySplit(mProgressiveLevel++);
+        for (Vertex * aVertex : {v0, v1}) {
+            mVerticesInMotion.insert(std::make_pair(aVertex, std::make_pair(startPos, glm::vec3(aVertex->mPos))));
+            mVertexTime.insert(std::make_pair(aVertex, 0.0));
+            aVertex->mPos = glm::vec4(startPos, 1.f);
+            MarkVertexDirty(aVertex);
+        }
+        GenerateIndicesFromFaces();
+        return true;
+    }
+    if (mDecimations.Empty() || mOpInProgress) return false;
     // For Upscale, perform the operation first, then do the animation
     mOpInProgress = true;
     
-    // Get most recently inserted decimation
-    Decimation decimation = mDecimations.top(); mDecimations.pop();
+    // Spell out the most recent decimation from its record and the faces of its vNew.
+    Decimation & decimation = mScratchDecimation;
+    ExpandSplit(mDecimations.Top(), decimation);
     
-    // 1. Create and reinsert faces into ajacencey list
+    // 1. Reattach faces to v0 and v1, reinsert the degenerate ones. This also restores the edges.
     RecreateFaces(decimation);
     
-    // 2. Create and reinsert edges
-    RecreateEdgesAndQuadrics(decimation);
+    // 2. Update the quadrics of every vertex whose faces changed
+    std::vector<Vertex* > neighbors = RecreateQuadrics(decimation);
     
     // 3. Create and update pairs
-    RecreatePairs(decimation);
+    RecreatePairs(decimation, neighbors);
+    mDecimations.Pop();
     
     // 4. Delete vNew from master vertex list
-    Vertex* vNew = decimation.vNew;
-    mVertices.erase(std::remove_if(mVertices.begin(), mVertices.end(), [vNew](Vertex *& v) {
-        return (*v == *vNew);
-    }), mVertices.end());
+    RemoveVertex(decimation.vNew);
     glm::vec3 startPos = decimation.vNew->mPos;
-    delete decimation.vNew;
+    DestroyVertex(decimation.vNew);
     
     // 5. Reinsert v0 and v1 into the master vertex list
-    mVertices.push_back(decimation.v0);
-    mVertices.push_back(decimation.v1);
+    InsertVertex(decimation.v0);
+    InsertVertex(decimation.v1);
+    if (sValidatePairs) ValidatePairs();
     
     // 6. Setup and schedule the animation
     auto end_v0 = glm::vec3(decimation.v0->mPos);
@@ -627,93 +1548,311 @@ bool ProgMesh::Upscale() {
 
 }
 
+bool ProgMesh::SetProgressiveLevel(uint32_t level) {
+	if (!mProgressive) return false;
+	FinishAnimations();
+	level = std::min(level, mProgressive->CheckSplits(level));
+	if (level == mProgressiveLevel && !mSelective) return false;
+
+	if (mSelective) {
+		// Splits past the level are undone last to first, so their dependents are gone by the time they are
+		// undone. The missing ones before it are applied first to last, after their dependencies.
+		for (uint32_t s = mProgressive->NumSplitsAvailable(); s-- > level;) {
+			if (mSplitApplied[s]) UndoSplit(s);
+		}
+		for (uint32_t s = 0; s < level; s++) {
+			if (!mSplitApplied[s]) ApplySplit(s);
+		}
+		mProgressiveLevel = level;
+		mSelective = false;
+	}
+	while (mProgressiveLevel < level) ApplySplit(mProgressiveLevel++);
+	while (mProgressiveLevel > level) UndoSplit(--mProgressiveLevel);
+	GenerateIndicesFromFaces();
+	if (sOptimizeVertexCache) OptimizeVertexCache();
+	return true;
+}
+
+bool ProgMesh::MorphToLevel(uint32_t level, starforge::RenderDevice & renderDevice) {
+	if (!mProgressive) return false;
+	FinishAnimations();
+	// A geomorph goes from one level to another, a selectively refined mesh first jumps to the level it has the
+	// number of splits of.
+	if (mSelective) {
+		SetProgressiveLevel(mProgressiveLevel);
+		UpdateBuffers(renderDevice);
+	}
+	level = std::min(level, mProgressive->CheckSplits(level));
+	if (level == mProgressiveLevel) return false;
+
+	if (!mGeomorphBuilder) mGeomorphBuilder.reset(new GeomorphBuilder(*mProgressive));
+	mGeomorphBuilder->Build(mProgressiveLevel, level, mGeomorph);
+	SetProgressiveLevel(level);
+	UpdateBuffers(renderDevice);
+
+	if (!mMorphVAO) {
+		// No geomorph has more vertices or faces than the finest level.
+		const PMHeader & header = mProgressive->Header();
+		mMorphVBO = renderDevice.CreateVertexBuffer((header.numBaseVertices + header.numSplits) * sizeof(GeomorphVertex), nullptr);
+		mMorphIBO = renderDevice.CreateIndexBuffer(header.numFaces * 3 * sizeof(uint32_t), nullptr);
+		starforge::VertexElement vertexElements[] = {
+			{0, starforge::VERTEXELEMENTTYPE_FLOAT, 4, sizeof(GeomorphVertex), 0}, // Start position
+			{1, starforge::VERTEXELEMENTTYPE_FLOAT, 4, sizeof(GeomorphVertex), sizeof(glm::vec4)}, // Normal
+			{2, starforge::VERTEXELEMENTTYPE_FLOAT, 4, sizeof(GeomorphVertex), sizeof(glm::vec4) * 2}, // Color
+			{3, starforge::VERTEXELEMENTTYPE_FLOAT, 4, sizeof(GeomorphVertex), sizeof(glm::vec4) * 3} // End position
+		};
+		mMorphDescription = renderDevice.CreateVertexDescription(4, vertexElements);
+		mMorphVAO = renderDevice.CreateVertexArray(1, &mMorphVBO, &mMorphDescription);
+	} else {
+		// The previous geomorph may still be drawing, fresh storage keeps the upload from waiting for it.
+		renderDevice.OrphanVertexBuffer(mMorphVBO);
+		renderDevice.OrphanIndexBuffer(mMorphIBO);
+	}
+	renderDevice.FillVertexBuffer(mMorphVBO, mGeomorph.vertices.size() * sizeof(GeomorphVertex), mGeomorph.vertices.data());
+	renderDevice.FillIndexBuffer(mMorphIBO, mGeomorph.indices.size() * sizeof(uint32_t), mGeomorph.indices.data());
+	mMorphing = true;
+	mMorphTime = 0.0;
+	mOpInProgress = true;
+	return true;
+}
+
+bool ProgMesh::AdaptRefinement(const RefinementView & view) {
+	if (!mProgressive) return false;
+	// The dependencies are only known once every split is in, until then a streaming mesh is refined by level. Any
+	// split can be needed, so a file checked on use is checked all the way now.
+	uint32_t numSplits = mProgressive->Header().numSplits;
+	if (mProgressive->CheckSplits(numSplits) < numSplits) return false;
+	FinishAnimations();
+	if (!mHierarchy) {
+		mHierarchy = std::make_shared<VertexHierarchy>(*mProgressive);
+		mSplitApplied.assign(numSplits, 0);
+		mAppliedDependents.assign(numSplits, 0);
+		for (uint32_t s = 0; s < mProgressiveLevel; s++) MarkSplit(s, true);
+	}
+	mSelective = true;
+
+	// A single pass over the active vertices, like Hoppe's adapt_refinement. The vertices a split brings in are
+	// appended to mVertices and get visited later in the same pass. A slot whose vertex was replaced is visited again.
+	size_t changes = 0;
+	size_t i = 0;
+	while (i < mVertices.size() && changes < view.maxChanges) {
+		uint32_t vertex = mVertexFileIndex[mVertices[i]->mId];
+		uint32_t split = mHierarchy->SplitOf(vertex);
+		if (split != VertexHierarchy::npos && mHierarchy->ShouldRefine(vertex, view)) {
+			changes += ForceSplit(split, view.maxChanges - changes);
+			continue;
+		}
+		// Collapse the vertex back into its parent if the parent is good enough, unless another split needs it.
+		uint32_t parent = mHierarchy->ParentSplit(vertex);
+		if (parent != VertexHierarchy::npos && mAppliedDependents[parent] == 0
+			&& !mHierarchy->ShouldRefine(mProgressive->Splits()[parent].vertex, view)) {
+			UndoSplit(parent);
+			mProgressiveLevel--;
+			changes++;
+			continue;
+		}
+		i++;
+	}
+	if (changes == 0) return false;
+	GenerateIndicesFromFaces();
+	// Reorders the whole mesh, so every adaptation then uploads all of it instead of the faces that changed.
+	if (sOptimizeVertexCache) OptimizeVertexCache();
+	return true;
+}
+
+size_t ProgMesh::ForceSplit(uint32_t split, size_t maxChanges) {
+	size_t changes = 0;
+	mSplitStack.assign(1, split);
+	while (!mSplitStack.empty() && changes < maxChanges) {
+		uint32_t top = mSplitStack.back();
+		const uint32_t * d = mHierarchy->DependenciesBegin(top);
+		const uint32_t * end = mHierarchy->DependenciesEnd(top);
+		while (d != end && mSplitApplied[*d]) d++;
+		if (d != end) {
+			mSplitStack.push_back(*d);
+			continue;
+		}
+		mSplitStack.pop_back();
+		// A split can end up on the stack twice when two others depend on it.
+		if (!mSplitApplied[top]) {
+			ApplySplit(top);
+			mProgressiveLevel++;
+			changes++;
+		}
+	}
+	return changes;
+}
+
+Vertex * ProgMesh::GetFileVertex(uint32_t index) {
+	Vertex *& aVertex = mFileVertices[index];
+	if (!aVertex) {
+		uint32_t poolIndex = mVertexPool.Create(MakeVertex(mProgressive->Vertices()[index]));
+		aVertex = mVertexPool[poolIndex];
+		aVertex->mId = poolIndex;
+		if (mVertexFileIndex.size() <= poolIndex) mVertexFileIndex.resize(poolIndex + 1);
+		mVertexFileIndex[poolIndex] = index;
+	}
+	return aVertex;
+}
+
+Face * ProgMesh::GetFileFace(uint32_t index) {
+	Face *& aFace = mFileFaces[index];
+	if (!aFace) {
+		// A face is only asked for once it is in the mesh, and then it has the vertices the file stored it with.
+		const uint32_t * corners = mProgressive->Faces() + 3 * index;
+		uint32_t poolIndex = mFacePool.Create(GetFileVertex(corners[0]), GetFileVertex(corners[1]), GetFileVertex(corners[2]));
+		aFace = mFacePool[poolIndex];
+		aFace->mId = poolIndex;
+	}
+	return aFace;
+}
+
+void ProgMesh::ApplySplit(uint32_t splitIndex) {
+	const PMSplit & split = mProgressive->Splits()[splitIndex];
+	const uint32_t * faceRefs = mProgressive->FaceRefs() + split.firstFaceRef;
+	Vertex * vSplit = mFileVertices[split.vertex];
+	Vertex * v0 = GetFileVertex(mProgressive->SplitV0(splitIndex));
+	Vertex * v1 = GetFileVertex(mProgressive->SplitV1(splitIndex));
+
+	for (uint32_t i = 0; i < split.numV0Faces; i++) {
+		mFileFaces[faceRefs[i]]->ReplaceVertex(vSplit, v0);
+	}
+	for (uint32_t i = 0; i < split.numV1Faces; i++) {
+		mFileFaces[faceRefs[split.numV0Faces + i]]->ReplaceVertex(vSplit, v1);
+	}
+	// The new faces were stored with v0 and v1 already in them.
+	for (uint32_t i = 0; i < split.numNewFaces; i++) {
+		InsertFace(GetFileFace(split.firstNewFace + i));
+	}
+	if (mPrefixLayout) NoteSplitFaces(split);
+
+	RemoveVertex(vSplit);
+	InsertVertex(v0);
+	InsertVertex(v1);
+
+	if (!mSplitApplied.empty()) MarkSplit(splitIndex, true);
+}
+
+void ProgMesh::UndoSplit(uint32_t splitIndex) {
+	const PMSplit & split = mProgressive->Splits()[splitIndex];
+	const uint32_t * faceRefs = mProgressive->FaceRefs() + split.firstFaceRef;
+	Vertex * vSplit = mFileVertices[split.vertex];
+	Vertex * v0 = mFileVertices[mProgressive->SplitV0(splitIndex)];
+	Vertex * v1 = mFileVertices[mProgressive->SplitV1(splitIndex)];
+
+	for (uint32_t i = 0; i < split.numNewFaces; i++) {
+		RemoveFace(mFileFaces[split.firstNewFace + i]);
+	}
+	for (uint32_t i = 0; i < split.numV0Faces; i++) {
+		mFileFaces[faceRefs[i]]->ReplaceVertex(v0, vSplit);
+	}
+	for (uint32_t i = 0; i < split.numV1Faces; i++) {
+		mFileFaces[faceRefs[split.numV0Faces + i]]->ReplaceVertex(v1, vSplit);
+	}
+	if (mPrefixLayout) NoteSplitFaces(split);
+
+	RemoveVertex(v0);
+	RemoveVertex(v1);
+	InsertVertex(vSplit);
+
+	if (!mSplitApplied.empty()) MarkSplit(splitIndex, false);
+}
+
+void ProgMesh::NoteSplitFaces(const PMSplit & split) {
+	const uint32_t * faceRefs = mProgressive->FaceRefs() + split.firstFaceRef;
+	mChangedFaces.insert(mChangedFaces.end(), faceRefs, faceRefs + split.numV0Faces + split.numV1Faces);
+	for (uint32_t i = 0; i < split.numNewFaces; i++) mChangedFaces.push_back(split.firstNewFace + i);
+}
+
+void ProgMesh::MarkSplit(uint32_t split, bool applied) {
+	mSplitApplied[split] = applied;
+	for (const uint32_t * d = mHierarchy->DependenciesBegin(split); d != mHierarchy->DependenciesEnd(split); d++) {
+		if (applied) mAppliedDependents[*d]++;
+		else mAppliedDependents[*d]--;
+	}
+}
+
 void ProgMesh::RecreateFaces(Decimation & decimation) {
 
 	Vertex * v0 = decimation.v0;
 	Vertex * v1 = decimation.v1;
 	Vertex * vNew = decimation.vNew;
 
-	auto & v0Faces = decimation.v0Faces;
-	auto & v1Faces = decimation.v1Faces;
+	// Every edge of vNew is about to go away, and its id may be handed out again.
+	DeletePairsAround(vNew);
 
 	// Replacing all face indicies with vNew in them to have v0 or v1
-	for (auto aFacePtr : v0Faces) {
+	for (Face * aFacePtr : decimation.v0Faces) {
 		aFacePtr->ReplaceVertex(vNew, v0);
-		mVertexFaceAdjacency.insert(std::make_pair(v0, aFacePtr));
+		mConnectivity.ReplaceVertex(aFacePtr->mId, vNew->mId, v0->mId);
 	}
-	for (auto aFacePtr : v1Faces) {
+	for (Face * aFacePtr : decimation.v1Faces) {
 		aFacePtr->ReplaceVertex(vNew, v1);
-		mVertexFaceAdjacency.insert(std::make_pair(v1, aFacePtr));
+		mConnectivity.ReplaceVertex(aFacePtr->mId, vNew->mId, v1->mId);
 	}
 
-	// Re-add the degenerate faces and update vertex to face adjacency for v0, v1, and the vertex neighbors shared by them
-	for (auto aDegenPtr : decimation.degenFaces) {
-		mFaces.insert(aDegenPtr);
-		mVertexFaceAdjacency.insert(std::make_pair(aDegenPtr->GetVertex(0), aDegenPtr));
-		mVertexFaceAdjacency.insert(std::make_pair(aDegenPtr->GetVertex(1), aDegenPtr));
-		mVertexFaceAdjacency.insert(std::make_pair(aDegenPtr->GetVertex(2), aDegenPtr));
+	// Re-add the degenerate faces, which restores the edge between v0 and v1
+	for (Face * aDegenPtr : decimation.degenFaces) {
+		InsertFace(aDegenPtr);
+		mConnectivity.AddFace(aDegenPtr->mId, aDegenPtr->GetVertex(0)->mId,
+							  aDegenPtr->GetVertex(1)->mId, aDegenPtr->GetVertex(2)->mId);
 	}
 
 }
 
-void ProgMesh::RecreateEdgesAndQuadrics(Decimation & decimation) {
+std::vector<Vertex* > ProgMesh::RecreateQuadrics(Decimation & decimation) {
 
 	Vertex * v0 = decimation.v0;
 	Vertex * v1 = decimation.v1;
-	Vertex * vNew = decimation.vNew;
-
-	// Reinsert removed edges between v0, v1 and their respective neighbors
-	for (auto & aNeighbor : decimation.v0Neighbors) {
-		mEdges.insert(std::make_pair(v0, aNeighbor));
-		mEdges.insert(std::make_pair(aNeighbor, v0));
-	}
-	for (auto & aNeighbor : decimation.v1Neighbors) {
-		mEdges.insert(std::make_pair(v1, aNeighbor));
-		mEdges.insert(std::make_pair(aNeighbor, v1));
-	}
-	mEdges.insert(std::make_pair(v0, v1));
-	mEdges.insert(std::make_pair(v1, v0));
 
-	// Getting the neighbors of vNew (w/o duplication)
+	// Getting the neighbors of vNew (w/o duplication), which are the ones of v0 and v1 now that their faces are back
 	std::vector<Vertex* > vNewNeighbors;
-	vNewNeighbors.reserve(decimation.v0Neighbors.size() + decimation.v1Neighbors.size() - decimation.degenFaces.size());
-	std::set_union(decimation.v0Neighbors.begin(), decimation.v0Neighbors.end(), decimation.v1Neighbors.begin(), 
-												decimation.v1Neighbors.end(), std::back_inserter(vNewNeighbors));
-
-	// Delete outbound edges of vNew
-	mEdges.erase(vNew);
-
-	// Delete the inbound edges of vNew
-	for (auto & aNeighbor : vNewNeighbors) {
-		auto range = mEdges.equal_range(aNeighbor);
-		for (auto it = range.first; it != range.second;) {
-			if (it->second == vNew) {
-				it = mEdges.erase(it);
-			}
-			else it++;
+	auto addNeighbor = [&](uint32_t aNeighbor, uint32_t) {
+		if (aNeighbor != v0->mId && aNeighbor != v1->mId) vNewNeighbors.push_back(mVertexPool[aNeighbor]);
+	};
+	mConnectivity.ForEachNeighbor(v0->mId, addNeighbor);
+	mConnectivity.ForEachNeighbor(v1->mId, addNeighbor);
+	std::sort(vNewNeighbors.begin(), vNewNeighbors.end(), IdLess());
+	vNewNeighbors.erase(std::unique(vNewNeighbors.begin(), vNewNeighbors.end()), vNewNeighbors.end());
+
+	// Undo UpdateQuadrics for the neighbors. The quadrics of v0 and v1 were left as they were at collapse time,
+	// and the one of vNew goes away with it.
+	for (Face * aFace : decimation.v0Faces) UpdateFacePlane(aFace, v0, v1);
+	for (Face * aFace : decimation.v1Faces) UpdateFacePlane(aFace, v0, v1);
+	for (Face * aDegenFace : decimation.degenFaces) {
+		for (int i = 0; i < 3; i++) {
+			Vertex * aVertex = aDegenFace->GetVertex(i);
+			if (aVertex != v0 && aVertex != v1) mQuadrics[aVertex->mId] += mFacePlanes[aDegenFace->mId];
 		}
 	}
 
-	// Update mQuadrics for vertices whose adjacent faces have changed
-	for (auto & aNeighbor : vNewNeighbors) {
-		auto itr = mQuadrics.find(aNeighbor);
-		itr->second = ComputeQuadric(aNeighbor);
-	}
-	auto itr = mQuadrics.find(v0);
-	itr->second = ComputeQuadric(v0);
-	itr = mQuadrics.find(v1);
-	itr->second = ComputeQuadric(v1);
-	mQuadrics.erase(vNew);
-
+	return vNewNeighbors;
 }
 
-void ProgMesh::RecreatePairs(Decimation & decimation) {
-	mPairs.clear();
-	mEdgeToPair.clear();
-	PreparePairs();
+void ProgMesh::RecreatePairs(Decimation & decimation, const std::vector<Vertex* > & neighbors) {
+	// The pairs of vNew were removed along with its edges. Score the pairs of v0, v1 and the neighbors
+	// against the restored edges and quadrics.
+	StorePairsAround(decimation.v0);
+	StorePairsAround(decimation.v1);
+	for (auto & aNeighbor : neighbors) {
+		StorePairsAround(aNeighbor);
+	}
+	ScorePendingPairs();
 }
 
 void ProgMesh::Animate(double delta_t, starforge::RenderDevice & renderDevice) {
+    // A geomorph is blended on the GPU, only its time moves on here.
+    if (mMorphing) {
+        mMorphTime = glm::clamp(mMorphTime + 0.1, 0.0, 1.0);
+        mMorphing = mMorphTime < 1.0;
+    }
+    // With no vertex moving, only what Downscale or Upscale changed since the last frame is left to upload.
+    if (mVerticesInMotion.empty()) {
+        mOpInProgress = mMorphing;
+        UpdateBuffers(renderDevice);
+        return;
+    }
+
     // Update the time values for each vertex in motion
     for(auto & aVertexPath: mVerticesInMotion) {
         Vertex * vertex = aVertexPath.first;
@@ -734,6 +1873,7 @@ void ProgMesh::Animate(double delta_t, starforge::RenderDevice & renderDevice) {
         double time = mVertexTime.at(vertex);
         auto newPos = glm::mix(startPos, endPos, time);
         vertex->mPos = glm::vec4(newPos, 1.f);
+        MarkVertexDirty(vertex);
         
         vMItr++;
     }
@@ -743,6 +1883,36 @@ void ProgMesh::Animate(double delta_t, starforge::RenderDevice & renderDevice) {
     CheckAnimations();
 }
 
+void ProgMesh::FinishAnimations() {
+    for (auto & aVertexPath : mVerticesInMotion) {
+        aVertexPath.first->mPos = glm::vec4(aVertexPath.second.second, 1.f);
+        MarkVertexDirty(aVertexPath.first);
+    }
+    mVerticesInMotion.clear();
+    mVertexTime.clear();
+
+    if (mScheduledCollapse.v0 != nullptr) PerformScheduledCollapse();
+    mMorphing = false;
+    mOpInProgress = false;
+}
+
+void ProgMesh::PerformScheduledCollapse() {
+    Vertex * v0 = mScheduledCollapse.v0;
+    Vertex * v1 = mScheduledCollapse.v1;
+    // The animation only moved them for show, the decimation has to remember where they really are.
+    v0->mPos = glm::vec4(mScheduledStart0, 1.f);
+    v1->mPos = glm::vec4(mScheduledStart1, 1.f);
+    MarkVertexDirty(v0);
+    MarkVertexDirty(v1);
+    // The pair is gone if an Upscale touched its neighborhood while the animation was playing.
+    if (mConnectivity.FindEdge(v0->mId, v1->mId) != MeshConnectivity::npos) {
+        if (sPrintStatements) std::cout << "Collapsing pair: " << v0 << ", " << v1 << std::endl;
+        EdgeCollapse(&mScheduledCollapse);
+        if (sPrintStatements) PrintConnectivity(std::cout);
+    }
+    mScheduledCollapse = Pair();
+}
+
 void ProgMesh::CheckAnimations() {
     for (auto & aVertexPtr : mVertices) {
         auto searchItr = mVertexTime.find(aVertexPtr);
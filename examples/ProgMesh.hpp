@@ -7,12 +7,53 @@
 #include <functional>
 #include <vector>
 #include <iostream>
-#include <stack>
 #include <memory>
 #include <atomic>
+#include <limits>
 #include "Geometry.hpp"
 #include "RenderDevice.hpp"
 #include "Decimation.hpp"
+#include "IndexedPriorityQueue.hpp"
+#include "MeshConnectivity.hpp"
+#include "Quadric.hpp"
+#include "PairCostKernel.hpp"
+#include "ObjectPool.hpp"
+#include "ProgMeshFile.hpp"
+#include "VertexHierarchy.hpp"
+#include "Geomorph.hpp"
+#include "VertexCache.hpp"
+#include "PackedVertex.hpp"
+
+/// Where ProgMesh::SimplifyTo stops. Simplification ends as soon as any one of the limits is reached.
+struct SimplifyTarget {
+    /// Stop once the mesh has at most this many faces.
+    size_t maxFaces = 0;
+    /// Stop once the mesh has at most this many vertices.
+    size_t maxVertices = 0;
+    /// Stop before the first collapse whose error is larger than this.
+    float maxError = std::numeric_limits<float>::infinity();
+};
+
+/// What a call to ProgMesh::SimplifyTo did.
+struct SimplifyStats {
+    size_t collapses = 0;
+    size_t facesBefore = 0, facesAfter = 0;
+    size_t verticesBefore = 0, verticesAfter = 0;
+    /// The largest error of any collapse performed.
+    float maxError = 0.f;
+    /// The summed error of all collapses performed, to compare simplification orders.
+    double totalError = 0.0;
+    /// Rounds of independent collapses, only counted by ProgMesh::SimplifyToParallel.
+    size_t rounds = 0;
+    double seconds = 0.0;
+};
+
+/// What ProgMesh::UpdateBuffers and AllocateBuffers sent to the GPU since the stats were last taken.
+struct UploadStats {
+    size_t bytes = 0;
+    /// Buffer updates issued, one per coalesced run of changed vertices or triangles.
+    size_t ranges = 0;
+};
 
 /**
  * This class represents geometry in space and any associated transformations on that geometry.
@@ -23,13 +64,26 @@ public:
 	ProgMesh();
 	//ProgMesh(std::vector<Vertex> & _verts, std::unordered_set<Face> & _faces);
     ProgMesh(std::vector<Vertex> & _verts, std::vector<uint32_t > & _indices);
+    /// Creates a mesh at the base level of a progressive mesh file. No connectivity, quadrics or pairs are built:
+    /// Upscale and Downscale step through the splits of the file instead.
+    ///
+    /// With prefixLayout, the buffers are laid out in the order of the file instead of the order of the current mesh:
+    /// AllocateBuffers uploads every vertex and face of the file once, and any level is a prefix of the faces. Going
+    /// from one level to another then only uploads the triangles the splits in between rewire, and never moves a
+    /// vertex. The buffers take as much memory as the finest level and everything merged away on the way.
+    explicit ProgMesh(std::shared_ptr<const ProgMeshFile> file, bool prefixLayout = false);
     ProgMesh(const ProgMesh & other);
     ~ProgMesh();
 
 	const glm::mat4 & GetModelMatrix() const { return  mModelMatrix; }
 	glm::mat4 & GetModelMatrix() { return mModelMatrix; }
 
+	size_t GetNumVertices() const { return mVertices.size(); }
+	size_t GetNumFaces() const { return mFaceList.size(); }
+
 	void AllocateBuffers(starforge::RenderDevice & renderDevice);
+	/// Destroys the GPU buffers of the mesh, for a mesh that is replaced while the device lives on.
+	void ReleaseBuffers(starforge::RenderDevice & renderDevice);
     void Draw(starforge::RenderDevice & renderDevice);
     void BuildConnectivity();
     void PrintConnectivity(std::ostream & os);
@@ -37,62 +91,305 @@ public:
     std::vector<Vertex *> GetConnectedVertices(Vertex *) const;
     /// Returns a list of faces that the given vertex is a part of.
     std::vector<Face *> GetAdjacentFaces(Vertex *) const;
-	glm::mat4 ComputeQuadric(Vertex * aVertex) const;
+	/// Sums the cached plane quadrics of the faces around the vertex.
+	Quadric ComputeQuadric(Vertex * aVertex) const;
+	/// The quadric of the plane of a face, zero if the face has no area.
+	static Quadric ComputePlaneQuadric(const Face * aFace);
+	/// Collapses the pair. Does not regenerate the index buffer.
 	void EdgeCollapse(Pair* collapsePair);
 	void TestEdgeCollapse(unsigned int v0, unsigned int v1);
 	bool Downscale();
 	bool Upscale();
+	/// Collapses the cheapest pairs back to back until the target is reached, without any animation.
+	/// Finishes an animation in progress first. The index buffer is regenerated once at the end,
+	/// call UpdateBuffers afterwards to upload the result.
+	SimplifyStats SimplifyTo(const SimplifyTarget & target);
+	/// Like SimplifyTo, but works in rounds: each round picks the cheapest pairs whose neighborhoods don't overlap
+	/// and collapses them on all threads at once. Collapses can happen in a somewhat different order than
+	/// SimplifyTo would pick them. The result does not depend on the number of threads.
+	SimplifyStats SimplifyToParallel(const SimplifyTarget & target);
+	/// A new mesh with the vertices and faces this one has now, ready to simplify on its own. Its quadrics start over
+	/// from those faces, so it only simplifies like this mesh would if this one hasn't been simplified yet.
+	/// Finishes an animation in progress first.
+	std::shared_ptr<ProgMesh> CopyCurrentMesh();
 	void GenerateNormals();
+	/// Writes the mesh as it is now as the base of a .pm file, with every decimation so far as a split.
+	/// Simplify it all the way first for the smallest base. Finishes an animation in progress first.
+	bool SaveProgressive(const std::string & path);
+	/// The same as SaveProgressive, kept in memory. Null if the decimations don't lead back to the mesh.
+	std::shared_ptr<const ProgMeshFile> MakeProgressiveFile();
+	/// For meshes created from a .pm file: applies or undoes splits until the given number of them is applied, or as
+	/// many as are available, then regenerates the index buffer. Use ProgMeshFile::LevelForFaces or LevelForError to
+	/// pick the level. Returns false if nothing changed.
+	/// Also turns a selectively refined mesh back into a plain level.
+	bool SetProgressiveLevel(uint32_t level);
+	/// How many splits are applied. After AdaptRefinement, they need not be the first ones.
+	uint32_t GetProgressiveLevel() const { return mProgressiveLevel; }
+	/// For meshes created from a complete .pm file: refines the regions of the mesh that are in view, face the eye
+	/// and show more error on screen than the view allows, and coarsens the others. Call it every frame, each call
+	/// only changes what the view change requires, then regenerates the index buffer. Finishes an animation in
+	/// progress first. Returns false if nothing changed.
+	bool AdaptRefinement(const RefinementView & view);
+	/// For meshes created from a .pm file: goes to a level like SetProgressiveLevel, but shows the change as a
+	/// geomorph that Animate plays out over the next frames, however many splits it covers. The mesh is at the new
+	/// level right away and its buffers are updated, only the drawing lags behind. Returns false if nothing changed.
+	bool MorphToLevel(uint32_t level, starforge::RenderDevice & renderDevice);
+	/// The blend factor to draw with, for the uMorph shader parameter. 0 unless a geomorph is playing.
+	float GetMorphBlend() const { return mMorphing ? (float)mMorphTime : 0.f; }
+	/// What the shader multiplies positions by, for the uDequantize shader parameter. Identity unless the vertices
+	/// are packed; geomorphs are always drawn from float vertices.
+	glm::mat4 GetDequantizeMatrix() const { return mPacked && !mMorphing ? mQuantization.DequantizeMatrix() : glm::mat4(1.f); }
+	/// Whether the normals are octahedral encoded, for the uOctahedralNormals shader parameter.
+	bool HasOctahedralNormals() const { return mPacked && !mMorphing; }
+	/// The file this mesh plays back, null if it was built from plain geometry.
+	const ProgMeshFile * GetProgressiveFile() const { return mProgressive.get(); }
+	std::shared_ptr<const ProgMeshFile> ShareProgressiveFile() const { return mProgressive; }
+	bool UsesPrefixLayout() const { return mPrefixLayout; }
+	/// Reorders the faces for the post-transform vertex cache and for overdraw, then the vertices in the order the
+	/// faces use them. Takes time linear in the size of the mesh, and the next UpdateBuffers uploads everything.
+	/// Does nothing with the prefix layout, whose order is the file's. Returns the statistics of the new order.
+	VertexCacheStats OptimizeVertexCache();
+	/// How the faces use the vertex cache as they are now.
+	VertexCacheStats AnalyzeVertexCache() const;
     
+    /// Uploads the vertices and triangles that changed since the last upload, in as few runs as they allow.
+    /// Runs separated by only a few unchanged elements are sent as one. They are written into a stream buffer and
+    /// copied into the mesh buffers from there, so the CPU doesn't wait for draws still reading them.
     void UpdateBuffers(starforge::RenderDevice & renderDevice);
+    /// Returns what was uploaded since the last call and starts counting again, e.g. once per frame.
+    UploadStats TakeUploadStats();
 
     void Animate(double delta_t, starforge::RenderDevice & renderDevice);
 	static bool sPrintStatements;
+	/// When set, every incremental pair update is cross-checked against a full rebuild. Slow, debugging only.
+	static bool sValidatePairs;
+	/// When set, meshes run OptimizeVertexCache whenever a level is made: by AllocateBuffers, SimplifyTo,
+	/// SimplifyToParallel, SetProgressiveLevel and AdaptRefinement.
+	static bool sOptimizeVertexCache;
+	/// When set, AllocateBuffers uploads PackedVertex instead of Vertex, and 16-bit indices whenever the vertices
+	/// fit. Applies to the buffers made after it is set.
+	static bool sPackVertices;
 private:
+	size_t VertexStride() const { return mPacked ? sizeof(PackedVertex) : sizeof(Vertex); }
+	size_t IndexSize() const { return mShortIndices ? sizeof(uint16_t) : sizeof(uint32_t); }
+	/// The vertices in the vertex buffer format, packed into mUploadPacked if need be. Sets bytes to their size.
+	const void * VertexData(const std::vector<Vertex> & vertices, long long & bytes);
+	/// count indices of mIndices from first on in the index buffer format. Sets bytes to their size.
+	const void * IndexData(size_t first, size_t count, long long & bytes);
+	/// Writes bytes of data into mStreamBuffer and copies them from there to offset in the vertex buffer, or in the
+	/// index buffer when indices is set. Updates the buffer directly when the data doesn't fit the stream buffer.
+	void StreamUpload(starforge::RenderDevice & renderDevice, bool indices, long long offset, long long bytes, const void * data);
 
     /// Computes initial quadrics and pairs and sorts the latter by smallest error
     void PreparePairsAndQuadrics();
 	void PreparePairs();
 	void GenerateIndicesFromFaces();
-	void DeletePairsWithNeighbor(Vertex* v, std::vector<Vertex* > neighbors, Decimation & dec);
-	void CalculateAndStorePair(Vertex* vA, Vertex * vB);
+	/// GenerateIndicesFromFaces for the prefix layout: brings the triangles of the faces in mChangedFaces and of the
+	/// ones the draw range now reaches up to date.
+	void GeneratePrefixIndices();
+	/// Queues the faces a split rewires, adds or removes for GeneratePrefixIndices.
+	void NoteSplitFaces(const PMSplit & split);
+	/// Sets the triangle of a file face to its corners, or to a degenerate one if the face is not in the mesh.
+	void WritePrefixTriangle(uint32_t face);
+	/// Where a vertex is in the vertex buffer: its slot, or its file index with the prefix layout.
+	uint32_t VertexBufferSlot(const Vertex * aVertex) const {
+		return mPrefixLayout ? mVertexFileIndex[aVertex->mId] : aVertex->mSlot;
+	}
+	/// Numbers the vertices, faces and splits of the mesh and its decimations for a .pm file.
+	bool NumberProgressive(uint32_t & numBaseFaces, std::vector<PMVertex> & vertices, std::vector<uint32_t> & faces,
+						   std::vector<PMSplit> & splits, std::vector<uint32_t> & faceRefs);
+	/// Creates a copy of the vertex in mVertexPool and sets its index.
+	Vertex * CreateVertex(const Vertex & aVertex);
+	/// Returns the slot of the vertex to mVertexPool. The vertex must not be used afterwards.
+	void DestroyVertex(Vertex * aVertex);
+	Face * CreateFace(Vertex * v0, Vertex * v1, Vertex * v2);
+	/// Appends the vertex to mVertices and records its slot.
+	void InsertVertex(Vertex * aVertex);
+	/// Queues the buffer slot of a vertex that was just added to mVertices, unless it already holds the vertex.
+	void MarkInsertedVertexDirty(const Vertex * aVertex);
+	/// Removes the vertex from mVertices in O(1) by moving the last vertex into its slot.
+	void RemoveVertex(Vertex * aVertex);
+	/// Appends the face to mFaceList and records its slot.
+	void InsertFace(Face * aFace);
+	/// Removes the face from mFaceList in O(1) by moving the last face into its slot.
+	void RemoveFace(Face * aFace);
+	/// Queues the vertex buffer slot of a vertex whose attributes changed for the next UpdateBuffers.
+	void MarkVertexDirty(const Vertex * aVertex);
+	/// Queues a triangle of mIndices that changed for the next UpdateBuffers.
+	void MarkTriangleDirty(size_t triangle);
+	/// Forgets every pending change, once the buffers hold all of them.
+	void ClearDirty();
+	/// Orders the two vertices of an edge by id so both directions map to the same pair.
+	static Edge MakeEdgeKey(Vertex * vA, Vertex * vB);
+	/// The pair of an edge of the connectivity. Pair ids are edge ids.
+	Pair GetPair(uint32_t edgeId) const;
+	/// Scores a single pair the same way ScorePendingPairs does. Returns its error and sets where it collapses to.
+	float CalcPairError(uint32_t edgeId, glm::vec3 & target) const;
+	/// Removes the pairs of every edge of the vertex. Must be called before those edges are removed,
+	/// since the connectivity recycles edge ids.
+	void DeletePairsAround(Vertex * v);
+	/// Queues the pairs of every edge of the vertex for (re)scoring by ScorePendingPairs.
+	void StorePairsAround(Vertex * v);
+	/// Scores the queued pairs in batches, then pushes or updates them in mPairs.
+	void ScorePendingPairs();
+	/// Scores the queued pairs into mPairCosts and mPairTargets only, leaving mPairs and mPendingPairs as they are.
+	/// mPendingPairs must not list an edge twice.
+	void EvaluatePendingPairs();
     void UpdateFaces(Vertex * v0, Vertex * v1, Vertex & newVertex, Decimation & dec);
-	std::vector<Vertex* > UpdateEdgesAndQuadrics(Vertex * v0, Vertex * v1, Vertex & newVertex, Decimation & dec);
-	void UpdatePairs(Vertex * v0, Vertex * v1, Vertex & newVertex, std::vector<Vertex* > neighbors, Decimation & dec);
+	/// Recomputes the cached plane of a face whose vertices moved, and moves the quadrics of its vertices
+	/// (except skipA and skipB) from the old plane to the new one.
+	void UpdateFacePlane(Face * aFace, const Vertex * skipA, const Vertex * skipB);
+	void UpdateQuadrics(Vertex * v0, Vertex * v1, Vertex & newVertex, const Decimation & dec);
+	/// Queues the pairs around the neighbors of a collapse for scoring.
+	void StoreCollapsePairs(const Decimation & dec);
+	void UpdatePairs(const Decimation & dec);
+
+	/// Fills the lists of the decimation for collapsing its v0 and v1, all sorted by id. Only reads the mesh.
+	void GatherCollapse(Decimation & dec) const;
+	/// Fills in the vertices and face lists of the decimation a split undoes, from the split and the faces of its vNew.
+	void ExpandSplit(const VertexSplit & split, Decimation & dec) const;
+	/// Moves the faces of v0 and v1 over to vNew in the connectivity and removes the degenerate ones.
+	/// Leaves mFaceList alone. Collapses with separate budgets and disjoint neighborhoods may rewire concurrently.
+	void RewireFaces(const Decimation & dec, MeshConnectivity::EdgeBudget * budget);
     
 	void RecreateFaces(Decimation & decimation);
-	void RecreateEdgesAndQuadrics(Decimation & decimation);
-	void RecreatePairs(Decimation & decimation);
+	std::vector<Vertex* > RecreateQuadrics(Decimation & decimation);
+	void RecreatePairs(Decimation & decimation, const std::vector<Vertex* > & neighbors);
+	/// Compares mPairs, and the quadrics it is scored from, against a from-scratch rebuild and reports any mismatch.
+	/// Returns true if they agree.
+	bool ValidatePairs() const;
     
+	/// The vertex or face made for one of mProgressive, created from the file the first time it is asked for.
+	Vertex * GetFileVertex(uint32_t index);
+	Face * GetFileFace(uint32_t index);
+	/// Apply or undo a split of mProgressive. Don't regenerate the index buffer.
+	void ApplySplit(uint32_t split);
+	void UndoSplit(uint32_t split);
+	/// Updates the bookkeeping of AdaptRefinement for a split that was applied or undone.
+	void MarkSplit(uint32_t split, bool applied);
+	/// Applies a split along with every split it depends on that isn't applied yet, at most maxChanges of them.
+	/// Returns how many were applied.
+	size_t ForceSplit(uint32_t split, size_t maxChanges);
+
     /// Called by Animate() removes animation that are completed
     void CheckAnimations();
+    /// Moves every vertex in motion to the end of its path, performs a scheduled collapse right away and ends
+    /// a geomorph.
+    void FinishAnimations();
+    /// Collapses mScheduledCollapse, once Downscale has animated it, unless the pair is gone.
+    void PerformScheduledCollapse();
 
     /// The list of decimation operations that have occurred
-    std::stack<Decimation> mDecimations;
+    DecimationStack mDecimations;
     
-	/// The vertices that compose this ProgMesh
+	/// The vertices that compose this ProgMesh, in vertex buffer order. Vertex::mSlot is the position in here.
 	std::vector<Vertex *> mVertices;
 
-	/// Stores the faces. Faces are indices into the vertex array.
-	//std::vector<Face> mFaces;
-    std::unordered_set<Face *, FacePtrHash> mFaces;
 	std::vector<uint32_t> mIndices;
+	/// The faces of the mesh in index buffer order. Face::mSlot is the position in here. Keeping every face where it
+	/// is lets GenerateIndicesFromFaces tell which triangles actually changed.
+	std::vector<Face *> mFaceList;
+
+	/// What changed since the last upload: the vertex buffer slots and the triangles of mIndices, flagged and listed.
+	std::vector<uint8_t> mSlotDirty;
+	std::vector<uint32_t> mDirtySlots;
+	std::vector<uint8_t> mTriangleDirty;
+	std::vector<uint32_t> mDirtyTriangles;
+	/// Scratch space for the vertices of a run, reused by UpdateBuffers.
+	std::vector<Vertex> mUploadVertices;
+	std::vector<PackedVertex> mUploadPacked;
+	std::vector<uint16_t> mUploadShortIndices;
+	UploadStats mUploadStats;
 
-	/// The vertex to face adjacency.
-	std::unordered_multimap<Vertex*, Face*, VertexPtrHash> mVertexFaceAdjacency;
+	/// The buffer formats AllocateBuffers picked: PackedVertex and the box its positions are relative to, and
+	/// 16-bit indices, which UpdateBuffers turns on and off as the vertex count changes.
+	bool mPacked = false;
+	bool mShortIndices = false;
+	PositionQuantization mQuantization;
 
-	/// The vertex adjacency (i.e. edges)
-	std::unordered_multimap<Vertex *, Vertex *, VertexPtrHash> mEdges;
+	/// Reused by EdgeCollapse and Upscale.
+	Decimation mScratchDecimation;
 
-	/// The vertex quadrics
-	std::unordered_map<Vertex *, glm::mat4, VertexPtrHash> mQuadrics;
+	/// A collapse of the current SimplifyToParallel round, along with its scratch space.
+	struct RoundCollapse {
+		uint32_t edgeId;
+		Decimation decimation;
+		MeshConnectivity::EdgeBudget edges;
+		/// The pairs around the neighbors, which need to be scored again.
+		std::vector<uint32_t> stalePairs;
+	};
+	/// The collapses of the current round. Kept around so the lists keep their capacity from round to round.
+	std::vector<RoundCollapse> mRoundCollapses;
+	/// Candidates of the current round as (error, edge id), and scratch space for finding them.
+	std::vector<std::pair<float, uint32_t>> mRoundCandidates;
+	std::vector<float> mRoundSample;
+	std::vector<size_t> mRoundChunkStarts;
+	/// The bulk updates of a round: the pool ids of the new vertices, the faces and vertices it removes, where each
+	/// collapse's share of a list starts, and the slots freed and the items moved into them.
+	std::vector<uint32_t> mRoundVertexIds;
+	std::vector<Face *> mRoundFaces;
+	std::vector<Vertex *> mRoundVertices;
+	std::vector<size_t> mRoundStarts;
+	std::vector<uint32_t> mRoundHoles;
+	std::vector<Face *> mRoundMovedFaces;
+	std::vector<Vertex *> mRoundMovedVertices;
+	/// Marks the vertices in the neighborhood of a collapse picked for the current round, indexed by Vertex::mId.
+	std::vector<uint8_t> mVertexClaimed;
 
-	/// The pairs ordered by error
-	std::multimap<float,Pair> mPairs;
+	/// Every vertex owned by this mesh, indexed by Vertex::mId. This includes the vertices that are
+	/// only referenced by decimations.
+	ObjectPool<Vertex> mVertexPool;
 
-	// map from two vertices to iterator that points into mPairs
-	// this allows access and updating of mPairs, given the two verticies that make up the pair
-	std::unordered_map<std::pair<Vertex*, Vertex*>, std::multimap<float, Pair>::iterator> mEdgeToPair;
+	/// Every face owned by this mesh, indexed by Face::mId. Faces are never destroyed before the mesh is.
+	ObjectPool<Face> mFacePool;
+
+	/// Vertex to face and vertex to vertex adjacency, in terms of vertex and face indices.
+	MeshConnectivity mConnectivity;
+
+	/// The vertex quadrics, indexed by Vertex::mId
+	std::vector<Quadric> mQuadrics;
+
+	/// The plane quadric of each face, indexed by Face::mId
+	std::vector<Quadric> mFacePlanes;
+
+	/// The candidate pairs, one per edge of mConnectivity and keyed by edge id, ordered by error.
+	IndexedPriorityQueue mPairs;
+
+	/// The position each pair collapses to and its error, indexed by edge id.
+	std::vector<glm::vec3> mPairTargets;
+	std::vector<float> mPairCosts;
+
+	/// Edges whose pairs are waiting to be scored.
+	std::vector<uint32_t> mPendingPairs;
+
+	/// The progressive mesh this mesh plays back, if it was loaded from a .pm file. It may be shared with other meshes.
+	std::shared_ptr<const ProgMeshFile> mProgressive;
+	/// How many splits of mProgressive are applied. Unless mSelective, they are the first ones.
+	uint32_t mProgressiveLevel = 0;
+	bool mSelective = false;
+	/// The vertex and face made for each one of mProgressive, by file index. Only the base mesh is made up front,
+	/// the rest when a split first brings them in, so opening a file costs little more than its base mesh.
+	std::vector<Vertex *> mFileVertices;
+	std::vector<Face *> mFileFaces;
+	/// The file index of each vertex, indexed by Vertex::mId.
+	std::vector<uint32_t> mVertexFileIndex;
+	/// For AdaptRefinement, made the first time it is called: the dependencies between the splits, whether each
+	/// split is applied, and how many applied splits depend on it. A split can only be undone once that is zero.
+	std::shared_ptr<const VertexHierarchy> mHierarchy;
+	std::vector<uint8_t> mSplitApplied;
+	std::vector<uint32_t> mAppliedDependents;
+	/// Scratch stack for ForceSplit.
+	std::vector<uint32_t> mSplitStack;
+
+	/// Whether the buffers are in file order, see the constructor. mIndices then has a triangle for every face of the
+	/// file, which are the same as in the index buffer, and only the first mDrawFaces are drawn. Faces past those
+	/// keep whatever they last had, usually the corners they come back with.
+	bool mPrefixLayout = false;
+	uint32_t mDrawFaces = 0;
+	/// The file faces added, removed or rewired since the last GeneratePrefixIndices.
+	std::vector<uint32_t> mChangedFaces;
+	/// Which vertex buffer slots hold their vertex, so bringing it back needs no upload.
+	std::vector<uint8_t> mSlotUploaded;
     
     /// Tracks vertices that are currently being moved for geomorphing animation
     /// Stores the start and end positions of the vertices
@@ -104,8 +401,19 @@ private:
     /// Flag the signifies whether an operation (including animation) is in progress.
     std::atomic_bool mOpInProgress;
     
-    /// Holds a vertex pair whose collapse has been scheduled.
-    Pair * mScheduledCollapse = nullptr;
+    /// Holds a vertex pair whose collapse has been scheduled. v0 is null if nothing is scheduled.
+    Pair mScheduledCollapse;
+    /// Where v0 and v1 of the scheduled collapse were before the animation moved them. The collapse puts them back,
+    /// so Upscale restores them there.
+    glm::vec3 mScheduledStart0, mScheduledStart1;
+
+    /// The geomorph being played for MorphToLevel, and how far along it is.
+    std::unique_ptr<GeomorphBuilder> mGeomorphBuilder;
+    /// Reorders the buffers for OptimizeVertexCache, made the first time it runs.
+    std::unique_ptr<VertexCacheOptimizer> mCacheOptimizer;
+    Geomorph mGeomorph;
+    bool mMorphing = false;
+    double mMorphTime = 0.0;
     
 	glm::mat4 mModelMatrix;
 
@@ -117,6 +425,13 @@ private:
 	starforge::VertexBuffer * mVBO = nullptr;
 	starforge::IndexBuffer * mIBO = nullptr;
     starforge::VertexDescription * mVertexDescription = nullptr;
+	/// The buffers of the geomorph, made the first time one is played, big enough for any level.
+	starforge::VertexArray * mMorphVAO = nullptr;
+	starforge::VertexBuffer * mMorphVBO = nullptr;
+	starforge::IndexBuffer * mMorphIBO = nullptr;
+	starforge::VertexDescription * mMorphDescription = nullptr;
+	/// What UpdateBuffers writes the changes of a frame into, to be copied into mVBO and mIBO from there.
+	starforge::StreamBuffer * mStreamBuffer = nullptr;
 	friend class ProgModel;
 };
 
@@ -0,0 +1,360 @@
+#include "ProgMeshFile.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <cstring>
+
+static const char kMagic[4] = {'P', 'M', 'S', 'H'};
+static const char kStreamMagic[4] = {'P', 'M', 'S', 'T'};
+
+static bool IsLittleEndian() {
+    const uint16_t one = 1;
+    return *reinterpret_cast<const uint8_t *>(&one) == 1;
+}
+
+static uint64_t AlignUp(uint64_t offset) {
+    return (offset + ProgMeshFile::kAlignment - 1) / ProgMeshFile::kAlignment * ProgMeshFile::kAlignment;
+}
+
+/// Places the sections of a header one after another in the order of the file, from its counts.
+static void PlaceSections(PMHeader & header) {
+    header.vertexOffset = AlignUp(sizeof(PMHeader));
+    header.faceOffset = AlignUp(header.vertexOffset + (uint64_t)header.numVertices * sizeof(PMVertex));
+    header.splitOffset = AlignUp(header.faceOffset + 3 * (uint64_t)header.numFaces * sizeof(uint32_t));
+    header.faceRefOffset = AlignUp(header.splitOffset + (uint64_t)header.numSplits * sizeof(PMSplit));
+    header.levelOffset = AlignUp(header.faceRefOffset + (uint64_t)header.numFaceRefs * sizeof(uint32_t));
+    header.fileSize = AlignUp(header.levelOffset + ((uint64_t)header.numSplits + 1) * sizeof(PMLevel));
+}
+
+/// Lays a progressive mesh out exactly like the file, in 8 byte units so the sections are aligned. The gaps between
+/// sections stay zero.
+static void LayOut(uint32_t numBaseVertices, uint32_t numBaseFaces, const std::vector<PMVertex> & vertices,
+                   const std::vector<uint32_t> & faces, const std::vector<PMSplit> & splits,
+                   const std::vector<uint32_t> & faceRefs, std::vector<uint64_t> & storage) {
+    std::vector<PMLevel> levels(splits.size() + 1);
+    levels[0].numFaces = numBaseFaces;
+    for (size_t i = 0; i < splits.size(); i++) {
+        levels[i + 1].numFaces = levels[i].numFaces + splits[i].numNewFaces;
+    }
+    levels.back().maxError = 0.f;
+    for (size_t i = splits.size(); i-- > 0;) {
+        levels[i].maxError = std::max(levels[i + 1].maxError, splits[i].error);
+    }
+
+    PMHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = ProgMeshFile::kVersion;
+    header.numVertices = (uint32_t)vertices.size();
+    header.numFaces = (uint32_t)(faces.size() / 3);
+    header.numBaseVertices = numBaseVertices;
+    header.numBaseFaces = numBaseFaces;
+    header.numSplits = (uint32_t)splits.size();
+    header.numFaceRefs = (uint32_t)faceRefs.size();
+    PlaceSections(header);
+
+    storage.assign(header.fileSize / sizeof(uint64_t), 0);
+    char * buffer = reinterpret_cast<char *>(storage.data());
+    std::memcpy(buffer, &header, sizeof(header));
+    if (!vertices.empty()) std::memcpy(buffer + header.vertexOffset, vertices.data(), vertices.size() * sizeof(PMVertex));
+    if (!faces.empty()) std::memcpy(buffer + header.faceOffset, faces.data(), faces.size() * sizeof(uint32_t));
+    if (!splits.empty()) std::memcpy(buffer + header.splitOffset, splits.data(), splits.size() * sizeof(PMSplit));
+    if (!faceRefs.empty()) std::memcpy(buffer + header.faceRefOffset, faceRefs.data(), faceRefs.size() * sizeof(uint32_t));
+    std::memcpy(buffer + header.levelOffset, levels.data(), levels.size() * sizeof(PMLevel));
+}
+
+bool ProgMeshFile::Write(const std::string & path, uint32_t numBaseVertices, uint32_t numBaseFaces,
+                         const std::vector<PMVertex> & vertices, const std::vector<uint32_t> & faces,
+                         const std::vector<PMSplit> & splits, const std::vector<uint32_t> & faceRefs) {
+    if (!IsLittleEndian()) {
+        std::cerr << "ERROR: Progressive mesh files can only be written on little-endian machines" << std::endl;
+        return false;
+    }
+
+    // Lay the whole file out in memory and write it at once.
+    std::vector<uint64_t> buffer;
+    LayOut(numBaseVertices, numBaseFaces, vertices, faces, splits, faceRefs, buffer);
+
+    std::ofstream file(path, std::ios::binary);
+    if (!file.good()) {
+        std::cerr << "ERROR: Unable to open " << path << " for writing" << std::endl;
+        return false;
+    }
+    file.write(reinterpret_cast<const char *>(buffer.data()), buffer.size() * sizeof(uint64_t));
+    if (!file.good()) {
+        std::cerr << "ERROR: Failed writing " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool ProgMeshFile::Assign(uint32_t numBaseVertices, uint32_t numBaseFaces, const std::vector<PMVertex> & vertices,
+                          const std::vector<uint32_t> & faces, const std::vector<PMSplit> & splits,
+                          const std::vector<uint32_t> & faceRefs) {
+    Release();
+
+    LayOut(numBaseVertices, numBaseFaces, vertices, faces, splits, faceRefs, mStorage);
+    mHeader = reinterpret_cast<const PMHeader *>(mStorage.data());
+    if (!Validate(mStorage.size() * sizeof(uint64_t), true)) {
+        std::cerr << "ERROR: The progressive mesh is not numbered in file order" << std::endl;
+        Release();
+        return false;
+    }
+    mNumSplitsAvailable.store(mHeader->numSplits, std::memory_order_release);
+    return true;
+}
+
+ProgMeshFile::~ProgMeshFile() {
+    Release();
+}
+
+void ProgMeshFile::Release() {
+    mMapping.Unmap();
+    mStorage.clear();
+    mStorage.shrink_to_fit();
+    mHeader = nullptr;
+    mNumSplitsAvailable.store(0, std::memory_order_release);
+    mOnUseValidator.reset();
+}
+
+bool ProgMeshFile::WriteStream(const std::string & path) const {
+    if (Empty() || NumSplitsAvailable() != mHeader->numSplits) {
+        std::cerr << "ERROR: Only complete progressive meshes can be written as a stream" << std::endl;
+        return false;
+    }
+    std::ofstream file(path, std::ios::binary);
+    if (!file.good()) {
+        std::cerr << "ERROR: Unable to open " << path << " for writing" << std::endl;
+        return false;
+    }
+    auto write = [&](const void * data, size_t size) { file.write(reinterpret_cast<const char *>(data), size); };
+
+    PMHeader header = *mHeader;
+    std::memcpy(header.magic, kStreamMagic, sizeof(kStreamMagic));
+    write(&header, sizeof(header));
+    write(&Levels()[0], sizeof(PMLevel));
+    write(Vertices(), header.numBaseVertices * sizeof(PMVertex));
+    write(Faces(), 3 * (size_t)header.numBaseFaces * sizeof(uint32_t));
+    for (uint32_t i = 0; i < header.numSplits; i++) {
+        const PMSplit & split = Splits()[i];
+        write(&split, sizeof(PMSplit));
+        write(&Levels()[i + 1], sizeof(PMLevel));
+        write(&Vertices()[SplitV0(i)], 2 * sizeof(PMVertex));
+        write(&FaceRefs()[split.firstFaceRef], ((size_t)split.numV0Faces + split.numV1Faces) * sizeof(uint32_t));
+        write(&Faces()[3 * (size_t)split.firstNewFace], 3 * (size_t)split.numNewFaces * sizeof(uint32_t));
+    }
+    if (!file.good()) {
+        std::cerr << "ERROR: Failed writing " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool ProgMeshFile::Read(const std::string & path) {
+    Release();
+
+    if (!IsLittleEndian()) {
+        std::cerr << "ERROR: Progressive mesh files can only be read on little-endian machines" << std::endl;
+        return false;
+    }
+
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file.good()) {
+        std::cerr << "ERROR: File " << path << " does not exist." << std::endl;
+        return false;
+    }
+    size_t size = (size_t)file.tellg();
+    file.seekg(0);
+    mStorage.resize((size + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+    file.read(reinterpret_cast<char *>(mStorage.data()), size);
+    if (!file.good()) {
+        std::cerr << "ERROR: Failed reading " << path << std::endl;
+        Release();
+        return false;
+    }
+
+    mHeader = reinterpret_cast<const PMHeader *>(mStorage.data());
+    if (!Validate(size, true)) {
+        std::cerr << "ERROR: " << path << " is not a valid progressive mesh file" << std::endl;
+        Release();
+        return false;
+    }
+    mNumSplitsAvailable.store(mHeader->numSplits, std::memory_order_release);
+    return true;
+}
+
+bool ProgMeshFile::Map(const std::string & path, Checks checks) {
+    Release();
+
+    if (!IsLittleEndian()) {
+        std::cerr << "ERROR: Progressive mesh files can only be read on little-endian machines" << std::endl;
+        return false;
+    }
+
+    if (!mMapping.Map(path)) return false;
+    size_t size = mMapping.Size();
+    mHeader = reinterpret_cast<const PMHeader *>(mMapping.Data());
+    bool valid = Validate(size, checks == kEverything);
+    if (valid && checks == kSplitsOnUse) {
+        mOnUseValidator.reset(new SplitValidator());
+        valid = CheckBase(*mOnUseValidator, mNumFacesChecked);
+    }
+    if (!valid) {
+        std::cerr << "ERROR: " << path << " is not a valid progressive mesh file" << std::endl;
+        Release();
+        return false;
+    }
+    if (mOnUseValidator && mHeader->numSplits > 0) return true;
+    mOnUseValidator.reset();
+    mNumSplitsAvailable.store(mHeader->numSplits, std::memory_order_release);
+    return true;
+}
+
+uint32_t ProgMeshFile::CheckSplits(uint32_t numSplits) const {
+    if (!mOnUseValidator) return NumSplitsAvailable();
+    numSplits = std::min(numSplits, mHeader->numSplits);
+    for (uint32_t s = NumSplitsAvailable(); s < numSplits; s++) {
+        if (!CheckSplit(*mOnUseValidator, s, mNumFacesChecked)) {
+            std::cerr << "ERROR: Split " << s << " of the progressive mesh is invalid, only the ones before it are used"
+                      << std::endl;
+            mOnUseValidator.reset();
+            break;
+        }
+        mNumSplitsAvailable.store(s + 1, std::memory_order_release);
+    }
+    // Once every split is in, the validator has nothing left to check.
+    if (NumSplitsAvailable() == mHeader->numSplits) mOnUseValidator.reset();
+    return NumSplitsAvailable();
+}
+
+bool ProgMeshFile::Validate(size_t size, bool checkIndices) const {
+    if (size < sizeof(PMHeader)) return false;
+    const PMHeader & h = *mHeader;
+    if (std::memcmp(h.magic, kMagic, sizeof(kMagic)) != 0 || h.version != kVersion) return false;
+    if (h.fileSize != size) return false;
+
+    auto sectionFits = [&](uint64_t offset, uint64_t count, uint64_t elementSize) {
+        return offset % kAlignment == 0 && offset >= sizeof(PMHeader) && offset <= size
+               && count * elementSize <= size - offset;
+    };
+    if (!sectionFits(h.vertexOffset, h.numVertices, sizeof(PMVertex))
+        || !sectionFits(h.faceOffset, (uint64_t)h.numFaces * 3, sizeof(uint32_t))
+        || !sectionFits(h.splitOffset, h.numSplits, sizeof(PMSplit))
+        || !sectionFits(h.faceRefOffset, h.numFaceRefs, sizeof(uint32_t))
+        || !sectionFits(h.levelOffset, (uint64_t)h.numSplits + 1, sizeof(PMLevel))) {
+        return false;
+    }
+    if ((uint64_t)h.numBaseVertices + 2 * (uint64_t)h.numSplits != h.numVertices) return false;
+    if (h.numBaseFaces > h.numFaces) return false;
+    if (!checkIndices) return true;
+
+    // Walk through the splits in order, tracking how many faces exist at each point and what they are made of.
+    SplitValidator validator;
+    uint32_t numFaces;
+    if (!CheckBase(validator, numFaces)) return false;
+    for (uint32_t s = 0; s < h.numSplits; s++) {
+        if (!CheckSplit(validator, s, numFaces)) return false;
+    }
+    return true;
+}
+
+bool ProgMeshFile::CheckBase(SplitValidator & validator, uint32_t & numFaces) const {
+    const PMHeader & h = *mHeader;
+    if (!validator.Reset(h, Faces())) return false;
+    numFaces = h.numBaseFaces;
+    if (Levels()[0].numFaces != numFaces) return false;
+    return h.numSplits > 0 || numFaces == h.numFaces;
+}
+
+bool ProgMeshFile::CheckSplit(SplitValidator & validator, uint32_t s, uint32_t & numFaces) const {
+    const PMHeader & h = *mHeader;
+    const PMSplit & split = Splits()[s];
+    uint64_t lastRef = (uint64_t)split.firstFaceRef + split.numV0Faces + split.numV1Faces;
+    if (lastRef > h.numFaceRefs) return false;
+    if (split.firstNewFace != numFaces || (uint64_t)numFaces + split.numNewFaces > h.numFaces) return false;
+    if (!validator.Apply(split, FaceRefs() + split.firstFaceRef, Faces() + 3 * (size_t)split.firstNewFace)) return false;
+    numFaces += split.numNewFaces;
+
+    const PMLevel * levels = Levels();
+    if (levels[s + 1].numFaces != numFaces || !(levels[s + 1].maxError <= levels[s].maxError)) return false;
+    // The last split has to arrive at every face of the file.
+    return s + 1 < h.numSplits || numFaces == h.numFaces;
+}
+
+uint32_t ProgMeshFile::NumLevelsListed() const {
+    return (mOnUseValidator ? mHeader->numSplits : NumSplitsAvailable()) + 1;
+}
+
+bool ProgMeshFile::IsLaidOut(const PMHeader & header) {
+    PMHeader expected = header;
+    PlaceSections(expected);
+    return header.vertexOffset == expected.vertexOffset && header.faceOffset == expected.faceOffset
+           && header.splitOffset == expected.splitOffset && header.faceRefOffset == expected.faceRefOffset
+           && header.levelOffset == expected.levelOffset && header.fileSize == expected.fileSize;
+}
+
+bool SplitValidator::Reset(const PMHeader & header, const uint32_t * baseFaces) {
+    mNumVertices = header.numBaseVertices;
+    mInMesh.assign(header.numVertices, 0);
+    std::fill(mInMesh.begin(), mInMesh.begin() + mNumVertices, 1);
+    mNumCorners.assign(header.numVertices, 0);
+    mCorners.clear();
+    mCorners.reserve(3 * (size_t)header.numFaces);
+    mCorners.insert(mCorners.end(), baseFaces, baseFaces + 3 * (size_t)header.numBaseFaces);
+    for (uint32_t vertex : mCorners) {
+        if (vertex >= mNumVertices) return false;
+        mNumCorners[vertex]++;
+    }
+    return true;
+}
+
+bool SplitValidator::Apply(const PMSplit & split, const uint32_t * faceRefs, const uint32_t * newFaces) {
+    if (!InMesh(split.vertex) || (uint64_t)mNumVertices + 2 > mInMesh.size()) return false;
+    uint32_t v0 = mNumVertices;
+    uint32_t v1 = mNumVertices + 1;
+
+    // Each face ref has to find the split vertex in its face, which is then replaced. A face named twice has lost it
+    // by the second time, and with as many refs as the vertex has corners, none can be missing.
+    uint64_t numRefs = (uint64_t)split.numV0Faces + split.numV1Faces;
+    if (numRefs != mNumCorners[split.vertex]) return false;
+    size_t numFaces = mCorners.size() / 3;
+    for (uint32_t i = 0; i < numRefs; i++) {
+        if (faceRefs[i] >= numFaces) return false;
+        uint32_t * face = mCorners.data() + 3 * (size_t)faceRefs[i];
+        uint32_t * corner = std::find(face, face + 3, split.vertex);
+        if (corner == face + 3) return false;
+        *corner = i < split.numV0Faces ? v0 : v1;
+    }
+    mInMesh[split.vertex] = 0;
+    mNumCorners[split.vertex] = 0;
+    mInMesh[v0] = mInMesh[v1] = 1;
+    mNumCorners[v0] = split.numV0Faces;
+    mNumCorners[v1] = split.numV1Faces;
+    mNumVertices += 2;
+
+    for (size_t i = 0; i < 3 * (size_t)split.numNewFaces; i++) {
+        if (!InMesh(newFaces[i])) return false;
+        mNumCorners[newFaces[i]]++;
+        mCorners.push_back(newFaces[i]);
+    }
+    return true;
+}
+
+uint32_t ProgMeshFile::LevelForFaces(size_t maxFaces) const {
+    const PMLevel * first = Levels();
+    const PMLevel * last = first + NumLevelsListed();
+    // Face counts only grow from level to level.
+    const PMLevel * above = std::upper_bound(first, last, maxFaces,
+                                             [](size_t count, const PMLevel & level) { return count < level.numFaces; });
+    return above == first ? 0 : (uint32_t)(above - first - 1);
+}
+
+uint32_t ProgMeshFile::LevelForError(float maxError) const {
+    const PMLevel * first = Levels();
+    const PMLevel * last = first + NumLevelsListed();
+    // Errors only shrink from level to level, and the last level has none.
+    const PMLevel * level = std::partition_point(first, last,
+                                                 [maxError](const PMLevel & aLevel) { return aLevel.maxError > maxError; });
+    return (uint32_t)std::min(level - first, last - first - 1);
+}
@@ -0,0 +1,208 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <memory>
+#include "MappedFile.hpp"
+
+/**
+ * The .pm progressive mesh format: a base mesh followed by the vertex splits that refine it back to the original,
+ * coarsest first. Written by ProgMesh::SaveProgressive, played back by ProgMesh without rebuilding connectivity,
+ * quadrics or pairs.
+ *
+ * Vertices and faces are numbered in the order they appear: the base mesh comes first, then split i brings in
+ * vertices numBaseVertices + 2i and numBaseVertices + 2i + 1 (the two it splits into, v0 and v1) and the faces
+ * [firstNewFace, firstNewFace + numNewFaces). Faces are stored with the vertices they have when they appear.
+ *
+ * All values are little-endian and every section starts at a multiple of kAlignment, so the sections can be
+ * used in place.
+ *
+ * The same data can also be sent in stream order, see WriteStream and ProgMeshStream: a header identical to the file
+ * header except for its magic, then level 0, the base vertices and the base faces, then for each split its PMSplit,
+ * the PMLevel after it, the vertices v0 and v1, its face refs and the corners of its new faces.
+ */
+
+struct PMHeader {
+    char magic[4];
+    uint32_t version;
+    /// All vertices and faces, i.e. the counts of the fully refined mesh plus everything merged away on the way.
+    uint32_t numVertices;
+    uint32_t numFaces;
+    uint32_t numBaseVertices;
+    uint32_t numBaseFaces;
+    uint32_t numSplits;
+    uint32_t numFaceRefs;
+    uint64_t fileSize;
+    /// Byte offsets of the sections from the start of the file.
+    uint64_t vertexOffset;
+    uint64_t faceOffset;
+    uint64_t splitOffset;
+    uint64_t faceRefOffset;
+    uint64_t levelOffset;
+};
+
+struct PMVertex {
+    float position[3];
+    float normal[3];
+    float color[4];
+};
+
+/// Splits a vertex into v0 and v1, undoing one edge collapse.
+struct PMSplit {
+    /// The vertex that is split. It leaves the mesh.
+    uint32_t vertex;
+    /// The faces of vertex that move to v0, followed by the ones that move to v1, are listed in the face refs
+    /// starting here.
+    uint32_t firstFaceRef;
+    uint32_t numV0Faces;
+    uint32_t numV1Faces;
+    /// The faces that the collapse made degenerate, which the split brings back.
+    uint32_t firstNewFace;
+    uint32_t numNewFaces;
+    /// The error of the collapse this split undoes.
+    float error;
+};
+
+/// The mesh after a number of splits. There are numSplits + 1 levels, level 0 is the base mesh.
+struct PMLevel {
+    uint32_t numFaces;
+    /// The largest error of the collapses still in effect, i.e. of the splits at and after this level.
+    float maxError;
+};
+
+/**
+ * Follows the faces of a progressive mesh from its base through its splits, to check that playback can apply each
+ * split: its face refs name every face of the split vertex exactly once, and its new faces only use vertices in the
+ * mesh. A split that misses a face would leave it using the vertex the split removes.
+ */
+class SplitValidator {
+public:
+    /// Starts over at the base mesh, whose faces hold 3 * header.numBaseFaces vertex indices. Returns false if one
+    /// is out of range.
+    bool Reset(const PMHeader & header, const uint32_t * baseFaces);
+    /// Checks the next split against the mesh as the ones before left it, and applies it. faceRefs holds the split's
+    /// numV0Faces + numV1Faces face refs, newFaces the vertices of its numNewFaces new faces. The caller checks that
+    /// the new faces fit the header. Returns false if the split can't be applied.
+    bool Apply(const PMSplit & split, const uint32_t * faceRefs, const uint32_t * newFaces);
+    bool InMesh(uint32_t vertex) const { return vertex < mNumVertices && mInMesh[vertex]; }
+
+private:
+    uint32_t mNumVertices = 0;
+    std::vector<uint8_t> mInMesh;
+    /// The vertices of each face as the splits so far left them, and how many face corners each vertex is.
+    std::vector<uint32_t> mCorners;
+    std::vector<uint32_t> mNumCorners;
+};
+
+/**
+ * A .pm file, either read into memory or mapped. The accessors point into a single buffer laid out exactly like
+ * the file, so a mapped file is used in place: nothing is parsed or copied, and processes opening the same file
+ * share its pages.
+ */
+class ProgMeshFile {
+public:
+    static const uint32_t kVersion = 1;
+    static const size_t kAlignment = 16;
+
+    /// How much of a mapped file is checked. The header and the section bounds always are.
+    enum Checks {
+        /// Nothing more, for trusted files. Opens in constant time.
+        kSectionsOnly,
+        /// The base mesh when the file is mapped, then every split the first time it is asked for, see CheckSplits.
+        /// Opens in time proportional to the base mesh, and never touches the pages of splits that aren't used.
+        kSplitsOnUse,
+        /// Every index up front, which touches every page of the file.
+        kEverything
+    };
+
+    ProgMeshFile() = default;
+    ProgMeshFile(const ProgMeshFile &) = delete;
+    ProgMeshFile & operator=(const ProgMeshFile &) = delete;
+    ~ProgMeshFile();
+
+    /// Writes a progressive mesh. The vertices and faces must be numbered as described above, faces hold three
+    /// vertex indices each. The levels are derived from the splits. Returns false if the file can't be written.
+    static bool Write(const std::string & path, uint32_t numBaseVertices, uint32_t numBaseFaces,
+                      const std::vector<PMVertex> & vertices, const std::vector<uint32_t> & faces,
+                      const std::vector<PMSplit> & splits, const std::vector<uint32_t> & faceRefs);
+
+    /// Builds the file in memory instead of writing it, as if it had been read. Returns false, leaving the object
+    /// empty, if the result is not a valid .pm file.
+    bool Assign(uint32_t numBaseVertices, uint32_t numBaseFaces, const std::vector<PMVertex> & vertices,
+                const std::vector<uint32_t> & faces, const std::vector<PMSplit> & splits,
+                const std::vector<uint32_t> & faceRefs);
+
+    /// Writes the file in stream order. Returns false if the file is incomplete or can't be written.
+    bool WriteStream(const std::string & path) const;
+
+    /// Reads and validates a file. Returns false, leaving the object empty, if it is not a valid .pm file.
+    bool Read(const std::string & path);
+    /// Maps a file read-only instead of reading it, checking as much of it as asked for.
+    bool Map(const std::string & path, Checks checks = kEverything);
+    bool IsMapped() const { return mMapping.IsMapped(); }
+
+    bool Empty() const { return mHeader == nullptr; }
+    const PMHeader & Header() const { return *mHeader; }
+    const PMVertex * Vertices() const { return Section<PMVertex>(mHeader->vertexOffset); }
+    /// Three vertex indices per face.
+    const uint32_t * Faces() const { return Section<uint32_t>(mHeader->faceOffset); }
+    const PMSplit * Splits() const { return Section<PMSplit>(mHeader->splitOffset); }
+    const uint32_t * FaceRefs() const { return Section<uint32_t>(mHeader->faceRefOffset); }
+    const PMLevel * Levels() const { return Section<PMLevel>(mHeader->levelOffset); }
+
+    /// How many splits can be used. All of them, unless the file is still arriving through a ProgMeshStream or was
+    /// mapped with kSplitsOnUse. Everything a split refers to is in place once it is counted here.
+    uint32_t NumSplitsAvailable() const { return mNumSplitsAvailable.load(std::memory_order_acquire); }
+    /// For a file mapped with kSplitsOnUse, checks the splits up to numSplits that haven't been yet, and counts them
+    /// as available. The first one that fails stops the file there for good. Does nothing for other files. Returns
+    /// NumSplitsAvailable(). Not safe to call from several threads at once.
+    uint32_t CheckSplits(uint32_t numSplits) const;
+
+    /// The vertices a split brings in.
+    uint32_t SplitV0(uint32_t split) const { return mHeader->numBaseVertices + 2 * split; }
+    uint32_t SplitV1(uint32_t split) const { return mHeader->numBaseVertices + 2 * split + 1; }
+    /// The split that brings in a vertex past the base mesh.
+    uint32_t ParentSplit(uint32_t vertex) const { return (vertex - mHeader->numBaseVertices) / 2; }
+
+    /// The finest available level with at most maxFaces faces, or 0 if even the base mesh has more. O(log n).
+    /// For a file mapped with kSplitsOnUse, levels whose splits haven't been checked yet count as available.
+    uint32_t LevelForFaces(size_t maxFaces) const;
+    /// The coarsest level whose error is at most maxError, or the finest available one. O(log n).
+    uint32_t LevelForError(float maxError) const;
+
+private:
+    friend class ProgMeshStream;
+
+    /// Checks the header and the section bounds, then optionally that every index refers to something that exists
+    /// by the time it is used, so playback never has to.
+    bool Validate(size_t size, bool checkIndices) const;
+    /// Starts a validator at the base mesh, and checks the base level. numFaces is set to the faces of the base.
+    bool CheckBase(SplitValidator & validator, uint32_t & numFaces) const;
+    /// Checks split s, with its level, against the mesh the splits before it left and applies it to the validator.
+    /// numFaces follows the face count.
+    bool CheckSplit(SplitValidator & validator, uint32_t s, uint32_t & numFaces) const;
+    /// The number of levels LevelForFaces and LevelForError search.
+    uint32_t NumLevelsListed() const;
+    /// True if the section offsets and the size in a header are the ones Write lays out for its counts.
+    static bool IsLaidOut(const PMHeader & header);
+    /// Empties the object, unmapping the file if it is mapped.
+    void Release();
+
+    template <typename T>
+    const T * Section(uint64_t offset) const {
+        return reinterpret_cast<const T *>(reinterpret_cast<const uint8_t *>(mHeader) + offset);
+    }
+
+    /// Backing store for a file that was read or assigned, in 8 byte units so the sections are aligned.
+    std::vector<uint64_t> mStorage;
+    /// The mapping of a file that was mapped. Mappings start on a page boundary, so the sections are aligned too.
+    MappedFile mMapping;
+    const PMHeader * mHeader = nullptr;
+    /// Mutable for CheckSplits, which makes splits of a const file available as they are asked for.
+    mutable std::atomic<uint32_t> mNumSplitsAvailable{0};
+    /// With kSplitsOnUse, the mesh as the available splits leave it, until every split is checked or one fails.
+    mutable std::unique_ptr<SplitValidator> mOnUseValidator;
+    mutable uint32_t mNumFacesChecked = 0;
+};
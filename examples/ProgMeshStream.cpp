@@ -0,0 +1,188 @@
+#include "ProgMeshStream.hpp"
+
+#include <iostream>
+#include <cstring>
+#include <algorithm>
+#include <new>
+#include <stdexcept>
+
+static const char kStreamMagic[4] = {'P', 'M', 'S', 'T'};
+static const char kMagic[4] = {'P', 'M', 'S', 'H'};
+
+std::shared_ptr<const ProgMeshFile> ProgMeshStream::File() const {
+    // mFile is set before the base is marked ready and never changes after.
+    return mBaseReady.load(std::memory_order_acquire) ? mFile : nullptr;
+}
+
+bool ProgMeshStream::Feed(const void * data, size_t size) {
+    if (mStatus.load() == kFailed) return false;
+    if (mStatus.load() == kDone) return size == 0 || Fail();
+
+    const char * bytes = static_cast<const char *>(data);
+    // Units that arrive whole are handled straight from the chunk, the rest are put together in mPending first.
+    while (size > 0 || (mPending.empty() && mUnitSize == 0)) {
+        if (mPending.empty() && size >= mUnitSize) {
+            size_t unitSize = mUnitSize;
+            if (!ProcessUnit(bytes)) return false;
+            bytes += unitSize;
+            size -= unitSize;
+        } else {
+            size_t take = std::min(size, mUnitSize - mPending.size());
+            mPending.insert(mPending.end(), bytes, bytes + take);
+            bytes += take;
+            size -= take;
+            if (mPending.size() < mUnitSize) break;
+            bool valid = ProcessUnit(mPending.data());
+            mPending.clear();
+            if (!valid) return false;
+        }
+        if (mStatus.load() == kDone) return size == 0 || Fail();
+    }
+    return true;
+}
+
+bool ProgMeshStream::ReadFrom(std::istream & stream, size_t chunkSize) {
+    std::vector<char> chunk(std::max(chunkSize, (size_t)1));
+    while (!mCancelled.load() && mStatus.load() == kReading) {
+        // Wait for the next byte, then take whatever else has arrived with it. read() would wait for a whole chunk,
+        // holding back the base mesh and the splits on a slow source.
+        if (stream.peek() == std::istream::traits_type::eof()) break;
+        std::streamsize count = stream.readsome(chunk.data(), (std::streamsize)chunk.size());
+        // Streams that can't tell how much they hold are read a byte at a time.
+        if (count <= 0) {
+            chunk[0] = (char)stream.get();
+            count = 1;
+        }
+        if (!Feed(chunk.data(), (size_t)count)) break;
+    }
+    if (mStatus.load() == kReading && !mCancelled.load()) {
+        std::cerr << "ERROR: Progressive mesh stream ended early" << std::endl;
+        Fail();
+    }
+    return Done();
+}
+
+bool ProgMeshStream::Fail() {
+    mStatus.store(kFailed);
+    mPending.clear();
+    return false;
+}
+
+bool ProgMeshStream::ProcessUnit(const char * data) {
+    bool valid = false;
+    // A valid header can still ask for more memory than there is, which fails the stream like any other bad input.
+    try {
+        switch (mUnit) {
+            case kHeader: valid = ProcessHeader(data); break;
+            case kBase: valid = ProcessBase(data); break;
+            case kSplit: valid = ProcessSplit(data); break;
+            case kSplitLists: valid = ProcessSplitLists(data); break;
+        }
+    } catch (const std::bad_alloc &) {
+        std::cerr << "ERROR: Not enough memory for the progressive mesh stream" << std::endl;
+        return Fail();
+    } catch (const std::length_error &) {
+        std::cerr << "ERROR: Not enough memory for the progressive mesh stream" << std::endl;
+        return Fail();
+    }
+    if (!valid) {
+        std::cerr << "ERROR: Invalid progressive mesh stream" << std::endl;
+        return Fail();
+    }
+    return true;
+}
+
+bool ProgMeshStream::ProcessHeader(const char * data) {
+    std::memcpy(&mHeader, data, sizeof(PMHeader));
+    if (std::memcmp(mHeader.magic, kStreamMagic, sizeof(kStreamMagic)) != 0) return false;
+
+    // The file is laid out in memory as it would be on disk. Check that the header describes a valid layout before
+    // allocating it, without indices that is all the header is looked at for. The size comes from the sender, so
+    // it also has to be exactly what the counts take up, not just large enough for them.
+    std::memcpy(mHeader.magic, kMagic, sizeof(kMagic));
+    mFile = std::make_shared<ProgMeshFile>();
+    mFile->mHeader = &mHeader;
+    if (!mFile->Validate(mHeader.fileSize, false) || !ProgMeshFile::IsLaidOut(mHeader)) return false;
+    mFile->mStorage.resize((mHeader.fileSize + sizeof(uint64_t) - 1) / sizeof(uint64_t), 0);
+    std::memcpy(mFile->mStorage.data(), &mHeader, sizeof(PMHeader));
+    mFile->mHeader = reinterpret_cast<const PMHeader *>(mFile->mStorage.data());
+
+    mUnit = kBase;
+    mUnitSize = sizeof(PMLevel) + mHeader.numBaseVertices * sizeof(PMVertex) + 3 * (size_t)mHeader.numBaseFaces * sizeof(uint32_t);
+    return true;
+}
+
+bool ProgMeshStream::ProcessBase(const char * data) {
+    PMLevel level;
+    std::memcpy(&level, data, sizeof(PMLevel));
+    if (level.numFaces != mHeader.numBaseFaces) return false;
+    std::memcpy(Section<PMLevel>(mHeader.levelOffset), &level, sizeof(PMLevel));
+    data += sizeof(PMLevel);
+
+    std::memcpy(Section<PMVertex>(mHeader.vertexOffset), data, mHeader.numBaseVertices * sizeof(PMVertex));
+    data += mHeader.numBaseVertices * sizeof(PMVertex);
+
+    uint32_t * faces = Section<uint32_t>(mHeader.faceOffset);
+    std::memcpy(faces, data, 3 * (size_t)mHeader.numBaseFaces * sizeof(uint32_t));
+    if (!mValidator.Reset(mHeader, faces)) return false;
+
+    mNumVertices = mHeader.numBaseVertices;
+    mNumFaces = mHeader.numBaseFaces;
+    mBaseReady.store(true, std::memory_order_release);
+
+    if (mHeader.numSplits == 0) {
+        if (mNumFaces != mHeader.numFaces) return false;
+        mStatus.store(kDone);
+    }
+    mUnit = kSplit;
+    mUnitSize = sizeof(PMSplit) + sizeof(PMLevel) + 2 * sizeof(PMVertex);
+    return true;
+}
+
+bool ProgMeshStream::ProcessSplit(const char * data) {
+    PMLevel level;
+    std::memcpy(&mSplit, data, sizeof(PMSplit));
+    std::memcpy(&level, data + sizeof(PMSplit), sizeof(PMLevel));
+    const PMLevel & previous = Section<PMLevel>(mHeader.levelOffset)[mNumSplits];
+
+    // Everything is sent in order, so the lists of each split pick up where the previous ones ended.
+    const PMSplit & split = mSplit;
+    if (!mValidator.InMesh(split.vertex)) return false;
+    if (split.firstFaceRef != mNumFaceRefs
+        || (uint64_t)mNumFaceRefs + split.numV0Faces + split.numV1Faces > mHeader.numFaceRefs) return false;
+    if (split.firstNewFace != mNumFaces || (uint64_t)mNumFaces + split.numNewFaces > mHeader.numFaces) return false;
+    if (level.numFaces != mNumFaces + split.numNewFaces || !(level.maxError <= previous.maxError)) return false;
+
+    Section<PMSplit>(mHeader.splitOffset)[mNumSplits] = split;
+    Section<PMLevel>(mHeader.levelOffset)[mNumSplits + 1] = level;
+    std::memcpy(Section<PMVertex>(mHeader.vertexOffset) + mNumVertices, data + sizeof(PMSplit) + sizeof(PMLevel),
+                2 * sizeof(PMVertex));
+
+    mUnit = kSplitLists;
+    mUnitSize = ((size_t)split.numV0Faces + split.numV1Faces + 3 * (size_t)split.numNewFaces) * sizeof(uint32_t);
+    return true;
+}
+
+bool ProgMeshStream::ProcessSplitLists(const char * data) {
+    const PMSplit & split = mSplit;
+    uint32_t numRefs = split.numV0Faces + split.numV1Faces;
+    uint32_t * faceRefs = Section<uint32_t>(mHeader.faceRefOffset) + mNumFaceRefs;
+    std::memcpy(faceRefs, data, numRefs * sizeof(uint32_t));
+    uint32_t * corners = Section<uint32_t>(mHeader.faceOffset) + 3 * (size_t)mNumFaces;
+    std::memcpy(corners, data + numRefs * sizeof(uint32_t), 3 * (size_t)split.numNewFaces * sizeof(uint32_t));
+    if (!mValidator.Apply(split, faceRefs, corners)) return false;
+
+    mNumVertices += 2;
+    mNumFaces += split.numNewFaces;
+    mNumFaceRefs += numRefs;
+    mNumSplits++;
+    mFile->mNumSplitsAvailable.store(mNumSplits, std::memory_order_release);
+
+    if (mNumSplits == mHeader.numSplits) {
+        if (mNumFaces != mHeader.numFaces) return false;
+        mStatus.store(kDone);
+    }
+    mUnit = kSplit;
+    mUnitSize = sizeof(PMSplit) + sizeof(PMLevel) + 2 * sizeof(PMVertex);
+    return true;
+}
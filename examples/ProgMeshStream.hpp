@@ -0,0 +1,66 @@
+#pragma once
+#include <memory>
+#include <vector>
+#include <atomic>
+#include <istream>
+#include "ProgMeshFile.hpp"
+
+/**
+ * Reads a progressive mesh sent in stream order, as written by ProgMeshFile::WriteStream, and rebuilds the file in
+ * memory as it arrives. Data can come in chunks of any size. As soon as the base mesh is in, File() can be played
+ * back, and each split that comes in after it is made available right away.
+ *
+ * One thread feeds the stream, typically a reader thread, while others play the file back at the same time: a
+ * split only counts towards ProgMeshFile::NumSplitsAvailable once all of its data has been written.
+ */
+class ProgMeshStream {
+public:
+    /// Consumes the next chunk. Returns false once the stream turned out to be broken, later chunks are ignored.
+    bool Feed(const void * data, size_t size);
+    /// Feeds the stream from an istream until it ends, breaks or Cancel() is called. Each chunk is whatever has
+    /// arrived, up to chunkSize bytes. Blocks while waiting for data, so run it on a thread of its own. Returns true
+    /// if the whole mesh arrived.
+    bool ReadFrom(std::istream & stream, size_t chunkSize = 64 * 1024);
+    /// Makes ReadFrom return after the chunk it is waiting for.
+    void Cancel() { mCancelled.store(true); }
+
+    /// The file being filled in, null until its base mesh has arrived.
+    std::shared_ptr<const ProgMeshFile> File() const;
+    bool Done() const { return mStatus.load() == kDone; }
+    bool Failed() const { return mStatus.load() == kFailed; }
+
+private:
+    enum Status { kReading, kDone, kFailed };
+    /// The pieces of the stream, each handled once it has arrived completely.
+    enum Unit { kHeader, kBase, kSplit, kSplitLists };
+
+    /// Handles the current unit and moves on to the next one. Returns false if the data is invalid.
+    bool ProcessUnit(const char * data);
+    bool ProcessHeader(const char * data);
+    bool ProcessBase(const char * data);
+    bool ProcessSplit(const char * data);
+    bool ProcessSplitLists(const char * data);
+    bool Fail();
+
+    /// Where the file's sections live, writable while the stream fills them in.
+    template <typename T>
+    T * Section(uint64_t offset) { return reinterpret_cast<T *>(reinterpret_cast<char *>(mFile->mStorage.data()) + offset); }
+
+    /// Received bytes that don't make up a whole unit yet.
+    std::vector<char> mPending;
+    Unit mUnit = kHeader;
+    size_t mUnitSize = sizeof(PMHeader);
+
+    std::shared_ptr<ProgMeshFile> mFile;
+    PMHeader mHeader;
+    /// The split whose lists are expected next.
+    PMSplit mSplit;
+    uint32_t mNumSplits = 0;
+    /// What has arrived so far, to check the indices against like ProgMeshFile does.
+    uint32_t mNumVertices = 0, mNumFaces = 0, mNumFaceRefs = 0;
+    SplitValidator mValidator;
+
+    std::atomic<bool> mBaseReady{false};
+    std::atomic<bool> mCancelled{false};
+    std::atomic<int> mStatus{kReading};
+};
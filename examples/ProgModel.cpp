@@ -1,66 +1,124 @@
 #include "ProgModel.hpp"
+#include "OffReader.hpp"
+#include "PlyReader.hpp"
+#include "StlReader.hpp"
+#include "VertexWelder.hpp"
 
 #include <iostream>
 #include <fstream>
-#include <sstream>
 #include <string>
+#include <cctype>
+
+ProgMeshFile::Checks ProgModel::sProgressiveFileChecks = ProgMeshFile::kSplitsOnUse;
+bool ProgModel::sPrefixLayout = false;
+float ProgModel::sWeldEpsilon = 0.f;
 
 ProgModel::ProgModel(const std::string & path) {
 //     LoadProgModel(path);
-    LoadOFF(path);
+    auto hasExtension = [&path](const std::string & extension) {
+        if (path.size() < extension.size()) return false;
+        for (size_t i = 0; i < extension.size(); i++) {
+            if (std::tolower((unsigned char)path[path.size() - extension.size() + i]) != extension[i]) return false;
+        }
+        return true;
+    };
+    if (hasExtension(".pm")) {
+        LoadPM(path);
+    } else if (hasExtension(".pms")) {
+        StreamPM(path);
+    } else if (hasExtension(".ply")) {
+        LoadPLY(path);
+    } else if (hasExtension(".stl")) {
+        LoadSTL(path);
+    } else {
+        LoadOFF(path);
+    }
 }
 
-
-void ProgModel::LoadOFF(std::string const & path) {
-    std::ifstream file(path);
-    if(!file.good()) {
-        std::cerr << "ERROR: File " << path << " does not exist." << std::endl;  
+ProgModel::~ProgModel() {
+    // A reader may be stuck waiting on a pipe that never delivers, so don't wait for it. It owns what it uses.
+    for (MeshStream & aStream : mStreams) {
+        aStream.stream->Cancel();
+        aStream.reader.detach();
     }
+}
 
-    //Read first line to make sure it is OFF
-    std::string offLine;
-    std::getline(file, offLine);
-    if(offLine != "OFF") {
-        std::cerr << "ERROR: File is not and OFF file" << std::endl;
+void ProgModel::StreamPM(std::string const & path) {
+    MeshStream aStream;
+    aStream.stream = std::make_shared<ProgMeshStream>();
+    std::shared_ptr<ProgMeshStream> stream = aStream.stream;
+    aStream.reader = std::thread([stream, path]() {
+        std::ifstream file(path, std::ios::binary);
+        if (!file.good()) {
+            std::cerr << "ERROR: File " << path << " does not exist." << std::endl;
+        }
+        stream->ReadFrom(file);
+    });
+    mStreams.push_back(std::move(aStream));
+}
+
+void ProgModel::UpdateStreams(starforge::RenderDevice & renderDevice) {
+    for (MeshStream & aStream : mStreams) {
+        if (!aStream.mesh) {
+            std::shared_ptr<const ProgMeshFile> file = aStream.stream->File();
+            if (!file) continue;
+            aStream.mesh = std::make_shared<ProgMesh>(file, sPrefixLayout);
+            aStream.mesh->AllocateBuffers(renderDevice);
+            mMeshes.push_back(aStream.mesh);
+        }
+        // Only follow the stream when something arrived, so Upscale and Downscale still work in between.
+        uint32_t numSplits = aStream.mesh->GetProgressiveFile()->NumSplitsAvailable();
+        if (numSplits != aStream.numSplits) {
+            aStream.numSplits = numSplits;
+            if (aStream.mesh->SetProgressiveLevel(numSplits)) aStream.mesh->UpdateBuffers(renderDevice);
+        }
     }
+}
+
+void ProgModel::LoadPM(std::string const & path) {
+    auto file = std::make_shared<ProgMeshFile>();
+    if (!file->Map(path, sProgressiveFileChecks)) return;
+    mMeshes.push_back(std::make_shared<ProgMesh>(file, sPrefixLayout));
+}
 
-    // Read number of vertices and faces
-    std::string numVertsAndFaces;
-    std::getline(file, numVertsAndFaces);
-    std::stringstream numBuf(numVertsAndFaces);
-    size_t numVerts, numFaces;
-    numBuf >> numVerts >> numFaces;
 
+void ProgModel::LoadOFF(std::string const & path) {
+    OffReader reader;
     std::vector<Vertex> vertices;
-    for (int i = 0; i < numVerts; ++i) {
-        std::string vertLine;
-        std::getline(file, vertLine);
-        std::stringstream components(vertLine);
-        float x, y, z;
-        components >> x >> y >> z;
-        vertices.emplace_back(glm::vec4(x, y, z, 1.0f));
-    }  
-
-    std::vector<unsigned int> indices;
-    for (int i = 0; i < numFaces; ++i)
-    {
-        std::string indicesLine;
-        std::getline(file, indicesLine);
-        std::stringstream indicesBuf(indicesLine);
-        size_t num, i0, i1, i2;
-        indicesBuf >> num >> i0 >> i1 >> i2;
-        indices.push_back(i0); indices.push_back(i1); indices.push_back(i2);
-    }
+    std::vector<uint32_t> indices;
+    if (!reader.Read(path, vertices, indices)) return;
+    AddMesh(vertices, indices, true);
+}
 
-    ProgMeshRef mesh = std::make_shared<ProgMesh>(vertices, indices);
-    mMeshes.push_back(mesh);
+void ProgModel::LoadPLY(std::string const & path) {
+    PlyReader reader;
+    std::vector<Vertex> vertices;
+    std::vector<uint32_t> indices;
+    if (!reader.Read(path, vertices, indices)) return;
+    AddMesh(vertices, indices, !reader.HasNormals());
+}
 
-#pragma omp parallel for
-    for (size_t i = 0; i < mMeshes.size(); ++i) {
-        mMeshes.at(i)->BuildConnectivity();
-        mMeshes.at(i)->GenerateNormals();
-        mMeshes.at(i)->PreparePairsAndQuadrics();
+void ProgModel::LoadSTL(std::string const & path) {
+    StlReader reader;
+    std::vector<Vertex> vertices;
+    std::vector<uint32_t> indices;
+    if (!reader.Read(path, vertices, indices)) return;
+    AddMesh(vertices, indices, true);
+}
+
+void ProgModel::AddMesh(std::vector<Vertex> & vertices, std::vector<uint32_t> & indices, bool generateNormals) {
+    VertexWelder welder;
+    size_t numTriangles = indices.size() / 3;
+    size_t numWelded = welder.Weld(vertices, indices, sWeldEpsilon);
+    if (numWelded > 0) std::cout << "Welded away " << numWelded << " duplicate or unused vertices" << std::endl;
+    if (indices.size() / 3 < numTriangles) {
+        std::cout << "Left out " << numTriangles - indices.size() / 3 << " degenerate or duplicate triangles" << std::endl;
     }
+    ProgMeshRef mesh = std::make_shared<ProgMesh>(vertices, indices);
+    mesh->BuildConnectivity();
+    if (generateNormals) mesh->GenerateNormals();
+    mesh->PreparePairsAndQuadrics();
+    mMeshes.push_back(mesh);
 }
 
 void ProgModel::LoadProgModel(const std::string &path) {
@@ -158,7 +216,7 @@ void ProgModel::PrintInfo(std::ostream &ostream) {
     for (size_t i = 0; i < mMeshes.size(); ++i) {
         ostream << '\t';
         ostream << "Mesh " << i << " contains " << mMeshes.at(i)->mVertices.size()
-                << " vertices and " << mMeshes.at(i)->mFaces.size() << " faces." << std::endl;
+                << " vertices and " << mMeshes.at(i)->GetNumFaces() << " faces." << std::endl;
         mMeshes.at(i)->PrintConnectivity(ostream);
     }
 
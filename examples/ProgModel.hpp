@@ -4,8 +4,10 @@
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 #include <memory>
+#include <thread>
 
 #include "ProgMesh.hpp"
+#include "ProgMeshStream.hpp"
 #include <iostream>
 
 /**
@@ -16,20 +18,57 @@ class ProgModel
 {
 public:
 	ProgModel(std::string const &path);
+	~ProgModel();
 
 	void LoadProgModel(std::string const & path);
+	/// Reads an OFF file with OffReader, then prepares the mesh for simplification.
 	void LoadOFF(std::string const & path);
+	/// Reads a binary PLY file with PlyReader, keeping its normals if it has them.
+	void LoadPLY(std::string const & path);
+	/// Reads a binary STL file with StlReader.
+	void LoadSTL(std::string const & path);
+	/// Loads a progressive mesh written by ProgMesh::SaveProgressive. The file is mapped and used in place, nothing is
+	/// rebuilt and the mesh starts out at its base.
+	void LoadPM(std::string const & path);
+	/// Streams a progressive mesh written by ProgMeshFile::WriteStream, e.g. from a slow pipe, on a thread of its own.
+	/// The mesh is added by UpdateStreams once its base has arrived.
+	void StreamPM(std::string const & path);
+	/// Adds the streamed meshes whose base has arrived, and refines streamed meshes with the splits that arrived since
+	/// the last call, updating their buffers. Never waits for a stream, call it every frame.
+	void UpdateStreams(starforge::RenderDevice & renderDevice);
 	void PrintInfo(std::ostream & ostream);
 
+	/// How much of a file LoadPM checks, see ProgMeshFile::Checks. By default the base mesh when it is opened and
+	/// each split when it is first applied, so opening doesn't touch every page of a large file.
+	static ProgMeshFile::Checks sProgressiveFileChecks;
+	/// Whether LoadPM and StreamPM lay the buffers of their meshes out in file order, see ProgMesh.
+	static bool sPrefixLayout;
+	/// Imported meshes have their vertices closer than this merged by a VertexWelder before the ProgMesh is made.
+	/// 0 merges only vertices at bitwise equal positions.
+	static float sWeldEpsilon;
+
 	const std::vector<ProgMeshRef> & GetMeshes() const { return mMeshes; }
 	std::vector<ProgMeshRef> & GetMeshes() { return mMeshes; }
 private:
 
+	/// Makes a mesh of what a reader produced, once welded, and prepares it for simplification.
+	void AddMesh(std::vector<Vertex> & vertices, std::vector<uint32_t> & indices, bool generateNormals);
 	void ProcessNode(aiNode *node, const aiScene *scene);
 	ProgMeshRef ProcessMesh(aiMesh *mesh, const aiScene *scene);
 	
 	std::vector<ProgMeshRef> mMeshes;
 
+	/// A mesh being streamed in. The reader thread shares the stream, so it can be let go while still waiting for data.
+	struct MeshStream {
+		std::shared_ptr<ProgMeshStream> stream;
+		std::thread reader;
+		/// Null until the base mesh has arrived.
+		ProgMeshRef mesh;
+		/// The splits that had arrived at the last update.
+		uint32_t numSplits = 0;
+	};
+	std::vector<MeshStream> mStreams;
+
 	std::string mDirectory;	
 };
 typedef std::shared_ptr<ProgModel> ProgModelRef;
\ No newline at end of file
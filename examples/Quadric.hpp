@@ -0,0 +1,60 @@
+#pragma once
+#include <glm/glm.hpp>
+
+/// A Garland-Heckbert error quadric. The 4x4 matrix is symmetric, so only its upper triangle is stored:
+///
+///     | a2 ab ac ad |
+///     |    b2 bc bd |
+///     |       c2 cd |
+///     |          d2 |
+///
+/// The coefficients are doubles. Collapses keep adding planes to the quadrics of their neighbors and subtracting them
+/// again, which in float rounds the sums away from any sum of planes until they are no longer positive semidefinite.
+struct Quadric {
+    double a2 = 0.0, ab = 0.0, ac = 0.0, ad = 0.0;
+    double b2 = 0.0, bc = 0.0, bd = 0.0;
+    double c2 = 0.0, cd = 0.0;
+    double d2 = 0.0;
+
+    /// The quadric of the plane ax + by + cz + d = 0, i.e. the outer product of the plane with itself.
+    static Quadric FromPlane(const glm::vec4 & plane) {
+        Quadric q;
+        double a = plane.x, b = plane.y, c = plane.z, d = plane.w;
+        q.a2 = a * a; q.ab = a * b; q.ac = a * c; q.ad = a * d;
+        q.b2 = b * b; q.bc = b * c; q.bd = b * d;
+        q.c2 = c * c; q.cd = c * d;
+        q.d2 = d * d;
+        return q;
+    }
+
+    Quadric & operator+=(const Quadric & other) {
+        a2 += other.a2; ab += other.ab; ac += other.ac; ad += other.ad;
+        b2 += other.b2; bc += other.bc; bd += other.bd;
+        c2 += other.c2; cd += other.cd;
+        d2 += other.d2;
+        return *this;
+    }
+
+    Quadric & operator-=(const Quadric & other) {
+        a2 -= other.a2; ab -= other.ab; ac -= other.ac; ad -= other.ad;
+        b2 -= other.b2; bc -= other.bc; bd -= other.bd;
+        c2 -= other.c2; cd -= other.cd;
+        d2 -= other.d2;
+        return *this;
+    }
+
+    Quadric operator+(const Quadric & other) const {
+        Quadric sum(*this);
+        sum += other;
+        return sum;
+    }
+
+    /// The error v^T Q v of the point v (with w = 1).
+    double Evaluate(const glm::vec3 & v) const {
+        double x = v.x, y = v.y, z = v.z;
+        return x * (a2 * x + 2.0 * (ab * y + ac * z + ad))
+             + y * (b2 * y + 2.0 * (bc * z + bd))
+             + z * (c2 * z + 2.0 * cd)
+             + d2;
+    }
+};
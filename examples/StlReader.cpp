@@ -0,0 +1,64 @@
+#include "StlReader.hpp"
+#include "MappedFile.hpp"
+
+#include <iostream>
+#include <cstring>
+#include <algorithm>
+#include <cctype>
+
+static const size_t kHeaderSize = 80;
+static const size_t kTriangleSize = 50;
+
+static uint32_t LoadUint32(const uint8_t * p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static float LoadFloat(const uint8_t * p) {
+    uint32_t bits = LoadUint32(p);
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+bool StlReader::Read(const std::string & path, std::vector<Vertex> & vertices, std::vector<uint32_t> & indices) {
+    MappedFile file;
+    if (!file.Map(path)) return false;
+    return Parse(file.Data(), file.Size(), path, vertices, indices);
+}
+
+bool StlReader::Parse(const char * data, size_t size, const std::string & name, std::vector<Vertex> & vertices,
+                      std::vector<uint32_t> & indices) {
+    vertices.clear();
+    indices.clear();
+    const uint8_t * bytes = reinterpret_cast<const uint8_t *>(data);
+    // ASCII files start with "solid", but so do some binary ones. A binary file holds the triangles its count says
+    // it has, and its first triangles aren't text.
+    uint64_t numTriangles = size >= kHeaderSize + 4 ? LoadUint32(bytes + kHeaderSize) : 0;
+    if (size < kHeaderSize + 4 || (size - kHeaderSize - 4) / kTriangleSize < numTriangles) {
+        bool isText = size >= 5 && std::memcmp(data, "solid", 5) == 0;
+        for (size_t i = 0; isText && i < std::min<size_t>(size, 512); i++) {
+            isText = std::isprint(bytes[i]) || std::isspace(bytes[i]);
+        }
+        if (isText) {
+            std::cerr << "ERROR: " << name << ": ASCII STL files are not supported, only binary ones" << std::endl;
+        } else if (size < kHeaderSize + 4) {
+            std::cerr << "ERROR: " << name << ": The file ends inside the header" << std::endl;
+        } else {
+            std::cerr << "ERROR: " << name << ": The file ends before its " << numTriangles << " triangles" << std::endl;
+        }
+        return false;
+    }
+
+    // One vertex per corner, in order, skipping each triangle's normal.
+    const uint8_t * triangles = bytes + kHeaderSize + 4;
+    vertices.resize(3 * (size_t)numTriangles);
+    indices.resize(3 * (size_t)numTriangles);
+#pragma omp parallel for
+    for (long long i = 0; i < (long long)(3 * numTriangles); i++) {
+        const uint8_t * corner = triangles + (size_t)(i / 3) * kTriangleSize + (1 + i % 3) * 3 * sizeof(float);
+        vertices[i].mPos = glm::vec4(LoadFloat(corner), LoadFloat(corner + sizeof(float)),
+                                     LoadFloat(corner + 2 * sizeof(float)), 1.f);
+        indices[i] = (uint32_t)i;
+    }
+    return true;
+}
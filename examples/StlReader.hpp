@@ -0,0 +1,24 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "Geometry.hpp"
+
+/**
+ * Reads binary STL meshes: an 80 byte header, the triangle count, then 50 bytes per triangle holding its normal, its
+ * corners and an attribute, all little endian. The normals and attributes are skipped. STL stores every corner on its
+ * own, so each becomes a vertex of its own too, for a VertexWelder to merge. Anything after the triangles the count
+ * gives is ignored.
+ *
+ * The file is mapped and the triangles decoded in parallel.
+ */
+class StlReader {
+public:
+    /// Reads the file at path into vertices and three indices per triangle. Reports what is wrong with the file and
+    /// returns false if it can't be read.
+    bool Read(const std::string & path, std::vector<Vertex> & vertices, std::vector<uint32_t> & indices);
+    /// Read for a file already in memory. name is what error messages call it.
+    bool Parse(const char * data, size_t size, const std::string & name, std::vector<Vertex> & vertices,
+               std::vector<uint32_t> & indices);
+};
@@ -0,0 +1,174 @@
+#include "VertexCache.hpp"
+
+#include <algorithm>
+
+static const uint32_t npos = 0xFFFFFFFFu;
+
+void VertexCacheOptimizer::OrderTriangles(const uint32_t * indices, size_t numTriangles, size_t numVertices,
+                                          const glm::vec3 * positions, std::vector<uint32_t> & order) {
+    order.clear();
+    order.reserve(numTriangles);
+
+    // The triangles around each vertex, counted first, then filled in using mCacheTime as the cursor of each row.
+    mFirstTriangle.assign(numVertices + 1, 0);
+    for (size_t i = 0; i < 3 * numTriangles; i++) mFirstTriangle[indices[i] + 1]++;
+    for (size_t v = 0; v < numVertices; v++) mFirstTriangle[v + 1] += mFirstTriangle[v];
+    mTriangles.resize(3 * numTriangles);
+    mCacheTime.assign(mFirstTriangle.begin(), mFirstTriangle.end() - 1);
+    for (size_t i = 0; i < 3 * numTriangles; i++) mTriangles[mCacheTime[indices[i]]++] = (uint32_t)(i / 3);
+    mLive.resize(numVertices);
+    for (size_t v = 0; v < numVertices; v++) mLive[v] = mFirstTriangle[v + 1] - mFirstTriangle[v];
+
+    // A vertex is in the cache while fewer than kCacheSize vertices entered it after it. Time only counts entries.
+    mCacheTime.assign(numVertices, 0);
+    uint32_t time = kCacheSize + 1;
+    mEmitted.assign(numTriangles, 0);
+    mDeadEnds.clear();
+    uint32_t nextVertex = 0;
+    while (nextVertex < numVertices && mLive[nextVertex] == 0) nextVertex++;
+    uint32_t fanning = nextVertex < numVertices ? nextVertex : npos;
+
+    while (fanning != npos) {
+        // Emit every triangle left around the vertex.
+        mCandidates.clear();
+        for (uint32_t j = mFirstTriangle[fanning]; j < mFirstTriangle[fanning + 1]; j++) {
+            uint32_t triangle = mTriangles[j];
+            if (mEmitted[triangle]) continue;
+            mEmitted[triangle] = 1;
+            order.push_back(triangle);
+            for (int k = 0; k < 3; k++) {
+                uint32_t v = indices[3 * (size_t)triangle + k];
+                mDeadEnds.push_back(v);
+                mCandidates.push_back(v);
+                mLive[v]--;
+                if (time - mCacheTime[v] > kCacheSize) mCacheTime[v] = time++;
+            }
+        }
+
+        // Fan around the oldest candidate that is still cached after its own triangles went in, or around any with
+        // triangles left if none will be.
+        fanning = npos;
+        int bestPriority = -1;
+        for (uint32_t v : mCandidates) {
+            if (mLive[v] == 0) continue;
+            int priority = 0;
+            if (time - mCacheTime[v] + 2 * mLive[v] <= kCacheSize) priority = (int)(time - mCacheTime[v]);
+            if (priority > bestPriority) {
+                bestPriority = priority;
+                fanning = v;
+            }
+        }
+        if (fanning != npos) continue;
+
+        // A dead end: go back to the most recently used vertex with triangles left, else to the next one in order.
+        while (!mDeadEnds.empty() && fanning == npos) {
+            uint32_t v = mDeadEnds.back();
+            mDeadEnds.pop_back();
+            if (mLive[v] > 0) fanning = v;
+        }
+        if (fanning != npos) continue;
+        while (nextVertex < numVertices && mLive[nextVertex] == 0) nextVertex++;
+        if (nextVertex < numVertices) fanning = nextVertex;
+    }
+
+    if (positions) SortClusters(indices, positions, numVertices, order);
+}
+
+void VertexCacheOptimizer::SortClusters(const uint32_t * indices, const glm::vec3 * positions, size_t numVertices,
+                                        std::vector<uint32_t> & order) {
+    // A cluster starts wherever the cache has nothing of the triangle, so moving it costs at most a few misses
+    // at its start.
+    mCacheTime.assign(numVertices, 0);
+    uint32_t time = kCacheSize + 1;
+    mClusterStart.clear();
+    for (size_t i = 0; i < order.size(); i++) {
+        int misses = 0;
+        for (int k = 0; k < 3; k++) {
+            uint32_t v = indices[3 * (size_t)order[i] + k];
+            if (time - mCacheTime[v] <= kCacheSize) continue;
+            mCacheTime[v] = time++;
+            misses++;
+        }
+        if (misses == 3) mClusterStart.push_back((uint32_t)i);
+    }
+    if (mClusterStart.size() < 2) return;
+    mClusterStart.push_back((uint32_t)order.size());
+
+    // The area weighted centers of the mesh and of each cluster, and the average normal of each cluster.
+    auto triangleCross = [&](uint32_t triangle, glm::vec3 & center) {
+        const uint32_t * corners = indices + 3 * (size_t)triangle;
+        const glm::vec3 & p0 = positions[corners[0]];
+        const glm::vec3 & p1 = positions[corners[1]];
+        const glm::vec3 & p2 = positions[corners[2]];
+        center = (p0 + p1 + p2) / 3.f;
+        return glm::cross(p1 - p0, p2 - p0);
+    };
+    glm::vec3 meshCenter(0.f);
+    float meshArea = 0.f;
+    for (uint32_t triangle : order) {
+        glm::vec3 center;
+        float area = glm::length(triangleCross(triangle, center));
+        meshCenter += center * area;
+        meshArea += area;
+    }
+    if (meshArea > 0.f) meshCenter /= meshArea;
+
+    // Clusters that face away from the center are in front of the rest from most directions, draw them first.
+    size_t numClusters = mClusterStart.size() - 1;
+    mClusterKeys.resize(numClusters);
+    for (size_t c = 0; c < numClusters; c++) {
+        glm::vec3 clusterCenter(0.f), normal(0.f);
+        float clusterArea = 0.f;
+        for (uint32_t i = mClusterStart[c]; i < mClusterStart[c + 1]; i++) {
+            glm::vec3 center;
+            glm::vec3 cross = triangleCross(order[i], center);
+            float area = glm::length(cross);
+            clusterCenter += center * area;
+            clusterArea += area;
+            normal += cross;
+        }
+        float key = 0.f;
+        float normalLength = glm::length(normal);
+        if (clusterArea > 0.f && normalLength > 0.f) key = glm::dot(clusterCenter / clusterArea - meshCenter, normal / normalLength);
+        mClusterKeys[c] = std::make_pair(-key, (uint32_t)c);
+    }
+    std::stable_sort(mClusterKeys.begin(), mClusterKeys.end(),
+                     [](const std::pair<float, uint32_t> & a, const std::pair<float, uint32_t> & b) { return a.first < b.first; });
+
+    mSorted.clear();
+    for (const auto & clusterKey : mClusterKeys) {
+        uint32_t c = clusterKey.second;
+        mSorted.insert(mSorted.end(), order.begin() + mClusterStart[c], order.begin() + mClusterStart[c + 1]);
+    }
+    order.swap(mSorted);
+}
+
+void VertexCacheOptimizer::OrderVertices(const uint32_t * indices, size_t numIndices, size_t numVertices,
+                                         std::vector<uint32_t> & remap) {
+    remap.assign(numVertices, npos);
+    uint32_t next = 0;
+    for (size_t i = 0; i < numIndices; i++) {
+        if (remap[indices[i]] == npos) remap[indices[i]] = next++;
+    }
+    for (size_t v = 0; v < numVertices; v++) {
+        if (remap[v] == npos) remap[v] = next++;
+    }
+}
+
+VertexCacheStats VertexCacheOptimizer::Analyze(const uint32_t * indices, size_t numIndices, size_t numVertices,
+                                               uint32_t cacheSize) {
+    VertexCacheStats stats;
+    std::vector<uint32_t> cacheTime(numVertices, 0);
+    uint32_t time = cacheSize + 1;
+    size_t misses = 0, used = 0;
+    for (size_t i = 0; i < numIndices; i++) {
+        uint32_t v = indices[i];
+        if (time - cacheTime[v] <= cacheSize) continue;
+        if (cacheTime[v] == 0) used++;
+        cacheTime[v] = time++;
+        misses++;
+    }
+    if (numIndices >= 3) stats.acmr = (float)misses / (float)(numIndices / 3);
+    if (used > 0) stats.atvr = (float)misses / (float)used;
+    return stats;
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+/// How well an index buffer uses the post-transform vertex cache, measured against a FIFO cache. Both count the
+/// vertices the GPU has to transform: per triangle (ACMR, at best about 0.5 for a large closed mesh) and per vertex
+/// (ATVR, at best 1, when every vertex is transformed once).
+struct VertexCacheStats {
+    float acmr = 0.f;
+    float atvr = 0.f;
+};
+
+/**
+ * Reorders index buffers for the GPU: the triangles so the post-transform cache hits more often, then so clusters
+ * facing outwards are drawn first and hide what is behind them, and the vertices in the order the triangles use them,
+ * so fetching them reads memory front to back.
+ *
+ * The triangle order is Tipsify (Sander, Nehab and Barczak, Fast triangle reordering for vertex locality and reduced
+ * overdraw, 2007), which takes time linear in the size of the mesh. The clusters for overdraw are the runs Tipsify
+ * emits between two jumps to an unrelated part of the mesh, so reordering them costs the cache almost nothing.
+ * Keeps its scratch space from one mesh to the next.
+ */
+class VertexCacheOptimizer {
+public:
+    /// The cache size the triangles are ordered for and measured with, that of most GPUs or smaller.
+    static const uint32_t kCacheSize = 16;
+
+    /// Orders the triangles of an index buffer with three indices per triangle: order[i] is the triangle to draw i-th.
+    /// With positions, indexed like the vertices, the clusters are then sorted for overdraw.
+    void OrderTriangles(const uint32_t * indices, size_t numTriangles, size_t numVertices, const glm::vec3 * positions,
+                        std::vector<uint32_t> & order);
+
+    /// Numbers the vertices in the order the indices first refer to them: remap[v] is the new index of vertex v.
+    /// Vertices that are not referred to come last, in their old order.
+    static void OrderVertices(const uint32_t * indices, size_t numIndices, size_t numVertices, std::vector<uint32_t> & remap);
+
+    /// Simulates a FIFO cache of the given size on an index buffer.
+    static VertexCacheStats Analyze(const uint32_t * indices, size_t numIndices, size_t numVertices,
+                                    uint32_t cacheSize = kCacheSize);
+
+private:
+    /// Sorts the clusters of the triangles in order, i.e. runs starting with a triangle none of whose vertices are
+    /// cached, so that the ones facing most away from the center of the mesh come first.
+    void SortClusters(const uint32_t * indices, const glm::vec3 * positions, size_t numVertices, std::vector<uint32_t> & order);
+
+    /// The triangles around each vertex, in compressed rows.
+    std::vector<uint32_t> mFirstTriangle;
+    std::vector<uint32_t> mTriangles;
+    /// Per vertex: triangles around it not emitted yet, and when it last entered the cache.
+    std::vector<uint32_t> mLive;
+    std::vector<uint32_t> mCacheTime;
+    std::vector<uint8_t> mEmitted;
+    std::vector<uint32_t> mDeadEnds;
+    std::vector<uint32_t> mCandidates;
+    /// The clusters of the triangle order, as the position each one starts at, and their sort keys.
+    std::vector<uint32_t> mClusterStart;
+    std::vector<std::pair<float, uint32_t>> mClusterKeys;
+    std::vector<uint32_t> mSorted;
+};
@@ -0,0 +1,130 @@
+#include "VertexHierarchy.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+const uint32_t VertexHierarchy::npos;
+
+static const float kPi = 3.14159265358979f;
+
+/// The angle between two normals, or a half turn if either of them has no direction.
+static float NormalAngle(const glm::vec3 & a, const glm::vec3 & b) {
+    float lengths = glm::length(a) * glm::length(b);
+    if (!(lengths > 0.f)) return kPi;
+    return std::acos(glm::clamp(glm::dot(a, b) / lengths, -1.f, 1.f));
+}
+
+RefinementView RefinementView::FromCamera(const glm::mat4 & objectToWorld, const glm::mat4 & view,
+                                          const glm::mat4 & projection, float viewportHeight) {
+    RefinementView result;
+    glm::mat4 modelView = view * objectToWorld;
+    glm::mat4 mvp = projection * modelView;
+    // A point is inside the frustum if -w <= x, y, z <= w in clip space, one plane per inequality.
+    glm::vec4 row[4];
+    for (int i = 0; i < 4; i++) row[i] = glm::vec4(mvp[0][i], mvp[1][i], mvp[2][i], mvp[3][i]);
+    for (int i = 0; i < 3; i++) {
+        result.frustum[2 * i] = row[3] + row[i];
+        result.frustum[2 * i + 1] = row[3] - row[i];
+    }
+    for (glm::vec4 & plane : result.frustum) {
+        plane /= glm::length(glm::vec3(plane));
+    }
+    result.eye = glm::vec3(glm::inverse(modelView) * glm::vec4(0.f, 0.f, 0.f, 1.f));
+    result.pixelsPerUnit = projection[1][1] * viewportHeight * 0.5f;
+    return result;
+}
+
+VertexHierarchy::VertexHierarchy(const ProgMeshFile & file) {
+    const PMHeader & header = file.Header();
+    const PMVertex * vertices = file.Vertices();
+    const uint32_t * faces = file.Faces();
+    const PMSplit * splits = file.Splits();
+    const uint32_t * faceRefs = file.FaceRefs();
+    const PMLevel * levels = file.Levels();
+    mNumBaseVertices = header.numBaseVertices;
+
+    mSplitOf.assign(header.numVertices, npos);
+    for (uint32_t s = 0; s < header.numSplits; s++) {
+        mSplitOf[splits[s].vertex] = s;
+    }
+
+    // The split that brings in a face. Level s + 1 is the first one to have the faces of split s.
+    auto faceCreator = [&](uint32_t face) -> uint32_t {
+        if (face < header.numBaseFaces) return npos;
+        const PMLevel * level = std::upper_bound(levels, levels + header.numSplits + 1, face,
+                                                 [](uint32_t f, const PMLevel & l) { return f < l.numFaces; });
+        return (uint32_t)(level - levels) - 1;
+    };
+
+    mDependencyStarts.reserve(header.numSplits + 1);
+    mDependencyStarts.push_back(0);
+    std::vector<uint32_t> dependencies;
+    for (uint32_t s = 0; s < header.numSplits; s++) {
+        const PMSplit & split = splits[s];
+        dependencies.clear();
+        dependencies.push_back(ParentSplit(split.vertex));
+        for (uint32_t i = 0; i < split.numV0Faces + split.numV1Faces; i++) {
+            dependencies.push_back(faceCreator(faceRefs[split.firstFaceRef + i]));
+        }
+        for (size_t i = 0; i < 3 * (size_t)split.numNewFaces; i++) {
+            uint32_t corner = faces[3 * (size_t)split.firstNewFace + i];
+            if (corner != file.SplitV0(s) && corner != file.SplitV1(s)) dependencies.push_back(ParentSplit(corner));
+        }
+        std::sort(dependencies.begin(), dependencies.end());
+        // npos sorts last.
+        auto end = std::unique(dependencies.begin(), dependencies.end());
+        if (end != dependencies.begin() && *(end - 1) == npos) --end;
+        mDependencies.insert(mDependencies.end(), dependencies.begin(), end);
+        mDependencyStarts.push_back((uint32_t)mDependencies.size());
+    }
+
+    // Bounds grow from the leaves up. Both children of a split are split, if at all, by later splits.
+    mBounds.resize(header.numVertices);
+    std::vector<float> coneAngles(header.numVertices, 0.f);
+    for (uint32_t v = 0; v < header.numVertices; v++) {
+        const PMVertex & vertex = vertices[v];
+        Bounds & bounds = mBounds[v];
+        bounds.position = glm::vec3(vertex.position[0], vertex.position[1], vertex.position[2]);
+        bounds.normal = glm::vec3(vertex.normal[0], vertex.normal[1], vertex.normal[2]);
+        float length = glm::length(bounds.normal);
+        if (length > 0.f) bounds.normal /= length;
+        else coneAngles[v] = kPi;
+        bounds.radius = 0.f;
+        bounds.error = 0.f;
+    }
+    for (uint32_t s = header.numSplits; s-- > 0;) {
+        Bounds & parent = mBounds[splits[s].vertex];
+        float & coneAngle = coneAngles[splits[s].vertex];
+        parent.error = std::sqrt(std::max(splits[s].error, 0.f));
+        for (uint32_t child : {file.SplitV0(s), file.SplitV1(s)}) {
+            const Bounds & bounds = mBounds[child];
+            parent.radius = std::max(parent.radius, glm::length(bounds.position - parent.position) + bounds.radius);
+            coneAngle = std::max(coneAngle, NormalAngle(parent.normal, bounds.normal) + coneAngles[child]);
+            parent.error = std::max(parent.error, bounds.error);
+        }
+    }
+    for (uint32_t v = 0; v < header.numVertices; v++) {
+        float angle = coneAngles[v];
+        mBounds[v].coneSin2 = angle < 0.5f * kPi ? std::sin(angle) * std::sin(angle) : 1.f;
+    }
+}
+
+bool VertexHierarchy::ShouldRefine(uint32_t vertex, const RefinementView & view) const {
+    const Bounds & bounds = mBounds[vertex];
+    for (const glm::vec4 & plane : view.frustum) {
+        if (glm::dot(glm::vec3(plane), bounds.position) + plane.w < -bounds.radius) return false;
+    }
+
+    // Every normal in the cone faces away from the eye, or every one faces it.
+    glm::vec3 toVertex = bounds.position - view.eye;
+    float distance2 = glm::dot(toVertex, toVertex);
+    float facing = glm::dot(bounds.normal, toVertex);
+    bool outsideCone = facing * facing > distance2 * bounds.coneSin2;
+    if (facing > 0.f && outsideCone) return false;
+    bool silhouette = !(facing < 0.f && outsideCone);
+
+    float distance = std::sqrt(distance2) - bounds.radius;
+    if (distance <= 0.f) return bounds.error > 0.f;
+    float tolerance = silhouette ? view.silhouetteTolerance : view.pixelTolerance;
+    return bounds.error * view.pixelsPerUnit > tolerance * distance;
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <vector>
+#include <cstdint>
+#include <limits>
+#include "ProgMeshFile.hpp"
+
+/// The view ProgMesh::AdaptRefinement refines for, and how much error may show.
+struct RefinementView {
+    /// The planes of the view frustum in the mesh's own space, normalized and facing inwards.
+    glm::vec4 frustum[6];
+    /// The camera position in the mesh's own space.
+    glm::vec3 eye = glm::vec3(0.f);
+    /// How many pixels one unit of length covers at a distance of one unit.
+    float pixelsPerUnit = 1.f;
+    /// Regions are refined until their error projects to fewer pixels than this.
+    float pixelTolerance = 1.f;
+    /// The same for regions on the silhouette, where errors are the most visible.
+    float silhouetteTolerance = 0.5f;
+    /// At most this many splits are applied or undone per call, which spreads a big change of view over frames.
+    size_t maxChanges = std::numeric_limits<size_t>::max();
+
+    /// Sets up the view for a mesh drawn with the given object to world, view and (perspective) projection matrices.
+    static RefinementView FromCamera(const glm::mat4 & objectToWorld, const glm::mat4 & view,
+                                     const glm::mat4 & projection, float viewportHeight);
+};
+
+/**
+ * The vertex hierarchy of a progressive mesh, for selective refinement (Hoppe, View-dependent refinement of
+ * progressive meshes, 1997). Each split is a node whose vertex is the parent of v0 and v1.
+ *
+ * Splits can be applied in any order that respects their dependencies: a split needs the splits that brought in
+ * its vertex, the faces it moves and the other vertices of the faces it adds. Those always come earlier in the
+ * file, so any prefix of the splits is a valid set, and so is any set closed under dependencies.
+ *
+ * For the refinement criteria every vertex also gets a sphere around the region its descendants cover, a cone
+ * around their normals and an error that bounds the error of its descendants.
+ *
+ * Built from a complete file, and read-only afterwards, so meshes playing back the same file can share it.
+ */
+class VertexHierarchy {
+public:
+    static const uint32_t npos = 0xFFFFFFFFu;
+
+    explicit VertexHierarchy(const ProgMeshFile & file);
+
+    /// The split that splits a vertex, npos for vertices that are never split.
+    uint32_t SplitOf(uint32_t vertex) const { return mSplitOf[vertex]; }
+    /// The split that brings in a vertex, npos for base vertices.
+    uint32_t ParentSplit(uint32_t vertex) const {
+        return vertex < mNumBaseVertices ? npos : (vertex - mNumBaseVertices) / 2;
+    }
+
+    /// The splits a split depends on.
+    const uint32_t * DependenciesBegin(uint32_t split) const { return mDependencies.data() + mDependencyStarts[split]; }
+    const uint32_t * DependenciesEnd(uint32_t split) const { return mDependencies.data() + mDependencyStarts[split + 1]; }
+
+    /// Whether the region of a vertex should be more detailed than the vertex itself for this view: it is at least
+    /// partly inside the view frustum, not facing away from the eye, and its error projects to more pixels than
+    /// the tolerance.
+    bool ShouldRefine(uint32_t vertex, const RefinementView & view) const;
+
+private:
+    struct Bounds {
+        glm::vec3 position;
+        float radius;
+        glm::vec3 normal;
+        /// sin^2 of the half angle of the normal cone, 1 for cones of 90 degrees or more.
+        float coneSin2;
+        float error;
+    };
+
+    uint32_t mNumBaseVertices;
+    std::vector<uint32_t> mSplitOf;
+    std::vector<uint32_t> mDependencyStarts;
+    std::vector<uint32_t> mDependencies;
+    std::vector<Bounds> mBounds;
+};
@@ -0,0 +1,150 @@
+#include "VertexWelder.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+
+static const uint32_t npos = 0xFFFFFFFFu;
+
+static uint64_t Mix(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDull;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+static uint64_t HashCell(int64_t x, int64_t y, int64_t z) {
+    return Mix((uint64_t)x ^ Mix((uint64_t)y ^ Mix((uint64_t)z)));
+}
+
+/// The bits of a coordinate, with -0 taken as 0 so both merge.
+static int64_t CoordinateBits(float coordinate) {
+    if (coordinate == 0.f) coordinate = 0.f;
+    uint32_t bits;
+    std::memcpy(&bits, &coordinate, sizeof(bits));
+    return bits;
+}
+
+/// The grid cell a coordinate falls in.
+static int64_t CellCoordinate(float coordinate, float cellSize) {
+    double cell = std::floor((double)coordinate / cellSize);
+    // Far away and non-finite coordinates share the outermost cells, the distance test keeps them apart.
+    if (!(cell > -4e18)) return INT64_MIN / 2;
+    if (!(cell < 4e18)) return INT64_MAX / 2;
+    return (int64_t)cell;
+}
+
+size_t VertexWelder::Weld(std::vector<Vertex> & vertices, std::vector<uint32_t> & indices, float epsilon) {
+    size_t numVertices = vertices.size();
+    if (numVertices == 0) return 0;
+    bool exact = !(epsilon > 0.f);
+    float epsilonSquared = epsilon * epsilon;
+    // Cells twice the tolerance wide, so the tolerance around a vertex overlaps at most two of them along each axis.
+    float cellSize = 2.f * epsilon;
+    size_t tableSize = 1;
+    while (tableSize < numVertices) tableSize *= 2;
+    uint64_t mask = tableSize - 1;
+
+    // Bucket the vertices by cell.
+    mBucket.resize(numVertices);
+#pragma omp parallel for
+    for (long long v = 0; v < (long long)numVertices; v++) {
+        const glm::vec4 & p = vertices[v].mPos;
+        uint64_t hash = exact ? HashCell(CoordinateBits(p.x), CoordinateBits(p.y), CoordinateBits(p.z))
+                              : HashCell(CellCoordinate(p.x, cellSize), CellCoordinate(p.y, cellSize), CellCoordinate(p.z, cellSize));
+        mBucket[v] = (uint32_t)(hash & mask);
+    }
+    mBucketStart.assign(tableSize + 1, 0);
+    for (uint32_t bucket : mBucket) mBucketStart[bucket + 1]++;
+    for (size_t b = 0; b < tableSize; b++) mBucketStart[b + 1] += mBucketStart[b];
+    mCursor.assign(mBucketStart.begin(), mBucketStart.end() - 1);
+    mSorted.resize(numVertices);
+    for (size_t v = 0; v < numVertices; v++) mSorted[mCursor[mBucket[v]]++] = (uint32_t)v;
+
+    // Find the lowest numbered vertex close to each one. The buckets also hold vertices of other cells whose hash
+    // collides, the test against the position sorts them out.
+    mTarget.resize(numVertices);
+#pragma omp parallel for
+    for (long long v = 0; v < (long long)numVertices; v++) {
+        glm::vec3 p(vertices[v].mPos);
+        uint32_t target = (uint32_t)v;
+        auto searchBucket = [&](uint32_t bucket) {
+            for (uint32_t i = mBucketStart[bucket]; i < mBucketStart[bucket + 1]; i++) {
+                uint32_t u = mSorted[i];
+                if (u >= target) continue;
+                glm::vec3 q(vertices[u].mPos);
+                bool close = exact ? CoordinateBits(p.x) == CoordinateBits(q.x) && CoordinateBits(p.y) == CoordinateBits(q.y)
+                                     && CoordinateBits(p.z) == CoordinateBits(q.z)
+                                   : glm::dot(p - q, p - q) <= epsilonSquared;
+                if (close) target = u;
+            }
+        };
+        if (exact) {
+            searchBucket(mBucket[v]);
+        } else {
+            int64_t low[3], high[3];
+            for (int axis = 0; axis < 3; axis++) {
+                low[axis] = CellCoordinate(p[axis] - epsilon, cellSize);
+                high[axis] = std::min(CellCoordinate(p[axis] + epsilon, cellSize), low[axis] + 1);
+            }
+            for (int64_t x = low[0]; x <= high[0]; x++) {
+                for (int64_t y = low[1]; y <= high[1]; y++) {
+                    for (int64_t z = low[2]; z <= high[2]; z++) {
+                        searchBucket((uint32_t)(HashCell(x, y, z) & mask));
+                    }
+                }
+            }
+        }
+        mTarget[v] = target;
+    }
+    // Targets are lower numbered, so going up follows every chain to its end.
+    for (size_t v = 0; v < numVertices; v++) mTarget[v] = mTarget[mTarget[v]];
+
+    // Point the indices at the targets, leaving out the triangles that lost a corner, and the ones with the same
+    // corners as an earlier one in either winding. The kept ones are found again through a hash table of their
+    // sorted corners.
+#pragma omp parallel for
+    for (long long i = 0; i < (long long)indices.size(); i++) {
+        indices[i] = mTarget[indices[i]];
+    }
+    size_t triangleTableSize = 1;
+    while (triangleTableSize < indices.size() / 3 * 2) triangleTableSize *= 2;
+    uint64_t triangleMask = triangleTableSize - 1;
+    mTriangleTable.assign(triangleTableSize, npos);
+    mTriangleKeys.clear();
+    size_t numTriangles = 0;
+    for (size_t t = 0; t < indices.size() / 3; t++) {
+        const uint32_t * triangle = indices.data() + 3 * t;
+        if (triangle[0] == triangle[1] || triangle[1] == triangle[2] || triangle[2] == triangle[0]) continue;
+        std::array<uint32_t, 3> key = {triangle[0], triangle[1], triangle[2]};
+        std::sort(key.begin(), key.end());
+        uint64_t slot = HashCell(key[0], key[1], key[2]) & triangleMask;
+        while (mTriangleTable[slot] != npos && mTriangleKeys[mTriangleTable[slot]] != key) slot = (slot + 1) & triangleMask;
+        if (mTriangleTable[slot] != npos) continue;
+        mTriangleTable[slot] = (uint32_t)numTriangles;
+        mTriangleKeys.push_back(key);
+        if (numTriangles != t) std::memmove(indices.data() + 3 * numTriangles, triangle, 3 * sizeof(uint32_t));
+        numTriangles++;
+    }
+    indices.resize(3 * numTriangles);
+
+    // Number the vertices that are still used, in their old order, and move them there.
+    mNewId.assign(numVertices, npos);
+    for (uint32_t index : indices) mNewId[index] = 0;
+    uint32_t numKept = 0;
+    for (size_t v = 0; v < numVertices; v++) {
+        if (mNewId[v] == npos) continue;
+        mNewId[v] = numKept;
+        if (numKept != v) vertices[numKept] = vertices[v];
+        numKept++;
+    }
+    vertices.erase(vertices.begin() + numKept, vertices.end());
+#pragma omp parallel for
+    for (long long i = 0; i < (long long)indices.size(); i++) {
+        indices[i] = mNewId[indices[i]];
+    }
+    return numVertices - numKept;
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <array>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "Geometry.hpp"
+
+/**
+ * Merges coincident vertices of an indexed triangle mesh, so that triangles sharing a corner share its vertex, as
+ * BuildConnectivity assumes.
+ *
+ * The vertices are bucketed by the cell of a grid they fall in, twice as big as the tolerance, through a hash table.
+ * Each vertex then looks through the up to 8 cells within the tolerance of it for the lowest numbered vertex within
+ * the tolerance, which it is merged into. Chains of close vertices merge into their lowest numbered one, so clusters can grow past the
+ * tolerance. With no tolerance, vertices are only merged when their positions are bitwise equal, and only their own
+ * cell is searched. Takes time linear in the size of the mesh as long as the cells hold a few vertices each.
+ */
+class VertexWelder {
+public:
+    /// Merges the vertices closer than epsilon, or at bitwise equal positions if epsilon is 0, keeping the attributes
+    /// of the lowest numbered one. Then renumbers the indices, leaves out the triangles that lost a corner or have
+    /// the same corners as an earlier one, whichever way they wind, and removes the vertices no triangle uses,
+    /// keeping the order of the others. Returns how many vertices went.
+    size_t Weld(std::vector<Vertex> & vertices, std::vector<uint32_t> & indices, float epsilon);
+
+private:
+    /// The hash table bucket of each vertex, the vertices sorted by bucket and where each bucket starts.
+    std::vector<uint32_t> mBucket;
+    std::vector<uint32_t> mSorted;
+    std::vector<uint32_t> mBucketStart;
+    std::vector<uint32_t> mCursor;
+    /// The vertex each one is merged into, then the new number of each.
+    std::vector<uint32_t> mTarget;
+    std::vector<uint32_t> mNewId;
+    /// An open addressing hash table of the triangles kept so far, and the sorted corners of each.
+    std::vector<uint32_t> mTriangleTable;
+    std::vector<std::array<uint32_t, 3>> mTriangleKeys;
+};
@@ -4,10 +4,14 @@
 #include <string>
 #include <chrono>
 #include <ratio>
+#include <vector>
+#include <cstdlib>
+#include <cctype>
 
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/glm.hpp>
-#include <glad/glad.h>
+// Only for the key codes, the platform does the rest
+#define GLFW_INCLUDE_NONE
 #include <GLFW/glfw3.h>
 
 #include "ProgMesh.hpp"
@@ -16,30 +20,84 @@
 
 #include "Platform.hpp"
 #include "RenderDevice.hpp"
+#include "RecordingRenderDevice.hpp"
 
-static void keyboard_callback(GLFWwindow* window, int key, int scancode, int action, int mods);
+static void keyboard_callback(int key, int action, int mods);
+static bool ParseKey(const std::string & arg, int & frame, int & key, int & mods);
 ProgModelRef aModel;
+std::string modelPath;
 starforge::RenderDevice *renderDevice;
 unsigned int opCount = 200;
 
 bool downScale = true;
 bool continuous = false;
+bool viewDependent = false;
+
+// Headless runs advance by the same time every frame, so they come out the same every time
+static const long long kHeadlessFrameMicroseconds = 16667;
 
 int main(int argc, char *argv[]) {
     if(argc <= 1) {
         std::cerr << "ERROR: Please provide a model file as input" << std::endl;
+        std::cerr << "Usage: " << argv[0] << " MODEL [--prefix-layout] [--optimize-cache] [--pack-vertices] [--weld-epsilon E] [--headless FRAMES] [--key FRAME:KEY]..." << std::endl;
+        std::cerr << "  MODEL              an .off, binary .ply or binary .stl mesh, or a .pm or .pms progressive mesh" << std::endl;
+        std::cerr << "  --prefix-layout    keep the buffers of .pm and .pms meshes in file order, so changing levels moves no vertex" << std::endl;
+        std::cerr << "  --optimize-cache   reorder the buffers for the vertex cache and overdraw whenever a level is made" << std::endl;
+        std::cerr << "  --weld-epsilon E   merge the vertices of .off, .ply and .stl meshes closer than E, not just equal ones" << std::endl;
+        std::cerr << "  --pack-vertices    upload 16-byte quantized vertices, and 16-bit indices where they fit" << std::endl;
+        std::cerr << "  --headless FRAMES  run that many frames without a window or GPU and print what was sent to the device" << std::endl;
+        std::cerr << "  --key FRAME:KEY    press KEY (a character, upper case for shift, or \"space\") at the start of FRAME" << std::endl;
         return -1;
     }
 
-    platform::InitPlatform();
+    // Key presses are queued once the platform knows it is headless
+    bool headless = false;
+    int headlessFrames = 0;
+    std::vector<std::string> keyArgs;
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--headless" && i + 1 < argc) {
+            headless = true;
+            headlessFrames = std::atoi(argv[++i]);
+        } else if (arg == "--key" && i + 1 < argc) {
+            keyArgs.push_back(argv[++i]);
+        } else if (arg == "--prefix-layout") {
+            ProgModel::sPrefixLayout = true;
+        } else if (arg == "--optimize-cache") {
+            ProgMesh::sOptimizeVertexCache = true;
+        } else if (arg == "--weld-epsilon" && i + 1 < argc) {
+            ProgModel::sWeldEpsilon = (float)std::atof(argv[++i]);
+        } else if (arg == "--pack-vertices") {
+            ProgMesh::sPackVertices = true;
+        } else {
+            std::cerr << "ERROR: Unknown argument " << arg << std::endl;
+            return -1;
+        }
+    }
+
+    platform::InitPlatform(headless ? platform::PLATFORM_HEADLESS : platform::PLATFORM_GLFW);
+    if (headless) {
+        platform::SetHeadlessFrameLimit(headlessFrames);
+        for (const std::string & keyArg : keyArgs) {
+            int frame, key, mods;
+            if (!ParseKey(keyArg, frame, key, mods)) {
+                std::cerr << "ERROR: Can't read key " << keyArg << ", expected FRAME:KEY" << std::endl;
+                platform::TerminatePlatform();
+                return -1;
+            }
+            platform::QueueHeadlessKey(frame, key, mods);
+        }
+    }
     platform::PLATFORM_WINDOW_REF window = platform::CreatePlatformWindow(1024, 768, "Progressive Meshes");
     if (!window) {
         platform::TerminatePlatform();
         return -1;
     }
-    glfwSetKeyCallback((GLFWwindow *)window, keyboard_callback);
+    platform::SetPlatformKeyCallback(window, keyboard_callback);
 
-    renderDevice = starforge::CreateRenderDevice();
+    renderDevice = starforge::CreateRenderDevice(headless ? starforge::RENDERDEVICE_RECORDING : starforge::RENDERDEVICE_OPENGL);
+    starforge::RasterState * fillState = renderDevice->CreateRasterState(false, starforge::WINDING_CCW, starforge::FACE_BACK, starforge::RASTERMODE_FILL);
+    starforge::RasterState * lineState = renderDevice->CreateRasterState(false, starforge::WINDING_CCW, starforge::FACE_BACK, starforge::RASTERMODE_LINE);
 
     // Load the shaders and create the pipeline.
     std::ifstream vShaderFile("data/shaders/standard.vert");
@@ -72,8 +130,12 @@ int main(int argc, char *argv[]) {
     starforge::PipelineParam * uNormalMatParam = pipeline->GetParam("uNormalMatrix");
     starforge::PipelineParam * uComputeShadingParam = pipeline->GetParam("uComputeShading");
     starforge::PipelineParam * uUseUniformColorParam = pipeline->GetParam("uUseUniformColor");
+    starforge::PipelineParam * uMorphParam = pipeline->GetParam("uMorph");
+    starforge::PipelineParam * uDequantizeParam = pipeline->GetParam("uDequantize");
+    starforge::PipelineParam * uOctahedralNormalsParam = pipeline->GetParam("uOctahedralNormals");
     
-    aModel = std::make_shared<ProgModel>(std::string(argv[1]));
+    modelPath = argv[1];
+    aModel = std::make_shared<ProgModel>(modelPath);
     aModel->PrintInfo(std::cout);
     for(auto & aMesh: aModel->GetMeshes()) {
         aMesh->AllocateBuffers(*renderDevice);
@@ -87,18 +149,23 @@ int main(int argc, char *argv[]) {
     while(platform::PollPlatformWindow(window)) {
         auto now = std::chrono::steady_clock::now();
         auto delta = std::chrono::duration_cast<std::chrono::microseconds>( now - prevFrameTime );
-        auto delta_t = delta.count() * 10e-6f;
+        auto delta_t = (headless ? kHeadlessFrameMicroseconds : delta.count()) * 10e-6f;
         
         
         renderDevice->Clear(0.2f, 0.3f, 0.3f);
         renderDevice->SetPipeline(pipeline);
         glm::mat4 arcball, view, projection;
         platform::GetPlatformViewport(arcball, view, projection);
+        int viewportWidth, viewportHeight;
+        platform::GetPlatformFramebufferSize(window, viewportWidth, viewportHeight);
 
         uArcballParam->SetAsMat4(glm::value_ptr(arcball));
         uViewParam->SetAsMat4(glm::value_ptr(view));
         uProjectionParam->SetAsMat4(glm::value_ptr(projection));
 
+        // Show whatever part of a streamed model has arrived so far
+        aModel->UpdateStreams(*renderDevice);
+
         for(ProgMeshRef aMesh: aModel->GetMeshes()) {
             if(continuous) {
                 if (downScale) {
@@ -111,26 +178,59 @@ int main(int argc, char *argv[]) {
             aMesh->Animate(delta_t, *renderDevice);
             
             auto & modelMat = aMesh->GetModelMatrix();
+            if (viewDependent) {
+                RefinementView refinementView = RefinementView::FromCamera(modelMat * arcball, view, projection, (float)viewportHeight);
+                // Spread big changes of view over a few frames
+                refinementView.maxChanges = 2000;
+                if (aMesh->AdaptRefinement(refinementView)) aMesh->UpdateBuffers(*renderDevice);
+            }
             uModelParam->SetAsMat4(glm::value_ptr(modelMat));
+            uMorphParam->SetAsFloat(aMesh->GetMorphBlend());
+            glm::mat4 dequantize = aMesh->GetDequantizeMatrix();
+            uDequantizeParam->SetAsMat4(glm::value_ptr(dequantize));
+            uOctahedralNormalsParam->SetAsBool(aMesh->HasOctahedralNormals());
 
             glm::mat3 normMat = glm::mat3(glm::transpose(glm::inverse(modelMat * arcball)));
             uNormalMatParam->SetAsMat3(glm::value_ptr(normMat));
 
             uUseUniformColorParam->SetAsBool(false);
             uComputeShadingParam->SetAsBool(true);
-            glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+            renderDevice->SetRasterState(fillState);
             aMesh->Draw(*renderDevice);
 
             uUseUniformColorParam->SetAsBool(true);
             uComputeShadingParam->SetAsBool(false);
-            glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+            renderDevice->SetRasterState(lineState);
             aMesh->Draw(*renderDevice);
         }
 
+        // How much went to the GPU for this frame, key presses since the last one included
+        UploadStats frameUploads;
+        for (ProgMeshRef aMesh : aModel->GetMeshes()) {
+            UploadStats meshUploads = aMesh->TakeUploadStats();
+            frameUploads.bytes += meshUploads.bytes;
+            frameUploads.ranges += meshUploads.ranges;
+        }
+        if (ProgMesh::sPrintStatements && frameUploads.bytes > 0) {
+            std::cout << "Uploaded " << frameUploads.bytes << " bytes in " << frameUploads.ranges << " ranges" << std::endl;
+        }
+
         platform::PresentPlatformWindow(window);
         prevFrameTime = now;
     }
 
+    if (headless) {
+        const starforge::RecordingStats & stats = static_cast<starforge::RecordingRenderDevice *>(renderDevice)->GetStats();
+        std::cout << "Frames: " << stats.frames << std::endl;
+        std::cout << "Draws: " << stats.draws << " (" << stats.verticesDrawn << " vertices)" << std::endl;
+        std::cout << "Uploads: " << stats.uploads << " (" << stats.uploadBytes << " bytes, " << stats.fillBytes
+                  << " of them filling whole buffers)" << std::endl;
+        std::cout << "State changes: " << stats.stateChanges << ", parameter sets: " << stats.paramSets << std::endl;
+        std::cout << "Commands: " << stats.commands << ", invalid draws: " << stats.invalidDraws << std::endl;
+    }
+
+    renderDevice->DestroyRasterState(fillState);
+    renderDevice->DestroyRasterState(lineState);
     renderDevice->DestroyPipeline(pipeline);
     aModel.reset();
 
@@ -139,10 +239,34 @@ int main(int argc, char *argv[]) {
     return 0;
 }
 
-static void keyboard_callback(GLFWwindow* window, int key, int scancode, int action, int mods) {
+// Reads FRAME:KEY, where KEY is a character or "space". Letters are the keys they are on, upper case ones with shift.
+static bool ParseKey(const std::string & arg, int & frame, int & key, int & mods) {
+    size_t colon = arg.find(':');
+    if (colon == std::string::npos || colon == 0) return false;
+    frame = std::atoi(arg.substr(0, colon).c_str());
+    std::string name = arg.substr(colon + 1);
+    mods = 0;
+    if (name == "space") {
+        key = GLFW_KEY_SPACE;
+        return true;
+    }
+    if (name.size() != 1) return false;
+    // GLFW key codes of printable keys are their (upper case) characters
+    char c = name[0];
+    if (std::isupper((unsigned char)c)) mods = GLFW_MOD_SHIFT;
+    key = std::toupper((unsigned char)c);
+    return true;
+}
+
+static void keyboard_callback(int key, int action, int mods) {
 	// Perform stepCount number of edge collapses
 	if (key == GLFW_KEY_EQUAL && action == GLFW_PRESS) {
 		for (auto aMesh : aModel->GetMeshes()) {
+            // Progressive meshes morph through all the splits at once
+            if (aMesh->GetProgressiveFile()) {
+                if (aMesh->MorphToLevel(aMesh->GetProgressiveLevel() + opCount, *renderDevice)) std::cout << "Performed Upscale" << std::endl;
+                continue;
+            }
             bool performedOp = false;
             for (size_t i = 0; i < opCount; i++) {
                 performedOp = performedOp || aMesh->Upscale();
@@ -157,6 +281,11 @@ static void keyboard_callback(GLFWwindow* window, int key, int scancode, int act
 	// Restore stepCount number of edge collapses
 	if (key == GLFW_KEY_MINUS && action == GLFW_PRESS) {
 		for (auto aMesh : aModel->GetMeshes()) {
+            if (aMesh->GetProgressiveFile()) {
+                uint32_t level = aMesh->GetProgressiveLevel();
+                if (aMesh->MorphToLevel(level > opCount ? level - opCount : 0, *renderDevice)) std::cout << "Performed Downscale" << std::endl;
+                continue;
+            }
             bool performedOp = false;
             for (size_t i = 0; i < opCount; i++) {
                 bool temp = aMesh->Downscale();
@@ -168,10 +297,94 @@ static void keyboard_callback(GLFWwindow* window, int key, int scancode, int act
 
     }
 
+	// Halve the face count in one go, without animation
+	// Shift+H does the same with the parallel simplifier
+	if (key == GLFW_KEY_H && action == GLFW_PRESS) {
+		for (auto aMesh : aModel->GetMeshes()) {
+			SimplifyTarget target;
+			target.maxFaces = aMesh->GetNumFaces() / 2;
+			if (!(mods & GLFW_MOD_SHIFT)) {
+				SimplifyStats stats = aMesh->SimplifyTo(target);
+				aMesh->UpdateBuffers(*renderDevice);
+				std::cout << "Simplified to " << stats.facesAfter << " faces in " << stats.seconds << "s, total error "
+						  << stats.totalError << std::endl;
+				continue;
+			}
+			// The rounds pick pairs in a different order, so show what that costs: SimplifyTo on a copy, same target
+			SimplifyStats serial = aMesh->CopyCurrentMesh()->SimplifyTo(target);
+			SimplifyStats stats = aMesh->SimplifyToParallel(target);
+			aMesh->UpdateBuffers(*renderDevice);
+			std::cout << "Simplified to " << stats.facesAfter << " faces in " << stats.seconds << "s, total error "
+					  << stats.totalError << " (SimplifyTo: " << serial.facesAfter << " faces in " << serial.seconds
+					  << "s, total error " << serial.totalError << ")" << std::endl;
+		}
+	}
+
+	// Simplify all the way and write each mesh as a progressive mesh next to the model, which can be opened instead of it,
+	// both as a .pm file and as a .pms stream
+	if (key == GLFW_KEY_S && action == GLFW_PRESS) {
+		auto & meshes = aModel->GetMeshes();
+		for (size_t i = 0; i < meshes.size(); i++) {
+			std::string path = modelPath + (meshes.size() == 1 ? std::string() : "." + std::to_string(i)) + ".pm";
+			meshes[i]->SimplifyTo(SimplifyTarget());
+			meshes[i]->UpdateBuffers(*renderDevice);
+			if (!meshes[i]->SaveProgressive(path)) continue;
+			std::cout << "Wrote " << path << std::endl;
+			// Also in stream order, for loading progressively
+			ProgMeshFile file;
+			if (file.Map(path) && file.WriteStream(path + "s")) std::cout << "Wrote " << path << "s" << std::endl;
+		}
+	}
+
+	// Switch each mesh to buffers in progressive order at the level it is at. Meshes loaded from a model are simplified
+	// all the way first and played back from the result, like a .pm file opened with --prefix-layout.
+	if (key == GLFW_KEY_L && action == GLFW_PRESS) {
+		for (auto & aMesh : aModel->GetMeshes()) {
+			if (aMesh->UsesPrefixLayout()) continue;
+			std::shared_ptr<const ProgMeshFile> file;
+			uint32_t level;
+			if (aMesh->GetProgressiveFile()) {
+				// The layout needs every vertex and face of the file to be in place
+				file = aMesh->ShareProgressiveFile();
+				if (file->CheckSplits(file->Header().numSplits) != file->Header().numSplits) continue;
+				level = aMesh->GetProgressiveLevel();
+			} else {
+				size_t numFaces = aMesh->GetNumFaces();
+				aMesh->SimplifyTo(SimplifyTarget());
+				file = aMesh->MakeProgressiveFile();
+				if (!file) continue;
+				level = file->LevelForFaces(numFaces);
+			}
+			auto laidOut = std::make_shared<ProgMesh>(file, true);
+			laidOut->SetProgressiveLevel(level);
+			laidOut->GetModelMatrix() = aMesh->GetModelMatrix();
+			aMesh->ReleaseBuffers(*renderDevice);
+			laidOut->AllocateBuffers(*renderDevice);
+			aMesh = laidOut;
+			std::cout << "Prefix layout with " << aMesh->GetNumFaces() << " faces" << std::endl;
+		}
+	}
+
+	// Reorder each mesh for the vertex cache and overdraw now, and show how much the cache gains
+	if (key == GLFW_KEY_O && action == GLFW_PRESS) {
+		for (auto aMesh : aModel->GetMeshes()) {
+			VertexCacheStats before = aMesh->AnalyzeVertexCache();
+			VertexCacheStats after = aMesh->OptimizeVertexCache();
+			aMesh->UpdateBuffers(*renderDevice);
+			std::cout << "ACMR " << before.acmr << " -> " << after.acmr << ", ATVR " << before.atvr << " -> " << after.atvr << std::endl;
+		}
+	}
+
 	//toggle print statements
 	if (key == GLFW_KEY_P && action == GLFW_PRESS) {
 		ProgMesh::sPrintStatements = !ProgMesh::sPrintStatements;
 	}
+
+	//toggle pair validation against a full rebuild
+	if (key == GLFW_KEY_V && action == GLFW_PRESS) {
+		ProgMesh::sValidatePairs = !ProgMesh::sValidatePairs;
+		std::cout << "Pair validation toggle: " << ProgMesh::sValidatePairs << std::endl;
+	}
     
     if (key == GLFW_KEY_SPACE && action == GLFW_PRESS) {
         continuous = !continuous;
@@ -180,6 +393,11 @@ static void keyboard_callback(GLFWwindow* window, int key, int scancode, int act
     if (key == GLFW_KEY_D && action == GLFW_PRESS) {
         downScale = !downScale;
     }
+    //toggle view-dependent refinement of .pm meshes
+    if (key == GLFW_KEY_R && action == GLFW_PRESS) {
+        viewDependent = !viewDependent;
+        std::cout << "View-dependent refinement toggle: " << viewDependent << std::endl;
+    }
     
     if (key == GLFW_KEY_LEFT_BRACKET && action == GLFW_PRESS) {
         opCount = glm::clamp(int(opCount - 50), 1, 500);
@@ -0,0 +1,134 @@
+#pragma once
+#include <vector>
+#include <cstring>
+#include <algorithm>
+#include <iostream>
+#include "RenderDevice.hpp"
+
+namespace starforge
+{
+	/// The contents of a buffer kept in memory, as a reference for what the update, map and orphan calls of
+	/// RenderDevice do. Bytes the interface leaves undefined are set to undefinedByte, so code that relies on them
+	/// shows up. Misuse is reported and ignored.
+	class CPUBufferStorage
+	{
+	public:
+		static const unsigned char undefinedByte = 0xCD;
+
+		CPUBufferStorage(long long size, const void *data) :
+				bytes((size_t)size, undefinedByte)
+		{
+			if (data) std::memcpy(bytes.data(), data, (size_t)size);
+		}
+
+		long long Size() const { return (long long)bytes.size(); }
+		const unsigned char *Data() const { return bytes.data(); }
+		bool IsMapped() const { return mapped; }
+
+		bool Update(long long offset, long long size, const void *data)
+		{
+			if (!CheckRange("update", offset, size)) return false;
+			if (mapped)
+			{
+				std::cout << "ERROR::BUFFER::UPDATE_WHILE_MAPPED" << std::endl;
+				return false;
+			}
+			if (size > 0) std::memcpy(bytes.data() + offset, data, (size_t)size);
+			return true;
+		}
+
+		void *Map(long long offset, long long size, unsigned int access)
+		{
+			if (!CheckRange("map", offset, size)) return nullptr;
+			if (mapped)
+			{
+				std::cout << "ERROR::BUFFER::ALREADY_MAPPED" << std::endl;
+				return nullptr;
+			}
+			if (access & BUFFERMAP_INVALIDATE_BUFFER) Orphan();
+			else if (access & BUFFERMAP_INVALIDATE_RANGE) std::memset(bytes.data() + offset, undefinedByte, (size_t)size);
+			mapped = true;
+			return bytes.data() + offset;
+		}
+
+		bool Unmap()
+		{
+			if (!mapped)
+			{
+				std::cout << "ERROR::BUFFER::NOT_MAPPED" << std::endl;
+				return false;
+			}
+			mapped = false;
+			return true;
+		}
+
+		void Orphan()
+		{
+			std::fill(bytes.begin(), bytes.end(), undefinedByte);
+		}
+
+	private:
+		bool CheckRange(const char *what, long long offset, long long size) const
+		{
+			if (offset < 0 || size < 0 || offset + size > Size())
+			{
+				std::cout << "ERROR::BUFFER::" << what << " of " << size << " bytes at " << offset
+						  << " is outside a buffer of " << Size() << " bytes" << std::endl;
+				return false;
+			}
+			return true;
+		}
+
+		std::vector<unsigned char> bytes;
+		bool mapped = false;
+	};
+
+	class CPUVertexBuffer : public VertexBuffer
+	{
+	public:
+		CPUVertexBuffer(long long size, const void *data) : storage(size, data) {}
+
+		bool operator ==(const VertexBuffer & obj) const override
+		{
+			return this == &obj;
+		}
+
+		CPUBufferStorage storage;
+	};
+
+	class CPUIndexBuffer : public IndexBuffer
+	{
+	public:
+		CPUIndexBuffer(long long size, const void *data) : storage(size, data) {}
+
+		bool operator ==(const IndexBuffer & obj) const override
+		{
+			return this == &obj;
+		}
+
+		CPUBufferStorage storage;
+	};
+
+	/// A stream buffer in memory. Commands complete as they are issued, so its fences are always passed, and copies
+	/// out of it read the memory right away.
+	class CPUStreamBuffer : public StreamBuffer
+	{
+	public:
+		explicit CPUStreamBuffer(long long size) : StreamBuffer(size), bytes((size_t)size, (char)CPUBufferStorage::undefinedByte) {}
+
+		~CPUStreamBuffer() override
+		{
+			ReleaseFences();
+		}
+
+		const unsigned char *Data() const { return reinterpret_cast<const unsigned char *>(bytes.data()); }
+
+	protected:
+		char *Memory() override { return bytes.data(); }
+		void *InsertFence() override { return nullptr; }
+		bool WaitFence(void *) override { return false; }
+
+	private:
+		std::vector<char> bytes;
+	};
+}
@@ -68,20 +68,48 @@ namespace starforge
 		static size_t count;
 	};
 
+	/// Translates a combination of BufferMapAccess flags for glMapBufferRange.
+	inline GLbitfield ToOpenGLMapAccess(unsigned int access)
+	{
+		GLbitfield result = 0;
+		if (access & BUFFERMAP_READ) result |= GL_MAP_READ_BIT;
+		if (access & BUFFERMAP_WRITE) result |= GL_MAP_WRITE_BIT;
+		if (access & BUFFERMAP_INVALIDATE_RANGE) result |= GL_MAP_INVALIDATE_RANGE_BIT;
+		if (access & BUFFERMAP_INVALIDATE_BUFFER) result |= GL_MAP_INVALIDATE_BUFFER_BIT;
+		if (access & BUFFERMAP_UNSYNCHRONIZED) result |= GL_MAP_UNSYNCHRONIZED_BIT;
+		return result;
+	}
+
 	class OpenGLVertexBuffer : public VertexBuffer
 	{
 	public:
 
-		OpenGLVertexBuffer(long long size, const void *data)
+		OpenGLVertexBuffer(long long _size, const void *data) : size(_size)
 		{
 			glGenBuffers(1, &VBO);
 			glBindBuffer(GL_ARRAY_BUFFER, VBO);
 			glBufferData(GL_ARRAY_BUFFER, size, data, GL_DYNAMIC_DRAW); // always assuming dynamic, for now
 		}
         
-        void FillBuffer(long long size, const void * data) {
+        void FillBuffer(long long size, const void * data, long long offset = 0) {
+            glBindBuffer(GL_ARRAY_BUFFER, VBO);
+            glBufferSubData(GL_ARRAY_BUFFER, offset, size, data);
+        }
+
+        void *MapBuffer(long long offset, long long size, unsigned int access) {
             glBindBuffer(GL_ARRAY_BUFFER, VBO);
-            glBufferSubData(GL_ARRAY_BUFFER, 0, size, data);
+            return glMapBufferRange(GL_ARRAY_BUFFER, offset, size, ToOpenGLMapAccess(access));
+        }
+
+        bool UnmapBuffer() {
+            glBindBuffer(GL_ARRAY_BUFFER, VBO);
+            return glUnmapBuffer(GL_ARRAY_BUFFER) == GL_TRUE;
+        }
+
+        /// Same size and usage, new storage. The driver keeps the old one until the draws reading it are done.
+        void OrphanBuffer() {
+            glBindBuffer(GL_ARRAY_BUFFER, VBO);
+            glBufferData(GL_ARRAY_BUFFER, size, nullptr, GL_DYNAMIC_DRAW);
         }
 
 		~OpenGLVertexBuffer() override
@@ -96,6 +124,7 @@ namespace starforge
 
 
 		unsigned int VBO = 0;
+		long long size = 0;
 	};
 
 	class OpenGLVertexArray : public VertexArray
@@ -140,16 +169,31 @@ namespace starforge
 	{
 	public:
 
-		OpenGLIndexBuffer(long long size, const void *data)
+		OpenGLIndexBuffer(long long _size, const void *data) : size(_size)
 		{
 			glGenBuffers(1, &IBO);
 			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, IBO);
 			glBufferData(GL_ELEMENT_ARRAY_BUFFER, size, data, GL_DYNAMIC_DRAW); // always assuming static, for now
 		}
         
-        void FillBuffer(long long size, const void * data) {
+        void FillBuffer(long long size, const void * data, long long offset = 0) {
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, IBO);
+            glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, offset, size, data);
+        }
+
+        void *MapBuffer(long long offset, long long size, unsigned int access) {
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, IBO);
+            return glMapBufferRange(GL_ELEMENT_ARRAY_BUFFER, offset, size, ToOpenGLMapAccess(access));
+        }
+
+        bool UnmapBuffer() {
             glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, IBO);
-            glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, size, data);
+            return glUnmapBuffer(GL_ELEMENT_ARRAY_BUFFER) == GL_TRUE;
+        }
+
+        void OrphanBuffer() {
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, IBO);
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, size, nullptr, GL_DYNAMIC_DRAW);
         }
 
 		~OpenGLIndexBuffer() override
@@ -163,6 +207,83 @@ namespace starforge
 		}
 
 		unsigned int IBO = 0;
+		long long size = 0;
+	};
+
+	/// Mapped persistently where OpenGL 4.4 is available. Elsewhere (macOS stops at 4.1) the data stays in client
+	/// memory and copies out of it upload it from there, which needs no fences.
+	class OpenGLStreamBuffer : public StreamBuffer
+	{
+	public:
+
+		explicit OpenGLStreamBuffer(long long size) : StreamBuffer(size)
+		{
+			if (GLAD_GL_VERSION_4_4)
+			{
+				const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+				glGenBuffers(1, &buffer);
+				glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+				glBufferStorage(GL_COPY_READ_BUFFER, size, nullptr, flags);
+				mapped = static_cast<char *>(glMapBufferRange(GL_COPY_READ_BUFFER, 0, size, flags));
+			}
+			if (!mapped) clientMemory.resize((size_t)size);
+		}
+
+		~OpenGLStreamBuffer() override
+		{
+			ReleaseFences();
+			if (mapped)
+			{
+				glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+				glUnmapBuffer(GL_COPY_READ_BUFFER);
+			}
+			if (buffer) glDeleteBuffers(1, &buffer);
+		}
+
+		/// Copies part of the stream into a buffer bound to GL_COPY_WRITE_BUFFER.
+		void CopyTo(long long streamOffset, long long offset, long long size)
+		{
+			if (mapped)
+			{
+				glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+				glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, streamOffset, offset, size);
+			}
+			else
+			{
+				glBufferSubData(GL_COPY_WRITE_BUFFER, offset, size, clientMemory.data() + streamOffset);
+			}
+		}
+
+		unsigned int buffer = 0;
+
+	protected:
+		char *Memory() override { return mapped ? mapped : clientMemory.data(); }
+
+		void *InsertFence() override
+		{
+			return mapped ? glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0) : nullptr;
+		}
+
+		bool WaitFence(void *fence) override
+		{
+			if (!fence) return false;
+			GLsync sync = static_cast<GLsync>(fence);
+			GLenum result = glClientWaitSync(sync, 0, 0);
+			bool blocked = result == GL_TIMEOUT_EXPIRED;
+			// Flush the first time round, or the fence may never be reached.
+			GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+			while (result == GL_TIMEOUT_EXPIRED)
+			{
+				result = glClientWaitSync(sync, flags, 1000000000);
+				flags = 0;
+			}
+			glDeleteSync(sync);
+			return blocked;
+		}
+
+	private:
+		char *mapped = nullptr;
+		std::vector<char> clientMemory;
 	};
 
 
@@ -190,6 +311,14 @@ namespace starforge
         
         void FillVertexBuffer(VertexBuffer * vertexBuffer, long long size, const void * data) override;
 
+        void UpdateVertexBuffer(VertexBuffer * vertexBuffer, long long offset, long long size, const void * data) override;
+
+        void *MapVertexBuffer(VertexBuffer * vertexBuffer, long long offset, long long size, unsigned int access = BUFFERMAP_WRITE) override;
+
+        bool UnmapVertexBuffer(VertexBuffer * vertexBuffer) override;
+
+        void OrphanVertexBuffer(VertexBuffer * vertexBuffer) override;
+
 		void DestroyVertexBuffer(VertexBuffer *vertexBuffer) override;
 
 		VertexDescription *CreateVertexDescription(unsigned int numVertexElements, const VertexElement *vertexElements) override;
@@ -207,6 +336,22 @@ namespace starforge
 		void DestroyIndexBuffer(IndexBuffer *indexBuffer) override;
         
         void FillIndexBuffer(IndexBuffer * vertexBuffer, long long size, const void * data) override;
+
+        void UpdateIndexBuffer(IndexBuffer * indexBuffer, long long offset, long long size, const void * data) override;
+
+        void *MapIndexBuffer(IndexBuffer * indexBuffer, long long offset, long long size, unsigned int access = BUFFERMAP_WRITE) override;
+
+        bool UnmapIndexBuffer(IndexBuffer * indexBuffer) override;
+
+        void OrphanIndexBuffer(IndexBuffer * indexBuffer) override;
+
+        StreamBuffer *CreateStreamBuffer(long long size) override;
+
+        void DestroyStreamBuffer(StreamBuffer *streamBuffer) override;
+
+        void CopyStreamToVertexBuffer(StreamBuffer *streamBuffer, long long streamOffset, VertexBuffer * vertexBuffer, long long offset, long long size) override;
+
+        void CopyStreamToIndexBuffer(StreamBuffer *streamBuffer, long long streamOffset, IndexBuffer * indexBuffer, long long offset, long long size) override;
         
 		void SetIndexBuffer(IndexBuffer *indexBuffer) override;
 
@@ -260,6 +405,8 @@ namespace starforge
 
 		void DrawTrianglesIndexed32(long long offset, int count) override;
 
+		void DrawTrianglesIndexed16(long long offset, int count) override;
+
 		Pipeline * GetDefaultPipeline() override;
 
 		void BindDefaultPipeline() override;
@@ -281,6 +428,7 @@ namespace starforge
 		std::vector<OpenGLVertexArray *> m_VAOs;
 		std::vector<OpenGLVertexBuffer *> m_VBOs;
 		std::vector<OpenGLIndexBuffer *> m_IBOs;
+		std::vector<OpenGLStreamBuffer *> m_streamBuffers;
 		std::vector<OpenGLVertexDescription *> m_vDescriptions;
 		std::vector<OpenGLRasterState *> m_rasterStates;
 		std::vector<OpenGLDepthStencilState *> m_depthStates;
@@ -8,7 +8,22 @@ namespace platform
 {
 	typedef void *PLATFORM_WINDOW_REF;
 
-	void InitPlatform();
+	/// Called when a key is pressed, repeated or released. Keys, actions and modifiers use the GLFW codes.
+	typedef void (*PLATFORM_KEY_CALLBACK)(int key, int action, int mods);
+
+	/// The implementations of the platform functions
+	enum PlatformBackend
+	{
+		/// A GLFW window with an OpenGL context.
+		PLATFORM_GLFW = 0,
+
+		/// No window, display or context, for use with a RENDERDEVICE_RECORDING device. The viewport has the size the
+		/// window was asked for, the view never moves, and key presses come from QueueHeadlessKey.
+		PLATFORM_HEADLESS
+	};
+
+	/// Picks the backend for the rest of the platform functions. Call it first.
+	void InitPlatform(PlatformBackend backend = PLATFORM_GLFW);
 
 	PLATFORM_WINDOW_REF CreatePlatformWindow(int width, int height, const char *title);
 
@@ -16,7 +31,18 @@ namespace platform
 
 	void GetPlatformViewport(glm::mat4 &model, glm::mat4 &view, glm::mat4 &projection);
 
+	/// The size of the window's framebuffer in pixels, which can differ from the window size on high-DPI displays.
+	void GetPlatformFramebufferSize(PLATFORM_WINDOW_REF window, int &width, int &height);
+
+	void SetPlatformKeyCallback(PLATFORM_WINDOW_REF window, PLATFORM_KEY_CALLBACK callback);
+
 	void PresentPlatformWindow(PLATFORM_WINDOW_REF window);
 
 	void TerminatePlatform();
-}
\ No newline at end of file
+
+	/// Headless only: how many frames PollPlatformWindow lets through before it returns false. 0 for no limit.
+	void SetHeadlessFrameLimit(int frames);
+
+	/// Headless only: presses and releases a key as the given frame is polled, counting from 0.
+	void QueueHeadlessKey(int frame, int key, int mods = 0);
+}
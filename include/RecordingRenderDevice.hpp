@@ -0,0 +1,355 @@
+#pragma once
+#include <vector>
+#include <map>
+#include <string>
+#include "RenderDevice.hpp"
+#include "CPUBuffers.hpp"
+
+namespace starforge
+{
+	class RecordingRenderDevice;
+
+	/// A command a RecordingRenderDevice received.
+	struct RecordedCommand
+	{
+		/// The RenderDevice (or PipelineParam) function that was called, like "UpdateVertexBuffer".
+		const char *name;
+		/// Bytes the command writes into a buffer, texture or uniform, 0 for the rest.
+		long long bytes;
+		/// Vertices a draw reads, indexed or not, 0 for the rest.
+		long long count;
+	};
+
+	/// Totals over the commands a RecordingRenderDevice received.
+	struct RecordingStats
+	{
+		size_t commands = 0;
+		/// Clears, one per frame in the usual loop.
+		size_t frames = 0;
+		/// Commands that write into a buffer or texture, and the bytes they write: creating one with data, filling,
+		/// updating, writing through a map and copying from a stream buffer.
+		size_t uploads = 0;
+		long long uploadBytes = 0;
+		/// Of those, the bytes written by filling a buffer as a whole rather than updating part of it.
+		long long fillBytes = 0;
+		size_t draws = 0;
+		long long verticesDrawn = 0;
+		/// Pipeline, vertex array, index buffer, texture, raster and depth/stencil state changes.
+		size_t stateChanges = 0;
+		size_t paramSets = 0;
+		/// Draws with nothing to draw from or that would read past the end of a buffer. Each one is also reported.
+		size_t invalidDraws = 0;
+	};
+
+	class RecordingVertexShader : public VertexShader
+	{
+	public:
+		explicit RecordingVertexShader(const char *_code) : code(_code) {}
+		std::string code;
+	};
+
+	class RecordingPixelShader : public PixelShader
+	{
+	public:
+		explicit RecordingPixelShader(const char *_code) : code(_code) {}
+		std::string code;
+	};
+
+	/// A uniform of a recording pipeline. Keeps the bytes it was last set to.
+	class RecordingPipelineParam : public PipelineParam
+	{
+	public:
+		RecordingPipelineParam(RecordingRenderDevice *_device) : device(_device) {}
+
+		void SetAsBool(bool value) override { Set("SetAsBool", &value, sizeof(value)); }
+		void SetAsInt(int value) override { Set("SetAsInt", &value, sizeof(value)); }
+		void SetAsFloat(float value) override { Set("SetAsFloat", &value, sizeof(value)); }
+		void SetAsMat4(const float *value) override { Set("SetAsMat4", value, 16 * sizeof(float)); }
+		void SetAsMat3(const float *value) override { Set("SetAsMat3", value, 9 * sizeof(float)); }
+		void SetAsVec3(const float *value) override { Set("SetAsVec3", value, 3 * sizeof(float)); }
+		void SetAsVec4(const float *value) override { Set("SetAsVec4", value, 4 * sizeof(float)); }
+		void SetAsIntArray(int count, const int *values) override { Set("SetAsIntArray", values, count * sizeof(int)); }
+		void SetAsFloatArray(int count, const float *values) override { Set("SetAsFloatArray", values, count * sizeof(float)); }
+		void SetAsMat4Array(int count, const float *values) override { Set("SetAsMat4Array", values, count * 16 * sizeof(float)); }
+
+		std::vector<unsigned char> value;
+
+	private:
+		void Set(const char *name, const void *data, size_t size);
+
+		RecordingRenderDevice *device;
+	};
+
+	/// A pipeline that has every uniform asked for, since there is no shader compiler to say which ones exist.
+	class RecordingPipeline : public Pipeline
+	{
+	public:
+		RecordingPipeline(RecordingRenderDevice *_device, const RecordingVertexShader *vertexShader, const RecordingPixelShader *pixelShader) :
+				device(_device), vertexCode(vertexShader ? vertexShader->code : std::string()),
+				pixelCode(pixelShader ? pixelShader->code : std::string()) {}
+
+		~RecordingPipeline() override
+		{
+			for (auto &aParam: paramsByName) delete aParam.second;
+		}
+
+		bool operator==(const Pipeline &other) const override { return this == &other; }
+
+		PipelineParam *GetParam(const char *name) override
+		{
+			RecordingPipelineParam *&param = paramsByName[name];
+			if (!param) param = new RecordingPipelineParam(device);
+			return param;
+		}
+
+		RecordingRenderDevice *device;
+		std::string vertexCode, pixelCode;
+		std::map<std::string, RecordingPipelineParam *> paramsByName;
+	};
+
+	class RecordingVertexDescription : public VertexDescription
+	{
+	public:
+		RecordingVertexDescription(unsigned int numVertexElements, const VertexElement *vertexElements) :
+				elements(vertexElements, vertexElements + numVertexElements) {}
+
+		unsigned int NumElements() override { return (unsigned int)elements.size(); }
+		bool operator==(const VertexDescription &obj) const override { return this == &obj; }
+
+		std::vector<VertexElement> elements;
+	};
+
+	class RecordingVertexArray : public VertexArray
+	{
+	public:
+		RecordingVertexArray(unsigned int numVertexBuffers, VertexBuffer **vertexBuffers, VertexDescription **vertexDescriptions)
+		{
+			for (unsigned int i = 0; i < numVertexBuffers; i++)
+			{
+				buffers.push_back(dynamic_cast<CPUVertexBuffer *>(vertexBuffers[i]));
+				descriptions.push_back(dynamic_cast<RecordingVertexDescription *>(vertexDescriptions[i]));
+			}
+		}
+
+		bool operator==(const VertexArray &obj) const override { return this == &obj; }
+
+		std::vector<CPUVertexBuffer *> buffers;
+		std::vector<RecordingVertexDescription *> descriptions;
+	};
+
+	class RecordingTexture2D : public Texture2D
+	{
+	public:
+		RecordingTexture2D(int _width, int _height) : width(_width), height(_height) {}
+		int width, height;
+	};
+
+	class RecordingRasterState : public RasterState
+	{
+	public:
+		RecordingRasterState(bool _cullEnabled, Winding _frontFace, Face _cullFace, RasterMode _rasterMode) :
+				cullEnabled(_cullEnabled), frontFace(_frontFace), cullFace(_cullFace), rasterMode(_rasterMode) {}
+
+		bool operator==(const RasterState &obj) const override { return this == &obj; }
+
+		bool cullEnabled;
+		Winding frontFace;
+		Face cullFace;
+		RasterMode rasterMode;
+	};
+
+	class RecordingDepthStencilState : public DepthStencilState
+	{
+	public:
+		RecordingDepthStencilState(bool _depthEnabled, bool _depthWriteEnabled, Compare _depthCompare) :
+				depthEnabled(_depthEnabled), depthWriteEnabled(_depthWriteEnabled), depthCompare(_depthCompare) {}
+
+		bool operator==(const DepthStencilState &obj) const override { return this == &obj; }
+
+		bool depthEnabled;
+		bool depthWriteEnabled;
+		Compare depthCompare;
+	};
+
+	/**
+	 * A RenderDevice that needs no GPU: it keeps the contents of its buffers in memory and records every command it
+	 * receives, with the bytes it writes and the vertices it draws. Nothing is rasterized. Draws are checked against
+	 * the buffers bound to them instead, so reads past the end show up as errors.
+	 *
+	 * Everything it records depends only on the commands, which makes it suited to measuring upload volume and draw
+	 * counts on hosts without a display, and to comparing them from one run to the next.
+	 */
+	class RecordingRenderDevice : public RenderDevice
+	{
+	public:
+		RecordingRenderDevice();
+		~RecordingRenderDevice() override;
+
+		/// The commands received since the last ClearCommands, oldest first.
+		const std::vector<RecordedCommand> &GetCommands() const { return m_commands; }
+		void ClearCommands() { m_commands.clear(); }
+
+		/// Whether to keep the commands themselves, or only count them in the stats. On by default.
+		void SetKeepCommands(bool keep) { m_keepCommands = keep; }
+
+		const RecordingStats &GetStats() const { return m_stats; }
+		void ResetStats() { m_stats = RecordingStats(); }
+
+		/// Adds a command to the record. Called by the device and the objects it hands out.
+		void Record(const char *name, long long bytes = 0, long long count = 0);
+
+		/// The memory a buffer of this device keeps its contents in.
+		static const CPUBufferStorage &GetStorage(const VertexBuffer *vertexBuffer);
+		static const CPUBufferStorage &GetStorage(const IndexBuffer *indexBuffer);
+
+		VertexShader *CreateVertexShader(const char *code) override;
+
+		void DestroyVertexShader(VertexShader *vertexShader) override;
+
+		PixelShader *CreatePixelShader(const char *code) override;
+
+		void DestroyPixelShader(PixelShader *pixelShader) override;
+
+		Pipeline *CreatePipeline(VertexShader *vertexShader, PixelShader *pixelShader) override;
+
+		void DestroyPipeline(Pipeline *pipeline) override;
+
+		void SetPipeline(Pipeline *pipeline) override;
+
+		VertexBuffer *CreateVertexBuffer(long long size, const void *data = nullptr) override;
+
+		void DestroyVertexBuffer(VertexBuffer *vertexBuffer) override;
+
+		void FillVertexBuffer(VertexBuffer * vertexBuffer, long long size, const void * data) override;
+
+		void UpdateVertexBuffer(VertexBuffer * vertexBuffer, long long offset, long long size, const void * data) override;
+
+		void *MapVertexBuffer(VertexBuffer * vertexBuffer, long long offset, long long size, unsigned int access = BUFFERMAP_WRITE) override;
+
+		bool UnmapVertexBuffer(VertexBuffer * vertexBuffer) override;
+
+		void OrphanVertexBuffer(VertexBuffer * vertexBuffer) override;
+
+		VertexDescription *CreateVertexDescription(unsigned int numVertexElements, const VertexElement *vertexElements) override;
+
+		void DestroyVertexDescription(VertexDescription *vertexDescription) override;
+
+		VertexArray *CreateVertexArray(unsigned int numVertexBuffers, VertexBuffer **vertexBuffers, VertexDescription **vertexDescriptions) override;
+
+		void DestroyVertexArray(VertexArray *vertexArray) override;
+
+		void SetVertexArray(VertexArray *vertexArray) override;
+
+		IndexBuffer *CreateIndexBuffer(long long size, const void *data = nullptr) override;
+
+		void DestroyIndexBuffer(IndexBuffer *indexBuffer) override;
+
+		void FillIndexBuffer(IndexBuffer * indexBuffer, long long size, const void * data) override;
+
+		void UpdateIndexBuffer(IndexBuffer * indexBuffer, long long offset, long long size, const void * data) override;
+
+		void *MapIndexBuffer(IndexBuffer * indexBuffer, long long offset, long long size, unsigned int access = BUFFERMAP_WRITE) override;
+
+		bool UnmapIndexBuffer(IndexBuffer * indexBuffer) override;
+
+		void OrphanIndexBuffer(IndexBuffer * indexBuffer) override;
+
+		StreamBuffer *CreateStreamBuffer(long long size) override;
+
+		void DestroyStreamBuffer(StreamBuffer *streamBuffer) override;
+
+		void CopyStreamToVertexBuffer(StreamBuffer *streamBuffer, long long streamOffset, VertexBuffer * vertexBuffer, long long offset, long long size) override;
+
+		void CopyStreamToIndexBuffer(StreamBuffer *streamBuffer, long long streamOffset, IndexBuffer * indexBuffer, long long offset, long long size) override;
+
+		void SetIndexBuffer(IndexBuffer *indexBuffer) override;
+
+		Texture2D *CreateTexture2D(int width, int height, const void *data = nullptr) override;
+
+		void DestroyTexture2D(Texture2D *texture2D) override;
+
+		void SetTexture2D(unsigned int slot, Texture2D *texture2D) override;
+
+		RasterState *CreateRasterState(bool cullEnabled = false, Winding frontFace = WINDING_CCW, Face cullFace = FACE_BACK, RasterMode rasterMode = RASTERMODE_FILL) override;
+
+		void DestroyRasterState(RasterState *rasterState) override;
+
+		void SetRasterState(RasterState *rasterState) override;
+
+		DepthStencilState *CreateDepthStencilState(bool depthEnabled = true,
+												   bool depthWriteEnabled = true, float depthNear = 0, float depthFar = 1,
+												   Compare depthCompare = COMPARE_LESS, bool frontFaceStencilEnabled = false,
+												   Compare frontFaceStencilCompare = COMPARE_ALWAYS,
+												   StencilAction frontFaceStencilFail = STENCIL_KEEP,
+												   StencilAction frontFaceStencilPass = STENCIL_KEEP,
+												   StencilAction frontFaceDepthFail = STENCIL_KEEP,
+												   int frontFaceRef = 0, unsigned int frontFaceReadMask = 0xFFFFFFFF,
+												   unsigned int frontFaceWriteMask = 0xFFFFFFFF,
+												   bool backFaceStencilEnabled = false,
+												   Compare backFaceStencilCompare = COMPARE_ALWAYS,
+												   StencilAction backFaceStencilFail = STENCIL_KEEP,
+												   StencilAction backFaceStencilPass = STENCIL_KEEP,
+												   StencilAction backFaceDepthFail = STENCIL_KEEP,
+												   int backFaceRef = 0, unsigned int backFaceReadMask = 0xFFFFFFFF,
+												   unsigned int backFaceWriteMask = 0xFFFFFFFF) override;
+
+		void DestroyDepthStencilState(DepthStencilState *depthStencilState) override;
+
+		void SetDepthStencilState(DepthStencilState *depthStencilState) override;
+
+		void Clear(float red = 0.0f, float green = 0.0f, float blue = 0.0f, float alpha = 1.0f, float depth = 1.0f, int stencil = 0) override;
+
+		void DrawTriangles(int offset, int count) override;
+
+		void DrawPoints(long long offset, int count) override;
+
+		void DrawLineStrip(long long offset, int count) override;
+
+		void DrawTrianglesIndexed32(long long offset, int count) override;
+
+		void DrawTrianglesIndexed16(long long offset, int count) override;
+
+		Pipeline * GetDefaultPipeline() override;
+
+		void BindDefaultPipeline() override;
+
+		void SetPointSize(float pSize) override;
+
+		void DrawModel(Model & aModel, glm::mat4 & arcball, glm::mat4 & view, glm::mat4 & projection) override;
+
+	private:
+		friend class RecordingPipelineParam;
+
+		/// Records a draw that reads vertices first to first + count - 1, or the indices of the bound index buffer at
+		/// indexOffset if it is not negative, indexSize bytes each, after checking they are all there.
+		void Draw(const char *name, long long first, long long count, long long indexOffset = -1, int indexSize = sizeof(uint32_t));
+		/// Records a write of size bytes into a buffer, if it took place.
+		void RecordUpload(const char *name, long long size, bool written);
+
+		std::vector<RecordedCommand> m_commands;
+		RecordingStats m_stats;
+		bool m_keepCommands = true;
+
+		RecordingPipeline *m_pipeline = nullptr;
+		RecordingVertexArray *m_vertexArray = nullptr;
+		CPUIndexBuffer *m_indexBuffer = nullptr;
+		RecordingRasterState *m_rasterState = nullptr;
+		RecordingRasterState *m_defaultRasterState = nullptr;
+		RecordingDepthStencilState *m_depthStencilState = nullptr;
+		RecordingDepthStencilState *m_defaultDepthStencilState = nullptr;
+		RecordingPipeline *m_defaultPipeline = nullptr;
+		/// The access each buffer is mapped with, to count what is written through the map once it is unmapped.
+		std::map<const CPUBufferStorage *, std::pair<long long, unsigned int>> m_mappings;
+
+		// Tracks everything that has been created, to clean up what is left over.
+		std::vector<RecordingVertexArray *> m_VAOs;
+		std::vector<CPUVertexBuffer *> m_VBOs;
+		std::vector<CPUIndexBuffer *> m_IBOs;
+		std::vector<CPUStreamBuffer *> m_streamBuffers;
+		std::vector<RecordingVertexDescription *> m_vDescriptions;
+		std::vector<RecordingRasterState *> m_rasterStates;
+		std::vector<RecordingDepthStencilState *> m_depthStates;
+		std::vector<RecordingPipeline *> m_pipelines;
+		std::vector<RecordingTexture2D *> m_textures;
+	};
+}
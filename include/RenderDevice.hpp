@@ -1,5 +1,6 @@
 #pragma once
 #include <string>
+#include <deque>
 #include <glm/matrix.hpp>
 
 namespace starforge {
@@ -117,6 +118,81 @@ protected:
     IndexBuffer() {}
 };
 
+/// How a mapped range of a buffer is used, any combination of these
+enum BufferMapAccess
+{
+    BUFFERMAP_READ = 1,
+    BUFFERMAP_WRITE = 2,
+
+    /// The previous contents of the range are not needed, so the driver doesn't have to keep or wait for them.
+    BUFFERMAP_INVALIDATE_RANGE = 4,
+
+    /// The same for the whole buffer.
+    BUFFERMAP_INVALIDATE_BUFFER = 8,
+
+    /// Don't wait for draws still reading the buffer. The caller makes sure it doesn't write anything they read.
+    BUFFERMAP_UNSYNCHRONIZED = 16
+};
+
+/**
+ * A buffer for data that is written once and used soon after, like the changes of a frame. It stays mapped and is
+ * handed out front to back as a ring: Allocate returns memory the GPU is done with, waiting for it only when the
+ * ring is full. Call EndFrame once the commands using this frame's allocations are issued, then the memory comes
+ * back once they complete. Copy the data where it is needed with RenderDevice::CopyStreamTo*Buffer.
+ */
+class StreamBuffer
+{
+public:
+    virtual ~StreamBuffer() {}
+    StreamBuffer(const StreamBuffer &) = delete;
+    StreamBuffer & operator=(const StreamBuffer &) = delete;
+
+    long long Size() const { return size; }
+
+    /// Reserves the given number of bytes at an offset that is a multiple of alignment. Returns where to write them
+    /// and sets offset to where they are in the buffer. Returns null if they don't fit even with every earlier frame
+    /// completed.
+    void *Allocate(long long bytes, long long alignment, long long & offset);
+
+    /// Marks the end of a frame: everything allocated since the last call is used by the commands issued so far.
+    void EndFrame();
+
+    /// How many times Allocate had to wait for the GPU to finish with the memory of an earlier frame. If this keeps
+    /// climbing, the buffer is too small for the frames in flight.
+    size_t NumWaits() const { return numWaits; }
+
+protected:
+    explicit StreamBuffer(long long _size) : size(_size) {}
+
+    /// The memory the ring hands out, size bytes.
+    virtual char *Memory() = 0;
+
+    /// Marks the commands issued so far, returns a handle for WaitFence.
+    virtual void *InsertFence() = 0;
+
+    /// Blocks until the commands before the fence have completed, then releases it. Returns whether it had to block.
+    virtual bool WaitFence(void *fence) = 0;
+
+    /// Waits for and releases every fence still pending. Implementations call it from their destructor.
+    void ReleaseFences();
+
+private:
+    struct Frame
+    {
+        /// Where the frame's allocations end, in bytes handed out since the start.
+        long long end;
+        void *fence;
+    };
+
+    long long size;
+    /// Bytes handed out since the start, and where the oldest ones the GPU may still read begin. Positions in the
+    /// buffer are these modulo the size.
+    long long head = 0, tail = 0;
+    /// The frames the GPU may still read from, oldest first.
+    std::deque<Frame> frames;
+    size_t numWaits = 0;
+};
+
 /// Encapsulates a 2D texture
 class Texture2D
 {
@@ -311,6 +387,20 @@ public:
 
     /// Fill an existing vertex buffer with new data.
     virtual void FillVertexBuffer(VertexBuffer * vertexBuffer, long long size, const void * data) = 0;
+
+    /// Overwrite size bytes of an existing vertex buffer, starting offset bytes in. The rest is left as it is.
+    virtual void UpdateVertexBuffer(VertexBuffer * vertexBuffer, long long offset, long long size, const void * data) = 0;
+
+    /// Map size bytes of a vertex buffer, starting offset bytes in, for direct access. access combines BufferMapAccess
+    /// flags. Returns null if the range can't be mapped. The buffer can't be used for drawing until it is unmapped.
+    virtual void *MapVertexBuffer(VertexBuffer * vertexBuffer, long long offset, long long size, unsigned int access = BUFFERMAP_WRITE) = 0;
+
+    /// Unmap a mapped vertex buffer. Returns false if its contents were lost while mapped and need to be written again.
+    virtual bool UnmapVertexBuffer(VertexBuffer * vertexBuffer) = 0;
+
+    /// Give a vertex buffer new storage of the same size, with undefined contents. Draws already issued keep reading
+    /// the old storage, so the buffer can be filled again right away instead of waiting for them.
+    virtual void OrphanVertexBuffer(VertexBuffer * vertexBuffer) = 0;
     
     /// Create a vertex description given an array of VertexElement structures
     virtual VertexDescription *CreateVertexDescription(unsigned int numVertexElements, const VertexElement *vertexElements) = 0;
@@ -335,6 +425,31 @@ public:
 
     /// Fill an existing vertex buffer with new data.
     virtual void FillIndexBuffer(IndexBuffer * vertexBuffer, long long size, const void * data) = 0;
+
+    /// Overwrite size bytes of an existing index buffer, starting offset bytes in. The rest is left as it is.
+    virtual void UpdateIndexBuffer(IndexBuffer * indexBuffer, long long offset, long long size, const void * data) = 0;
+
+    /// Map part of an index buffer, like MapVertexBuffer.
+    virtual void *MapIndexBuffer(IndexBuffer * indexBuffer, long long offset, long long size, unsigned int access = BUFFERMAP_WRITE) = 0;
+
+    /// Unmap a mapped index buffer, like UnmapVertexBuffer.
+    virtual bool UnmapIndexBuffer(IndexBuffer * indexBuffer) = 0;
+
+    /// Give an index buffer new storage, like OrphanVertexBuffer.
+    virtual void OrphanIndexBuffer(IndexBuffer * indexBuffer) = 0;
+
+    /// Create a stream buffer of the given size. Make it hold a few frames' worth of data.
+    virtual StreamBuffer *CreateStreamBuffer(long long size) = 0;
+
+    /// Destroy a stream buffer. Waits for the commands still reading it.
+    virtual void DestroyStreamBuffer(StreamBuffer *streamBuffer) = 0;
+
+    /// Copy size bytes allocated from a stream buffer into a vertex buffer, starting offset bytes in. Happens in
+    /// order with the draws, after the ones already issued.
+    virtual void CopyStreamToVertexBuffer(StreamBuffer *streamBuffer, long long streamOffset, VertexBuffer * vertexBuffer, long long offset, long long size) = 0;
+
+    /// Copy size bytes allocated from a stream buffer into an index buffer, like CopyStreamToVertexBuffer.
+    virtual void CopyStreamToIndexBuffer(StreamBuffer *streamBuffer, long long streamOffset, IndexBuffer * indexBuffer, long long offset, long long size) = 0;
     
     /// Set an index buffer as active for subsequent draw commands
     virtual void SetIndexBuffer(IndexBuffer *indexBuffer) = 0;
@@ -401,6 +516,9 @@ public:
      */
     virtual void DrawTrianglesIndexed32(long long offset, int count) = 0;
 
+    /// Like DrawTrianglesIndexed32, for an index buffer of 16-bit indices. The offset is in bytes.
+    virtual void DrawTrianglesIndexed16(long long offset, int count) = 0;
+
     /// Draw a collection of points using the currently active shader pipeline & vertex array data
     virtual void DrawPoints(long long offset, int count) = 0;
 
@@ -417,8 +535,18 @@ public:
     virtual void DrawModel(Model & aModel, glm::mat4 & arcball, glm::mat4 & view, glm::mat4 & projection) = 0;
 };
 
+/// The kinds of RenderDevice there are
+enum RenderDeviceType
+{
+    /// Draws with OpenGL, in the context of the platform window.
+    RENDERDEVICE_OPENGL = 0,
+
+    /// Draws nothing and needs no GPU, records the commands instead. See RecordingRenderDevice.
+    RENDERDEVICE_RECORDING
+};
+
 /// Creates a RenderDevice. Note: Always initilize the platform BEFORE calling this fn!
-RenderDevice *CreateRenderDevice();
+RenderDevice *CreateRenderDevice(RenderDeviceType type = RENDERDEVICE_OPENGL);
 
 /// Destroys a RenderDevice. Note: Always destroy the render device BEFORE terminating the platform.
 void DestroyRenderDevice(RenderDevice *renderDevice);
@@ -1,4 +1,4 @@
-#include "Platform.hpp"
+#include "PlatformBackends.hpp"
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #define GLM_ENABLE_EXPERIMENTAL
@@ -11,6 +11,8 @@
 #include <iostream>
 
 namespace platform
+{
+namespace glfw
 {
 	static float s_Width;
 	static float s_Height;
@@ -29,6 +31,14 @@ namespace platform
 
 	static glm::mat4 s_View = glm::translate(glm::mat4(1), glm::vec3(0, 0, -50));
 
+	static PLATFORM_KEY_CALLBACK s_KeyCallback = nullptr;
+
+	static void key_callback(GLFWwindow *window, int key, int scancode, int action, int mods)
+	{
+		if (s_KeyCallback)
+			s_KeyCallback(key, action, mods);
+	}
+
 	static void scroll_callback(GLFWwindow *window, double xoffset, double yoffset)
 	{
 		s_View[3][2] += float(yoffset);
@@ -188,6 +198,7 @@ namespace platform
 		glfwSetMouseButtonCallback(window, mouse_button_callback);
 		glfwSetCursorPosCallback(window, cursor_position_callback);
 		glfwSetScrollCallback(window, scroll_callback);
+		glfwSetKeyCallback(window, key_callback);
 
 		// glad: load all OpenGL function pointers
 		// ---------------------------------------
@@ -219,6 +230,16 @@ namespace platform
 		projection = s_Projection;
 	}
 
+	void GetPlatformFramebufferSize(PLATFORM_WINDOW_REF window, int &width, int &height)
+	{
+		glfwGetFramebufferSize((GLFWwindow *)window, &width, &height);
+	}
+
+	void SetPlatformKeyCallback(PLATFORM_WINDOW_REF window, PLATFORM_KEY_CALLBACK callback)
+	{
+		s_KeyCallback = callback;
+	}
+
 	void PresentPlatformWindow(PLATFORM_WINDOW_REF window)
 	{
 		// glfw: swap buffers
@@ -232,4 +253,5 @@ namespace platform
 		// ------------------------------------------------------------------
 		glfwTerminate();
 	}
-}
\ No newline at end of file
+}
+}
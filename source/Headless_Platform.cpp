@@ -0,0 +1,104 @@
+#include "PlatformBackends.hpp"
+#define GLFW_INCLUDE_NONE
+#include <GLFW/glfw3.h>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <vector>
+
+// No window and no input: every frame looks the same, and the keys pressed are the queued ones. Uses the GLFW key
+// codes so the same callback serves both backends.
+namespace platform
+{
+	namespace headless
+	{
+		struct QueuedKey
+		{
+			int frame;
+			int key;
+			int mods;
+		};
+
+		static int s_Window;
+		static int s_Width = 1;
+		static int s_Height = 1;
+		static int s_Frame = 0;
+		static int s_FrameLimit = 0;
+		static std::vector<QueuedKey> s_Keys;
+		static size_t s_NextKey = 0;
+		static PLATFORM_KEY_CALLBACK s_KeyCallback = nullptr;
+
+		static const glm::mat4 s_View = glm::translate(glm::mat4(1), glm::vec3(0, 0, -50));
+
+		void InitPlatform()
+		{
+			s_Frame = 0;
+			s_NextKey = 0;
+		}
+
+		PLATFORM_WINDOW_REF CreatePlatformWindow(int width, int height, const char *title)
+		{
+			s_Width = width;
+			s_Height = height;
+			return (PLATFORM_WINDOW_REF)&s_Window;
+		}
+
+		bool PollPlatformWindow(PLATFORM_WINDOW_REF window)
+		{
+			if (s_FrameLimit > 0 && s_Frame >= s_FrameLimit) return false;
+
+			for (; s_NextKey < s_Keys.size() && s_Keys[s_NextKey].frame <= s_Frame; s_NextKey++)
+			{
+				const QueuedKey &queued = s_Keys[s_NextKey];
+				if (queued.key == GLFW_KEY_ESCAPE) return false;
+				if (!s_KeyCallback) continue;
+				s_KeyCallback(queued.key, GLFW_PRESS, queued.mods);
+				s_KeyCallback(queued.key, GLFW_RELEASE, queued.mods);
+			}
+			s_Frame++;
+			return true;
+		}
+
+		void GetPlatformViewport(glm::mat4 &model, glm::mat4 &view, glm::mat4 &projection)
+		{
+			model = glm::mat4(1);
+			view = s_View;
+			projection = glm::perspective(glm::radians(45.0f), static_cast<float>(s_Width) / static_cast<float>(s_Height), 0.1f, 10000.f);
+		}
+
+		void GetPlatformFramebufferSize(PLATFORM_WINDOW_REF window, int &width, int &height)
+		{
+			width = s_Width;
+			height = s_Height;
+		}
+
+		void SetPlatformKeyCallback(PLATFORM_WINDOW_REF window, PLATFORM_KEY_CALLBACK callback)
+		{
+			s_KeyCallback = callback;
+		}
+
+		void PresentPlatformWindow(PLATFORM_WINDOW_REF window)
+		{
+		}
+
+		void TerminatePlatform()
+		{
+			s_Keys.clear();
+			s_NextKey = 0;
+			s_KeyCallback = nullptr;
+		}
+
+		void SetFrameLimit(int frames)
+		{
+			s_FrameLimit = frames;
+		}
+
+		void QueueKey(int frame, int key, int mods)
+		{
+			// Keep the keys of a frame in the order they were queued
+			auto at = std::upper_bound(s_Keys.begin() + s_NextKey, s_Keys.end(), frame,
+									   [](int f, const QueuedKey &queued) { return f < queued.frame; });
+			s_Keys.insert(at, QueuedKey{frame, key, mods});
+		}
+	}
+}
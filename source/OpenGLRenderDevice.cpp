@@ -69,6 +69,8 @@ namespace starforge {
         m_IBOs.clear();
         for (auto &aBuf: m_VBOs) Utilities::Safe_Delete(aBuf);
         m_VBOs.clear();
+        for (auto &aBuf: m_streamBuffers) Utilities::Safe_Delete(aBuf);
+        m_streamBuffers.clear();
         for (auto &aVAO: m_VAOs) Utilities::Safe_Delete(aVAO);
         m_VAOs.clear();
         for (auto &aVD: m_vDescriptions) Utilities::Safe_Delete(aVD);
@@ -127,6 +129,23 @@ namespace starforge {
         glBuffer->FillBuffer(size, data);
     }
 
+    void OpenGLRenderDevice::UpdateVertexBuffer(VertexBuffer *vertexBuffer, long long offset, long long size, const void * data) {
+        auto glBuffer = dynamic_cast<OpenGLVertexBuffer*>(vertexBuffer);
+        glBuffer->FillBuffer(size, data, offset);
+    }
+
+    void *OpenGLRenderDevice::MapVertexBuffer(VertexBuffer *vertexBuffer, long long offset, long long size, unsigned int access) {
+        return dynamic_cast<OpenGLVertexBuffer*>(vertexBuffer)->MapBuffer(offset, size, access);
+    }
+
+    bool OpenGLRenderDevice::UnmapVertexBuffer(VertexBuffer *vertexBuffer) {
+        return dynamic_cast<OpenGLVertexBuffer*>(vertexBuffer)->UnmapBuffer();
+    }
+
+    void OpenGLRenderDevice::OrphanVertexBuffer(VertexBuffer *vertexBuffer) {
+        dynamic_cast<OpenGLVertexBuffer*>(vertexBuffer)->OrphanBuffer();
+    }
+
     void OpenGLRenderDevice::DestroyVertexBuffer(VertexBuffer *vertexBuffer) {
         if (vertexBuffer) {
             m_VBOs.erase(
@@ -201,6 +220,47 @@ namespace starforge {
         glBuffer->FillBuffer(size, data);
     }
 
+    void OpenGLRenderDevice::UpdateIndexBuffer(IndexBuffer *indexBuffer, long long offset, long long size, const void * data) {
+        auto glBuffer = dynamic_cast<OpenGLIndexBuffer*>(indexBuffer);
+        glBuffer->FillBuffer(size, data, offset);
+    }
+
+    void *OpenGLRenderDevice::MapIndexBuffer(IndexBuffer *indexBuffer, long long offset, long long size, unsigned int access) {
+        return dynamic_cast<OpenGLIndexBuffer*>(indexBuffer)->MapBuffer(offset, size, access);
+    }
+
+    bool OpenGLRenderDevice::UnmapIndexBuffer(IndexBuffer *indexBuffer) {
+        return dynamic_cast<OpenGLIndexBuffer*>(indexBuffer)->UnmapBuffer();
+    }
+
+    void OpenGLRenderDevice::OrphanIndexBuffer(IndexBuffer *indexBuffer) {
+        dynamic_cast<OpenGLIndexBuffer*>(indexBuffer)->OrphanBuffer();
+    }
+
+    StreamBuffer *OpenGLRenderDevice::CreateStreamBuffer(long long size) {
+        m_streamBuffers.push_back(new OpenGLStreamBuffer(size));
+        return m_streamBuffers.back();
+    }
+
+    void OpenGLRenderDevice::DestroyStreamBuffer(StreamBuffer *streamBuffer) {
+        if (streamBuffer) {
+            m_streamBuffers.erase(std::remove(m_streamBuffers.begin(), m_streamBuffers.end(), streamBuffer), m_streamBuffers.end());
+            Utilities::Safe_Delete(streamBuffer);
+        }
+    }
+
+    void OpenGLRenderDevice::CopyStreamToVertexBuffer(StreamBuffer *streamBuffer, long long streamOffset,
+                                                      VertexBuffer *vertexBuffer, long long offset, long long size) {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, dynamic_cast<OpenGLVertexBuffer*>(vertexBuffer)->VBO);
+        dynamic_cast<OpenGLStreamBuffer*>(streamBuffer)->CopyTo(streamOffset, offset, size);
+    }
+
+    void OpenGLRenderDevice::CopyStreamToIndexBuffer(StreamBuffer *streamBuffer, long long streamOffset,
+                                                     IndexBuffer *indexBuffer, long long offset, long long size) {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, dynamic_cast<OpenGLIndexBuffer*>(indexBuffer)->IBO);
+        dynamic_cast<OpenGLStreamBuffer*>(streamBuffer)->CopyTo(streamOffset, offset, size);
+    }
+
     void OpenGLRenderDevice::SetIndexBuffer(IndexBuffer *indexBuffer) {
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, reinterpret_cast<OpenGLIndexBuffer *>(indexBuffer)->IBO);
     }
@@ -355,6 +415,10 @@ namespace starforge {
         glDrawElements(GL_TRIANGLES, count, GL_UNSIGNED_INT, reinterpret_cast<const void *>(offset));
     }
 
+    void OpenGLRenderDevice::DrawTrianglesIndexed16(long long offset, int count) {
+        glDrawElements(GL_TRIANGLES, count, GL_UNSIGNED_SHORT, reinterpret_cast<const void *>(offset));
+    }
+
     void OpenGLRenderDevice::BindDefaultPipeline() { SetPipeline(m_defaultPipeline); }
 
     void OpenGLRenderDevice::SetPointSize(float pSize) {
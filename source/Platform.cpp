@@ -0,0 +1,66 @@
+#include "Platform.hpp"
+#include "PlatformBackends.hpp"
+
+namespace platform
+{
+	static PlatformBackend s_Backend = PLATFORM_GLFW;
+
+	void InitPlatform(PlatformBackend backend)
+	{
+		s_Backend = backend;
+		if (s_Backend == PLATFORM_HEADLESS) headless::InitPlatform();
+		else glfw::InitPlatform();
+	}
+
+	PLATFORM_WINDOW_REF CreatePlatformWindow(int width, int height, const char *title)
+	{
+		if (s_Backend == PLATFORM_HEADLESS) return headless::CreatePlatformWindow(width, height, title);
+		return glfw::CreatePlatformWindow(width, height, title);
+	}
+
+	bool PollPlatformWindow(PLATFORM_WINDOW_REF window)
+	{
+		if (s_Backend == PLATFORM_HEADLESS) return headless::PollPlatformWindow(window);
+		return glfw::PollPlatformWindow(window);
+	}
+
+	void GetPlatformViewport(glm::mat4 &model, glm::mat4 &view, glm::mat4 &projection)
+	{
+		if (s_Backend == PLATFORM_HEADLESS) headless::GetPlatformViewport(model, view, projection);
+		else glfw::GetPlatformViewport(model, view, projection);
+	}
+
+	void GetPlatformFramebufferSize(PLATFORM_WINDOW_REF window, int &width, int &height)
+	{
+		if (s_Backend == PLATFORM_HEADLESS) headless::GetPlatformFramebufferSize(window, width, height);
+		else glfw::GetPlatformFramebufferSize(window, width, height);
+	}
+
+	void SetPlatformKeyCallback(PLATFORM_WINDOW_REF window, PLATFORM_KEY_CALLBACK callback)
+	{
+		if (s_Backend == PLATFORM_HEADLESS) headless::SetPlatformKeyCallback(window, callback);
+		else glfw::SetPlatformKeyCallback(window, callback);
+	}
+
+	void PresentPlatformWindow(PLATFORM_WINDOW_REF window)
+	{
+		if (s_Backend == PLATFORM_HEADLESS) headless::PresentPlatformWindow(window);
+		else glfw::PresentPlatformWindow(window);
+	}
+
+	void TerminatePlatform()
+	{
+		if (s_Backend == PLATFORM_HEADLESS) headless::TerminatePlatform();
+		else glfw::TerminatePlatform();
+	}
+
+	void SetHeadlessFrameLimit(int frames)
+	{
+		headless::SetFrameLimit(frames);
+	}
+
+	void QueueHeadlessKey(int frame, int key, int mods)
+	{
+		headless::QueueKey(frame, key, mods);
+	}
+}
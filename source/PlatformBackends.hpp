@@ -0,0 +1,33 @@
+#pragma once
+
+#include "Platform.hpp"
+
+// The implementations Platform.cpp picks from, one namespace per PlatformBackend.
+namespace platform
+{
+	namespace glfw
+	{
+		void InitPlatform();
+		PLATFORM_WINDOW_REF CreatePlatformWindow(int width, int height, const char *title);
+		bool PollPlatformWindow(PLATFORM_WINDOW_REF window);
+		void GetPlatformViewport(glm::mat4 &model, glm::mat4 &view, glm::mat4 &projection);
+		void GetPlatformFramebufferSize(PLATFORM_WINDOW_REF window, int &width, int &height);
+		void SetPlatformKeyCallback(PLATFORM_WINDOW_REF window, PLATFORM_KEY_CALLBACK callback);
+		void PresentPlatformWindow(PLATFORM_WINDOW_REF window);
+		void TerminatePlatform();
+	}
+
+	namespace headless
+	{
+		void InitPlatform();
+		PLATFORM_WINDOW_REF CreatePlatformWindow(int width, int height, const char *title);
+		bool PollPlatformWindow(PLATFORM_WINDOW_REF window);
+		void GetPlatformViewport(glm::mat4 &model, glm::mat4 &view, glm::mat4 &projection);
+		void GetPlatformFramebufferSize(PLATFORM_WINDOW_REF window, int &width, int &height);
+		void SetPlatformKeyCallback(PLATFORM_WINDOW_REF window, PLATFORM_KEY_CALLBACK callback);
+		void PresentPlatformWindow(PLATFORM_WINDOW_REF window);
+		void TerminatePlatform();
+		void SetFrameLimit(int frames);
+		void QueueKey(int frame, int key, int mods);
+	}
+}
@@ -0,0 +1,444 @@
+#include "RecordingRenderDevice.hpp"
+#include <algorithm>
+#include <glm/gtc/type_ptr.hpp>
+#include "DefaultShaders.hpp"
+#include "Model.hpp"
+#include "Utilities.hpp"
+
+namespace starforge {
+    static long long VertexElementTypeSize(VertexElementType type) {
+        static const long long sizes[] = { 1, 2, 4, 1, 2, 4, 1, 2, 4, 1, 2, 4, 2, 4, 8 };
+        return sizes[type];
+    }
+
+    template<typename T>
+    static void DestroyTracked(std::vector<T *> &tracked, T *object) {
+        tracked.erase(std::remove(tracked.begin(), tracked.end(), object), tracked.end());
+        Utilities::Safe_Delete(object);
+    }
+
+    void RecordingPipelineParam::Set(const char *name, const void *data, size_t size) {
+        value.assign(static_cast<const unsigned char *>(data), static_cast<const unsigned char *>(data) + size);
+        device->Record(name, (long long)size);
+        device->m_stats.paramSets++;
+    }
+
+    RecordingRenderDevice::RecordingRenderDevice() {
+        m_defaultRasterState = dynamic_cast<RecordingRasterState *>(CreateRasterState());
+        SetRasterState(m_defaultRasterState);
+
+        m_defaultDepthStencilState = dynamic_cast<RecordingDepthStencilState *>(CreateDepthStencilState());
+        SetDepthStencilState(m_defaultDepthStencilState);
+
+        auto vertexShader = CreateVertexShader(g_defaultVertexShaderSource);
+        auto pixelShader = CreatePixelShader(g_defaultPixelShaderSource);
+        m_defaultPipeline = dynamic_cast<RecordingPipeline *>(CreatePipeline(vertexShader, pixelShader));
+        DestroyVertexShader(vertexShader);
+        DestroyPixelShader(pixelShader);
+
+        // Setting up isn't part of what the device is asked to do
+        ClearCommands();
+        ResetStats();
+    }
+
+    RecordingRenderDevice::~RecordingRenderDevice() {
+        for (auto &aDState: m_depthStates) Utilities::Safe_Delete(aDState);
+        for (auto &aRasterState: m_rasterStates) Utilities::Safe_Delete(aRasterState);
+        for (auto &aPipe: m_pipelines) Utilities::Safe_Delete(aPipe);
+        for (auto &aBuf: m_IBOs) Utilities::Safe_Delete(aBuf);
+        for (auto &aBuf: m_VBOs) Utilities::Safe_Delete(aBuf);
+        for (auto &aBuf: m_streamBuffers) Utilities::Safe_Delete(aBuf);
+        for (auto &aVAO: m_VAOs) Utilities::Safe_Delete(aVAO);
+        for (auto &aVD: m_vDescriptions) Utilities::Safe_Delete(aVD);
+        for (auto &aTexture: m_textures) Utilities::Safe_Delete(aTexture);
+    }
+
+    void RecordingRenderDevice::Record(const char *name, long long bytes, long long count) {
+        m_stats.commands++;
+        if (m_keepCommands) m_commands.push_back(RecordedCommand{name, bytes, count});
+    }
+
+    void RecordingRenderDevice::RecordUpload(const char *name, long long size, bool written) {
+        Record(name, written ? size : 0);
+        if (!written || size <= 0) return;
+        m_stats.uploads++;
+        m_stats.uploadBytes += size;
+    }
+
+    const CPUBufferStorage &RecordingRenderDevice::GetStorage(const VertexBuffer *vertexBuffer) {
+        return dynamic_cast<const CPUVertexBuffer *>(vertexBuffer)->storage;
+    }
+
+    const CPUBufferStorage &RecordingRenderDevice::GetStorage(const IndexBuffer *indexBuffer) {
+        return dynamic_cast<const CPUIndexBuffer *>(indexBuffer)->storage;
+    }
+
+    VertexShader *RecordingRenderDevice::CreateVertexShader(const char *code) {
+        Record("CreateVertexShader");
+        return new RecordingVertexShader(code);
+    }
+
+    void RecordingRenderDevice::DestroyVertexShader(VertexShader *vertexShader) {
+        Record("DestroyVertexShader");
+        Utilities::Safe_Delete(vertexShader);
+    }
+
+    PixelShader *RecordingRenderDevice::CreatePixelShader(const char *code) {
+        Record("CreatePixelShader");
+        return new RecordingPixelShader(code);
+    }
+
+    void RecordingRenderDevice::DestroyPixelShader(PixelShader *pixelShader) {
+        Record("DestroyPixelShader");
+        Utilities::Safe_Delete(pixelShader);
+    }
+
+    Pipeline *RecordingRenderDevice::CreatePipeline(VertexShader *vertexShader, PixelShader *pixelShader) {
+        Record("CreatePipeline");
+        m_pipelines.push_back(new RecordingPipeline(this, dynamic_cast<RecordingVertexShader *>(vertexShader),
+                                                    dynamic_cast<RecordingPixelShader *>(pixelShader)));
+        return m_pipelines.back();
+    }
+
+    void RecordingRenderDevice::DestroyPipeline(Pipeline *pipeline) {
+        Record("DestroyPipeline");
+        if (!pipeline) return;
+        if (m_pipeline == pipeline) m_pipeline = nullptr;
+        DestroyTracked(m_pipelines, dynamic_cast<RecordingPipeline *>(pipeline));
+    }
+
+    void RecordingRenderDevice::SetPipeline(Pipeline *pipeline) {
+        Record("SetPipeline");
+        m_stats.stateChanges++;
+        m_pipeline = dynamic_cast<RecordingPipeline *>(pipeline);
+    }
+
+    VertexBuffer *RecordingRenderDevice::CreateVertexBuffer(long long size, const void *data) {
+        RecordUpload("CreateVertexBuffer", size, data != nullptr);
+        m_VBOs.push_back(new CPUVertexBuffer(size, data));
+        return m_VBOs.back();
+    }
+
+    void RecordingRenderDevice::DestroyVertexBuffer(VertexBuffer *vertexBuffer) {
+        Record("DestroyVertexBuffer");
+        if (!vertexBuffer) return;
+        auto buffer = dynamic_cast<CPUVertexBuffer *>(vertexBuffer);
+        m_mappings.erase(&buffer->storage);
+        DestroyTracked(m_VBOs, buffer);
+    }
+
+    void RecordingRenderDevice::FillVertexBuffer(VertexBuffer *vertexBuffer, long long size, const void *data) {
+        // Filling writes from the start of the buffer and leaves its size as it is
+        auto buffer = dynamic_cast<CPUVertexBuffer *>(vertexBuffer);
+        bool written = data && buffer->storage.Update(0, size, data);
+        RecordUpload("FillVertexBuffer", size, written);
+        if (written && size > 0) m_stats.fillBytes += size;
+    }
+
+    void RecordingRenderDevice::UpdateVertexBuffer(VertexBuffer *vertexBuffer, long long offset, long long size, const void *data) {
+        RecordUpload("UpdateVertexBuffer", size, dynamic_cast<CPUVertexBuffer *>(vertexBuffer)->storage.Update(offset, size, data));
+    }
+
+    void *RecordingRenderDevice::MapVertexBuffer(VertexBuffer *vertexBuffer, long long offset, long long size, unsigned int access) {
+        Record("MapVertexBuffer");
+        CPUBufferStorage &storage = dynamic_cast<CPUVertexBuffer *>(vertexBuffer)->storage;
+        void *mapped = storage.Map(offset, size, access);
+        if (mapped) m_mappings[&storage] = std::make_pair(size, access);
+        return mapped;
+    }
+
+    bool RecordingRenderDevice::UnmapVertexBuffer(VertexBuffer *vertexBuffer) {
+        CPUBufferStorage &storage = dynamic_cast<CPUVertexBuffer *>(vertexBuffer)->storage;
+        std::pair<long long, unsigned int> mapping = m_mappings[&storage];
+        m_mappings.erase(&storage);
+        bool unmapped = storage.Unmap();
+        RecordUpload("UnmapVertexBuffer", mapping.first, unmapped && (mapping.second & BUFFERMAP_WRITE));
+        return unmapped;
+    }
+
+    void RecordingRenderDevice::OrphanVertexBuffer(VertexBuffer *vertexBuffer) {
+        Record("OrphanVertexBuffer");
+        dynamic_cast<CPUVertexBuffer *>(vertexBuffer)->storage.Orphan();
+    }
+
+    VertexDescription *RecordingRenderDevice::CreateVertexDescription(unsigned int numVertexElements, const VertexElement *vertexElements) {
+        Record("CreateVertexDescription");
+        m_vDescriptions.push_back(new RecordingVertexDescription(numVertexElements, vertexElements));
+        return m_vDescriptions.back();
+    }
+
+    void RecordingRenderDevice::DestroyVertexDescription(VertexDescription *vertexDescription) {
+        Record("DestroyVertexDescription");
+        if (vertexDescription) DestroyTracked(m_vDescriptions, dynamic_cast<RecordingVertexDescription *>(vertexDescription));
+    }
+
+    VertexArray *RecordingRenderDevice::CreateVertexArray(unsigned int numVertexBuffers, VertexBuffer **vertexBuffers,
+                                                          VertexDescription **vertexDescriptions) {
+        Record("CreateVertexArray");
+        m_VAOs.push_back(new RecordingVertexArray(numVertexBuffers, vertexBuffers, vertexDescriptions));
+        return m_VAOs.back();
+    }
+
+    void RecordingRenderDevice::DestroyVertexArray(VertexArray *vertexArray) {
+        Record("DestroyVertexArray");
+        if (!vertexArray) return;
+        if (m_vertexArray == vertexArray) m_vertexArray = nullptr;
+        DestroyTracked(m_VAOs, dynamic_cast<RecordingVertexArray *>(vertexArray));
+    }
+
+    void RecordingRenderDevice::SetVertexArray(VertexArray *vertexArray) {
+        Record("SetVertexArray");
+        m_stats.stateChanges++;
+        m_vertexArray = dynamic_cast<RecordingVertexArray *>(vertexArray);
+    }
+
+    IndexBuffer *RecordingRenderDevice::CreateIndexBuffer(long long size, const void *data) {
+        RecordUpload("CreateIndexBuffer", size, data != nullptr);
+        m_IBOs.push_back(new CPUIndexBuffer(size, data));
+        return m_IBOs.back();
+    }
+
+    void RecordingRenderDevice::DestroyIndexBuffer(IndexBuffer *indexBuffer) {
+        Record("DestroyIndexBuffer");
+        if (!indexBuffer) return;
+        auto buffer = dynamic_cast<CPUIndexBuffer *>(indexBuffer);
+        if (m_indexBuffer == buffer) m_indexBuffer = nullptr;
+        m_mappings.erase(&buffer->storage);
+        DestroyTracked(m_IBOs, buffer);
+    }
+
+    void RecordingRenderDevice::FillIndexBuffer(IndexBuffer *indexBuffer, long long size, const void *data) {
+        // Filling writes from the start of the buffer and leaves its size as it is
+        auto buffer = dynamic_cast<CPUIndexBuffer *>(indexBuffer);
+        bool written = data && buffer->storage.Update(0, size, data);
+        RecordUpload("FillIndexBuffer", size, written);
+        if (written && size > 0) m_stats.fillBytes += size;
+    }
+
+    void RecordingRenderDevice::UpdateIndexBuffer(IndexBuffer *indexBuffer, long long offset, long long size, const void *data) {
+        RecordUpload("UpdateIndexBuffer", size, dynamic_cast<CPUIndexBuffer *>(indexBuffer)->storage.Update(offset, size, data));
+    }
+
+    void *RecordingRenderDevice::MapIndexBuffer(IndexBuffer *indexBuffer, long long offset, long long size, unsigned int access) {
+        Record("MapIndexBuffer");
+        CPUBufferStorage &storage = dynamic_cast<CPUIndexBuffer *>(indexBuffer)->storage;
+        void *mapped = storage.Map(offset, size, access);
+        if (mapped) m_mappings[&storage] = std::make_pair(size, access);
+        return mapped;
+    }
+
+    bool RecordingRenderDevice::UnmapIndexBuffer(IndexBuffer *indexBuffer) {
+        CPUBufferStorage &storage = dynamic_cast<CPUIndexBuffer *>(indexBuffer)->storage;
+        std::pair<long long, unsigned int> mapping = m_mappings[&storage];
+        m_mappings.erase(&storage);
+        bool unmapped = storage.Unmap();
+        RecordUpload("UnmapIndexBuffer", mapping.first, unmapped && (mapping.second & BUFFERMAP_WRITE));
+        return unmapped;
+    }
+
+    void RecordingRenderDevice::OrphanIndexBuffer(IndexBuffer *indexBuffer) {
+        Record("OrphanIndexBuffer");
+        dynamic_cast<CPUIndexBuffer *>(indexBuffer)->storage.Orphan();
+    }
+
+    StreamBuffer *RecordingRenderDevice::CreateStreamBuffer(long long size) {
+        Record("CreateStreamBuffer");
+        m_streamBuffers.push_back(new CPUStreamBuffer(size));
+        return m_streamBuffers.back();
+    }
+
+    void RecordingRenderDevice::DestroyStreamBuffer(StreamBuffer *streamBuffer) {
+        Record("DestroyStreamBuffer");
+        if (streamBuffer) DestroyTracked(m_streamBuffers, dynamic_cast<CPUStreamBuffer *>(streamBuffer));
+    }
+
+    static bool CopyFromStream(const CPUStreamBuffer *streamBuffer, long long streamOffset, CPUBufferStorage &storage,
+                               long long offset, long long size) {
+        if (streamOffset < 0 || size < 0 || streamOffset + size > streamBuffer->Size()) {
+            std::cout << "ERROR::RECORDING::COPY of " << size << " bytes at " << streamOffset
+                      << " is outside a stream buffer of " << streamBuffer->Size() << " bytes" << std::endl;
+            return false;
+        }
+        return storage.Update(offset, size, streamBuffer->Data() + streamOffset);
+    }
+
+    void RecordingRenderDevice::CopyStreamToVertexBuffer(StreamBuffer *streamBuffer, long long streamOffset,
+                                                         VertexBuffer *vertexBuffer, long long offset, long long size) {
+        bool written = CopyFromStream(dynamic_cast<CPUStreamBuffer *>(streamBuffer), streamOffset,
+                                      dynamic_cast<CPUVertexBuffer *>(vertexBuffer)->storage, offset, size);
+        RecordUpload("CopyStreamToVertexBuffer", size, written);
+    }
+
+    void RecordingRenderDevice::CopyStreamToIndexBuffer(StreamBuffer *streamBuffer, long long streamOffset,
+                                                        IndexBuffer *indexBuffer, long long offset, long long size) {
+        bool written = CopyFromStream(dynamic_cast<CPUStreamBuffer *>(streamBuffer), streamOffset,
+                                      dynamic_cast<CPUIndexBuffer *>(indexBuffer)->storage, offset, size);
+        RecordUpload("CopyStreamToIndexBuffer", size, written);
+    }
+
+    void RecordingRenderDevice::SetIndexBuffer(IndexBuffer *indexBuffer) {
+        Record("SetIndexBuffer");
+        m_stats.stateChanges++;
+        m_indexBuffer = dynamic_cast<CPUIndexBuffer *>(indexBuffer);
+    }
+
+    Texture2D *RecordingRenderDevice::CreateTexture2D(int width, int height, const void *data) {
+        RecordUpload("CreateTexture2D", 4LL * width * height, data != nullptr);
+        m_textures.push_back(new RecordingTexture2D(width, height));
+        return m_textures.back();
+    }
+
+    void RecordingRenderDevice::DestroyTexture2D(Texture2D *texture2D) {
+        Record("DestroyTexture2D");
+        if (texture2D) DestroyTracked(m_textures, dynamic_cast<RecordingTexture2D *>(texture2D));
+    }
+
+    void RecordingRenderDevice::SetTexture2D(unsigned int slot, Texture2D *texture2D) {
+        Record("SetTexture2D");
+        m_stats.stateChanges++;
+    }
+
+    RasterState *RecordingRenderDevice::CreateRasterState(bool cullEnabled, Winding frontFace, Face cullFace, RasterMode rasterMode) {
+        Record("CreateRasterState");
+        m_rasterStates.push_back(new RecordingRasterState(cullEnabled, frontFace, cullFace, rasterMode));
+        return m_rasterStates.back();
+    }
+
+    void RecordingRenderDevice::DestroyRasterState(RasterState *rasterState) {
+        Record("DestroyRasterState");
+        if (!rasterState) return;
+        if (m_rasterState == rasterState) m_rasterState = m_defaultRasterState;
+        DestroyTracked(m_rasterStates, dynamic_cast<RecordingRasterState *>(rasterState));
+    }
+
+    void RecordingRenderDevice::SetRasterState(RasterState *rasterState) {
+        RecordingRasterState *oldRasterState = m_rasterState;
+        m_rasterState = rasterState ? dynamic_cast<RecordingRasterState *>(rasterState) : m_defaultRasterState;
+        Record("SetRasterState");
+        if (m_rasterState != oldRasterState) m_stats.stateChanges++;
+    }
+
+    DepthStencilState *
+    RecordingRenderDevice::CreateDepthStencilState(bool depthEnabled, bool depthWriteEnabled, float depthNear,
+                                                   float depthFar, Compare depthCompare,
+                                                   bool frontFaceStencilEnabled, Compare frontFaceStencilCompare,
+                                                   StencilAction frontFaceStencilFail, StencilAction frontFaceStencilPass,
+                                                   StencilAction frontFaceDepthFail, int frontFaceRef,
+                                                   unsigned int frontFaceReadMask, unsigned int frontFaceWriteMask,
+                                                   bool backFaceStencilEnabled,
+                                                   Compare backFaceStencilCompare, StencilAction backFaceStencilFail,
+                                                   StencilAction backFaceStencilPass, StencilAction backFaceDepthFail,
+                                                   int backFaceRef, unsigned int backFaceReadMask,
+                                                   unsigned int backFaceWriteMask) {
+        Record("CreateDepthStencilState");
+        m_depthStates.push_back(new RecordingDepthStencilState(depthEnabled, depthWriteEnabled, depthCompare));
+        return m_depthStates.back();
+    }
+
+    void RecordingRenderDevice::DestroyDepthStencilState(DepthStencilState *depthStencilState) {
+        Record("DestroyDepthStencilState");
+        if (!depthStencilState) return;
+        if (m_depthStencilState == depthStencilState) m_depthStencilState = m_defaultDepthStencilState;
+        DestroyTracked(m_depthStates, dynamic_cast<RecordingDepthStencilState *>(depthStencilState));
+    }
+
+    void RecordingRenderDevice::SetDepthStencilState(DepthStencilState *depthStencilState) {
+        RecordingDepthStencilState *oldDepthStencilState = m_depthStencilState;
+        m_depthStencilState = depthStencilState ? dynamic_cast<RecordingDepthStencilState *>(depthStencilState)
+                                                : m_defaultDepthStencilState;
+        Record("SetDepthStencilState");
+        if (m_depthStencilState != oldDepthStencilState) m_stats.stateChanges++;
+    }
+
+    void RecordingRenderDevice::Clear(float red, float green, float blue, float alpha, float depth, int stencil) {
+        Record("Clear");
+        m_stats.frames++;
+    }
+
+    void RecordingRenderDevice::Draw(const char *name, long long first, long long count, long long indexOffset, int indexSize) {
+        Record(name, 0, count);
+        m_stats.draws++;
+        m_stats.verticesDrawn += count;
+        if (count <= 0) return;
+
+        const char *problem = nullptr;
+        long long lastVertex = first + count - 1;
+        if (!m_pipeline) problem = "no pipeline is set";
+        else if (!m_vertexArray) problem = "no vertex array is set";
+        else if (indexOffset >= 0) {
+            const CPUBufferStorage *indices = m_indexBuffer ? &m_indexBuffer->storage : nullptr;
+            if (!indices) problem = "no index buffer is set";
+            else if (indices->IsMapped()) problem = "the index buffer is mapped";
+            else if (indexOffset + count * indexSize > indices->Size()) problem = "it reads past the end of the index buffer";
+            else if (indexSize == sizeof(uint16_t)) {
+                const uint16_t *begin = reinterpret_cast<const uint16_t *>(indices->Data() + indexOffset);
+                lastVertex = *std::max_element(begin, begin + count);
+            } else {
+                const uint32_t *begin = reinterpret_cast<const uint32_t *>(indices->Data() + indexOffset);
+                lastVertex = *std::max_element(begin, begin + count);
+            }
+        }
+        for (size_t i = 0; !problem && m_vertexArray && i < m_vertexArray->buffers.size(); i++) {
+            const CPUBufferStorage &vertices = m_vertexArray->buffers[i]->storage;
+            if (vertices.IsMapped()) problem = "a vertex buffer is mapped";
+            for (const VertexElement &element: m_vertexArray->descriptions[i]->elements) {
+                long long elementSize = element.size * VertexElementTypeSize(element.type);
+                long long stride = element.stride ? element.stride : elementSize;
+                if (element.offset + lastVertex * stride + elementSize > vertices.Size()) problem = "it reads past the end of a vertex buffer";
+            }
+        }
+        if (problem) {
+            m_stats.invalidDraws++;
+            std::cout << "ERROR::RECORDING::INVALID_DRAW " << name << " of " << count << " vertices: " << problem << std::endl;
+        }
+    }
+
+    void RecordingRenderDevice::DrawTriangles(int offset, int count) {
+        Draw("DrawTriangles", offset, count);
+    }
+
+    void RecordingRenderDevice::DrawPoints(long long offset, int count) {
+        Draw("DrawPoints", offset, count);
+    }
+
+    void RecordingRenderDevice::DrawLineStrip(long long offset, int count) {
+        Draw("DrawLineStrip", offset, count);
+    }
+
+    void RecordingRenderDevice::DrawTrianglesIndexed32(long long offset, int count) {
+        Draw("DrawTrianglesIndexed32", 0, count, offset);
+    }
+
+    void RecordingRenderDevice::DrawTrianglesIndexed16(long long offset, int count) {
+        Draw("DrawTrianglesIndexed16", 0, count, offset, sizeof(uint16_t));
+    }
+
+    Pipeline *RecordingRenderDevice::GetDefaultPipeline() { return m_defaultPipeline; }
+
+    void RecordingRenderDevice::BindDefaultPipeline() { SetPipeline(m_defaultPipeline); }
+
+    void RecordingRenderDevice::SetPointSize(float pSize) {
+        Record("SetPointSize");
+    }
+
+    void RecordingRenderDevice::DrawModel(Model &aModel, glm::mat4 &arcball, glm::mat4 &view, glm::mat4 &projection) {
+        Record("DrawModel");
+        // The same commands the OpenGL device issues for a model
+        Pipeline *pipeline = aModel.GetPipeline();
+        glm::mat3 normalMat = glm::mat3(glm::transpose(glm::inverse(arcball * aModel.GetModelMatrix())));
+        pipeline->GetParam("uView")->SetAsMat4(glm::value_ptr(view));
+        pipeline->GetParam("uProjection")->SetAsMat4(glm::value_ptr(projection));
+        pipeline->GetParam("uNormalMatrix")->SetAsMat3(glm::value_ptr(normalMat));
+        pipeline->GetParam("uArcball")->SetAsMat4(glm::value_ptr(arcball));
+
+        SetPipeline(pipeline);
+        for (size_t i = 0; i < aModel.NumMeshes(); i++) {
+            Mesh *aMesh = aModel.GetMesh(i);
+            for (size_t j = 0; j < aMesh->NumTextures(); j++)
+                SetTexture2D(j, aMesh->GetTexture(j));
+            SetVertexArray(aMesh->GetVertexArray());
+            SetIndexBuffer(aMesh->GetIndexBuffer());
+            DrawTrianglesIndexed32(0, aMesh->NumIndices());
+        }
+    }
+}
@@ -1,13 +1,63 @@
 #include "RenderDevice.hpp"
 #include "OpenGLRenderDevice.hpp"
+#include "RecordingRenderDevice.hpp"
+#include "CPUBuffers.hpp"
 
 namespace starforge
 {
-	RenderDevice *CreateRenderDevice()
+	const unsigned char CPUBufferStorage::undefinedByte;
+
+	void *StreamBuffer::Allocate(long long bytes, long long alignment, long long & offset)
+	{
+		if (bytes < 0 || bytes > size) return nullptr;
+		if (alignment < 1) alignment = 1;
+
+		// Allocations don't wrap around the end of the buffer, one that doesn't fit starts over at the beginning.
+		long long position = head % size;
+		long long aligned = (position + alignment - 1) / alignment * alignment;
+		long long start = aligned + bytes <= size ? head + (aligned - position) : head + (size - position);
+
+		// The new bytes must not reach the ones the GPU may still read. With none left, the bytes skipped to get
+		// here don't count either. The current frame has to fit on its own.
+		if (tail == head) tail = start;
+		while (start + bytes - tail > size)
+		{
+			if (frames.empty()) return nullptr;
+			if (WaitFence(frames.front().fence)) numWaits++;
+			tail = frames.front().end;
+			frames.pop_front();
+			if (tail == head) tail = start;
+		}
+
+		head = start + bytes;
+		offset = start % size;
+		return Memory() + offset;
+	}
+
+	void StreamBuffer::EndFrame()
+	{
+		long long frameStart = frames.empty() ? tail : frames.back().end;
+		if (head == frameStart) return;
+		frames.push_back(Frame{head, InsertFence()});
+	}
+
+	void StreamBuffer::ReleaseFences()
+	{
+		for (Frame & frame : frames) WaitFence(frame.fence);
+		frames.clear();
+		tail = head;
+	}
+
+	RenderDevice *CreateRenderDevice(RenderDeviceType type)
 	{
-		// Eventually, we will parse a config, command-line argument, or global setting, in order to retrieve which RenderDevice should be instantiated.
-		// Right now, we only have OpenGL.
-		return new OpenGLRenderDevice;
+		switch (type)
+		{
+		case RENDERDEVICE_RECORDING:
+			return new RecordingRenderDevice;
+		case RENDERDEVICE_OPENGL:
+		default:
+			return new OpenGLRenderDevice;
+		}
 	}
 
 	void DestroyRenderDevice(RenderDevice *renderDevice)
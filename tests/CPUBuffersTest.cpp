@@ -0,0 +1,256 @@
+#include <cstring>
+#include <iostream>
+#include <set>
+#include "CPUBuffers.hpp"
+#include "RecordingRenderDevice.hpp"
+
+using namespace starforge;
+
+static int failures = 0;
+
+#define CHECK(condition) \
+	do { \
+		if (!(condition)) \
+		{ \
+			std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #condition ") failed" << std::endl; \
+			failures++; \
+		} \
+	} while (0)
+
+/// A stream buffer whose fences complete when the test says so. Waiting on one that hasn't completed counts as
+/// blocking, and the fences waited on are kept in order.
+class TestStreamBuffer : public StreamBuffer
+{
+public:
+	explicit TestStreamBuffer(long long size) : StreamBuffer(size), bytes((size_t)size) {}
+
+	~TestStreamBuffer() override
+	{
+		ReleaseFences();
+	}
+
+	/// Fences are numbered from 1 in the order they were inserted.
+	void Complete(size_t fence) { completed.insert(fence); }
+
+	std::vector<size_t> waited;
+
+protected:
+	char *Memory() override { return bytes.data(); }
+
+	void *InsertFence() override
+	{
+		return reinterpret_cast<void *>(++numFences);
+	}
+
+	bool WaitFence(void *fence) override
+	{
+		size_t id = reinterpret_cast<size_t>(fence);
+		waited.push_back(id);
+		return completed.insert(id).second;
+	}
+
+private:
+	std::vector<char> bytes;
+	std::set<size_t> completed;
+	size_t numFences = 0;
+};
+
+static void TestAllocateWrapsAround()
+{
+	TestStreamBuffer ring(100);
+	long long offset = -1;
+	CHECK(ring.Allocate(40, 1, offset) != nullptr);
+	CHECK(offset == 0);
+	ring.EndFrame();
+	CHECK(ring.Allocate(40, 1, offset) != nullptr);
+	CHECK(offset == 40);
+	ring.EndFrame();
+
+	// 30 bytes don't fit after 80, so they start over at the beginning once the first frame is done with it
+	CHECK(ring.Allocate(30, 1, offset) != nullptr);
+	CHECK(offset == 0);
+	CHECK(ring.waited == std::vector<size_t>{1});
+	CHECK(ring.NumWaits() == 1);
+
+	// The second frame still holds [40, 80)
+	CHECK(ring.Allocate(10, 1, offset) != nullptr);
+	CHECK(offset == 30);
+	CHECK(ring.waited.size() == 1);
+}
+
+static void TestAllocateWaitsOnlyForBusyFrames()
+{
+	TestStreamBuffer ring(64);
+	long long offset = -1;
+	CHECK(ring.Allocate(32, 1, offset) != nullptr);
+	ring.EndFrame();
+	CHECK(ring.Allocate(32, 1, offset) != nullptr);
+	CHECK(offset == 32);
+	ring.EndFrame();
+
+	// The first frame has already completed, taking its memory back doesn't block
+	ring.Complete(1);
+	CHECK(ring.Allocate(16, 1, offset) != nullptr);
+	CHECK(offset == 0);
+	CHECK(ring.NumWaits() == 0);
+
+	// The second one hasn't
+	CHECK(ring.Allocate(32, 1, offset) != nullptr);
+	CHECK(offset == 16);
+	CHECK(ring.NumWaits() == 1);
+	CHECK((ring.waited == std::vector<size_t>{1, 2}));
+}
+
+static void TestAllocateAligns()
+{
+	TestStreamBuffer ring(64);
+	long long offset = -1;
+	CHECK(ring.Allocate(5, 1, offset) != nullptr);
+	CHECK(ring.Allocate(8, 16, offset) != nullptr);
+	CHECK(offset == 16);
+	ring.EndFrame();
+	CHECK(ring.Allocate(20, 1, offset) != nullptr);
+	CHECK(offset == 24);
+	CHECK(ring.Allocate(8, 16, offset) != nullptr);
+	CHECK(offset == 48);
+	// An aligned start past the end starts over at the beginning
+	CHECK(ring.Allocate(8, 16, offset) != nullptr);
+	CHECK(offset == 0);
+}
+
+static void TestAllocateRejectsWhatCantFit()
+{
+	TestStreamBuffer ring(64);
+	long long offset = -1;
+	CHECK(ring.Allocate(65, 1, offset) == nullptr);
+	CHECK(ring.Allocate(-1, 1, offset) == nullptr);
+
+	// The current frame has to fit on its own, there is nothing to wait for
+	CHECK(ring.Allocate(40, 1, offset) != nullptr);
+	CHECK(ring.Allocate(40, 1, offset) == nullptr);
+	CHECK(ring.waited.empty());
+
+	// Once it is ended, the next frame can wait for it
+	ring.EndFrame();
+	CHECK(ring.Allocate(40, 1, offset) != nullptr);
+	CHECK(offset == 0);
+	CHECK(ring.NumWaits() == 1);
+}
+
+static void TestEndFrameWithoutAllocations()
+{
+	TestStreamBuffer ring(64);
+	long long offset = -1;
+	ring.EndFrame();
+	CHECK(ring.Allocate(64, 1, offset) != nullptr);
+	ring.EndFrame();
+	ring.EndFrame();
+	CHECK(ring.Allocate(64, 1, offset) != nullptr);
+	// Only the frame with the allocation got a fence
+	CHECK(ring.waited == std::vector<size_t>{1});
+}
+
+static const unsigned char pattern[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+
+static bool Unchanged(const CPUBufferStorage & storage, long long begin, long long end)
+{
+	for (long long i = begin; i < end; i++)
+	{
+		if (storage.Data()[i] != pattern[i]) return false;
+	}
+	return true;
+}
+
+static bool Undefined(const CPUBufferStorage & storage, long long begin, long long end)
+{
+	for (long long i = begin; i < end; i++)
+	{
+		if (storage.Data()[i] != CPUBufferStorage::undefinedByte) return false;
+	}
+	return true;
+}
+
+static void TestMapInvalidates()
+{
+	CPUBufferStorage storage(8, pattern);
+	CHECK(storage.Map(2, 3, BUFFERMAP_WRITE | BUFFERMAP_INVALIDATE_RANGE) == storage.Data() + 2);
+	CHECK(Unchanged(storage, 0, 2));
+	CHECK(Undefined(storage, 2, 5));
+	CHECK(Unchanged(storage, 5, 8));
+	CHECK(storage.Unmap());
+
+	CPUBufferStorage whole(8, pattern);
+	CHECK(whole.Map(2, 3, BUFFERMAP_WRITE | BUFFERMAP_INVALIDATE_BUFFER) != nullptr);
+	CHECK(Undefined(whole, 0, 8));
+	CHECK(whole.Unmap());
+
+	// Without either flag the contents stay
+	CPUBufferStorage kept(8, pattern);
+	CHECK(kept.Map(0, 8, BUFFERMAP_READ | BUFFERMAP_WRITE) != nullptr);
+	CHECK(Unchanged(kept, 0, 8));
+	CHECK(kept.Unmap());
+}
+
+static void TestMisuseIsRejected()
+{
+	CPUBufferStorage storage(8, pattern);
+	const unsigned char zeros[8] = {};
+	CHECK(storage.Map(0, 4, BUFFERMAP_WRITE) != nullptr);
+	CHECK(storage.IsMapped());
+	CHECK(!storage.Update(4, 4, zeros));
+	CHECK(Unchanged(storage, 0, 8));
+	CHECK(storage.Map(4, 4, BUFFERMAP_WRITE) == nullptr);
+	CHECK(storage.Unmap());
+	CHECK(!storage.Unmap());
+
+	CHECK(storage.Update(4, 4, zeros));
+	CHECK(storage.Data()[4] == 0 && storage.Data()[7] == 0);
+	CHECK(!storage.Update(6, 4, zeros));
+	CHECK(storage.Map(6, 4, BUFFERMAP_WRITE) == nullptr);
+	CHECK(!storage.IsMapped());
+}
+
+static void TestCopyFromStreamBuffer()
+{
+	RecordingRenderDevice device;
+	VertexBuffer *vertexBuffer = device.CreateVertexBuffer(8, pattern);
+	StreamBuffer *streamBuffer = device.CreateStreamBuffer(64);
+
+	long long offset = -1;
+	void *memory = streamBuffer->Allocate(4, 4, offset);
+	CHECK(memory != nullptr);
+	const unsigned char data[4] = {9, 9, 9, 9};
+	std::memcpy(memory, data, sizeof(data));
+	device.CopyStreamToVertexBuffer(streamBuffer, offset, vertexBuffer, 2, 4);
+	streamBuffer->EndFrame();
+
+	const CPUBufferStorage &storage = RecordingRenderDevice::GetStorage(vertexBuffer);
+	CHECK(Unchanged(storage, 0, 2));
+	CHECK(std::memcmp(storage.Data() + 2, data, sizeof(data)) == 0);
+	CHECK(Unchanged(storage, 6, 8));
+
+	// Copies can't land in a buffer that is mapped
+	CHECK(device.MapVertexBuffer(vertexBuffer, 0, 8) != nullptr);
+	CHECK(streamBuffer->Allocate(4, 4, offset) != nullptr);
+	size_t uploads = device.GetStats().uploads;
+	device.CopyStreamToVertexBuffer(streamBuffer, offset, vertexBuffer, 0, 4);
+	CHECK(device.GetStats().uploads == uploads);
+	CHECK(device.UnmapVertexBuffer(vertexBuffer));
+
+	device.DestroyStreamBuffer(streamBuffer);
+	device.DestroyVertexBuffer(vertexBuffer);
+}
+
+int main()
+{
+	TestAllocateWrapsAround();
+	TestAllocateWaitsOnlyForBusyFrames();
+	TestAllocateAligns();
+	TestAllocateRejectsWhatCantFit();
+	TestEndFrameWithoutAllocations();
+	TestMapInvalidates();
+	TestMisuseIsRejected();
+	TestCopyFromStreamBuffer();
+	if (failures) std::cerr << failures << " checks failed" << std::endl;
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,145 @@
+#include <cstdint>
+#include <iostream>
+#include <vector>
+#include "Geomorph.hpp"
+
+static int failures = 0;
+
+#define CHECK(condition) \
+	do { \
+		if (!(condition)) \
+		{ \
+			std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #condition ") failed" << std::endl; \
+			failures++; \
+		} \
+	} while (0)
+
+static PMVertex MakeVertex(float x, float y)
+{
+	return PMVertex{{x, y, 0.f}, {0.f, 0.f, 1.f}, {1.f, 1.f, 1.f, 1.f}};
+}
+
+/**
+ * A square refined by two splits:
+ *
+ *   level 0: vertices 0-3, faces (0 1 3) and (0 3 2)
+ *   split 0: 3 splits into 4 and 5, face 0 moves to 4, face 1 to 5, face (0 4 5) comes back
+ *   split 1: 4 splits into 6 and 7, face 0 moves to 6, face 2 to 7, face (1 6 7) comes back
+ *
+ * So at level 2 the faces are (0 1 6), (0 5 2), (0 7 5) and (1 6 7), and 5, 6 and 7 all descend from 3.
+ */
+static bool BuildFile(ProgMeshFile & file)
+{
+	std::vector<PMVertex> vertices = {MakeVertex(0.f, 0.f), MakeVertex(2.f, 0.f), MakeVertex(0.f, 2.f),
+									  MakeVertex(2.f, 2.f), MakeVertex(3.f, 2.f), MakeVertex(2.f, 3.f),
+									  MakeVertex(4.f, 1.f), MakeVertex(3.f, 4.f)};
+	std::vector<uint32_t> faces = {0, 1, 3, 0, 3, 2, 0, 4, 5, 1, 6, 7};
+	std::vector<PMSplit> splits = {{3, 0, 1, 1, 2, 1, 0.5f}, {4, 2, 1, 1, 3, 1, 0.25f}};
+	std::vector<uint32_t> faceRefs = {0, 1, 0, 2};
+	return file.Assign(4, 2, vertices, faces, splits, faceRefs);
+}
+
+static glm::vec4 FilePosition(const ProgMeshFile & file, uint32_t vertex)
+{
+	const float * p = file.Vertices()[vertex].position;
+	return glm::vec4(p[0], p[1], p[2], 1.f);
+}
+
+/// The corners of each face of a level, as file vertices.
+static const uint32_t kLevel0Faces[] = {0, 1, 3, 0, 3, 2};
+static const uint32_t kLevel1Faces[] = {0, 1, 4, 0, 5, 2, 0, 4, 5};
+static const uint32_t kLevel2Faces[] = {0, 1, 6, 0, 5, 2, 0, 7, 5, 1, 6, 7};
+
+/// At blend factor t the morph has to look like the level given by its faces: the first ones in the same place,
+/// the rest without area.
+static void CheckLooksLike(const ProgMeshFile & file, const Geomorph & morph, float t, const uint32_t * levelFaces,
+						   size_t numLevelFaces)
+{
+	CHECK(morph.indices.size() % 3 == 0);
+	for (size_t f = 0; f < morph.indices.size() / 3; f++) {
+		glm::vec4 corners[3];
+		for (int i = 0; i < 3; i++) corners[i] = morph.PositionAt(morph.indices[3 * f + i], t);
+		if (f < numLevelFaces) {
+			for (int i = 0; i < 3; i++) CHECK(corners[i] == FilePosition(file, levelFaces[3 * f + i]));
+		} else {
+			glm::vec3 normal = glm::cross(glm::vec3(corners[1] - corners[0]), glm::vec3(corners[2] - corners[0]));
+			CHECK(normal == glm::vec3(0.f));
+		}
+	}
+}
+
+static void TestRefine()
+{
+	ProgMeshFile file;
+	CHECK(BuildFile(file));
+	if (file.Empty()) return;
+	GeomorphBuilder builder(file);
+	Geomorph morph;
+	builder.Build(0, 2, morph);
+	CHECK(morph.fromLevel == 0 && morph.toLevel == 2);
+
+	// The vertices of level 2, each starting at the one it descends from
+	const uint32_t fine[] = {0, 1, 2, 5, 6, 7};
+	const uint32_t ancestor[] = {0, 1, 2, 3, 3, 3};
+	CHECK(morph.vertices.size() == 6 && morph.fileVertices.size() == 6);
+	for (size_t i = 0; i < morph.fileVertices.size() && i < 6; i++) {
+		CHECK(morph.fileVertices[i] == fine[i]);
+		glm::vec4 from = FilePosition(file, ancestor[i]), to = FilePosition(file, fine[i]);
+		CHECK(morph.PositionAt(i, 0.f) == from);
+		CHECK(morph.PositionAt(i, 1.f) == to);
+		CHECK(morph.PositionAt(i, 0.5f) == (from + to) * 0.5f);
+	}
+
+	CHECK(morph.indices.size() == 12);
+	CheckLooksLike(file, morph, 0.f, kLevel0Faces, 2);
+	CheckLooksLike(file, morph, 1.f, kLevel2Faces, 4);
+}
+
+static void TestCoarsen()
+{
+	ProgMeshFile file;
+	CHECK(BuildFile(file));
+	if (file.Empty()) return;
+	GeomorphBuilder builder(file);
+	Geomorph morph;
+	builder.Build(2, 0, morph);
+	CHECK(morph.fromLevel == 2 && morph.toLevel == 0);
+	CheckLooksLike(file, morph, 0.f, kLevel2Faces, 4);
+	CheckLooksLike(file, morph, 1.f, kLevel0Faces, 2);
+	for (size_t i = 0; i < morph.vertices.size(); i++) {
+		glm::vec4 from = morph.PositionAt(i, 0.f), to = morph.PositionAt(i, 1.f);
+		CHECK(morph.PositionAt(i, 0.5f) == (from + to) * 0.5f);
+	}
+}
+
+/// Between two levels past the base, vertices split before the coarse level stay put.
+static void TestBetweenSplits()
+{
+	ProgMeshFile file;
+	CHECK(BuildFile(file));
+	if (file.Empty()) return;
+	GeomorphBuilder builder(file);
+	Geomorph morph;
+	builder.Build(1, 2, morph);
+	CheckLooksLike(file, morph, 0.f, kLevel1Faces, 3);
+	CheckLooksLike(file, morph, 1.f, kLevel2Faces, 4);
+	for (size_t i = 0; i < morph.fileVertices.size(); i++) {
+		uint32_t v = morph.fileVertices[i];
+		glm::vec4 from = FilePosition(file, v < 6 ? v : 4);
+		CHECK(morph.PositionAt(i, 0.f) == from);
+		CHECK(morph.PositionAt(i, 0.5f) == (from + FilePosition(file, v)) * 0.5f);
+	}
+
+	// The same level both ways is the level itself, standing still
+	builder.Build(1, 1, morph);
+	CheckLooksLike(file, morph, 0.5f, kLevel1Faces, 3);
+}
+
+int main()
+{
+	TestRefine();
+	TestCoarsen();
+	TestBetweenSplits();
+	if (failures) std::cerr << failures << " checks failed" << std::endl;
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,40 @@
+# Plays a scripted session on the cone without a window or GPU: halve it, collapse and restore a few pairs. Which pairs
+# are cheapest, and with that the exact uploads, depends on how the platform rounds, so only what has to hold anyway
+# is checked: nothing invalid is drawn, every frame draws the mesh twice, and the updates after filling the buffers
+# once send less than filling them again would.
+#
+#   cmake -DPROGRAM=<ProgressiveMeshes> -P HeadlessCone.cmake
+
+set(FRAMES 40)
+execute_process(COMMAND ${PROGRAM} data/cone.off --headless ${FRAMES} --key 2:h --key 5:- --key 20:=
+                OUTPUT_VARIABLE output
+                ERROR_VARIABLE errors
+                RESULT_VARIABLE result)
+message("${output}${errors}")
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "Exited with ${result}")
+endif()
+if(errors MATCHES "ERROR")
+    message(FATAL_ERROR "Reported an error")
+endif()
+
+if(NOT output MATCHES "Frames: ([0-9]+)\nDraws: ([0-9]+) ")
+    message(FATAL_ERROR "No frame or draw count")
+endif()
+set(frames ${CMAKE_MATCH_1})
+math(EXPR expectedDraws "2 * ${frames}")
+if(NOT frames EQUAL FRAMES OR NOT CMAKE_MATCH_2 EQUAL expectedDraws)
+    message(FATAL_ERROR "${CMAKE_MATCH_2} draws in ${frames} frames, expected ${expectedDraws} in ${FRAMES}")
+endif()
+
+if(NOT output MATCHES "invalid draws: 0\n")
+    message(FATAL_ERROR "Invalid draws")
+endif()
+
+if(NOT output MATCHES "Uploads: [0-9]+ \\(([0-9]+) bytes, ([0-9]+) of them filling whole buffers\\)")
+    message(FATAL_ERROR "No upload count")
+endif()
+math(EXPR updateBytes "${CMAKE_MATCH_1} - ${CMAKE_MATCH_2}")
+if(CMAKE_MATCH_2 EQUAL 0 OR NOT updateBytes LESS CMAKE_MATCH_2)
+    message(FATAL_ERROR "Updates sent ${updateBytes} bytes, filling the buffers took ${CMAKE_MATCH_2}")
+endif()
@@ -0,0 +1,153 @@
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "OffReader.hpp"
+
+static int failures = 0;
+
+#define CHECK(condition) \
+	do { \
+		if (!(condition)) \
+		{ \
+			std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #condition ") failed" << std::endl; \
+			failures++; \
+		} \
+	} while (0)
+
+/// Parses text as test.off, with what the reader reports in error.
+static bool Parse(const std::string & text, std::vector<Vertex> & vertices, std::vector<uint32_t> & indices,
+				  std::string & error)
+{
+	std::ostringstream captured;
+	std::streambuf * previous = std::cerr.rdbuf(captured.rdbuf());
+	OffReader reader;
+	bool result = reader.Parse(text.data(), text.size(), "test.off", vertices, indices);
+	std::cerr.rdbuf(previous);
+	error = captured.str();
+	return result;
+}
+
+/// Checks that text fails to parse with an error on the given line that contains message.
+static void CheckError(const std::string & text, size_t line, const std::string & message)
+{
+	std::vector<Vertex> vertices;
+	std::vector<uint32_t> indices;
+	std::string error;
+	bool parsed = Parse(text, vertices, indices, error);
+	CHECK(!parsed);
+	std::string where = "ERROR: test.off:" + std::to_string(line) + ": ";
+	bool found = error.compare(0, where.size(), where) == 0 && error.find(message) != std::string::npos;
+	if (!found) std::cerr << "  expected line " << line << ": " << message << ", got " << error;
+	CHECK(found);
+}
+
+static void TestTriangulation()
+{
+	const std::string text =
+		"# A pentagon, a square with a repeated corner and a triangle\n"
+		"OFF\n"
+		"\n"
+		"6 3 0\n"
+		"0 0 0\n"
+		"1 0 0\n"
+		"1.5 1 0 # comments may follow values\n"
+		"0.5 1.5 0\n"
+		"-0.5 1 0\n"
+		"\t-1e1  2.5E-1 +3\r\n"
+		"5 0 1 2 3 4\n"
+		"# in the middle of the faces too\n"
+		"4 0 1 1 2\n"
+		"3 5 0 4 1 0 0\n";
+	std::vector<Vertex> vertices;
+	std::vector<uint32_t> indices;
+	std::string error;
+	CHECK(Parse(text, vertices, indices, error));
+	CHECK(error.empty());
+	CHECK(vertices.size() == 6);
+	if (vertices.size() == 6) {
+		CHECK(vertices[2].mPos == glm::vec4(1.5f, 1.f, 0.f, 1.f));
+		CHECK(vertices[5].mPos == glm::vec4(-10.f, 0.25f, 3.f, 1.f));
+	}
+	// Fans around the first corner, leaving out the triangles of the repeated corner; the face color is ignored
+	CHECK((indices == std::vector<uint32_t>{0, 1, 2, 0, 2, 3, 0, 3, 4, 0, 1, 2, 5, 0, 4}));
+}
+
+static void TestHeaderAndColors()
+{
+	// Counts on the keyword line, no edge count, colors in [0, 255] without alpha and in [0, 1] with
+	std::vector<Vertex> vertices;
+	std::vector<uint32_t> indices;
+	std::string error;
+	CHECK(Parse("COFF 3 1\n0 0 0 255 0 51\n1 0 0 0 255 0\n0 1 0 0 0 255\n3 0 1 2\n", vertices, indices, error));
+	CHECK(vertices.size() == 3 && indices.size() == 3);
+	if (vertices.size() == 3) {
+		const glm::vec4 & color = vertices[0].mColor;
+		CHECK(color.x == 1.f && color.y == 0.f && std::fabs(color.z - 0.2f) < 1e-6f && color.w == 1.f);
+	}
+
+	CHECK(Parse("OFF\n3 1\n0 0 0 1 0.5 0 0.25\n1 0 0\n0 1 0\n3 0 1 2\n", vertices, indices, error));
+	if (vertices.size() == 3) CHECK(vertices[0].mColor == glm::vec4(1.f, 0.5f, 0.f, 0.25f));
+
+	// Normals are skipped
+	CHECK(Parse("NOFF\n3 1 0\n0 0 0 0 0 1\n1 0 0 0 0 1\n0 1 0 0 0 1\n3 0 1 2\n", vertices, indices, error));
+	if (vertices.size() == 3) CHECK(vertices[1].mPos == glm::vec4(1.f, 0.f, 0.f, 1.f));
+}
+
+static void TestErrors()
+{
+	CheckError("", 1, "Empty file");
+	CheckError("# nothing but\n\n# comments\n", 3, "Empty file");
+	CheckError("# comment\nPLY\n", 2, "Not an OFF file");
+	CheckError("4OFF\n", 1, "three-dimensional");
+	CheckError("OFF\n", 1, "Expected the vertex, face and edge counts");
+	CheckError("OFF\n# no counts\n", 2, "Expected the vertex, face and edge counts");
+	CheckError("OFF\n\n3 x 0\n", 3, "Expected the vertex, face and edge counts");
+	CheckError("OFF 3 1 0 7\n", 1, "Expected only the vertex, face and edge counts");
+	CheckError("OFF\n3 1 0\n0 0 0\n# one short\n1 0 0\n", 5, "The file ends after 2 of the 3 vertices");
+	CheckError("OFF\n3 2 0\n0 0 0\n1 0 0\n0 1 0\n3 0 1 2\n", 6, "The file ends after 1 of the 2 faces");
+	CheckError("OFF\n3 1 0\n0 0 0\n\n1 zero 0\n0 1 0\n3 0 1 2\n", 5, "Expected a number");
+	CheckError("OFF\n3 1 0\n0 0 0\n1 0 0 1\n0 1 0\n3 0 1 2\n", 4, "Expected 3 values for a vertex");
+	CheckError("OFF\n3 1 0\n0 0 0\n1 0 0\n0 1 0\n2 0 1\n", 6, "at least 3 vertices");
+	CheckError("OFF\n3 1 0\n0 0 0\n1 0 0\n0 1 0\n3 0 1 3\n", 6, "Vertex index 3 is out of range");
+	CheckError("OFF\n3 1 0\n0 0 0\n1 0 0\n0 1 0\n4 0 1 2\n", 6, "Expected 4 vertex indices");
+	CheckError("OFF\n3 1 0\n0 0 0\n1 0 0\n0 1 0\n3 0 1 2\n3 0 1 2\n", 7, "More vertices and faces than the header");
+}
+
+/// Files over a megabyte are parsed in chunks, each numbering its lines from where the one before it ends.
+static void TestChunks()
+{
+	const size_t numVertices = 200000;
+	std::string text = "OFF\n# many vertices\n" + std::to_string(numVertices) + " 1 0\n";
+	for (size_t v = 0; v < numVertices; v++) {
+		text += std::to_string(v % 1000) + ".25 " + std::to_string(v / 1000) + " 0\n";
+		if (v % 1000 == 0) text += "\n";
+	}
+	size_t lastVertexLine = 3 + numVertices + numVertices / 1000;
+	CHECK(text.size() > 2 << 20);
+	std::vector<Vertex> vertices;
+	std::vector<uint32_t> indices;
+	std::string error;
+	CHECK(Parse(text + "3 0 1 199999\n", vertices, indices, error));
+	CHECK(vertices.size() == numVertices);
+	if (vertices.size() == numVertices) CHECK(vertices[123456].mPos == glm::vec4(456.25f, 123.f, 0.f, 1.f));
+	CHECK((indices == std::vector<uint32_t>{0, 1, 199999}));
+
+	CheckError(text + "3 0 1 200000\n", lastVertexLine + 1, "Vertex index 200000 is out of range");
+	std::string broken = text;
+	size_t at = broken.find("\n456.25 123 0\n") + 1;
+	broken[at] = 'x';
+	CheckError(broken + "3 0 1 2\n", 3 + 123456 + 1 + 124, "Expected a number");
+}
+
+int main()
+{
+	TestTriangulation();
+	TestHeaderAndColors();
+	TestErrors();
+	TestChunks();
+	if (failures) std::cerr << failures << " checks failed" << std::endl;
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,196 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+#include "PairCostKernel.hpp"
+
+static int failures = 0;
+
+#define CHECK(condition) \
+	do { \
+		if (!(condition)) \
+		{ \
+			std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #condition ") failed" << std::endl; \
+			failures++; \
+		} \
+	} while (0)
+
+/// The path PairCostKernel.cpp takes with the flags this test is built with, see there.
+static const char * KernelPath()
+{
+#if defined(PAIRCOST_NO_SIMD)
+	return "scalar";
+#elif defined(__AVX__)
+	return "AVX";
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	return "SSE2";
+#else
+	return "scalar";
+#endif
+}
+
+/// A point in double, for the reference.
+struct Point
+{
+	double x, y, z;
+
+	Point operator+(const Point & p) const { return {x + p.x, y + p.y, z + p.z}; }
+	Point operator-(const Point & p) const { return {x - p.x, y - p.y, z - p.z}; }
+	Point operator*(double s) const { return {x * s, y * s, z * s}; }
+	double Length() const { return std::sqrt(x * x + y * y + z * z); }
+	glm::vec3 ToFloat() const { return glm::vec3((float)x, (float)y, (float)z); }
+	static Point FromFloat(const glm::vec3 & v) { return {v.x, v.y, v.z}; }
+};
+
+/// A unit sphere around center as a latitude/longitude grid without the poles: the vertices, and the summed plane
+/// quadric of the faces around each one, like ProgMesh computes them.
+struct Sphere
+{
+	static const int kRings = 11, kSegments = 24;
+
+	std::vector<glm::vec3> positions;
+	std::vector<Quadric> quadrics;
+
+	explicit Sphere(const Point & center)
+	{
+		const double pi = 3.14159265358979323846;
+		for (int r = 1; r <= kRings; r++) {
+			for (int s = 0; s < kSegments; s++) {
+				double theta = pi * r / (kRings + 1), phi = 2 * pi * s / kSegments;
+				Point p = {std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi)};
+				positions.push_back((center + p).ToFloat());
+			}
+		}
+		quadrics.resize(positions.size());
+		for (int r = 0; r + 1 < kRings; r++) {
+			for (int s = 0; s < kSegments; s++) {
+				uint32_t a = Index(r, s), b = Index(r, s + 1), c = Index(r + 1, s), d = Index(r + 1, s + 1);
+				AddFace(a, c, b);
+				AddFace(b, c, d);
+			}
+		}
+	}
+
+	uint32_t Index(int ring, int segment) const { return (uint32_t)(ring * kSegments + segment % kSegments); }
+
+	void AddFace(uint32_t a, uint32_t b, uint32_t c)
+	{
+		Point pa = Point::FromFloat(positions[a]), u = Point::FromFloat(positions[b]) - pa, v = Point::FromFloat(positions[c]) - pa;
+		Point n = {u.y * v.z - u.z * v.y, u.z * v.x - u.x * v.z, u.x * v.y - u.y * v.x};
+		n = n * (1.0 / n.Length());
+		Quadric q = Quadric::FromPlane(glm::vec4(n.ToFloat(), (float)-(n.x * pa.x + n.y * pa.y + n.z * pa.z)));
+		quadrics[a] += q;
+		quadrics[b] += q;
+		quadrics[c] += q;
+	}
+};
+
+/// The error of q at p, computed in double all the way.
+static double Error(const Quadric & q, const Point & p)
+{
+	return p.x * (q.a2 * p.x + 2.0 * (q.ab * p.y + q.ac * p.z + q.ad))
+		 + p.y * (q.b2 * p.y + 2.0 * (q.bc * p.z + q.bd))
+		 + p.z * (q.c2 * p.z + 2.0 * q.cd)
+		 + q.d2;
+}
+
+/// The least error the kernel could find for the pair: at the optimum of the 3x3 system, solved in double, or the
+/// best of the endpoints and the midpoint. The system counts as singular the same way as in the kernel.
+static double ReferenceError(const Quadric & q, const Point & p0, const Point & p1)
+{
+	double best = std::min(std::min(Error(q, p0), Error(q, p1)), Error(q, (p0 + p1) * 0.5));
+	double c00 = q.b2 * q.c2 - q.bc * q.bc, c01 = q.bc * q.ac - q.ab * q.c2, c02 = q.ab * q.bc - q.b2 * q.ac;
+	double c11 = q.a2 * q.c2 - q.ac * q.ac, c12 = q.ab * q.ac - q.a2 * q.bc, c22 = q.a2 * q.b2 - q.ab * q.ab;
+	double det = q.a2 * c00 + q.ab * c01 + q.ac * c02;
+	double trace = q.a2 + q.b2 + q.c2;
+	if (std::fabs(det) > 1e-5 * trace * trace * trace) {
+		Point optimum = {-(c00 * q.ad + c01 * q.bd + c02 * q.cd) / det, -(c01 * q.ad + c11 * q.bd + c12 * q.cd) / det,
+						 -(c02 * q.ad + c12 * q.bd + c22 * q.cd) / det};
+		best = std::min(best, Error(q, optimum));
+	}
+	return best;
+}
+
+/// Scores every edge of a sphere around center, in batches, and compares with the double reference.
+static void TestAgainstDouble(const Point & center)
+{
+	Sphere sphere(center);
+	struct Edge { uint32_t v0, v1; };
+	std::vector<Edge> edges;
+	for (int r = 0; r < Sphere::kRings; r++) {
+		for (int s = 0; s < Sphere::kSegments; s++) {
+			edges.push_back({sphere.Index(r, s), sphere.Index(r, s + 1)});
+			if (r + 1 < Sphere::kRings) edges.push_back({sphere.Index(r, s), sphere.Index(r + 1, s)});
+		}
+	}
+
+	size_t off = 0;
+	double maxDeviation = 0.0;
+	for (size_t first = 0; first < edges.size(); first += PairCostBatch::kBatchSize) {
+		PairCostBatch batch;
+		size_t last = std::min(first + PairCostBatch::kBatchSize, edges.size());
+		for (size_t i = first; i < last; i++) {
+			const Edge & e = edges[i];
+			batch.Add(sphere.quadrics[e.v0] + sphere.quadrics[e.v1], sphere.positions[e.v0], sphere.positions[e.v1]);
+		}
+		batch.Evaluate();
+		for (size_t i = first; i < last; i++) {
+			const Edge & e = edges[i];
+			Quadric q = sphere.quadrics[e.v0] + sphere.quadrics[e.v1];
+			Point p0 = Point::FromFloat(sphere.positions[e.v0]), p1 = Point::FromFloat(sphere.positions[e.v1]);
+			Point position = Point::FromFloat(batch.Position(i - first));
+			double cost = batch.Cost(i - first);
+
+			// The cost has to be the error at the position it comes with, and about as low as it gets. The errors
+			// here are around 1e-3. Rounding the position to float 10000 out moves them by up to about 2e-6, in
+			// absolute coordinates the float quadrics are off by 10 and more.
+			double reference = ReferenceError(q, p0, p1);
+			double tolerance = 1e-5 + 1e-3 * std::fabs(reference);
+			double deviation = std::max(std::fabs(cost - Error(q, position)), cost - reference);
+			maxDeviation = std::max(maxDeviation, deviation);
+			if (deviation > tolerance) off++;
+			// And the position stays with the pair
+			CHECK((position - (p0 + p1) * 0.5).Length() <= (p1 - p0).Length());
+		}
+	}
+	if (off) {
+		std::cerr << KernelPath() << " around (" << center.x << ", " << center.y << ", " << center.z << "): " << off
+				  << " of " << edges.size() << " pairs off by up to " << maxDeviation << std::endl;
+	}
+	CHECK(off == 0);
+}
+
+/// The same pair gets the same result alone as in a full batch.
+static void TestLanesAgree()
+{
+	Sphere sphere({0.0, 0.0, 0.0});
+	PairCostBatch alone, full;
+	Quadric q = sphere.quadrics[30] + sphere.quadrics[31];
+	alone.Add(q, sphere.positions[30], sphere.positions[31]);
+	alone.Evaluate();
+	for (size_t i = 0; i < PairCostBatch::kBatchSize; i++) {
+		uint32_t v = (uint32_t)(i == 5 ? 30 : 50 + 2 * i);
+		full.Add(sphere.quadrics[v] + sphere.quadrics[v + 1], sphere.positions[v], sphere.positions[v + 1]);
+	}
+	full.Evaluate();
+	CHECK(alone.Cost(0) == full.Cost(5));
+	CHECK(alone.Position(0) == full.Position(5));
+}
+
+int main()
+{
+#if defined(__AVX__) && (defined(__GNUC__) || defined(__clang__))
+	if (!__builtin_cpu_supports("avx")) {
+		std::cerr << "This CPU has no AVX, skipped" << std::endl;
+		return 77;
+	}
+#endif
+	TestAgainstDouble({0.0, 0.0, 0.0});
+	// Far enough out that the quadrics in float, in absolute coordinates, lose the error entirely
+	TestAgainstDouble({1000.0, -2000.0, 500.0});
+	TestAgainstDouble({-10000.0, 100.0, 5000.0});
+	TestLanesAgree();
+	if (failures) std::cerr << failures << " checks failed" << std::endl;
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,217 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "PlyReader.hpp"
+
+static int failures = 0;
+
+#define CHECK(condition) \
+	do { \
+		if (!(condition)) \
+		{ \
+			std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #condition ") failed" << std::endl; \
+			failures++; \
+		} \
+	} while (0)
+
+/// A binary PLY file being put together: the header text, then values in either byte order.
+struct PlyFile
+{
+	std::string data;
+	bool bigEndian;
+
+	PlyFile(bool bigEndian, const std::string & elements): bigEndian(bigEndian)
+	{
+		data = std::string("ply\nformat ") + (bigEndian ? "binary_big_endian" : "binary_little_endian") +
+			   " 1.0\ncomment made by PlyReaderTest\n" + elements + "end_header\n";
+	}
+
+	template <typename T>
+	PlyFile & Put(T value)
+	{
+		char bytes[sizeof(T)];
+		std::memcpy(bytes, &value, sizeof(T));
+		const uint16_t one = 1;
+		bool littleEndian = *reinterpret_cast<const uint8_t *>(&one) == 1;
+		if (littleEndian == bigEndian) std::reverse(bytes, bytes + sizeof(T));
+		data.append(bytes, sizeof(T));
+		return *this;
+	}
+};
+
+/// Parses data as test.ply, with what the reader reports in error.
+static bool Parse(const std::string & data, std::vector<Vertex> & vertices, std::vector<uint32_t> & indices,
+				  std::string & error, PlyReader & reader)
+{
+	std::ostringstream captured;
+	std::streambuf * previous = std::cerr.rdbuf(captured.rdbuf());
+	bool result = reader.Parse(data.data(), data.size(), "test.ply", vertices, indices);
+	std::cerr.rdbuf(previous);
+	error = captured.str();
+	return result;
+}
+
+static void CheckError(const std::string & data, const std::string & message)
+{
+	std::vector<Vertex> vertices;
+	std::vector<uint32_t> indices;
+	std::string error;
+	PlyReader reader;
+	CHECK(!Parse(data, vertices, indices, error, reader));
+	bool found = error.find(message) != std::string::npos;
+	if (!found) std::cerr << "  expected " << message << ", got " << error;
+	CHECK(found);
+}
+
+/// Four vertices with float positions, uchar colors and no alpha, and two triangles, in both byte orders.
+static void TestTriangles()
+{
+	for (int bigEndian = 0; bigEndian < 2; bigEndian++) {
+		PlyFile file(bigEndian != 0,
+					 "element vertex 4\nproperty float x\nproperty float y\nproperty float z\n"
+					 "property uchar red\nproperty uchar green\nproperty uchar blue\n"
+					 "element face 2\nproperty list uchar int vertex_indices\n");
+		const float positions[4][3] = {{0.f, 0.f, 0.f}, {1.5f, 0.f, 0.f}, {1.5f, -2.f, 0.f}, {0.f, 1e6f, 0.25f}};
+		for (int v = 0; v < 4; v++) {
+			file.Put(positions[v][0]).Put(positions[v][1]).Put(positions[v][2]);
+			file.Put<uint8_t>(255).Put<uint8_t>((uint8_t)(v * 51)).Put<uint8_t>(0);
+		}
+		file.Put<uint8_t>(3).Put<int32_t>(0).Put<int32_t>(1).Put<int32_t>(2);
+		file.Put<uint8_t>(3).Put<int32_t>(0).Put<int32_t>(2).Put<int32_t>(3);
+
+		std::vector<Vertex> vertices;
+		std::vector<uint32_t> indices;
+		std::string error;
+		PlyReader reader;
+		CHECK(Parse(file.data, vertices, indices, error, reader));
+		CHECK(error.empty());
+		CHECK(!reader.HasNormals());
+		CHECK(vertices.size() == 4);
+		for (size_t v = 0; v < vertices.size() && v < 4; v++) {
+			CHECK(vertices[v].mPos == glm::vec4(positions[v][0], positions[v][1], positions[v][2], 1.f));
+			CHECK(vertices[v].mColor.x == 1.f && vertices[v].mColor.z == 0.f && vertices[v].mColor.w == 1.f);
+			CHECK(vertices[v].mColor.y == (float)(v * 51 * (1.0 / 255.0)));
+		}
+		CHECK((indices == std::vector<uint32_t>{0, 1, 2, 0, 2, 3}));
+	}
+}
+
+/// The list counts and indices can be of any integer type, polygons are fan triangulated, and other properties and
+/// elements are skipped.
+static void TestListTypes()
+{
+	const char * const countTypes[] = {"uchar", "char", "ushort", "short", "uint", "int", "uint8", "int32"};
+	const char * const indexTypes[] = {"int", "uint", "ushort", "int16", "uint32", "int", "uchar", "uint"};
+	for (int t = 0; t < 8; t++) {
+		for (int bigEndian = 0; bigEndian < 2; bigEndian++) {
+			PlyFile file(bigEndian != 0,
+						 std::string("element vertex 5\nproperty double x\nproperty double y\nproperty double z\n"
+									 "property float nx\nproperty float ny\nproperty float nz\n"
+									 "property ushort diffuse_red\nproperty ushort diffuse_green\n"
+									 "property ushort diffuse_blue\nproperty ushort diffuse_alpha\n"
+									 "element face 3\nproperty uchar flags\nproperty list ") +
+							 countTypes[t] + " " + indexTypes[t] + " vertex_indices\nproperty float quality\n"
+							 "element edge 1\nproperty list uchar int vertices\n");
+			for (int v = 0; v < 5; v++) {
+				file.Put((double)v).Put(0.5 * v).Put(-1.0);
+				file.Put(0.f).Put(0.f).Put(1.f);
+				file.Put<uint16_t>(65535).Put<uint16_t>(0).Put<uint16_t>(0).Put<uint16_t>(65535);
+			}
+			auto putCount = [&](int count) {
+				switch (t) {
+					case 0: case 6: file.Put<uint8_t>((uint8_t)count); break;
+					case 1: file.Put<int8_t>((int8_t)count); break;
+					case 2: file.Put<uint16_t>((uint16_t)count); break;
+					case 3: file.Put<int16_t>((int16_t)count); break;
+					case 4: file.Put<uint32_t>((uint32_t)count); break;
+					default: file.Put<int32_t>(count); break;
+				}
+			};
+			auto putIndex = [&](int index) {
+				switch (t) {
+					case 2: file.Put<uint16_t>((uint16_t)index); break;
+					case 3: file.Put<int16_t>((int16_t)index); break;
+					case 6: file.Put<uint8_t>((uint8_t)index); break;
+					case 0: case 5: file.Put<int32_t>(index); break;
+					default: file.Put<uint32_t>((uint32_t)index); break;
+				}
+			};
+			// A triangle first, so the reader first decodes them as if all of them were, then a pentagon and a quad
+			// with a repeated corner
+			const std::vector<std::vector<int>> faces = {{4, 3, 2}, {0, 1, 2, 3, 4}, {1, 1, 2, 3}};
+			for (const std::vector<int> & face : faces) {
+				file.Put<uint8_t>(7);
+				putCount((int)face.size());
+				for (int index : face) putIndex(index);
+				file.Put(0.5f);
+			}
+			file.Put<uint8_t>(2).Put<int32_t>(0).Put<int32_t>(1);
+
+			std::vector<Vertex> vertices;
+			std::vector<uint32_t> indices;
+			std::string error;
+			PlyReader reader;
+			bool parsed = Parse(file.data, vertices, indices, error, reader);
+			if (!parsed) std::cerr << "  " << countTypes[t] << " counts of " << indexTypes[t] << " indices: " << error;
+			CHECK(parsed);
+			CHECK(reader.HasNormals());
+			CHECK((indices == std::vector<uint32_t>{4, 3, 2, 0, 1, 2, 0, 2, 3, 0, 3, 4, 1, 2, 3}));
+			CHECK(vertices.size() == 5);
+			if (vertices.size() == 5) {
+				CHECK(vertices[3].mPos == glm::vec4(3.f, 1.5f, -1.f, 1.f));
+				CHECK(vertices[3].mNormal == glm::vec4(0.f, 0.f, 1.f, 0.f));
+				CHECK(vertices[3].mColor == glm::vec4(1.f, 0.f, 0.f, 1.f));
+			}
+		}
+	}
+}
+
+static void TestErrors()
+{
+	const std::string triangle = "element vertex 3\nproperty float x\nproperty float y\nproperty float z\n"
+								 "element face 1\nproperty list uchar uint vertex_indices\n";
+	auto triangleFile = [&](uint32_t lastIndex) {
+		PlyFile file(true, triangle);
+		for (int i = 0; i < 9; i++) file.Put((float)i);
+		file.Put<uint8_t>(3).Put<uint32_t>(0).Put<uint32_t>(1).Put<uint32_t>(lastIndex);
+		return file.data;
+	};
+	{
+		std::vector<Vertex> vertices;
+		std::vector<uint32_t> indices;
+		std::string error;
+		PlyReader reader;
+		CHECK(Parse(triangleFile(2), vertices, indices, error, reader));
+		CHECK((indices == std::vector<uint32_t>{0, 1, 2}));
+	}
+	CheckError(triangleFile(3), "Face 0 refers to vertex 3, there are 3 vertices");
+	std::string cut = triangleFile(2);
+	CheckError(cut.substr(0, cut.size() - 20), "The file ends inside the vertex element");
+	CheckError(cut.substr(0, cut.size() - 2), "The file ends inside face 0");
+	CheckError("OFF\n", "test.ply:1: Not a PLY file");
+	CheckError("ply\nformat ascii 1.0\nend_header\n", "test.ply:2: ASCII PLY files are not supported");
+	CheckError("ply\nformat binary_little_endian 1.0\nelement vertex 3\n", "The file ends inside the header");
+	CheckError("ply\nformat binary_little_endian 1.0\nelement face 1\nproperty list float int vertex_indices\n"
+			   "end_header\n", "test.ply:4: Unknown list count type float");
+	CheckError("ply\nformat binary_big_endian 1.0\nelement vertex 0\nproperty float x\nend_header\n",
+			   "Expected a vertex and a face element");
+
+	PlyFile quad(false, "element vertex 3\nproperty float x\nproperty float y\nproperty float z\n"
+						"element face 1\nproperty list uchar int vertex_indices\n");
+	for (int i = 0; i < 9; i++) quad.Put((float)i);
+	quad.Put<uint8_t>(2).Put<int32_t>(0).Put<int32_t>(1);
+	CheckError(quad.data, "Face 0 has 2 vertices, it needs at least 3");
+}
+
+int main()
+{
+	TestTriangles();
+	TestListTypes();
+	TestErrors();
+	if (failures) std::cerr << failures << " checks failed" << std::endl;
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,128 @@
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "StlReader.hpp"
+
+static int failures = 0;
+
+#define CHECK(condition) \
+	do { \
+		if (!(condition)) \
+		{ \
+			std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #condition ") failed" << std::endl; \
+			failures++; \
+		} \
+	} while (0)
+
+static void PutUint32(std::string & data, uint32_t value)
+{
+	for (int i = 0; i < 4; i++) data.push_back((char)(value >> (8 * i)));
+}
+
+static void PutFloat(std::string & data, float value)
+{
+	uint32_t bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+	PutUint32(data, bits);
+}
+
+/// A binary STL file with the given header text, triangle count and triangles, the corners of the i-th one at
+/// (i, 0, 0), (i, 1, 0) and (i, 0, 1).
+static std::string BinaryStl(const std::string & header, uint32_t count, uint32_t numTriangles)
+{
+	std::string data = header;
+	data.resize(80, ' ');
+	PutUint32(data, count);
+	for (uint32_t i = 0; i < numTriangles; i++) {
+		for (int k = 0; k < 3; k++) PutFloat(data, k == 0 ? -1.f : 0.f);
+		const float corners[3][3] = {{(float)i, 0.f, 0.f}, {(float)i, 1.f, 0.f}, {(float)i, 0.f, 1.f}};
+		for (const auto & corner : corners) {
+			for (float value : corner) PutFloat(data, value);
+		}
+		data.append(2, '\0');
+	}
+	return data;
+}
+
+/// Parses data as test.stl, with what the reader reports in error.
+static bool Parse(const std::string & data, std::vector<Vertex> & vertices, std::vector<uint32_t> & indices,
+				  std::string & error)
+{
+	std::ostringstream captured;
+	std::streambuf * previous = std::cerr.rdbuf(captured.rdbuf());
+	StlReader reader;
+	bool result = reader.Parse(data.data(), data.size(), "test.stl", vertices, indices);
+	std::cerr.rdbuf(previous);
+	error = captured.str();
+	return result;
+}
+
+static void CheckError(const std::string & data, const std::string & message)
+{
+	std::vector<Vertex> vertices;
+	std::vector<uint32_t> indices;
+	std::string error;
+	CHECK(!Parse(data, vertices, indices, error));
+	bool found = error.find(message) != std::string::npos;
+	if (!found) std::cerr << "  expected " << message << ", got " << error;
+	CHECK(found);
+}
+
+/// Every corner becomes a vertex of its own.
+static void CheckTriangles(const std::string & data, uint32_t numTriangles)
+{
+	std::vector<Vertex> vertices;
+	std::vector<uint32_t> indices;
+	std::string error;
+	CHECK(Parse(data, vertices, indices, error));
+	CHECK(error.empty());
+	CHECK(vertices.size() == 3 * (size_t)numTriangles && indices.size() == 3 * (size_t)numTriangles);
+	for (uint32_t i = 0; i < indices.size(); i++) CHECK(indices[i] == i);
+	for (uint32_t t = 0; t < numTriangles && 3 * t + 2 < vertices.size(); t++) {
+		CHECK(vertices[3 * t].mPos == glm::vec4((float)t, 0.f, 0.f, 1.f));
+		CHECK(vertices[3 * t + 1].mPos == glm::vec4((float)t, 1.f, 0.f, 1.f));
+		CHECK(vertices[3 * t + 2].mPos == glm::vec4((float)t, 0.f, 1.f, 1.f));
+	}
+}
+
+static void TestBinary()
+{
+	CheckTriangles(BinaryStl("binary STL", 3, 3), 3);
+	// Plenty of exporters start the header of binary files with "solid" too
+	CheckTriangles(BinaryStl("solid cube, exported as binary", 2, 2), 2);
+	CheckTriangles(BinaryStl("solid", 0, 0), 0);
+	// Anything after the triangles the count gives is ignored
+	CheckTriangles(BinaryStl("binary STL", 2, 3), 2);
+}
+
+/// ASCII files are told apart from binary ones whose count doesn't fit their size.
+static void TestDetection()
+{
+	const std::string ascii = "solid triangle\n"
+							  "  facet normal 0 0 1\n"
+							  "    outer loop\n"
+							  "      vertex 0 0 0\n"
+							  "      vertex 1 0 0\n"
+							  "      vertex 0 1 0\n"
+							  "    endloop\n"
+							  "  endfacet\n"
+							  "endsolid triangle\n";
+	CheckError(ascii, "ASCII STL files are not supported");
+	CheckError("solid x\r\n\tendsolid x\r\n", "ASCII STL files are not supported");
+
+	// A binary file cut short, with or without "solid" in its header
+	CheckError(BinaryStl("binary STL", 3, 2), "The file ends before its 3 triangles");
+	CheckError(BinaryStl("solid", 1000, 2), "The file ends before its 1000 triangles");
+	CheckError(std::string(40, '\0'), "The file ends inside the header");
+}
+
+int main()
+{
+	TestBinary();
+	TestDetection();
+	if (failures) std::cerr << failures << " checks failed" << std::endl;
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,123 @@
+#include <cstdint>
+#include <iostream>
+#include <vector>
+#include "VertexWelder.hpp"
+
+static int failures = 0;
+
+#define CHECK(condition) \
+	do { \
+		if (!(condition)) \
+		{ \
+			std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #condition ") failed" << std::endl; \
+			failures++; \
+		} \
+	} while (0)
+
+static Vertex At(float x, float y, float z, float red = 1.f)
+{
+	return Vertex(glm::vec4(x, y, z, 1.f), glm::vec4(0.f, 0.f, 1.f, 0.f), glm::vec4(red, 0.f, 0.f, 1.f));
+}
+
+/// Two triangles of a square as a triangle soup: every corner is its own vertex, the shared ones at equal positions.
+/// The second copy of each shared corner is a bit off, by offset along x, and 0 is written as -0 there.
+static void MakeSoup(float offset, std::vector<Vertex> & vertices, std::vector<uint32_t> & indices)
+{
+	vertices = {At(0.f, 0.f, 0.f, 0.1f), At(1.f, 0.f, 0.f, 0.2f), At(1.f, 1.f, 0.f, 0.3f),
+				At(-0.f + offset, -0.f, -0.f, 0.4f), At(1.f + offset, 1.f, 0.f, 0.5f), At(0.f, 1.f, 0.f, 0.6f)};
+	indices = {0, 1, 2, 3, 4, 5};
+}
+
+/// With no tolerance only bitwise equal positions merge, -0 counting as 0.
+static void TestExact()
+{
+	std::vector<Vertex> vertices;
+	std::vector<uint32_t> indices;
+	MakeSoup(0.f, vertices, indices);
+	VertexWelder welder;
+	CHECK(welder.Weld(vertices, indices, 0.f) == 2);
+	CHECK(vertices.size() == 4);
+	CHECK((indices == std::vector<uint32_t>{0, 1, 2, 0, 2, 3}));
+	// The merged vertices keep the attributes of the lowest numbered one
+	CHECK(vertices[0].mColor.x == 0.1f && vertices[2].mColor.x == 0.3f && vertices[3].mColor.x == 0.6f);
+
+	MakeSoup(1e-6f, vertices, indices);
+	CHECK(welder.Weld(vertices, indices, 0.f) == 0);
+	CHECK(vertices.size() == 6);
+	CHECK((indices == std::vector<uint32_t>{0, 1, 2, 3, 4, 5}));
+}
+
+/// With a tolerance, vertices closer than it merge, and vertices further apart don't.
+static void TestEpsilon()
+{
+	std::vector<Vertex> vertices;
+	std::vector<uint32_t> indices;
+	VertexWelder welder;
+	MakeSoup(1e-6f, vertices, indices);
+	CHECK(welder.Weld(vertices, indices, 1e-5f) == 2);
+	CHECK(vertices.size() == 4);
+	CHECK((indices == std::vector<uint32_t>{0, 1, 2, 0, 2, 3}));
+
+	MakeSoup(1e-3f, vertices, indices);
+	CHECK(welder.Weld(vertices, indices, 1e-5f) == 0);
+	CHECK(vertices.size() == 6);
+
+	// Across a cell boundary of the grid, and with the whole mesh far from the origin
+	vertices = {At(1000.f, 2e-5f - 1e-6f, 0.f), At(1001.f, 0.f, 0.f), At(1000.f, 1.f, 0.f), At(1000.f, 2e-5f + 1e-6f, 0.f),
+				At(1000.f, -1.f, 0.f), At(1001.f, 0.f, 0.f)};
+	indices = {0, 1, 2, 3, 4, 5};
+	CHECK(welder.Weld(vertices, indices, 1e-5f) == 2);
+	CHECK((indices == std::vector<uint32_t>{0, 1, 2, 0, 3, 1}));
+}
+
+/// Triangles that lose a corner go, and so do triangles with the same corners as an earlier one, however they wind.
+/// So do the vertices only they used.
+static void TestTriangles()
+{
+	std::vector<Vertex> vertices = {At(0.f, 0.f, 0.f), At(1.f, 0.f, 0.f), At(0.f, 1.f, 0.f), At(1.f, 0.f, 0.f),
+									At(0.f, 0.f, 1.f), At(5.f, 5.f, 5.f), At(5.f, 5.f, 5.f), At(6.f, 5.f, 5.f)};
+	std::vector<uint32_t> indices = {
+		0, 1, 2, // kept
+		1, 2, 0, // the same, rotated
+		0, 3, 2, // the same once 3 is welded to 1
+		2, 1, 0, // the same, wound the other way
+		0, 1, 4, // kept
+		5, 6, 7, // loses a corner, 5 to 7 go with it
+		4, 1, 0, // the second one again
+		1, 2, 4 // kept
+	};
+	VertexWelder welder;
+	CHECK(welder.Weld(vertices, indices, 0.f) == 4);
+	CHECK(vertices.size() == 4);
+	CHECK((indices == std::vector<uint32_t>{0, 1, 2, 0, 1, 3, 1, 2, 3}));
+	CHECK(vertices[3].mPos == glm::vec4(0.f, 0.f, 1.f, 1.f));
+
+	// Enough triangles for different ones to collide in the hash table
+	const uint32_t size = 100;
+	vertices.clear();
+	indices.clear();
+	for (uint32_t y = 0; y <= size; y++) {
+		for (uint32_t x = 0; x <= size; x++) vertices.push_back(At((float)x, (float)y, 0.f));
+	}
+	for (int copy = 0; copy < 2; copy++) {
+		for (uint32_t y = 0; y < size; y++) {
+			for (uint32_t x = 0; x < size; x++) {
+				uint32_t a = y * (size + 1) + x, b = a + 1, c = a + size + 1, d = c + 1;
+				if (copy == 0) indices.insert(indices.end(), {a, b, d, a, d, c});
+				else indices.insert(indices.end(), {d, b, a, c, d, a});
+			}
+		}
+	}
+	std::vector<uint32_t> once(indices.begin(), indices.begin() + indices.size() / 2);
+	CHECK(welder.Weld(vertices, indices, 0.f) == 0);
+	CHECK(indices == once);
+}
+
+int main()
+{
+	TestExact();
+	TestEpsilon();
+	TestTriangles();
+	if (failures) std::cerr << failures << " checks failed" << std::endl;
+	return failures ? 1 : 0;
+}